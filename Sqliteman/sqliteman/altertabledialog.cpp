@@ -12,11 +12,15 @@ for which a new license (GPL+exception) is in place.
 	multiple collate are possible even with different collation names
 */
 
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtCore/QElapsedTimer>
+#include <QApplication>
 #include <QMessageBox>
+#include <QProgressDialog>
 #include <QSqlQuery>
 #include <QSqlError>
-#include <QTreeWidgetItem>
 
+#include <algorithm>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -25,9 +29,15 @@ for which a new license (GPL+exception) is in place.
 #include "mylineedit.h"
 #include "preferences.h"
 #include "sqlparser.h"
+#include "tablerebuild.h"
 #include "tabletree.h"
 #include "utils.h"
 
+// Virtual machine instructions between checks for cancelling the count
+#define ALTER_TABLE_PROGRESS_OPS 10000
+// How long counting waits for a lock held by the GUI's connection
+#define ALTER_TABLE_BUSY_TIMEOUT 2000
+
 namespace {
     // Static variable for createNew, prevents failure when using it
     // 21 times in a single sqliteman session.
@@ -73,7 +83,7 @@ void AlterTableDialog::resetClicked()
         if (m_item == NULL) { reject(); } // can't continue this dialog
     }
 	// Initialize fields
-	SqlParser * parsed = Database::parseTable(m_item->text(0), m_item->text(1));
+	SqlParserRef parsed = Database::parseTable(m_item->text(0), m_item->text(1));
 	m_fields = parsed->m_fields;
 	ui.columnTable->clearContents();
 	ui.columnTable->setRowCount(0);
@@ -108,16 +118,18 @@ void AlterTableDialog::resetClicked()
 		}
 	}
 
+	m_oldIndexed = m_isIndexed;
+	countPages();
+
 	m_hadRowid = parsed->m_hasRowid;
 	ui.withoutRowid->setChecked(!m_hadRowid);
-	delete parsed;
 	m_dropped = false;
 	checkChanges();
     fudge();
 }
 
 AlterTableDialog::AlterTableDialog(LiteManWindow * parent,
-								   QTreeWidgetItem * item,
+								   SchemaItem * item,
 								   const bool isActive)
 	: TableEditorDialog(parent),
 	  m_item(item)
@@ -187,12 +199,15 @@ AlterTableDialog::AlterTableDialog(LiteManWindow * parent,
 	ui.columnTable->setHorizontalHeaderItem(6, new QTableWidgetItem());
 	connect(ui.columnTable, SIGNAL(cellClicked(int, int)),
 			this, SLOT(cellClicked(int,int)));
+	// says whether the table will be altered in place or rebuilt
+	ui.adviceLabel->setWordWrap(true);
 	ui.adviceLabel->hide();
 	m_alterButton =
 		ui.buttonBox->addButton("Alte&r", QDialogButtonBox::ApplyRole);
 	m_alterButton->setDisabled(true);
 	connect(m_alterButton, SIGNAL(clicked(bool)),
 			this, SLOT(alterButton_clicked()));
+	connect(&m_pageCounter, SIGNAL(finished()), this, SLOT(pagesCounted()));
     Preferences * prefs = Preferences::instance();
 	resize(prefs->altertableWidth(), prefs->altertableHeight());
 	resetClicked();
@@ -200,6 +215,8 @@ AlterTableDialog::AlterTableDialog(LiteManWindow * parent,
 
 AlterTableDialog::~AlterTableDialog()
 {
+	m_cancelPages.storeRelease(1);
+	m_pageCounter.waitForFinished();
     Preferences * prefs = Preferences::instance();
     prefs->setaltertableHeight(height());
     prefs->setaltertableWidth(width());
@@ -584,6 +601,280 @@ void AlterTableDialog::restorePragmas() {
 // Renaming a column updates any foreign key references to it, regardless of
 // the settings of PRAGMAs legacy_alter_table and foreign_keys
 
+// The extras combo index which addField() gives to an existing column
+static int extraIndex(const FieldInfo & field)
+{
+	if (field.isNotNull) { return field.isUnique ? 2 : 1; }
+	else if (field.isAutoIncrement) { return 4; }
+	else if (field.isPartOfPrimaryKey) { return 3; }
+	else if (field.isUnique) { return 5; }
+	return 0;
+}
+
+bool AlterTableDialog::nativePlan(QStringList & statements, bool & rewrites)
+{
+	statements.clear();
+	rewrites = false;
+	if (m_hadRowid == ui.withoutRowid->isChecked()) { return false; }
+	int version = sqlite3_libversion_number();
+	QString table(Utils::q(m_databaseName) + "." + Utils::q(m_tableName));
+	QStringList drops;
+	QStringList renames;
+	QStringList adds;
+	QVector<bool> kept(m_fields.count(), false);
+	int lastOld = -1;
+	bool seenNew = false;
+	int n = ui.columnTable->rowCount();
+	for (int i = 0; i < n; ++i)
+	{
+		QString name(qobject_cast<QLineEdit*>
+			(ui.columnTable->cellWidget(i, 0))->text());
+		QComboBox * typeBox =
+			qobject_cast<QComboBox*>(ui.columnTable->cellWidget(i, 1));
+		QString type(typeBox->currentText());
+		QComboBox * extraBox =
+			qobject_cast<QComboBox*>(ui.columnTable->cellWidget(i, 2));
+		QString defval(qobject_cast<QLineEdit*>
+			(ui.columnTable->cellWidget(i, 3))->text());
+		int j = m_oldColumn[i];
+		if (j >= 0)
+		{
+			// old columns must stay in order and ahead of new ones
+			if (seenNew || (j < lastOld)) { return false; }
+			lastOld = j;
+			kept[j] = true;
+			FieldInfo & f = m_fields[j];
+			if (   ((type != f.type) && !(type.isEmpty() && f.type.isEmpty()))
+				|| (extraBox->currentIndex() != extraIndex(f))
+				|| (defval != SqlParser::defaultToken(f)))
+			{
+				return false;
+			}
+			if (name != f.name)
+			{
+				if (version < 3025000) { return false; }
+				renames.append(QString("ALTER TABLE %1 RENAME COLUMN %2 TO %3;")
+							   .arg(table, Utils::q(f.name), Utils::q(name)));
+			}
+		}
+		else
+		{
+			seenNew = true;
+			// ADD COLUMN can't add a key, and a NOT NULL column needs a
+			// constant non-null default
+			int extra = extraBox->currentIndex();
+			if ((extra > 1) || ((extra == 1) && defval.isEmpty()))
+			{
+				return false;
+			}
+			if (   defval.startsWith("(")
+				|| defval.startsWith("CURRENT_", Qt::CaseInsensitive))
+			{
+				return false;
+			}
+			QString column(Utils::q(name));
+			if (!type.isEmpty())
+			{
+				column += " "
+						  + ((typeBox->currentIndex() == 0) ? Utils::q(type)
+															: type);
+			}
+			if (extra == 1) { column += " NOT NULL"; }
+			if (!defval.isEmpty()) { column += " DEFAULT " + defval; }
+			adds.append(QString("ALTER TABLE %1 ADD COLUMN %2;")
+						.arg(table, column));
+		}
+	}
+	for (int j = 0; j < m_fields.count(); ++j)
+	{
+		if (kept[j]) { continue; }
+		// sqlite refuses to drop these
+		if (   (version < 3035000)
+			|| m_fields[j].isPartOfPrimaryKey
+			|| m_fields[j].isUnique
+			|| m_oldIndexed[j])
+		{
+			return false;
+		}
+		drops.append(QString("ALTER TABLE %1 DROP COLUMN %2;")
+					 .arg(table, Utils::q(m_fields[j].name)));
+		rewrites = true;
+	}
+	// a rename onto a name still in use would need an order to find
+	for (int i = 0; i < n; ++i)
+	{
+		int j = m_oldColumn[i];
+		if (j < 0) { continue; }
+		QString name(qobject_cast<QLineEdit*>
+			(ui.columnTable->cellWidget(i, 0))->text());
+		if (name == m_fields[j].name) { continue; }
+		for (int k = 0; k < m_fields.count(); ++k)
+		{
+			if (   (k != j) && kept[k]
+				&& !name.compare(m_fields[k].name, Qt::CaseInsensitive))
+			{
+				return false;
+			}
+		}
+	}
+	statements << drops << renames << adds;
+	return true;
+}
+
+void AlterTableDialog::countPages()
+{
+	// forget a count of the table as it was before an alteration,
+	// including one which has finished but not been taken yet
+	m_cancelPages.storeRelease(1);
+	m_pageCounter.waitForFinished();
+	m_pageCounter.setFuture(QFuture<PageCounts>());
+	m_cancelPages.storeRelease(0);
+
+	m_tablePages = -1;
+	m_indexPages = 0;
+	m_pagesExact = false;
+	m_pages.clear();
+	QString pageCount(Database::pragma("page_count"));
+	// until it has been counted, the whole file is the most it can be
+	if (!pageCount.isEmpty()) { m_tablePages = pageCount.toLongLong(); }
+
+	/* dbstat reads every page of the table, which would freeze the GUI on a
+	 * big one. A worker's connection only sees what has been committed, and
+	 * temporary and in-memory databases are private to the GUI's one. */
+	if (   !Database::isAutoCommit()
+		|| !m_databaseName.compare("temp", Qt::CaseInsensitive))
+	{
+		return;
+	}
+	QString file(Database::getDatabases().value(m_databaseName));
+	if (file.isEmpty()) { return; }
+	m_pageCounter.setFuture(QtConcurrent::run(&AlterTableDialog::readPages,
+											  file, m_tableName,
+											  &m_cancelPages));
+}
+
+int AlterTableDialog::progressHandler(void * cancel)
+{
+	return ((const QAtomicInt *)cancel)->loadAcquire();
+}
+
+AlterTableDialog::PageCounts AlterTableDialog::readPages(
+	const QString & file, const QString & table, const QAtomicInt * cancel)
+{
+	PageCounts pages;
+	sqlite3 * db = 0;
+	if (sqlite3_open_v2(file.toUtf8().constData(), &db,
+						SQLITE_OPEN_READONLY, 0) != SQLITE_OK)
+	{
+		sqlite3_close(db);
+		return pages;
+	}
+	sqlite3_busy_timeout(db, ALTER_TABLE_BUSY_TIMEOUT);
+	sqlite3_progress_handler(db, ALTER_TABLE_PROGRESS_OPS, progressHandler,
+							 (void *)cancel);
+	// the second argument makes dbstat add up the pages of each b-tree
+	const char * sql = "SELECT name, pageno FROM dbstat('main', 1) "
+					   "WHERE name IN (SELECT name FROM sqlite_master "
+					   "WHERE tbl_name = ?1);";
+	QByteArray name(table.toUtf8());
+	sqlite3_stmt * stmt = 0;
+	if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK)
+	{
+		sqlite3_bind_text(stmt, 1, name.constData(), name.size(),
+						  SQLITE_STATIC);
+		int rc;
+		while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+		{
+			pages.insert(QString::fromUtf8(
+							 (const char *)sqlite3_column_text(stmt, 0)),
+						 sqlite3_column_int64(stmt, 1));
+		}
+		// don't give a partial count
+		if (rc != SQLITE_DONE) { pages.clear(); }
+	}
+	sqlite3_finalize(stmt);
+	sqlite3_close(db);
+	return pages;
+}
+
+void AlterTableDialog::pagesCounted()
+{
+	// an empty future, set to forget an earlier count, has no result
+	if (m_pageCounter.future().resultCount() < 1) { return; }
+	PageCounts pages(m_pageCounter.result());
+	if (pages.isEmpty()) { return; }
+	m_pages = pages;
+	m_tablePages = 0;
+	m_indexPages = 0;
+	PageCounts::const_iterator i;
+	for (i = m_pages.constBegin(); i != m_pages.constEnd(); ++i)
+	{
+		if (!i.key().compare(m_tableName, Qt::CaseInsensitive))
+		{
+			m_tablePages = i.value();
+		}
+		else { m_indexPages += i.value(); }
+	}
+	m_pagesExact = true;
+	checkChanges();
+}
+
+void AlterTableDialog::showPath(bool rewrites)
+{
+	QString pages;
+	if (m_tablePages < 0)
+	{
+		pages = tr("an unknown number of");
+	}
+	else
+	{
+		qint64 n = m_tablePages;
+		if (!m_isNative) { n += m_indexPages; }
+		pages = m_pagesExact ? tr("about %1").arg(n) : tr("up to %1").arg(n);
+	}
+	QString text;
+	if (!m_altered)
+	{
+		text.clear();
+	}
+	else if (!m_isNative)
+	{
+		text = tr("The table will be rebuilt: %1 pages of data and indexes "
+				  "will be rewritten.").arg(pages);
+	}
+	else if (rewrites)
+	{
+		text = tr("The table will be altered in place, but dropping a "
+				  "column rewrites its rows: %1 pages.").arg(pages);
+	}
+	else
+	{
+		text = tr("The table will be altered in place: only the schema "
+				  "changes.");
+	}
+	ui.adviceLabel->setText(text);
+	ui.adviceLabel->setVisible(!text.isEmpty());
+}
+
+bool AlterTableDialog::doNative(QString newTableName)
+{
+	QStringList::const_iterator it;
+	for (it = m_native.constBegin(); it != m_native.constEnd(); ++it)
+	{
+		if (!execSql(*it, tr("Sqlite cannot alter the table in place")))
+		{
+			return true;
+		}
+	}
+	if (!renameTable(m_tableName, newTableName)) { return true; }
+	m_tableName = newTableName;
+	if (!execSql("RELEASE ALTER_TABLE;", tr("Cannot release savepoint")))
+	{
+		return true;
+	}
+	return false;
+}
+
 // This does the transaction inside alterButton_clicked()
 // so that cleanup happens in only one place.
 // returns true if we need to roll back
@@ -617,7 +908,7 @@ bool AlterTableDialog::doit(QString newTableName) {
 		return true;
 	}
 
-	// insert old data
+	// old data, copied by the rebuild job
 	QMap<QString,QString> columnMap; // old => new
 	QString insert;
 	QString select;
@@ -647,62 +938,118 @@ bool AlterTableDialog::doit(QString newTableName) {
 			columnMap.insert(m_fields[j].name, nameItem->text());
 		}
 	}
-    sql = "DROP TABLE ";
+	QString oldTable = Utils::q(m_item->text(1)) + "." + Utils::q(m_tableName);
+	// without page counts, the weights are only relative
+	qint64 tablePages = qMax(m_tablePages, (qint64)1000);
+	TableRebuild rebuild(Database::sqlite3handle());
 	if (!insert.isEmpty())
 	{
-		select += " FROM "
-				  + Utils::q(m_item->text(1))
-				  + "."
-				  + Utils::q(m_tableName)
-				  + ";";
-		message = tr("Cannot insert data into ")
-				  + newTableName;
-		if (!execSql(insert + select, message))
+		// by rowid if there is one and a column doesn't hide all its names
+		QString rowid;
+		if (m_hadRowid)
 		{
-            sql += Utils::q(m_item->text(1))
-                + "."
-                + Utils::q(newTableName)
-                + ";";
-            message = tr("Cannot drop table ")
-                    + newTableName;
-            execSql(sql, message);
-            return true;
+			QStringList columns;
+			foreach (const FieldInfo & f, m_fields) { columns.append(f.name); }
+			rowid = Utils::rowidAlias(columns);
 		}
+		rebuild.setCopy(insert, select, oldTable, rowid, tablePages);
 	}
 
 	// drop old table
-	sql += Utils::q(m_item->text(1))
-		   + "."
-		   + Utils::q(m_tableName)
-		   + ";";
-	message = tr("Cannot drop table ")
-			  + m_tableName;
-
-    if (!execSql(sql, message)) {
-        return true;
-    }
-	m_tableName = newTableName;
+	rebuild.addStep("DROP TABLE " + oldTable + ";",
+					tr("Dropping table %1").arg(m_tableName),
+					tr("Cannot drop table ") + m_tableName,
+					1 + tablePages / 20, true);
 
-	// restoring original triggers
-	// FIXME fix up if columns dropped or renamed
-    QStringList::const_iterator it;
-    for (it = originalSrc.constBegin(); it != originalSrc.constEnd(); ++it) {
-		// continue after failure here
-		(void)execSql(*it, tr("Cannot recreate original trigger"));
-	}
-
-	// recreate indices
+	// recreate indices, the biggest first, so that the estimate of the
+	// time remaining gets better as it goes
+	QList<QPair<qint64, QString> > indexes;
+	QMap<QString,QString> indexNames; // statement => index name
 	while (!originalIx.isEmpty())
 	{
 		SqlParser * parser = originalIx.takeFirst();
+		QString name(parser->m_indexName);
+		qint64 pages = m_pages.value(name, -1);
+		if (pages < 0)
+		{
+			// guess from how much of the row it holds
+			pages = tablePages
+					* Database::indexFields(name, m_item->text(1)).count()
+					/ qMax(m_fields.count(), 1);
+		}
 		if (parser->replace(columnMap, ui.nameEdit->text()))
 		{
-			// continue after failure here
-			(void)execSql(parser->toString(),
-						  tr("Cannot recreate index ") + parser->m_indexName);
+			indexes.append(qMakePair(-(pages + 1), parser->toString()));
+			indexNames.insert(parser->toString(), name);
 		}
 		delete parser;
 	}
+	std::sort(indexes.begin(), indexes.end());
+	for (int i = 0; i < indexes.count(); ++i)
+	{
+		// continue after failure here
+		QString name(indexNames.value(indexes[i].second));
+		rebuild.addStep(indexes[i].second,
+						tr("Creating index %1").arg(name),
+						tr("Cannot recreate index ") + name,
+						-indexes[i].first, false);
+	}
+
+	QProgressDialog progress(tr("Rebuilding %1").arg(newTableName),
+							 tr("Cancel"), 0, 1000, this);
+	connect(&progress, SIGNAL(canceled()), &rebuild, SLOT(cancel()));
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(1000);
+	QElapsedTimer timer;
+	timer.start();
+	rebuild.start();
+	while (!rebuild.wait(100))
+	{
+		qint64 done = rebuild.done();
+		QString text(rebuild.stepText());
+		if (text.isNull())
+		{
+			text = tr("Copying rows: %1 done").arg(rebuild.rowsCopied());
+		}
+		// the time remaining if the rest goes as fast as what's done
+		qint64 ms = timer.elapsed();
+		if ((done > 0) && (ms > 2000))
+		{
+			qint64 left = ms * (rebuild.total() - done) / done / 1000;
+			text += "\n" + tr("About %1:%2 remaining")
+							.arg(left / 60).arg(left % 60, 2, 10, QChar('0'));
+		}
+		progress.setLabelText(text);
+		progress.setValue((int)(done * 1000 / qMax(rebuild.total(), (qint64)1)));
+		qApp->processEvents();
+	}
+	progress.reset();
+
+	QStringList warnings(rebuild.warnings());
+	for (int i = 0; i < warnings.count(); ++i) { resultAppend(warnings[i]); }
+	if (rebuild.wasCancelled())
+	{
+		resultAppend(tr("Cancelled: the table has not been changed"));
+		return true;
+	}
+	if (!rebuild.errorString().isNull())
+	{
+		QString errtext = tr("Cannot rebuild table ") + m_tableName
+						  + ":<br/><span style=\" color:#ff0000;\">"
+						  + rebuild.errorString()
+						  + "<br/></span>";
+		resultAppend(errtext);
+		return true;
+	}
+	m_tableName = newTableName;
+
+	// restoring original triggers
+	// FIXME fix up if columns dropped or renamed
+    QStringList::const_iterator it;
+    for (it = originalSrc.constBegin(); it != originalSrc.constEnd(); ++it) {
+		// continue after failure here
+		(void)execSql(*it, tr("Cannot recreate original trigger"));
+	}
 
 	if (!execSql("RELEASE ALTER_TABLE;", tr("Cannot release savepoint")))
 	{
@@ -712,7 +1059,6 @@ bool AlterTableDialog::doit(QString newTableName) {
 }
 
 // User clicked on "Alter", go ahead and do it
-// FIXME Use ALTER TABLE RENAME COLUMN where appropriate
 void AlterTableDialog::alterButton_clicked()
 {
     ui.resultEdit->clear();
@@ -755,6 +1101,29 @@ void AlterTableDialog::alterButton_clicked()
 	}
 	ui.resultEdit->setHtml("");
 
+	// Renaming, appending or dropping columns doesn't need a rebuild,
+	// nor the pragma changes: sqlite fixes up indexes, triggers and views.
+	if (m_altered && m_isNative)
+	{
+		if (!execSql("SAVEPOINT ALTER_TABLE;", tr("Cannot create savepoint")))
+		{
+			return;
+		}
+		if (!doNative(newTableName))
+		{
+			m_updated = true;
+			m_item->setText(0, m_tableName);
+			emit rebuildTableTree(ui.databaseCombo->currentText());
+			m_item = NULL;
+			resetClicked();
+			resultAppend(tr("Table successfully altered"));
+			return;
+		}
+		doRollback(tr("Cannot roll back after error"));
+		m_tableName = m_item->text(0);
+		resultAppend(tr("Rebuilding the table instead"));
+	}
+
     m_oldPragmaAlterTable = Database::pragma("legacy_alter_table").toInt();
     m_oldPragmaForeignKeys = Database::pragma("foreign_keys").toInt();
     bool needPragmaChanges =   (m_oldPragmaAlterTable == 0)
@@ -834,14 +1203,14 @@ void AlterTableDialog::alterButton_clicked()
     }
     restorePragmas();
     if (failed) {
-        // reverse the rename if we did it
+        // reverse the rename if we did it, and keep the messages
         renameTable(savePointTableName, m_item->text(0));
-    } else {
-        m_updated = true;
-        m_item->setText(0, m_tableName);
-        emit rebuildTableTree(ui.databaseCombo->currentText());
-        m_item = NULL;
+        return;
     }
+    m_updated = true;
+    m_item->setText(0, m_tableName);
+    emit rebuildTableTree(ui.databaseCombo->currentText());
+    m_item = NULL;
     resetClicked();
     resultAppend(tr("Table successfully altered"));
 }
@@ -853,6 +1222,9 @@ void AlterTableDialog::checkChanges()
 	m_altered = m_hadRowid == ui.withoutRowid->isChecked();
 	m_altered |= m_dropped;
 	bool ok = checkOk(); // side-effect on m_dubious and m_altered
+	bool rewrites = false;
+	m_isNative = m_altered && nativePlan(m_native, rewrites);
+	showPath(rewrites);
     // Alter button is enabled if the current table definition is valid
     // and something has changed,
     // even if newName differs from m_tableName in case only.
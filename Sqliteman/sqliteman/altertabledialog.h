@@ -8,10 +8,13 @@ for which a new license (GPL+exception) is in place.
 #ifndef ALTERTABLEDIALOG_H
 #define ALTERTABLEDIALOG_H
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QFutureWatcher>
+
 #include "database.h"
 #include "tableeditordialog.h"
 
-class QTreeWidgetItem;
+class SchemaItem;
 class QPushButton;
 
 /*! \brief Handle alter table features.
@@ -21,8 +24,12 @@ Table Renaming is handled directly in the LiteManWindow
 method renameTable().
 Adding columns - see addColumns(). It's a wrapper around
 plain ALTER TABLE ADD COLUMN statement.
-Drop Column is using a workaround with tmp table, insert-select
-statement and renaming. See createButton_clicked()
+When the changes are only renaming, appending or dropping columns, they
+are made in place with ALTER TABLE RENAME COLUMN, ADD COLUMN and DROP
+COLUMN as far as the sqlite library supports them, see nativePlan().
+Anything else uses a workaround with tmp table, insert-select
+statement and renaming, which rewrites the whole table. See doit():
+the copy and the index rebuilds run as a cancellable TableRebuild job.
 \author Petr Vanek <petr@scribus.info>
 */
 
@@ -41,17 +48,29 @@ class AlterTableDialog : public TableEditorDialog // ->DialogCommon->QDialog
 
 	public:
 		AlterTableDialog(LiteManWindow * parent = 0,
-						 QTreeWidgetItem * item = 0,
+						 SchemaItem * item = 0,
 						 const bool isActive = false
 						);
 		~AlterTableDialog();
 
 	private:
-		QTreeWidgetItem * m_item;
+		//! \brief Pages of a table and of each of its indexes, by name
+		typedef QMap<QString,qint64> PageCounts;
+
+		SchemaItem * m_item;
 		QPushButton * m_alterButton;
 		QList<FieldInfo> m_fields;
 		QVector<bool> m_isIndexed;
 		QVector<int> m_oldColumn; // -1 if no old column
+		QVector<bool> m_oldIndexed; // by old column
+		QStringList m_native; // in-place statements if m_isNative
+		bool m_isNative;
+		qint64 m_tablePages; // -1 if unknown
+		qint64 m_indexPages;
+		bool m_pagesExact; // false if they are only an upper bound
+		PageCounts m_pages; // by table or index name, if exact
+		QFutureWatcher<PageCounts> m_pageCounter;
+		QAtomicInt m_cancelPages;
 		bool m_hadRowid;
 		bool m_alteringActive; // true if altering currently active table
 		bool m_altered; // something changed other than the name
@@ -106,11 +125,37 @@ class AlterTableDialog : public TableEditorDialog // ->DialogCommon->QDialog
         // does the internals of alterButton_clicked()
         bool doit(QString newTableName);
 
+		/*! \brief Work out ALTER TABLE statements which make the changes
+		without rebuilding the table.
+		\param statements gets them, drops first, then renames, then adds
+		\param rewrites set if a DROP COLUMN rewrites the table's rows
+		\retval false if the table has to be rebuilt
+		*/
+		bool nativePlan(QStringList & statements, bool & rewrites);
+		/*! \brief Run m_native in a savepoint, then rename the table.
+		\retval true if sqlite refused and it has been rolled back
+		*/
+		bool doNative(QString newTableName);
+		/*! \brief Set m_tablePages to the size of the whole file, and
+		start counting the table's pages exactly on a worker thread */
+		void countPages();
+		/*! \brief Count the pages of \a table and its indexes in \a file
+		with dbstat, on a read only connection of its own.
+		\retval PageCounts empty if they can't be counted */
+		static PageCounts readPages(const QString & file,
+									const QString & table,
+									const QAtomicInt * cancel);
+		static int progressHandler(void * cancel);
+		//! \brief Tell the user which way the table will be altered
+		void showPath(bool rewrites);
+
     signals:
 		void rebuildTableTree(QString schema);
 
 	private slots:
 		void cellClicked(int, int);
+		//! \brief Take the counts from readPages()
+		void pagesCounted();
 		void alterButton_clicked();
 
 		//! \brief Setup the Alter button if there is something changed
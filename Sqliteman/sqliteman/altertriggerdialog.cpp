@@ -9,15 +9,15 @@ for which a new license (GPL+exception) is in place.
 #include <QPushButton>
 #include <QSqlQuery>
 #include <QSqlError>
-#include <QTreeWidgetItem>
 
 #include "altertriggerdialog.h"
 #include "database.h"
 #include "preferences.h"
+#include "schemamodel.h"
 #include "utils.h"
 
 AlterTriggerDialog::AlterTriggerDialog(
-    QTreeWidgetItem * item, LiteManWindow * parent)
+    SchemaItem * item, LiteManWindow * parent)
 	: CreateTriggerDialog(item, parent)
 {
     m_databaseName = item->text(1);;
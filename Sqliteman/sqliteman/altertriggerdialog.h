@@ -10,7 +10,7 @@ for which a new license (GPL+exception) is in place.
 
 #include "createtriggerdialog.h"
 
-class QTreeWidgetItem;
+class SchemaItem;
 
 /*! \brief GUI for trigger altering
 \author Petr Vanek <petr@scribus.info>
@@ -20,7 +20,7 @@ class AlterTriggerDialog : public CreateTriggerDialog // ->DialogCommon->QDialog
 	Q_OBJECT
 
 	public:
-		AlterTriggerDialog(QTreeWidgetItem * item, LiteManWindow * parent = 0);
+		AlterTriggerDialog(SchemaItem * item, LiteManWindow * parent = 0);
 		~AlterTriggerDialog();
 
  		bool m_updated;
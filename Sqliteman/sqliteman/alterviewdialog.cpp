@@ -11,6 +11,7 @@ for which a new license (GPL+exception) is in place.
 #include <QtCore/QtDebug>
 
 #include "alterviewdialog.h"
+#include "catalogue.h"
 #include "database.h"
 #include "preferences.h"
 #include "utils.h"
@@ -102,6 +103,7 @@ void AlterViewDialog::createButton_clicked()
 						  + "<br/><tt>" + sql;
 		resultAppend(errtext);
 		QSqlQuery q3("ROLLBACK TO ALTER_VIEW;", db);
+		Catalogue::rolledBack();
 		if (q3.lastError().isValid())
 		{
 			resultAppend(tr("Cannot roll back after error"));
@@ -140,6 +142,7 @@ void AlterViewDialog::createButton_clicked()
 						  + "<br/><tt>" + sql;
 		resultAppend(errtext);
 		QSqlQuery q3("ROLLBACK TO ALTER_VIEW;", db);
+		Catalogue::rolledBack();
 		return;
 	}
 	sql = QString("RELEASE ALTER_VIEW ;");
@@ -153,6 +156,7 @@ void AlterViewDialog::createButton_clicked()
 						  + "<br/><tt>" + sql;
 		resultAppend(errtext);
 		QSqlQuery q6("ROLLBACK TO ALTER_VIEW;", db);
+		Catalogue::rolledBack();
 		if(q6.lastError().isValid())
 		{
 			QString errtext = tr("Cannot roll back either")
@@ -0,0 +1,179 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QtCore/QVariant>
+
+#include "catalogue.h"
+#include "utils.h"
+
+QHash<QString, Catalogue::Entry> Catalogue::m_entries;
+QAtomicInt Catalogue::m_rollbacks;
+
+void Catalogue::rollbackHook(void *)
+{
+	rolledBack();
+}
+
+int Catalogue::schemaVersion(const QString & schema)
+{
+	QSqlQuery query(QString("PRAGMA %1.schema_version;").arg(Utils::q(schema)),
+					QSqlDatabase::database(SESSION_NAME));
+	if (query.next()) { return query.value(0).toInt(); }
+	return -1; // not attached, or no database
+}
+
+CatalogueRef Catalogue::read(const QString & schema, int version)
+{
+	CatalogueSnapshot * s = new CatalogueSnapshot;
+	s->schema = schema;
+	s->version = version;
+	if (schema.compare("temp", Qt::CaseInsensitive))
+	{
+		s->system.insert("sqlite_master", "");
+	}
+	else
+	{
+		s->system.insert("sqlite_temp_master", "");
+	}
+
+	QSqlQuery query(QString("SELECT lower(type), name, tbl_name, "
+							"name LIKE 'sqlite_%', sql FROM %1;")
+					.arg(Database::getMaster(schema)),
+					QSqlDatabase::database(SESSION_NAME));
+	while (query.next())
+	{
+		QString type(query.value(0).toString());
+		QString name(query.value(1).toString());
+		QString parent(query.value(2).toString());
+		s->all.insertMulti(parent, name);
+		if (type == "trigger")
+		{
+			s->triggerSql.insert(name.toLower(), query.value(4).toString());
+		}
+		else
+		{
+			s->names.insert(name.toLower());
+			s->sql.insert(name.toLower(), query.value(4).toString());
+		}
+		if (!query.value(3).toBool())
+			s->objects[type].insertMulti(parent, name);
+		else if (type == "table")
+			s->system.insertMulti(parent, name);
+	}
+
+	if (query.lastError().isValid())
+	{
+		Database::exception(tr("Error reading the schema of %1: %2")
+							.arg(schema).arg(query.lastError().text()));
+		delete s;
+		return CatalogueRef();
+	}
+	return CatalogueRef(s);
+}
+
+Catalogue::Entry * Catalogue::entry(const QString & schema)
+{
+	QString key(schema.toLower());
+	int version = schemaVersion(schema);
+	if (version < 0)
+	{
+		m_entries.remove(key);
+		return 0;
+	}
+	// a new connection has no hook, and setting it again costs nothing
+	sqlite3 * db = Database::sqlite3handle();
+	if (db) { sqlite3_rollback_hook(db, rollbackHook, 0); }
+	int rollbacks = m_rollbacks.loadAcquire();
+	Entry & e = m_entries[key];
+	if (   e.snapshot.isNull() || (e.snapshot->version != version)
+		|| (e.rollbacks != rollbacks))
+	{
+		// anything parsed at the old version may be out of date
+		e.parsed.clear();
+		e.indexFields.clear();
+		e.sysIndexes.clear();
+		e.snapshot = read(schema, version);
+		e.rollbacks = rollbacks;
+		if (e.snapshot.isNull())
+		{
+			m_entries.remove(key);
+			return 0;
+		}
+	}
+	return &e;
+}
+
+CatalogueRef Catalogue::snapshot(const QString & schema)
+{
+	Entry * e = entry(schema);
+	return e ? e->snapshot : CatalogueRef();
+}
+
+SqlParserRef Catalogue::parsed(const QString & name, const QString & schema)
+{
+	Entry * e = entry(schema);
+	// callers expect a parser even if there is nothing to parse
+	if (!e) { return SqlParserRef(new SqlParser(QString())); }
+	QString key(name.toLower());
+	QHash<QString, SqlParserRef>::const_iterator i = e->parsed.constFind(key);
+	if (i != e->parsed.constEnd()) { return i.value(); }
+
+	SqlParserRef result(new SqlParser(e->snapshot->sql.value(key)));
+	e->parsed.insert(key, result);
+	return result;
+}
+
+QList<FieldInfo> Catalogue::tableFields(const QString & table,
+										const QString & schema)
+{
+	return parsed(table, schema)->m_fields;
+}
+
+QStringList Catalogue::indexFields(const QString & index,
+								   const QString & schema)
+{
+	Entry * e = entry(schema);
+	if (!e) { return QStringList(); }
+	QString key(index.toLower());
+	QHash<QString, QStringList>::const_iterator i =
+		e->indexFields.constFind(key);
+	if (i != e->indexFields.constEnd()) { return i.value(); }
+
+	bool ok;
+	QStringList result(Database::readIndexFields(index, schema, ok));
+	if (ok) { m_entries[schema.toLower()].indexFields.insert(key, result); }
+	return result;
+}
+
+QStringList Catalogue::sysIndexes(const QString & table,
+								  const QString & schema)
+{
+	Entry * e = entry(schema);
+	if (!e) { return QStringList(); }
+	QString key(table.toLower());
+	QHash<QString, QStringList>::const_iterator i =
+		e->sysIndexes.constFind(key);
+	if (i != e->sysIndexes.constEnd()) { return i.value(); }
+
+	bool ok;
+	QStringList result(Database::readSysIndexes(
+		table, schema, e->snapshot->objectsOf("index").values(table), ok));
+	if (ok) { m_entries[schema.toLower()].sysIndexes.insert(key, result); }
+	return result;
+}
+
+void Catalogue::clear()
+{
+	m_entries.clear();
+}
+
+void Catalogue::rolledBack()
+{
+	m_rollbacks.fetchAndAddRelease(1);
+}
@@ -0,0 +1,121 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef CATALOGUE_H
+#define CATALOGUE_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QSharedPointer>
+
+#include "database.h"
+
+/*! \brief What one schema's sqlite_master held at one schema_version.
+It is never changed once it has been made, so it can be shared.
+*/
+class CatalogueSnapshot
+{
+	public:
+		QString schema;
+		int version; //!< PRAGMA schema_version when it was read
+		DbObjects all; //!< every object, "its parent"/"object name"
+		//! \brief by lower case type, without the reserved "sqlite_%" names
+		QMap<QString, DbObjects> objects;
+		//! \brief the reserved "sqlite_%" tables and the master table
+		DbObjects system;
+		/*! \brief lower case names of the tables, views and indexes,
+		which share one name space */
+		QSet<QString> names;
+		/*! \brief CREATE statements of the tables, views and indexes
+		by lower case name */
+		QHash<QString, QString> sql;
+		/*! \brief CREATE statements of the triggers by lower case name:
+		a trigger can have the same name as a table */
+		QHash<QString, QString> triggerSql;
+
+		DbObjects objectsOf(const QString & type) const
+		{
+			return objects.value(type.toLower());
+		}
+};
+
+typedef QSharedPointer<const CatalogueSnapshot> CatalogueRef;
+
+/*! \brief In-memory cache of the schema for every attached database.
+Each schema's sqlite_master is read once into a CatalogueSnapshot, and
+the parsed CREATE statements and the fields of its tables and indexes are
+kept as they are asked for.
+Every lookup first checks PRAGMA schema_version, which sqlite changes
+with any change to the schema from any connection, and the schema is read
+again if it has changed. That costs no more than reading the database
+header, so the consumers which go through Database don't touch
+sqlite_master again until something alters the schema.
+A rollback puts the schema version back, and the next change to the schema
+can then reach the version of a snapshot which was read inside the rolled
+back transaction, so a snapshot is only trusted if there has been no
+rollback since it was read. Rollbacks of a whole transaction are seen by a
+hook on the GUI's connection, but ROLLBACK TO a savepoint doesn't call it,
+so whatever runs one must call rolledBack().
+The schema version doesn't say which file is attached under a name, so
+clear() must be called when databases are opened, attached or detached.
+It uses the GUI's connection, so only use it from the GUI thread, except
+for rolledBack().
+*/
+class Catalogue
+{
+		Q_DECLARE_TR_FUNCTIONS(Catalogue)
+
+	public:
+		/*! \brief The current objects of \a schema.
+		\retval CatalogueRef null if it can't be read */
+		static CatalogueRef snapshot(const QString & schema);
+
+		//! \brief See Database::parseTable()
+		static SqlParserRef parsed(const QString & name,
+								   const QString & schema);
+		//! \brief See Database::tableFields()
+		static QList<FieldInfo> tableFields(const QString & table,
+											const QString & schema);
+		//! \brief See Database::indexFields()
+		static QStringList indexFields(const QString & index,
+									   const QString & schema);
+		//! \brief See Database::getSysIndexes()
+		static QStringList sysIndexes(const QString & table,
+									  const QString & schema);
+
+		//! \brief Forget everything.
+		static void clear();
+
+		/*! \brief Don't trust any snapshot read before now.
+		Call it after a ROLLBACK TO on the GUI's connection, from any thread.
+		*/
+		static void rolledBack();
+
+	private:
+		typedef struct
+		{
+			CatalogueRef snapshot;
+			int rollbacks; //!< m_rollbacks when the snapshot was read
+			// by lower case name, as sqlite's names are case insensitive
+			QHash<QString, SqlParserRef> parsed;
+			QHash<QString, QStringList> indexFields;
+			QHash<QString, QStringList> sysIndexes;
+		}
+		Entry;
+
+		//! \brief The up to date entry for \a schema, or 0 on error
+		static Entry * entry(const QString & schema);
+		static int schemaVersion(const QString & schema);
+		static CatalogueRef read(const QString & schema, int version);
+		static void rollbackHook(void * context);
+
+		static QHash<QString, Entry> m_entries;
+		static QAtomicInt m_rollbacks;
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifdef ENABLE_CHANGESETS
+
+#include <QtCore/QFile>
+
+#include "changerecorder.h"
+#include "database.h"
+#include "utils.h"
+
+namespace
+{
+	//! \brief State shared with ChangeRecorder::conflict()
+	typedef struct
+	{
+		ChangeRecorder::Policy policy;
+		QStringList * log;
+	}
+	ApplyContext;
+};
+
+ChangeRecorder::ChangeRecorder(sqlite3 * db)
+	: m_db(db),
+	  m_session(0)
+{
+	start();
+}
+
+ChangeRecorder::~ChangeRecorder()
+{
+	// must go before the connection is closed
+	if (m_session) { sqlite3session_delete(m_session); }
+}
+
+bool ChangeRecorder::start()
+{
+	if (sqlite3session_create(m_db, "main", &m_session) != SQLITE_OK)
+	{
+		m_error = QString::fromUtf8(sqlite3_errmsg(m_db));
+		m_session = 0;
+		return false;
+	}
+	// all tables, including ones created later
+	if (sqlite3session_attach(m_session, 0) != SQLITE_OK)
+	{
+		m_error = QString::fromUtf8(sqlite3_errmsg(m_db));
+		sqlite3session_delete(m_session);
+		m_session = 0;
+		return false;
+	}
+	return true;
+}
+
+bool ChangeRecorder::isEmpty() const
+{
+	return !m_session || sqlite3session_isempty(m_session);
+}
+
+int ChangeRecorder::readChanges(void * in, void * data, int * size)
+{
+	qint64 n = static_cast<QFile *>(in)->read((char *)data, *size);
+	if (n < 0) { return SQLITE_IOERR; }
+	*size = (int)n;
+	return SQLITE_OK;
+}
+
+int ChangeRecorder::writeChanges(void * out, const void * data, int size)
+{
+	return (static_cast<QFile *>(out)->write((const char *)data, size) == size)
+		   ? SQLITE_OK : SQLITE_IOERR;
+}
+
+bool ChangeRecorder::save(const QString & fileName)
+{
+	if (!m_session)
+	{
+		m_error = tr("Changes are not being recorded");
+		return false;
+	}
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		m_error = tr("Unable to open file %1 for writing.").arg(fileName);
+		return false;
+	}
+	int rc = sqlite3session_changeset_strm(m_session, writeChanges, &file);
+	file.close();
+	if ((rc != SQLITE_OK) || (file.error() != QFile::NoError))
+	{
+		m_error = (rc == SQLITE_IOERR) ? file.errorString()
+									   : QString::fromUtf8(sqlite3_errstr(rc));
+		// keep recording into the same checkpoint
+		file.remove();
+		return false;
+	}
+	sqlite3session_delete(m_session);
+	m_session = 0;
+	return start();
+}
+
+QString ChangeRecorder::valueText(sqlite3_value * v)
+{
+	if (!v) { return "?"; }
+	switch (sqlite3_value_type(v))
+	{
+		case SQLITE_INTEGER:
+		case SQLITE_FLOAT:
+			return QString::fromUtf8((const char *)sqlite3_value_text(v));
+		case SQLITE_TEXT:
+			return Utils::q(QString::fromUtf8(
+				(const char *)sqlite3_value_text(v)), "'");
+		case SQLITE_BLOB:
+			return Database::hex(QByteArray(
+				(const char *)sqlite3_value_blob(v), sqlite3_value_bytes(v)));
+		default:
+			return "NULL";
+	}
+}
+
+int ChangeRecorder::conflict(void * context, int type,
+							 sqlite3_changeset_iter * it)
+{
+	ApplyContext * ctx = static_cast<ApplyContext *>(context);
+	if (type == SQLITE_CHANGESET_FOREIGN_KEY)
+	{
+		// not about any one change: reported once at the end
+		int n = 0;
+		sqlite3changeset_fk_conflicts(it, &n);
+		ctx->log->append(tr("%n foreign key constraint(s) would be violated",
+							0, n));
+		return (ctx->policy == Abort) ? SQLITE_CHANGESET_ABORT
+									  : SQLITE_CHANGESET_OMIT;
+	}
+
+	const char * table;
+	int columns;
+	int op;
+	int indirect;
+	unsigned char * pk;
+	sqlite3changeset_op(it, &table, &columns, &op, &indirect);
+	sqlite3changeset_pk(it, &pk, &columns);
+	QStringList key;
+	for (int i = 0; i < columns; ++i)
+	{
+		if (!pk[i]) { continue; }
+		sqlite3_value * v = 0;
+		if (op == SQLITE_INSERT) { sqlite3changeset_new(it, i, &v); }
+		else { sqlite3changeset_old(it, i, &v); }
+		key.append(valueText(v));
+	}
+	QString what;
+	switch (op)
+	{
+		case SQLITE_INSERT: what = "INSERT"; break;
+		case SQLITE_UPDATE: what = "UPDATE"; break;
+		default: what = "DELETE"; break;
+	}
+	QString why;
+	switch (type)
+	{
+		case SQLITE_CHANGESET_DATA:
+			why = tr("the row has been changed here too");
+			break;
+		case SQLITE_CHANGESET_NOTFOUND:
+			why = tr("the row does not exist");
+			break;
+		case SQLITE_CHANGESET_CONFLICT:
+			why = tr("the row already exists");
+			break;
+		default:
+			why = tr("a constraint would be violated");
+			break;
+	}
+	ctx->log->append(tr("%1 %2 (%3): %4")
+					 .arg(what).arg(Utils::q(QString::fromUtf8(table)))
+					 .arg(key.join(", ")).arg(why));
+
+	switch (ctx->policy)
+	{
+		case Abort:
+			return SQLITE_CHANGESET_ABORT;
+		case Replace:
+			// only these two have a row to replace
+			if (   (type == SQLITE_CHANGESET_DATA)
+				|| (type == SQLITE_CHANGESET_CONFLICT))
+			{
+				return SQLITE_CHANGESET_REPLACE;
+			}
+			return SQLITE_CHANGESET_OMIT;
+		default:
+			return SQLITE_CHANGESET_OMIT;
+	}
+}
+
+bool ChangeRecorder::apply(sqlite3 * db, const QString & fileName,
+						   Policy policy, QStringList & log, QString & error)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		error = tr("Cannot open file %1 for reading.").arg(fileName);
+		return false;
+	}
+	ApplyContext ctx;
+	ctx.policy = policy;
+	ctx.log = &log;
+	// this runs in a savepoint of its own
+	int rc = sqlite3changeset_apply_strm(db, readChanges, &file,
+										 0, conflict, &ctx);
+	if (rc == SQLITE_ABORT)
+	{
+		error = tr("Stopped at the first conflict; nothing was changed");
+		return false;
+	}
+	if (rc != SQLITE_OK)
+	{
+		error = QString::fromUtf8(sqlite3_errmsg(db));
+		return false;
+	}
+	return true;
+}
+
+#endif // ENABLE_CHANGESETS
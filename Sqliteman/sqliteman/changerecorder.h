@@ -0,0 +1,69 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef CHANGERECORDER_H
+#define CHANGERECORDER_H
+
+#ifdef ENABLE_CHANGESETS
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
+
+#include "sqlite3.h"
+
+/*! \brief Incremental dumps with the sqlite session extension.
+Records the changes made to the main database through Sqliteman's
+connection, so that they can be saved as a changeset which another copy
+of the database can apply. Every table with a PRIMARY KEY is recorded,
+including tables created later. Changes made by other programs are not.
+*/
+class ChangeRecorder
+{
+	Q_DECLARE_TR_FUNCTIONS(ChangeRecorder)
+
+	public:
+		//! \brief What to do with a change which conflicts
+		enum Policy { Skip, Replace, Abort };
+
+		ChangeRecorder(sqlite3 * db);
+		~ChangeRecorder();
+
+		bool isValid() const { return m_session != 0; }
+		//! \brief True if nothing has changed since the last checkpoint
+		bool isEmpty() const;
+		QString errorString() const { return m_error; }
+
+		/*! \brief Write the changes since the last checkpoint into
+		\a fileName and start a new checkpoint. Nothing is lost on failure.
+		*/
+		bool save(const QString & fileName);
+
+		/*! \brief Apply a changeset file in one transaction.
+		\param log gets a line for each conflict
+		\param error why it failed
+		\retval false if it failed or was aborted; nothing is changed then
+		*/
+		static bool apply(sqlite3 * db, const QString & fileName,
+						  Policy policy, QStringList & log, QString & error);
+
+	private:
+		bool start();
+
+		// sqlite callbacks
+		static int readChanges(void * in, void * data, int * size);
+		static int writeChanges(void * out, const void * data, int size);
+		static int conflict(void * context, int type,
+							sqlite3_changeset_iter * it);
+		static QString valueText(sqlite3_value * v);
+
+		sqlite3 * m_db;
+		sqlite3_session * m_session;
+		QString m_error;
+};
+
+#endif // ENABLE_CHANGESETS
+#endif
@@ -174,7 +174,7 @@ void CreateIndexDialog::resetClicked()
     ui.resultEdit->clear();
     ui.queryEditor->ui.termsTab->m_columnList.clear();
 	// Initialize fields
-	SqlParser * parsed = Database::parseTable(m_tableName, m_databaseName);
+	SqlParserRef parsed = Database::parseTable(m_tableName, m_databaseName);
 	QList<FieldInfo> fields = parsed->m_fields;
 	ui.columnTable->clearContents();
 	ui.columnTable->setRowCount(0);
@@ -183,7 +183,6 @@ void CreateIndexDialog::resetClicked()
         addField(fields[i]);
         ui.queryEditor->ui.termsTab->m_columnList.append(fields[i].name);
     }
-	delete parsed;
     ui.queryEditor->ui.termsTab->ui.orButton->setChecked(true);
     setFirstLine();
 	checkChanges();
@@ -369,6 +368,26 @@ CreateIndexDialog::~CreateIndexDialog() {
     prefs->setcreateindexWidth(width());
 }
 
+void CreateIndexDialog::setIndex(const QString & name,
+                                 const QStringList & columns)
+{
+    ui.nameEdit->setText(name);
+    SqlParserRef parsed = Database::parseTable(m_tableName, m_databaseName);
+    QList<FieldInfo> fields = parsed->m_fields;
+    ui.columnTable->clearContents();
+    ui.columnTable->setRowCount(0);
+    foreach (const QString & column, columns) {
+        for (int i = 0; i < fields.size(); ++i) {
+            if (fields[i].name.compare(column, Qt::CaseInsensitive) == 0) {
+                addField(fields[i]);
+                break;
+            }
+        }
+    }
+    setFirstLine();
+    checkChanges();
+}
+
 // public slots:
 
 // reimplementation of virtual function from TableEditorDialog
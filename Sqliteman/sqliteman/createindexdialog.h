@@ -56,6 +56,12 @@ public:
                         LiteManWindow * parent = 0);
     ~CreateIndexDialog();
 
+    /*! \brief Start from an index the user didn't design
+    \param name the index name
+    \param columns the columns to index, in order; others are dropped
+    */
+    void setIndex(const QString & name, const QStringList & columns);
+
 public slots:
     void checkChanges();
     void tableChanged(const QString table);
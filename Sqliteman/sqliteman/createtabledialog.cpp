@@ -10,16 +10,16 @@ for which a new license (GPL+exception) is in place.
 #include <QMessageBox>
 #include <QSqlQuery>
 #include <QSqlError>
-#include <QTreeWidgetItem>
 
 #include "createtabledialog.h"
 #include "database.h"
 #include "litemanwindow.h"
 #include "preferences.h"
+#include "schemamodel.h"
 #include "utils.h"
 
 CreateTableDialog::CreateTableDialog(LiteManWindow * parent,
-									 QTreeWidgetItem * item)
+									 SchemaItem * item)
 	: TableEditorDialog(parent)
 {
     ui.gridLayout->removeItem(ui.onTableBox);
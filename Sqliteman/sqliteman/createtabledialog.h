@@ -10,7 +10,7 @@ for which a new license (GPL+exception) is in place.
 
 #include "tableeditordialog.h"
 
-class QTreeWidgetItem;
+class SchemaItem;
 class QPushButton;
 
 /*! \brief A GUI for CREATE TABLE procedure.
@@ -22,7 +22,7 @@ class CreateTableDialog : public TableEditorDialog // ->DialogCommon->QDialog
 
     public:
         CreateTableDialog(LiteManWindow * parent = 0,
-                          QTreeWidgetItem * item = 0);
+                          SchemaItem * item = 0);
         ~CreateTableDialog();
 
     private:
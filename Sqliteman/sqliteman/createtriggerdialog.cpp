@@ -8,7 +8,6 @@ for which a new license (GPL+exception) is in place.
 #include <QPushButton>
 #include <QSqlQuery>
 #include <QSqlError>
-#include <QTreeWidgetItem>
 #include <QtCore/QSettings>
 
 #include "createtriggerdialog.h"
@@ -18,7 +17,7 @@ for which a new license (GPL+exception) is in place.
 #include "tabletree.h"
 #include "utils.h"
 
-CreateTriggerDialog::CreateTriggerDialog(QTreeWidgetItem * item,
+CreateTriggerDialog::CreateTriggerDialog(SchemaItem * item,
 										 LiteManWindow * parent)
 	: DialogCommon(parent)
 {
@@ -13,7 +13,7 @@ for which a new license (GPL+exception) is in place.
 #include "dialogcommon.h"
 #include "ui_createtriggerdialog.h"
 
-class QTreeWidgetItem;
+class SchemaItem;
 
 /*! \brief GUI for trigger creation
 \author Petr Vanek <petr@scribus.info>
@@ -23,7 +23,7 @@ class CreateTriggerDialog : public DialogCommon // ->QDialog
 	Q_OBJECT
 
 	public:
-		CreateTriggerDialog(QTreeWidgetItem * item, LiteManWindow * parent = 0);
+		CreateTriggerDialog(SchemaItem * item, LiteManWindow * parent = 0);
 		~CreateTriggerDialog();
 
 		bool m_updated;
@@ -7,12 +7,12 @@ for which a new license (GPL+exception) is in place.
 
 #include <QMessageBox>
 #include <QPushButton>
-#include <QTreeWidgetItem>
 
 #include "createviewdialog.h"
 #include "database.h"
 #include "litemanwindow.h"
 #include "preferences.h"
+#include "schemamodel.h"
 
 bool CreateViewDialog::checkColumn(int i, QString cname,
 								   QString ctype, QString cextra)
@@ -21,7 +21,7 @@ bool CreateViewDialog::checkColumn(int i, QString cname,
 }
 
 CreateViewDialog::CreateViewDialog(LiteManWindow * parent,
-									 QTreeWidgetItem * item)
+									 SchemaItem * item)
 	: TableEditorDialog(parent)
 {
     ui.gridLayout->removeItem(ui.onTableBox);
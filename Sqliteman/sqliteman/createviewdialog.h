@@ -13,7 +13,7 @@ for which a new license (GPL+exception) is in place.
 #include "litemanwindow.h"
 #include "tableeditordialog.h"
 
-class QTreeWidgetItem;
+class SchemaItem;
 class QPushButton;
 
 /*! \brief GUI for view creation
@@ -31,7 +31,7 @@ class CreateViewDialog : public TableEditorDialog // ->DialogCommon->QDialog
 
 	public:
 		CreateViewDialog(LiteManWindow * parent = 0,
-						  QTreeWidgetItem * item = 0);
+						  SchemaItem * item = 0);
 		~CreateViewDialog();
 		void setSql(QString query);
 
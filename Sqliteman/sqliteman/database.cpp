@@ -14,6 +14,7 @@ for which a new license (GPL+exception) is in place.
 #include <QtCore/QFile>
 #include <QMessageBox>
 
+#include "catalogue.h"
 #include "database.h"
 #include "preferences.h"
 #include "sqlparser.h"
@@ -38,6 +39,7 @@ QSqlQuery Database::doSql(QString statement)
 QSqlQuery Database::runSql(QString statement)
 {
 	QSqlQuery query(statement, QSqlDatabase::database(SESSION_NAME));
+	if (Utils::rollsBack(statement)) { Catalogue::rolledBack(); }
 	if (query.lastError().isValid())
 	{
 		exception(query.lastQuery());
@@ -73,41 +75,24 @@ DbAttach Database::getDatabases()
 	return ret;
 }
 
-SqlParser * Database::parseTable(const QString & table, const QString & schema)
+SqlParserRef Database::parseTable(const QString & table,
+								  const QString & schema)
 {
-	// Build a query string to SELECT the CREATE statement from sqlite_master
-	QString createSQL = QString("SELECT sql FROM ")
-						+ getMaster(schema)
-						+ " WHERE lower(name) = "
-						+ Utils::q(table.toLower())
-						+ ";";
-	// Run the query
-
-	QSqlQuery createQuery(createSQL, QSqlDatabase::database(SESSION_NAME));
-	// Make sure the query ran successfully
-	if(createQuery.lastError().isValid()) {
-		exception(tr("Error grabbing CREATE statement: ")
-				  + table
-				  + ": "
-				  + createQuery.lastError().text());
-	}
-	// Position the Query on the first (only) result
-	createQuery.first();
-	// Grab the complete CREATE statement
-	QString createStatement = createQuery.value(0).toString();
-
-	// Parse the CREATE statement
-	return new SqlParser(createStatement);
+	return Catalogue::parsed(table, schema);
 }
 
 QList<FieldInfo> Database::tableFields(const QString & table, const QString & schema)
 {
-	SqlParser * parser = parseTable(table, schema);
-	QList<FieldInfo> result(parser->m_fields);
-	delete parser;
-	return result;
+	return Catalogue::tableFields(table, schema);
 }
+
 QStringList Database::indexFields(const QString & index, const QString &schema)
+{
+	return Catalogue::indexFields(index, schema);
+}
+
+QStringList Database::readIndexFields(const QString & index,
+									  const QString & schema, bool & ok)
 {
 	QString sql = QString("PRAGMA ")
 				  + Utils::q(schema)
@@ -117,7 +102,8 @@ QStringList Database::indexFields(const QString & index, const QString &schema)
 	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
 	QStringList fields;
 
-	if (query.lastError().isValid())
+	ok = !query.lastError().isValid();
+	if (!ok)
 	{
         exception(tr("Error while getting the fields of ")
         		  + index
@@ -134,40 +120,20 @@ QStringList Database::indexFields(const QString & index, const QString &schema)
 
 DbObjects Database::getObjects(const QString type, const QString schema)
 {
-	DbObjects objs;
-
-	QString sql;
-	if (type.isNull())
-	{
-        sql = QString("SELECT name, tbl_name FROM ")
-			  + getMaster(schema)
-			  + ";";
-	}
-	else
-	{
-        sql = QString("SELECT name, tbl_name FROM ")
-			  + getMaster(schema)
-			  + " WHERE lower(type) = "
-			  + Utils::q(type.toLower())
-			  + " and name not like 'sqlite_%';";
-	}
-
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
-	while(query.next())
-		objs.insertMulti(query.value(1).toString(), query.value(0).toString());
-
-	if(query.lastError().isValid())
-		exception(tr("Error getting the list of ")
-				  + type
-				  + ": "
-				  + query.lastError().text());
-
-	return objs;
+	CatalogueRef catalogue = Catalogue::snapshot(schema);
+	if (!catalogue) { return DbObjects(); }
+	return type.isNull() ? catalogue->all : catalogue->objectsOf(type);
 }
 
 QStringList Database::getSysIndexes(const QString & table, const QString & schema)
 {
-	QStringList orig = Database::getObjects("index", schema).values(table);
+	return Catalogue::sysIndexes(table, schema);
+}
+
+QStringList Database::readSysIndexes(const QString & table,
+									 const QString & schema,
+									 const QStringList & indexes, bool & ok)
+{
 	// really all indexes
 	QStringList sysIx;
 	QSqlQuery query(QString("PRAGMA ")
@@ -180,11 +146,12 @@ QStringList Database::getSysIndexes(const QString & table, const QString & schem
 	while(query.next())
 	{
 		curr = query.value(1).toString();
-		if (!orig.contains(curr))
+		if (!indexes.contains(curr))
 			sysIx.append(curr);
 	}
 
-	if(query.lastError().isValid())
+	ok = !query.lastError().isValid();
+	if (!ok)
 		exception(tr("Error getting the list of indexes: ")
 				  + query.lastError().text());
 
@@ -193,28 +160,8 @@ QStringList Database::getSysIndexes(const QString & table, const QString & schem
 
 DbObjects Database::getSysObjects(const QString & schema)
 {
-	DbObjects objs;
-
-    QSqlQuery query(QString("SELECT name, tbl_name FROM %1 "
-							"WHERE type = 'table' and name like 'sqlite_%';")
-					.arg(getMaster(schema)),
-					QSqlDatabase::database(SESSION_NAME));
-
-	if (schema.compare("temp", Qt::CaseInsensitive))
-	{
-		objs.insert("sqlite_master", "");
-	}
-	else
-	{
-		objs.insert("sqlite_temp_master", "");
-	}
-	while(query.next())
-		objs.insertMulti(query.value(1).toString(), query.value(0).toString());
-
-	if(query.lastError().isValid())
-		exception(tr("Error getting the system catalogue: %1.").arg(query.lastError().text()));
-
-	return objs;
+	CatalogueRef catalogue = Catalogue::snapshot(schema);
+	return catalogue ? catalogue->system : DbObjects();
 }
 
 bool Database::dropView(const QString & view, const QString & schema)
@@ -297,111 +244,6 @@ bool Database::exportSql(const QString & fileName)
 	return true;
 }
 
-// TODO/FIXME: it definitely requires worker thread - to unfreeze GUI
-bool Database::dumpDatabase(const QString & fileName)
-{
-	QFile file(fileName);
-	
-	if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
-	{
-		exception(tr("Unable to open file %1 for writing.").arg(fileName));
-		return false;
-	}
-
-	QTextStream stream(&file);
-	
-	// Run query for whole schema
-	QString sql = "SELECT sql FROM sqlite_master;";
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
-	
-	if (query.lastError().isValid())
-	{
-		exception(tr(
-			"Error while reading sqlite_master: %1."
-        ).arg(query.lastError().text()));
-		return false;
-	}
-	
-	stream << "BEGIN TRANSACTION;\n";
-	while(query.next())
-    {
-        QString row = query.value(0).toString();
-        row.replace("CREATE INDEX", "CREATE INDEX IF NOT EXISTS");
-        row.replace("CREATE TABLE", "CREATE TABLE IF NOT EXISTS");
-        row.replace("CREATE TRIGGER", "CREATE TRIGGER IF NOT EXISTS");
-        row.replace("CREATE VIEW", "CREATE VIEW IF NOT EXISTS");
-		stream << row << ";\n";
-    }
-
-    // Run query on each table
-	sql = "SELECT name, sql FROM sqlite_master WHERE type = \"table\";";
-	QSqlQuery q1(sql, QSqlDatabase::database(SESSION_NAME));
-	if (q1.lastError().isValid())
-	{
-		exception(tr(
-			"Error while reading table names: %1."
-        ).arg(q1.lastError().text()));
-		return false;
-	}
-	while(q1.next())
-    {
-        QString tablename = q1.value(0).toString();
-        sql = "SELECT * FROM ";
-        sql.append(Utils::q(tablename)).append(";");
-        QSqlQuery q2(sql, QSqlDatabase::database(SESSION_NAME));
-        if (q2.lastError().isValid())
-        {
-            exception(tr(
-                "Error while reading table %1: %2."
-            ).arg(Utils::q(tablename)).arg(q2.lastError().text()));
-            return false;
-        }
-        QString fnames;
-        while(q2.next())
-        {
-            int i;
-            QSqlRecord rec = q2.record();
-            QString sep = "";
-            if (fnames.isNull())
-            {
-                fnames = "INSERT OR REPLACE INTO ";
-                fnames.append(Utils::q(tablename)).append(" ( ");
-                QString sep = "";
-                for (i = 0; i < rec.count(); ++i)
-                {
-                    fnames.append(sep).append(Utils::q(rec.fieldName(i)));
-                    sep = ", ";
-                }
-                fnames.append(" ) VALUES ( ");
-            }
-            stream << fnames;
-            sep = "";
-            for (i = 0; i < rec.count(); ++i)
-            {
-                QVariant v =rec.value(i);
-                if (v.isNull())
-                {
-                    stream << sep << "NULL";
-                }
-                else if (v.type() == QVariant::LongLong)
-                {
-                    stream << sep << v.toString();
-                }
-                else
-                {
-                    stream << sep << Utils::q(v.toString(), "'");
-                }
-                sep = ", ";
-            }
-            stream << " );\n";
-        }
-    }
-	stream << "COMMIT;\n";
-	
-	file.close();
-	return true;
-}
-
 QString Database::describeObject(const QString & name,
 								 const QString & schema,
 								 const QString & type)
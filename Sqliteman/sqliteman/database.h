@@ -11,6 +11,7 @@ for which a new license (GPL+exception) is in place.
 #include <QtCore/QCoreApplication>
 #include <QSqlDatabase>
 #include <QSqlQuery>
+#include <QtCore/QSharedPointer>
 #include <QtCore/QStringList>
 
 #include "sqlite3.h"
@@ -23,6 +24,10 @@ for which a new license (GPL+exception) is in place.
  */
 #define SESSION_NAME "sqliteman-db"
 
+/*! \brief A parsed CREATE statement shared from the Catalogue.
+Nothing may change it, since others may be looking at it too. */
+typedef QSharedPointer<const SqlParser> SqlParserRef;
+
 /*! \brief This struct is a sqlite3 table column representation.
 Something like a system catalogue item */
 typedef struct
@@ -147,11 +152,11 @@ class Database
 		@brief Returns parsed info for a table
 		@param table The table to retreive the fields from
 		\param schema a name of the DB schema
-		@return a pointer to a new SqlParser: the caller is responsible for
-		destroying it
+		@return the parsed CREATE statement, which is only parsed again
+		when the schema has changed
 		*/
-		static SqlParser * parseTable(const QString & table,
-									  const QString & schema);
+		static SqlParserRef parseTable(const QString & table,
+									   const QString & schema);
 
 		//! \brief Returns the list of columns in given index
 		static QStringList indexFields(const QString & index, const QString &schema);
@@ -180,8 +185,6 @@ class Database
 		*/
 		static bool exportSql(const QString & fileName);
 
-		static bool dumpDatabase(const QString & fileName);
-
 		static QString describeObject(const QString & name,
 									  const QString & schema,
 									  const QString & type);
@@ -225,8 +228,18 @@ class Database
 		static int makeUserFunctions();
 
 	private:
+		friend class Catalogue;
+
 		//! \brief Error feedback to the user.
 		static void exception(const QString & message);
+
+		// the uncached lookups behind Catalogue
+		static QStringList readIndexFields(const QString & index,
+										   const QString & schema, bool & ok);
+		static QStringList readSysIndexes(const QString & table,
+										  const QString & schema,
+										  const QStringList & indexes,
+										  bool & ok);
 };
 
 #endif
@@ -0,0 +1,181 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QSqlDatabase>
+#include <QtCore/QFile>
+
+#include "database.h"
+#include "databasebackup.h"
+
+// Pages copied by each sqlite3_backup_step()
+#define BACKUP_PAGES_PER_STEP 256
+// Time left to the GUI connection between steps
+#define BACKUP_YIELD_MS 10
+// and to wait before retrying when the source is locked
+#define BACKUP_BUSY_MS 100
+
+DatabaseBackup::DatabaseBackup(const QString & source, const QString & target,
+							   QObject * parent)
+	: QThread(parent),
+	  m_source(source),
+	  m_target(target),
+	  m_shared(0),
+	  m_cancelled(0),
+	  m_pageSize(0),
+	  m_restarts(0)
+{
+	// read on the GUI thread, the QSqlDatabase isn't thread safe
+	QString name = QSqlDatabase::database(SESSION_NAME).databaseName();
+	if (m_source.isEmpty()) { m_source = name; }
+	if (m_target.isEmpty()) { m_target = name; }
+	if (   m_source.isEmpty() || (m_source == ":memory:")
+		|| m_target.isEmpty() || (m_target == ":memory:"))
+	{
+		// Nobody else can open it, so use the GUI's connection:
+		// sqlite serializes calls on a connection from several threads.
+		m_shared = Database::sqlite3handle();
+	}
+}
+
+DatabaseBackup::~DatabaseBackup()
+{
+	wait();
+}
+
+void DatabaseBackup::cancel()
+{
+	m_cancelled.storeRelease(1);
+}
+
+bool DatabaseBackup::isShared(const QString & name)
+{
+	return name.isEmpty() || (name == ":memory:");
+}
+
+bool DatabaseBackup::open(const QString & name, sqlite3 ** db, int flags)
+{
+	if (isShared(name))
+	{
+		*db = m_shared;
+		return true;
+	}
+	if (sqlite3_open_v2(name.toUtf8().constData(), db, flags, 0) != SQLITE_OK)
+	{
+		m_error = tr("Cannot open %1: %2").arg(name)
+				  .arg(QString::fromUtf8(*db ? sqlite3_errmsg(*db)
+											 : "out of memory"));
+		sqlite3_close(*db);
+		*db = 0;
+		return false;
+	}
+	return true;
+}
+
+void DatabaseBackup::close(sqlite3 * db)
+{
+	if (db != m_shared) { sqlite3_close(db); }
+}
+
+void DatabaseBackup::run()
+{
+	m_error = QString();
+	QString part(isShared(m_target) ? m_target : m_target + ".part");
+	// a leftover from an interrupted backup is started again
+	if (!isShared(m_target)) { QFile::remove(part); }
+
+	sqlite3 * source = 0;
+	sqlite3 * dest = 0;
+	if (!open(m_source, &source, SQLITE_OPEN_READONLY)) { return; }
+	if (!open(part, &dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE))
+	{
+		close(source);
+		return;
+	}
+
+	sqlite3_stmt * stmt;
+	if (sqlite3_prepare_v2(source, "PRAGMA main.page_size;", -1, &stmt, 0)
+		== SQLITE_OK)
+	{
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			m_pageSize.storeRelease(sqlite3_column_int(stmt, 0));
+		}
+		sqlite3_finalize(stmt);
+	}
+
+	// an in-memory target can't change its page size during the copy
+	if (isShared(m_target) && (pageSize() > 0))
+	{
+		QByteArray sql("PRAGMA main.page_size = "
+					   + QByteArray::number(pageSize()) + ";");
+		sqlite3_exec(dest, sql.constData(), 0, 0, 0);
+	}
+
+	sqlite3_backup * backup = sqlite3_backup_init(dest, "main", source, "main");
+	if (!backup)
+	{
+		m_error = QString::fromUtf8(sqlite3_errmsg(dest));
+		close(dest);
+		close(source);
+		if (!isShared(m_target)) { QFile::remove(part); }
+		return;
+	}
+	int rc;
+	int lastRemaining = -1;
+	while (true)
+	{
+		rc = sqlite3_backup_step(backup, BACKUP_PAGES_PER_STEP);
+		int remaining = sqlite3_backup_remaining(backup);
+		if ((lastRemaining >= 0) && (remaining > lastRemaining))
+		{
+			m_restarts.fetchAndAddRelease(1);
+		}
+		lastRemaining = remaining;
+		emit progress(remaining, sqlite3_backup_pagecount(backup));
+		if (rc == SQLITE_DONE) { break; }
+		if (   (rc != SQLITE_OK) && (rc != SQLITE_BUSY)
+			&& (rc != SQLITE_LOCKED))
+		{
+			break;
+		}
+		if (m_cancelled.loadAcquire()) { break; }
+		msleep((rc == SQLITE_OK) ? BACKUP_YIELD_MS : BACKUP_BUSY_MS);
+	}
+	// rolls the target back unless the copy is complete
+	sqlite3_backup_finish(backup);
+	if (rc == SQLITE_DONE)
+	{
+		m_error = QString();
+	}
+	else if (m_cancelled.loadAcquire())
+	{
+		m_error = tr("Cancelled");
+	}
+	else
+	{
+		m_error = QString::fromUtf8(sqlite3_errstr(rc));
+	}
+	close(dest);
+	close(source);
+
+	if (!isShared(m_target))
+	{
+		if (!m_error.isNull())
+		{
+			QFile::remove(part);
+		}
+		else if (QFile::exists(m_target) && !QFile::remove(m_target))
+		{
+			m_error = tr("Cannot replace %1; the backup is in %2")
+					  .arg(m_target).arg(part);
+		}
+		else if (!QFile::rename(part, m_target))
+		{
+			m_error = tr("Cannot rename %1 to %2").arg(part).arg(m_target);
+		}
+	}
+}
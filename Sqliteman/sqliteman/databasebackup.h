@@ -0,0 +1,72 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef DATABASEBACKUP_H
+#define DATABASEBACKUP_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QThread>
+
+#include "sqlite3.h"
+
+/*! \brief Copies one database into another with the online backup API.
+Either end is a file name, or empty for the open database. The open
+database is read through a connection of our own when it is a file,
+and through the GUI's connection when it is only in memory.
+A few pages are copied at a time and the worker sleeps between steps,
+so the GUI connection can keep reading and writing meanwhile. If the
+source is written by another connection, sqlite starts the copy again.
+A file target is written as target.part and only renamed when complete,
+so an interrupted backup leaves nothing behind and is simply restarted.
+*/
+class DatabaseBackup : public QThread
+{
+	Q_OBJECT
+
+	public:
+		DatabaseBackup(const QString & source, const QString & target,
+					   QObject * parent = 0);
+		~DatabaseBackup();
+
+		QString source() const { return m_source; }
+		QString target() const { return m_target; }
+		int pageSize() const { return m_pageSize.loadAcquire(); }
+		//! \brief How often the copy started again from the first page
+		int restarts() const { return m_restarts.loadAcquire(); }
+
+		//! \brief Null if the copy completed, otherwise why it didn't
+		QString errorString() const { return m_error; }
+		bool wasCancelled() const { return m_cancelled.loadAcquire() != 0; }
+
+		//! \brief True if \a name can only be reached through the GUI's connection
+		static bool isShared(const QString & name);
+
+	signals:
+		//! \brief Emitted after each step
+		void progress(int remaining, int pageCount);
+
+	public slots:
+		//! \brief Stop after the current step and leave the target as it was.
+		void cancel();
+
+	protected:
+		void run();
+
+	private:
+		bool open(const QString & name, sqlite3 ** db, int flags);
+		void close(sqlite3 * db);
+
+		QString m_source;
+		QString m_target;
+		sqlite3 * m_shared;
+		QString m_error;
+		QAtomicInt m_cancelled;
+		QAtomicInt m_pageSize;
+		QAtomicInt m_restarts;
+};
+
+#endif
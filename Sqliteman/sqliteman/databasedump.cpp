@@ -0,0 +1,650 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QSqlDatabase>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtCore/QDir>
+#include <QtCore/QRegExp>
+#include <QtCore/QtNumeric>
+
+#include "database.h"
+#include "databasedump.h"
+#include "utils.h"
+
+// Rows per INSERT statement: many rows per statement parse much faster
+#define DUMP_ROWS_PER_INSERT 500
+// but don't let one statement get too large for the reader
+#define DUMP_BYTES_PER_INSERT (1024 * 1024)
+// How long to wait for locks held by the GUI or other processes
+#define DUMP_BUSY_TIMEOUT 10000
+
+/*! \brief QtConcurrent::map() functor for DatabaseDump::dumpTables():
+one per reader, each takes tables from the shared list until none are left.
+*/
+class DumpTables
+{
+	public:
+		typedef void result_type;
+		DumpTables(DatabaseDump * dump) : m_dump(dump) {}
+		void operator()(DatabaseDump::Reader & reader) const
+		{
+			m_dump->dumpTables(reader);
+		}
+	private:
+		DatabaseDump * m_dump;
+};
+
+DatabaseDump::DatabaseDump(const QString & path, Mode mode, QObject * parent)
+	: QThread(parent),
+	  m_path(path),
+	  m_mode(mode),
+	  m_sequence(false),
+	  m_nextTable(0),
+	  m_cancelled(0),
+	  m_tables(0),
+	  m_tablesDone(0),
+	  m_rows(0),
+	  m_bytes(0)
+{
+	// read on the GUI thread, the QSqlDatabase isn't thread safe
+	m_databaseName = QSqlDatabase::database(SESSION_NAME).databaseName();
+	if (m_databaseName.isEmpty() || (m_databaseName == ":memory:"))
+	{
+		// Nobody else can open it, and the GUI goes on using its own
+		// connection while we dump, so dump a copy of it instead.
+		copyDatabase();
+	}
+}
+
+void DatabaseDump::copyDatabase()
+{
+	m_databaseName = QString();
+	if (!m_copy.open())
+	{
+		m_copyError = tr("Cannot create a temporary file: %1")
+					  .arg(m_copy.errorString());
+		return;
+	}
+	m_copy.close(); // sqlite opens it by name
+	sqlite3 * dest = 0;
+	if (sqlite3_open_v2(m_copy.fileName().toUtf8().constData(), &dest,
+						SQLITE_OPEN_READWRITE, 0) != SQLITE_OK)
+	{
+		m_copyError = tr("Cannot open %1: %2").arg(m_copy.fileName())
+					  .arg(QString::fromUtf8(dest ? sqlite3_errmsg(dest)
+												  : "out of memory"));
+		sqlite3_close(dest);
+		return;
+	}
+	// in one step, so that it's a snapshot: the copy is a file, so it
+	// doesn't take any more memory. An open transaction of the user's
+	// is copied as it stands, as the dump did when it used the connection.
+	sqlite3_backup * backup = sqlite3_backup_init(dest, "main",
+		Database::sqlite3handle(), "main");
+	int rc = backup ? sqlite3_backup_step(backup, -1) : sqlite3_errcode(dest);
+	if (backup) { sqlite3_backup_finish(backup); }
+	if (rc != SQLITE_DONE)
+	{
+		m_copyError = tr("Cannot copy the database to dump it: %1")
+					  .arg(QString::fromUtf8(sqlite3_errstr(rc)));
+	}
+	else
+	{
+		m_databaseName = m_copy.fileName();
+	}
+	sqlite3_close(dest);
+}
+
+DatabaseDump::~DatabaseDump()
+{
+	wait();
+	closeReaders();
+}
+
+QString DatabaseDump::schemaFile(const QString & directory)
+{
+	return QDir(directory).filePath("schema.sql");
+}
+
+QString DatabaseDump::dataDirectory(const QString & directory)
+{
+	return QDir(directory).filePath("data");
+}
+
+QString DatabaseDump::finishFile(const QString & directory)
+{
+	return QDir(directory).filePath("finish.sql");
+}
+
+void DatabaseDump::cancel()
+{
+	m_cancelled.storeRelease(1);
+}
+
+void DatabaseDump::run()
+{
+	m_error = m_copyError;
+	if (!m_error.isNull()) { return; }
+	bool ok = (m_mode == Directory) ? dumpDirectory() : dumpFile();
+	if (!ok && m_error.isNull())
+	{
+		for (int i = 0; i < m_readers.count(); ++i)
+		{
+			if (!m_readers.at(i).error.isNull())
+			{
+				m_error = m_readers.at(i).error;
+				break;
+			}
+		}
+	}
+	if (m_cancelled.loadAcquire()) { m_error = tr("Cancelled"); }
+	closeReaders();
+}
+
+bool DatabaseDump::openReaders(int count)
+{
+	m_readers.clear();
+	QByteArray name(m_databaseName.toUtf8());
+	sqlite3 * gate = 0;
+	if ((count > 1) && !openGate(&gate, count)) { return false; }
+	bool ok = true;
+	for (int i = 0; ok && (i < count); ++i)
+	{
+		Reader reader;
+		reader.db = 0;
+		if (sqlite3_open_v2(name.constData(), &reader.db,
+							SQLITE_OPEN_READONLY, 0) != SQLITE_OK)
+		{
+			m_error = tr("Cannot open %1: %2").arg(m_databaseName)
+					  .arg(QString::fromUtf8(reader.db
+						  ? sqlite3_errmsg(reader.db) : "out of memory"));
+			sqlite3_close(reader.db);
+			ok = false;
+			break;
+		}
+		sqlite3_busy_timeout(reader.db, DUMP_BUSY_TIMEOUT);
+		m_readers.append(reader);
+		// the first read takes the snapshot (the WAL read mark)
+		if (sqlite3_exec(reader.db,
+						 "BEGIN; SELECT count(*) FROM main.sqlite_master;",
+						 0, 0, 0) != SQLITE_OK)
+		{
+			ok = sqliteError(m_readers.last(), "BEGIN");
+		}
+	}
+	if (gate)
+	{
+		sqlite3_exec(gate, "ROLLBACK;", 0, 0, 0);
+		sqlite3_close(gate);
+	}
+	return ok;
+}
+
+bool DatabaseDump::openGate(sqlite3 ** gate, int & count)
+{
+	// One read transaction gives each reader a consistent snapshot. To
+	// make it the same snapshot for all of them, hold the write lock
+	// while they start, so that no commit can come in between.
+	QByteArray name(m_databaseName.toUtf8());
+	if (sqlite3_open_v2(name.constData(), gate,
+						SQLITE_OPEN_READWRITE, 0) != SQLITE_OK)
+	{
+		// sqlite falls back to read only by itself if it can
+		m_error = tr("Cannot open %1: %2").arg(m_databaseName)
+				  .arg(QString::fromUtf8(*gate ? sqlite3_errmsg(*gate)
+											   : "out of memory"));
+		sqlite3_close(*gate);
+		*gate = 0;
+		return false;
+	}
+	sqlite3_busy_timeout(*gate, DUMP_BUSY_TIMEOUT);
+	const char * lock = "BEGIN IMMEDIATE;";
+	if (sqlite3_db_readonly(*gate, "main") == 1)
+	{
+		// Without write permission, a read transaction still keeps
+		// commits out in rollback journal mode, but not in WAL mode:
+		// there the one reader's snapshot is the only consistent one.
+		sqlite3_stmt * stmt = 0;
+		bool wal = false;
+		if (sqlite3_prepare_v2(*gate, "PRAGMA main.journal_mode;", -1,
+							   &stmt, 0) == SQLITE_OK)
+		{
+			wal = (sqlite3_step(stmt) == SQLITE_ROW)
+				  && (qstricmp((const char *)sqlite3_column_text(stmt, 0),
+							   "wal") == 0);
+		}
+		sqlite3_finalize(stmt);
+		if (wal)
+		{
+			sqlite3_close(*gate);
+			*gate = 0;
+			count = 1;
+			return true;
+		}
+		lock = "BEGIN; SELECT count(*) FROM main.sqlite_master;";
+	}
+	if (sqlite3_exec(*gate, lock, 0, 0, 0) != SQLITE_OK)
+	{
+		m_error = tr("Cannot take a consistent snapshot: %1")
+				  .arg(QString::fromUtf8(sqlite3_errmsg(*gate)));
+		sqlite3_close(*gate);
+		*gate = 0;
+		return false;
+	}
+	return true;
+}
+
+void DatabaseDump::closeReaders()
+{
+	for (int i = 0; i < m_readers.count(); ++i)
+	{
+		sqlite3 * db = m_readers.at(i).db;
+		sqlite3_exec(db, "COMMIT;", 0, 0, 0);
+		sqlite3_close(db);
+	}
+	m_readers.clear();
+}
+
+bool DatabaseDump::sqliteError(Reader & reader, const QString & context)
+{
+	if (reader.error.isNull())
+	{
+		reader.error = QString("%1: %2").arg(context)
+					   .arg(QString::fromUtf8(sqlite3_errmsg(reader.db)));
+	}
+	return false;
+}
+
+bool DatabaseDump::write(Reader & reader, QFile & out, const QByteArray & data)
+{
+	if (out.write(data) != data.size())
+	{
+		if (reader.error.isNull())
+		{
+			reader.error = tr("Error writing %1: %2")
+						   .arg(out.fileName()).arg(out.errorString());
+		}
+		return false;
+	}
+	m_bytes.fetchAndAddRelease(data.size());
+	return true;
+}
+
+QByteArray DatabaseDump::ifNotExists(const QByteArray & sql)
+{
+	// only the statement's own keywords, not text inside it
+	QRegExp re("^(\\s*CREATE\\s+(?:(?:TEMP|TEMPORARY|UNIQUE|VIRTUAL)\\s+)?"
+			   "(?:TABLE|INDEX|TRIGGER|VIEW)\\s+)(?!IF\\s)",
+			   Qt::CaseInsensitive);
+	QString s(QString::fromUtf8(sql));
+	if (re.indexIn(s) == 0)
+	{
+		s.insert(re.matchedLength(), "IF NOT EXISTS ");
+	}
+	return s.toUtf8();
+}
+
+void DatabaseDump::appendValue(QByteArray & out, sqlite3_stmt * stmt, int i)
+{
+	switch (sqlite3_column_type(stmt, i))
+	{
+		case SQLITE_INTEGER:
+			out.append(QByteArray::number(sqlite3_column_int64(stmt, i)));
+			break;
+		case SQLITE_FLOAT:
+		{
+			double d = sqlite3_column_double(stmt, i);
+			if (qIsInf(d))
+			{
+				// sqlite reads any overflowing literal as infinity
+				out.append(d < 0 ? "-1e999" : "1e999");
+			}
+			else
+			{
+				// %! keeps the ".0" so that the value stays a REAL
+				char buf[32];
+				sqlite3_snprintf(sizeof(buf), buf, "%!.17g", d);
+				out.append(buf);
+			}
+			break;
+		}
+		case SQLITE_TEXT:
+		{
+			const char * p = (const char *)sqlite3_column_text(stmt, i);
+			int n = sqlite3_column_bytes(stmt, i);
+			if (memchr(p, 0, n))
+			{
+				// a literal would end at the NUL
+				out.append("CAST(X'")
+				   .append(QByteArray::fromRawData(p, n).toHex())
+				   .append("' AS TEXT)");
+			}
+			else
+			{
+				out.append('\'');
+				const char * q;
+				while ((q = (const char *)memchr(p, '\'', n)))
+				{
+					int len = q - p + 1;
+					out.append(p, len).append('\'');
+					p += len;
+					n -= len;
+				}
+				out.append(p, n).append('\'');
+			}
+			break;
+		}
+		case SQLITE_BLOB:
+		{
+			QByteArray blob((const char *)sqlite3_column_blob(stmt, i),
+							sqlite3_column_bytes(stmt, i));
+			out.append("X'").append(blob.toHex()).append('\'');
+			break;
+		}
+		default:
+			out.append("NULL");
+			break;
+	}
+}
+
+bool DatabaseDump::readSchema(Reader & reader)
+{
+	// Tables first, then their data, then indexes, triggers and views.
+	// Indexes are quicker to build after the rows are in and triggers
+	// mustn't fire while restoring. sqlite_* objects are internal.
+	m_tableNames.clear();
+	m_tableSql.clear();
+	m_otherSql.clear();
+	m_sequence = false;
+	sqlite3_stmt * stmt;
+	const char * sql = "SELECT type, name, sql FROM main.sqlite_master"
+					   " WHERE sql NOT NULL ORDER BY rowid;";
+	if (sqlite3_prepare_v2(reader.db, sql, -1, &stmt, 0) != SQLITE_OK)
+	{
+		return sqliteError(reader, tr("Error while reading sqlite_master"));
+	}
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		QByteArray type((const char *)sqlite3_column_text(stmt, 0));
+		QString name(QString::fromUtf8(
+			(const char *)sqlite3_column_text(stmt, 1)));
+		QByteArray create((const char *)sqlite3_column_text(stmt, 2));
+		if (name.startsWith("sqlite_", Qt::CaseInsensitive))
+		{
+			if (name.toLower() == "sqlite_sequence") { m_sequence = true; }
+			continue;
+		}
+		if (type == "table")
+		{
+			m_tableSql.append(ifNotExists(create));
+			// virtual tables keep their rows in their shadow tables
+			if (!QString::fromUtf8(create).simplified()
+				.startsWith("CREATE VIRTUAL", Qt::CaseInsensitive))
+			{
+				m_tableNames.append(name);
+			}
+		}
+		else
+		{
+			m_otherSql.append(ifNotExists(create));
+		}
+	}
+	if (sqlite3_finalize(stmt) != SQLITE_OK)
+	{
+		return sqliteError(reader, tr("Error while reading sqlite_master"));
+	}
+	m_tables.storeRelease(m_tableNames.count() + (m_sequence ? 1 : 0));
+	return true;
+}
+
+bool DatabaseDump::dumpTable(Reader & reader, const QString & table,
+							 QFile & out)
+{
+	QByteArray name(Utils::q(table).toUtf8());
+
+	// generated and hidden columns can't be inserted into,
+	// and table_info leaves them out
+	QStringList columns;
+	sqlite3_stmt * stmt;
+	QByteArray sql("PRAGMA main.table_info(" + name + ");");
+	if (sqlite3_prepare_v2(reader.db, sql.constData(), -1, &stmt, 0)
+		!= SQLITE_OK)
+	{
+		return sqliteError(reader, table);
+	}
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		columns.append(QString::fromUtf8(
+			(const char *)sqlite3_column_text(stmt, 1)));
+	}
+	sqlite3_finalize(stmt);
+	if (columns.isEmpty()) { return true; }
+
+	// Keep the rowids too, or a restore renumbers them. Use whichever
+	// of its names isn't hidden by a column. WITHOUT ROWID tables fail
+	// to prepare with it and are read without.
+	QString rowid(Utils::rowidAlias(columns));
+	QStringList quoted;
+	foreach (QString c, columns) { quoted.append(Utils::q(c)); }
+	QByteArray select("SELECT " + quoted.join(", ").toUtf8()
+					  + " FROM main." + name + ";");
+	bool withRowid = false;
+	if (!rowid.isNull())
+	{
+		sql = "SELECT " + rowid.toUtf8() + ", "
+			  + quoted.join(", ").toUtf8() + " FROM main." + name + ";";
+		withRowid = (sqlite3_prepare_v2(reader.db, sql.constData(), -1,
+										&stmt, 0) == SQLITE_OK);
+	}
+	if (!withRowid)
+	{
+		if (sqlite3_prepare_v2(reader.db, select.constData(), -1, &stmt, 0)
+			!= SQLITE_OK)
+		{
+			return sqliteError(reader, table);
+		}
+	}
+	else
+	{
+		quoted.prepend(rowid);
+	}
+
+	QByteArray insert("INSERT OR REPLACE INTO " + name
+					  + " (" + quoted.join(", ").toUtf8() + ") VALUES\n(");
+	int n = sqlite3_column_count(stmt);
+	QByteArray data;
+	int inStatement = 0;
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+	{
+		if (m_cancelled.loadAcquire()) { break; }
+		if (inStatement == 0)
+		{
+			data.append(insert);
+		}
+		else
+		{
+			data.append("),\n(");
+		}
+		for (int i = 0; i < n; ++i)
+		{
+			if (i) { data.append(','); }
+			appendValue(data, stmt, i);
+		}
+		m_rows.fetchAndAddRelease(1);
+		if (   (++inStatement >= DUMP_ROWS_PER_INSERT)
+			|| (data.size() >= DUMP_BYTES_PER_INSERT))
+		{
+			data.append(");\n");
+			inStatement = 0;
+			if (!write(reader, out, data))
+			{
+				sqlite3_finalize(stmt);
+				return false;
+			}
+			data.clear();
+		}
+	}
+	sqlite3_finalize(stmt);
+	if (m_cancelled.loadAcquire()) { return false; }
+	if (rc != SQLITE_DONE) { return sqliteError(reader, table); }
+	if (inStatement) { data.append(");\n"); }
+	return write(reader, out, data);
+}
+
+bool DatabaseDump::dumpFile()
+{
+	QFile file(m_path);
+	// not QIODevice::Text: strings must be written byte for byte
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		m_error = tr("Unable to open file %1 for writing.").arg(m_path);
+		return false;
+	}
+	bool ok = openReaders(1) && readSchema(m_readers[0]);
+	if (ok)
+	{
+		Reader & reader = m_readers[0];
+		ok = write(reader, file,
+				   "PRAGMA foreign_keys=OFF;\nBEGIN TRANSACTION;\n");
+		for (int i = 0; ok && (i < m_tableSql.count()); ++i)
+		{
+			ok = write(reader, file, m_tableSql.at(i) + ";\n");
+		}
+		for (int i = 0; ok && (i < m_tableNames.count()); ++i)
+		{
+			ok = dumpTable(reader, m_tableNames.at(i), file);
+			m_tablesDone.fetchAndAddRelease(1);
+		}
+		if (ok && m_sequence)
+		{
+			// it already exists once the AUTOINCREMENT tables do
+			ok = write(reader, file, "DELETE FROM sqlite_sequence;\n")
+				 && dumpTable(reader, "sqlite_sequence", file);
+			m_tablesDone.fetchAndAddRelease(1);
+		}
+		for (int i = 0; ok && (i < m_otherSql.count()); ++i)
+		{
+			ok = write(reader, file, m_otherSql.at(i) + ";\n");
+		}
+		ok = ok && write(reader, file, "COMMIT;\n");
+	}
+	file.close();
+	if (!ok) { file.remove(); }
+	return ok;
+}
+
+void DatabaseDump::dumpTables(Reader & reader)
+{
+	QDir data(dataDirectory(m_path));
+	while (!m_cancelled.loadAcquire())
+	{
+		int i = m_nextTable.fetchAndAddOrdered(1);
+		if (i >= m_tableNames.count()) { break; }
+		QFile out(data.filePath(QString("%1.sql")
+								.arg(i + 1, 4, 10, QChar('0'))));
+		if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		{
+			reader.error = tr("Unable to open file %1 for writing.")
+						   .arg(out.fileName());
+		}
+		else if (write(reader, out, "BEGIN TRANSACTION;\n")
+				 && dumpTable(reader, m_tableNames.at(i), out))
+		{
+			write(reader, out, "COMMIT;\n");
+		}
+		m_tablesDone.fetchAndAddRelease(1);
+		if (!reader.error.isNull())
+		{
+			// stop the other readers too
+			m_nextTable.storeRelease(m_tableNames.count());
+			break;
+		}
+	}
+}
+
+bool DatabaseDump::dumpDirectory()
+{
+	QDir dir(m_path);
+	if (!dir.mkpath("data"))
+	{
+		m_error = tr("Cannot create directory %1")
+				  .arg(dataDirectory(m_path));
+		return false;
+	}
+	// data files left from a larger dump would be restored too
+	QDir data(dataDirectory(m_path));
+	foreach (QString f, data.entryList(QStringList("*.sql"), QDir::Files))
+	{
+		data.remove(f);
+	}
+
+	int count = qMax(1, QThread::idealThreadCount());
+	bool ok = openReaders(count) && readSchema(m_readers[0]);
+	if (ok)
+	{
+		QFile schema(schemaFile(m_path));
+		Reader & reader = m_readers[0];
+		ok = schema.open(QIODevice::WriteOnly | QIODevice::Truncate);
+		if (!ok)
+		{
+			m_error = tr("Unable to open file %1 for writing.")
+					  .arg(schema.fileName());
+		}
+		ok = ok && write(reader, schema,
+						 "PRAGMA foreign_keys=OFF;\nBEGIN TRANSACTION;\n");
+		for (int i = 0; ok && (i < m_tableSql.count()); ++i)
+		{
+			ok = write(reader, schema, m_tableSql.at(i) + ";\n");
+		}
+		ok = ok && write(reader, schema, "COMMIT;\n");
+	}
+	if (ok)
+	{
+		m_nextTable.storeRelease(0);
+		QtConcurrent::blockingMap(m_readers, DumpTables(this));
+		for (int i = 0; ok && (i < m_readers.count()); ++i)
+		{
+			ok = m_readers.at(i).error.isNull();
+		}
+		ok = ok && !m_cancelled.loadAcquire();
+	}
+	if (ok)
+	{
+		QFile finish(finishFile(m_path));
+		Reader & reader = m_readers[0];
+		ok = finish.open(QIODevice::WriteOnly | QIODevice::Truncate);
+		if (!ok)
+		{
+			m_error = tr("Unable to open file %1 for writing.")
+					  .arg(finish.fileName());
+		}
+		ok = ok && write(reader, finish, "BEGIN TRANSACTION;\n");
+		if (ok && m_sequence)
+		{
+			ok = write(reader, finish, "DELETE FROM sqlite_sequence;\n")
+				 && dumpTable(reader, "sqlite_sequence", finish);
+			m_tablesDone.fetchAndAddRelease(1);
+		}
+		for (int i = 0; ok && (i < m_otherSql.count()); ++i)
+		{
+			ok = write(reader, finish, m_otherSql.at(i) + ";\n");
+		}
+		ok = ok && write(reader, finish, "COMMIT;\n");
+	}
+	if (!ok)
+	{
+		foreach (QString f, data.entryList(QStringList("*.sql"), QDir::Files))
+		{
+			data.remove(f);
+		}
+		dir.rmdir("data");
+		QFile::remove(schemaFile(m_path));
+		QFile::remove(finishFile(m_path));
+	}
+	return ok;
+}
@@ -0,0 +1,126 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef DATABASEDUMP_H
+#define DATABASEDUMP_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QFile>
+#include <QtCore/QStringList>
+#include <QtCore/QTemporaryFile>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+
+#include "sqlite3.h"
+
+/*! \brief Writes an SQL dump of the main database on a worker thread.
+The dump is read from separate read-only connections inside read
+transactions, so it is a consistent snapshot and the GUI stays responsive.
+Values are written from the sqlite3_column_* API so that reading the dump
+back gives exactly the same values and storage classes: doubles with
+%!.17g, blobs as X'..' and rows grouped into multi-row INSERTs.
+
+A SingleFile dump is one script. A Directory dump is schema.sql, one
+data/NNNN.sql per table and finish.sql, in that order; the tables are
+dumped concurrently by a pool of connections which share one snapshot,
+or by one connection for a read only file in WAL mode, where nothing
+would keep commits from coming in while the pool starts.
+The GUI polls tablesDone(), rowsDone() and bytesWritten() for progress.
+
+A database which is only in memory can't be opened by the readers, so
+it is first copied into a temporary file on the GUI thread when the
+dump is constructed, and the copy is dumped.
+*/
+class DatabaseDump : public QThread
+{
+	Q_OBJECT
+
+	public:
+		enum Mode { SingleFile, Directory };
+
+		DatabaseDump(const QString & path, Mode mode = SingleFile,
+					 QObject * parent = 0);
+		~DatabaseDump();
+
+		//! \brief Number of tables with data, known once the dump starts
+		int tables() const { return m_tables.loadAcquire(); }
+		int tablesDone() const { return m_tablesDone.loadAcquire(); }
+		qint64 rowsDone() const { return m_rows.loadAcquire(); }
+		qint64 bytesWritten() const { return m_bytes.loadAcquire(); }
+
+		//! \brief Null if the dump completed, otherwise why it didn't
+		QString errorString() const { return m_error; }
+		bool wasCancelled() const { return m_cancelled.loadAcquire() != 0; }
+
+		//! \brief The files of a Directory dump
+		static QString schemaFile(const QString & directory);
+		static QString dataDirectory(const QString & directory);
+		static QString finishFile(const QString & directory);
+
+	public slots:
+		//! \brief Stop at the next row; the partial output is removed.
+		void cancel();
+
+	protected:
+		void run();
+
+	private:
+		//! \brief A read connection and the first error it hit
+		typedef struct
+		{
+			sqlite3 * db;
+			QString error;
+		}
+		Reader;
+		friend class DumpTables;
+
+		//! \brief Copy the GUI's in-memory database into m_copy
+		void copyDatabase();
+		bool openReaders(int count);
+		/*! \brief Lock out commits while the readers start, so that
+		they share one snapshot. If that can't be done, \a count is
+		reduced to one reader. */
+		bool openGate(sqlite3 ** gate, int & count);
+		void closeReaders();
+		bool readSchema(Reader & reader);
+		bool dumpFile();
+		bool dumpDirectory();
+		//! \brief Take tables from m_tableNames until there are none left
+		void dumpTables(Reader & reader);
+		bool dumpTable(Reader & reader, const QString & table, QFile & out);
+		bool write(Reader & reader, QFile & out, const QByteArray & data);
+		//! \brief Record the connection's last error in the reader
+		bool sqliteError(Reader & reader, const QString & context);
+
+		//! \brief Append one column of the current row as an SQL literal
+		static void appendValue(QByteArray & out, sqlite3_stmt * stmt, int i);
+		//! \brief Turn "CREATE TABLE x" into "CREATE TABLE IF NOT EXISTS x"
+		static QByteArray ifNotExists(const QByteArray & sql);
+
+		QString m_path;
+		Mode m_mode;
+		QString m_databaseName;
+		//! \brief The copy of a :memory: database which is dumped
+		QTemporaryFile m_copy;
+		QString m_copyError;
+		QVector<Reader> m_readers;
+
+		QStringList m_tableNames;
+		QList<QByteArray> m_tableSql;
+		QList<QByteArray> m_otherSql;
+		bool m_sequence;
+		QAtomicInt m_nextTable;
+
+		QString m_error;
+		QAtomicInt m_cancelled;
+		QAtomicInt m_tables;
+		QAtomicInt m_tablesDone;
+		QAtomicInteger<qint64> m_rows;
+		QAtomicInteger<qint64> m_bytes;
+};
+
+#endif
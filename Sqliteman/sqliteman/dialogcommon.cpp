@@ -12,8 +12,10 @@
 #include <QSqlQuery>
 #include <QTextDocument>
 
+#include "catalogue.h"
 #include "database.h"
 #include "dialogcommon.h"
+#include "utils.h"
 
 /* contructor */
 DialogCommon::DialogCommon(LiteManWindow * parent)
@@ -69,6 +71,7 @@ void DialogCommon::resultAppend(QString text)
 bool DialogCommon::execSql(const QString & statement, const QString & message)
 {
 	QSqlQuery query(statement, QSqlDatabase::database(SESSION_NAME));
+	if (Utils::rollsBack(statement)) { Catalogue::rolledBack(); }
 	if (query.lastError().isValid())
 	{
         if (!message.isNull()) {
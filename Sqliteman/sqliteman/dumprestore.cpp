@@ -0,0 +1,536 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QFuture>
+
+#include "database.h"
+#include "databasedump.h"
+#include "dumprestore.h"
+
+// How much of a file is read at once
+#define RESTORE_BLOCK_SIZE (1024 * 1024)
+// Parsed statements waiting for the writer
+#define RESTORE_QUEUE_SIZE 64
+
+/*! \brief QtConcurrent::run() target for DumpRestore::parseFiles()
+*/
+class ParseFiles
+{
+	public:
+		typedef void result_type;
+		ParseFiles(DumpRestore * restore) : m_restore(restore) {}
+		void operator()() const { m_restore->parseFiles(); }
+	private:
+		DumpRestore * m_restore;
+};
+
+DumpRestore::DumpRestore(const QString & directory, QObject * parent)
+	: QThread(parent),
+	  m_directory(directory),
+	  m_bytes(0),
+	  m_parsers(0),
+	  m_nextFile(0),
+	  m_stop(0),
+	  m_cancelled(0),
+	  m_bytesDone(0),
+	  m_rows(0)
+{
+	m_db = Database::sqlite3handle();
+	QDir data(DatabaseDump::dataDirectory(directory));
+	// the names sort in the order they were dumped
+	foreach (QString f, data.entryList(QStringList("*.sql"), QDir::Files,
+									   QDir::Name))
+	{
+		m_files.append(data.filePath(f));
+		m_bytes += QFileInfo(m_files.last()).size();
+	}
+	m_bytes += QFileInfo(DatabaseDump::schemaFile(directory)).size();
+	m_bytes += QFileInfo(DatabaseDump::finishFile(directory)).size();
+}
+
+DumpRestore::~DumpRestore()
+{
+	wait();
+}
+
+void DumpRestore::cancel()
+{
+	m_cancelled.storeRelease(1);
+	stop();
+}
+
+bool DumpRestore::stopping() const
+{
+	return m_stop.loadAcquire() || m_cancelled.loadAcquire();
+}
+
+void DumpRestore::stop(const QString & error)
+{
+	QMutexLocker locker(&m_mutex);
+	if (m_error.isNull()) { m_error = error; }
+	m_stop.storeRelease(1);
+	m_notEmpty.wakeAll();
+	m_notFull.wakeAll();
+}
+
+bool DumpRestore::push(const Batch & batch)
+{
+	QMutexLocker locker(&m_mutex);
+	while ((m_queue.count() >= RESTORE_QUEUE_SIZE) && !stopping())
+	{
+		m_notFull.wait(&m_mutex);
+	}
+	if (stopping()) { return false; }
+	m_queue.enqueue(batch);
+	m_notEmpty.wakeOne();
+	return true;
+}
+
+bool DumpRestore::pop(Batch & batch)
+{
+	QMutexLocker locker(&m_mutex);
+	while (m_queue.isEmpty())
+	{
+		if ((m_parsers == 0) || stopping()) { return false; }
+		m_notEmpty.wait(&m_mutex);
+	}
+	if (stopping()) { return false; }
+	batch = m_queue.dequeue();
+	m_notFull.wakeOne();
+	return true;
+}
+
+bool DumpRestore::sqliteError(const QString & context)
+{
+	stop(QString("%1: %2").arg(context)
+		 .arg(QString::fromUtf8(sqlite3_errmsg(m_db))));
+	return false;
+}
+
+bool DumpRestore::parseValue(const char *& p, const char * end, Value & v)
+{
+	if ((end - p >= 4) && (qstrncmp(p, "NULL", 4) == 0))
+	{
+		v.type = SQLITE_NULL;
+		p += 4;
+		return true;
+	}
+	if (*p == '\'')
+	{
+		v.type = SQLITE_TEXT;
+		v.bytes.clear();
+		const char * start = ++p;
+		while (true)
+		{
+			const char * q = (const char *)memchr(p, '\'', end - p);
+			if (!q) { return false; }
+			if ((q + 1 < end) && (q[1] == '\''))
+			{
+				// '' is one quote
+				v.bytes.append(start, q - start + 1);
+				p = start = q + 2;
+				continue;
+			}
+			v.bytes.append(start, q - start);
+			p = q + 1;
+			return true;
+		}
+	}
+	bool cast = false;
+	if ((end - p >= 7) && (qstrncmp(p, "CAST(X'", 7) == 0))
+	{
+		cast = true;
+		p += 5;
+	}
+	if ((end - p >= 2) && ((*p == 'X') || (*p == 'x')) && (p[1] == '\''))
+	{
+		const char * q = (const char *)memchr(p + 2, '\'', end - p - 2);
+		if (!q) { return false; }
+		v.type = cast ? SQLITE_TEXT : SQLITE_BLOB;
+		v.bytes = QByteArray::fromHex(QByteArray::fromRawData(p + 2,
+															  q - p - 2));
+		p = q + 1;
+		if (cast)
+		{
+			if ((end - p < 9) || (qstrncmp(p, " AS TEXT)", 9) != 0))
+			{
+				return false;
+			}
+			p += 9;
+		}
+		return true;
+	}
+	if (cast) { return false; }
+	const char * start = p;
+	bool real = false;
+	if ((p < end) && ((*p == '-') || (*p == '+'))) { ++p; }
+	while (p < end)
+	{
+		char c = *p;
+		if ((c == '.') || (c == 'e') || (c == 'E'))
+		{
+			real = true;
+		}
+		else if (   ((c == '-') || (c == '+'))
+				 && ((p[-1] == 'e') || (p[-1] == 'E')))
+		{
+			// exponent sign
+		}
+		else if ((c < '0') || (c > '9'))
+		{
+			break;
+		}
+		++p;
+	}
+	if (p == start) { return false; }
+	QByteArray number(QByteArray::fromRawData(start, p - start));
+	bool ok;
+	if (real)
+	{
+		v.type = SQLITE_FLOAT;
+		v.real = number.toDouble(&ok);
+	}
+	else
+	{
+		v.type = SQLITE_INTEGER;
+		v.integer = number.toLongLong(&ok);
+	}
+	// overflows (1e999 for infinity) are left to sqlite
+	return ok;
+}
+
+bool DumpRestore::parseInsert(const QByteArray & sql, Batch & batch)
+{
+	// Only what DatabaseDump writes:
+	// INSERT OR REPLACE INTO "t" ("a", "b") VALUES\n(1,'x'),\n(2,NULL);
+	static const char prefix[] = "INSERT OR REPLACE INTO \"";
+	const char * p = sql.constData();
+	const char * end = p + sql.size();
+	if (qstrncmp(p, prefix, sizeof(prefix) - 1) != 0) { return false; }
+	p += sizeof(prefix) - 1;
+	// quoted identifiers, "" is one quote
+	while ((p < end) && ((*p != '"') || ((p + 1 < end) && (p[1] == '"'))))
+	{
+		p += (*p == '"') ? 2 : 1;
+	}
+	if ((end - p < 3) || (qstrncmp(p, "\" (", 3) != 0)) { return false; }
+	p += 3;
+	batch.columns = 0;
+	while (p < end)
+	{
+		if (*p == '"')
+		{
+			++p;
+			while ((p < end) && ((*p != '"') || ((p + 1 < end) && (p[1] == '"'))))
+			{
+				p += (*p == '"') ? 2 : 1;
+			}
+			++p;
+		}
+		else
+		{
+			// the rowid alias isn't quoted
+			while ((p < end) && (isalnum((uchar)*p) || (*p == '_'))) { ++p; }
+		}
+		++batch.columns;
+		if ((end - p >= 2) && (qstrncmp(p, ", ", 2) == 0)) { p += 2; }
+		else { break; }
+	}
+	static const char values[] = ") VALUES";
+	if ((end - p < (int)sizeof(values) - 1)
+		|| (qstrncmp(p, values, sizeof(values) - 1) != 0))
+	{
+		return false;
+	}
+	p += sizeof(values) - 1;
+	batch.sql = QByteArray(sql.constData(), p - sql.constData());
+	batch.values.clear();
+
+	Value v;
+	while (true)
+	{
+		while ((p < end) && isspace((uchar)*p)) { ++p; }
+		if ((p >= end) || (*p != '(')) { return false; }
+		++p;
+		for (int i = 0; i < batch.columns; ++i)
+		{
+			if ((p >= end) || !parseValue(p, end, v)) { return false; }
+			batch.values.append(v);
+			char expected = (i + 1 < batch.columns) ? ',' : ')';
+			if ((p >= end) || (*p != expected)) { return false; }
+			++p;
+		}
+		if ((p < end) && (*p == ',')) { ++p; continue; }
+		if ((p < end) && (*p == ';')) { break; }
+		return false;
+	}
+	batch.parsed = true;
+	return true;
+}
+
+bool DumpRestore::statement(const QByteArray & sql, bool queue)
+{
+	QByteArray s(sql.trimmed());
+	QByteArray upper(s.left(32).toUpper());
+	// The restore is one savepoint, and foreign keys are deferred to its end
+	if (   s.isEmpty() || (upper == "BEGIN TRANSACTION;")
+		|| (upper == "BEGIN;") || (upper == "COMMIT;")
+		|| (upper == "END;") || (upper == "PRAGMA FOREIGN_KEYS=OFF;"))
+	{
+		m_bytesDone.fetchAndAddRelease(sql.size());
+		return true;
+	}
+	Batch batch;
+	batch.bytes = sql.size();
+	batch.parsed = false;
+	batch.columns = 0;
+	if (!parseInsert(s, batch))
+	{
+		batch.parsed = false;
+		batch.values.clear();
+		batch.sql = s;
+	}
+	if (queue) { return push(batch); }
+	if (!execBatch(batch)) { return false; }
+	m_bytesDone.fetchAndAddRelease(batch.bytes);
+	return true;
+}
+
+bool DumpRestore::splitFile(const QString & fileName, bool queue)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		stop(tr("Cannot open file %1 for reading.").arg(fileName));
+		return false;
+	}
+	// Find the semicolons outside quotes and comments;
+	// sqlite3_complete() decides about those inside triggers.
+	QByteArray text;
+	int pos = 0;
+	char quote = 0;
+	bool lineComment = false;
+	int blockComment = -1; // where it started, or -1
+	while (!stopping())
+	{
+		if (pos >= text.size())
+		{
+			QByteArray more(file.read(RESTORE_BLOCK_SIZE));
+			if (more.isEmpty()) { break; }
+			text.append(more);
+		}
+		char c = text.at(pos++);
+		if (quote)
+		{
+			// a doubled quote closes and opens again
+			if (c == quote) { quote = 0; }
+		}
+		else if (lineComment)
+		{
+			if (c == '\n') { lineComment = false; }
+		}
+		else if (blockComment >= 0)
+		{
+			if ((c == '/') && (pos - 2 > blockComment)
+				&& (text.at(pos - 2) == '*'))
+			{
+				blockComment = -1;
+			}
+		}
+		else switch (c)
+		{
+			case '\'':
+			case '"':
+			case '`':
+				quote = c;
+				break;
+			case '[':
+				quote = ']';
+				break;
+			case '-':
+				if ((pos >= 2) && (text.at(pos - 2) == '-'))
+				{
+					lineComment = true;
+				}
+				break;
+			case '*':
+				if ((pos >= 2) && (text.at(pos - 2) == '/'))
+				{
+					blockComment = pos - 1;
+				}
+				break;
+			case ';':
+			{
+				QByteArray sql(text.left(pos));
+				if (sqlite3_complete(sql.constData()))
+				{
+					if (!statement(sql, queue)) { return false; }
+					text.remove(0, pos);
+					pos = 0;
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+	if (stopping()) { return false; }
+	if (file.error() != QFile::NoError)
+	{
+		stop(tr("Error reading %1: %2").arg(fileName)
+			 .arg(file.errorString()));
+		return false;
+	}
+	// an incomplete last statement is left to sqlite to complain about
+	return statement(text, queue);
+}
+
+void DumpRestore::parseFiles()
+{
+	while (!stopping())
+	{
+		int i = m_nextFile.fetchAndAddOrdered(1);
+		if (i >= m_files.count()) { break; }
+		if (!splitFile(m_files.at(i), true)) { break; }
+	}
+	QMutexLocker locker(&m_mutex);
+	--m_parsers;
+	m_notEmpty.wakeAll();
+}
+
+bool DumpRestore::execBatch(const Batch & batch)
+{
+	if (!batch.parsed)
+	{
+		char * error = 0;
+		if (sqlite3_exec(m_db, batch.sql.constData(), 0, 0, &error)
+			!= SQLITE_OK)
+		{
+			stop(QString("%1: %2").arg(QString::fromUtf8(batch.sql.left(200)))
+				 .arg(QString::fromUtf8(error)));
+			sqlite3_free(error);
+			return false;
+		}
+		return true;
+	}
+
+	sqlite3_stmt * stmt = m_inserts.value(batch.sql);
+	if (!stmt)
+	{
+		QByteArray sql(batch.sql + " (?");
+		for (int i = 1; i < batch.columns; ++i) { sql.append(",?"); }
+		sql.append(");");
+		if (sqlite3_prepare_v2(m_db, sql.constData(), -1, &stmt, 0)
+			!= SQLITE_OK)
+		{
+			return sqliteError(QString::fromUtf8(batch.sql));
+		}
+		m_inserts.insert(batch.sql, stmt);
+	}
+	int rows = batch.values.count() / batch.columns;
+	for (int r = 0; r < rows; ++r)
+	{
+		for (int i = 0; i < batch.columns; ++i)
+		{
+			const Value & v = batch.values.at(r * batch.columns + i);
+			switch (v.type)
+			{
+				case SQLITE_INTEGER:
+					sqlite3_bind_int64(stmt, i + 1, v.integer);
+					break;
+				case SQLITE_FLOAT:
+					sqlite3_bind_double(stmt, i + 1, v.real);
+					break;
+				case SQLITE_TEXT:
+					sqlite3_bind_text(stmt, i + 1, v.bytes.constData(),
+									  v.bytes.size(), SQLITE_STATIC);
+					break;
+				case SQLITE_BLOB:
+					sqlite3_bind_blob(stmt, i + 1, v.bytes.constData(),
+									  v.bytes.size(), SQLITE_STATIC);
+					break;
+				default:
+					sqlite3_bind_null(stmt, i + 1);
+					break;
+			}
+		}
+		int rc = sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+		if (rc != SQLITE_DONE)
+		{
+			return sqliteError(QString::fromUtf8(batch.sql));
+		}
+	}
+	m_rows.fetchAndAddRelease(rows);
+	return true;
+}
+
+void DumpRestore::run()
+{
+	m_error = QString();
+	if (!m_db)
+	{
+		m_error = tr("No database is open");
+		return;
+	}
+	if (sqlite3_exec(m_db, "SAVEPOINT RESTORE_DUMP;", 0, 0, 0) != SQLITE_OK)
+	{
+		sqliteError("SAVEPOINT RESTORE_DUMP");
+		return;
+	}
+	// rows may refer to tables which are restored later
+	sqlite3_exec(m_db, "PRAGMA defer_foreign_keys = ON;", 0, 0, 0);
+
+	bool ok = splitFile(DatabaseDump::schemaFile(m_directory), false);
+	if (ok && !m_files.isEmpty())
+	{
+		// the writer thread is busy too, leave it a core
+		int parsers = qBound(1, QThread::idealThreadCount() - 1,
+							 m_files.count());
+		m_parsers = parsers;
+		QList<QFuture<void> > futures;
+		for (int i = 0; i < parsers; ++i)
+		{
+			futures.append(QtConcurrent::run(ParseFiles(this)));
+		}
+		Batch batch;
+		while (pop(batch))
+		{
+			if (!execBatch(batch)) { break; }
+			m_bytesDone.fetchAndAddRelease(batch.bytes);
+		}
+		for (int i = 0; i < futures.count(); ++i)
+		{
+			futures[i].waitForFinished();
+		}
+		ok = !stopping();
+	}
+	ok = ok && splitFile(DatabaseDump::finishFile(m_directory), false);
+
+	foreach (sqlite3_stmt * stmt, m_inserts) { sqlite3_finalize(stmt); }
+	m_inserts.clear();
+	if (ok)
+	{
+		if (sqlite3_exec(m_db, "RELEASE RESTORE_DUMP;", 0, 0, 0) != SQLITE_OK)
+		{
+			// a foreign key is still violated
+			sqliteError("RELEASE RESTORE_DUMP");
+			ok = false;
+		}
+	}
+	if (!ok)
+	{
+		sqlite3_exec(m_db, "ROLLBACK TO RESTORE_DUMP;", 0, 0, 0);
+		sqlite3_exec(m_db, "RELEASE RESTORE_DUMP;", 0, 0, 0);
+	}
+	if (m_cancelled.loadAcquire()) { m_error = tr("Cancelled"); }
+	else if (!ok && m_error.isNull()) { m_error = tr("Restore failed"); }
+}
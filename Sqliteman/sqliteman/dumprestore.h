@@ -0,0 +1,121 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef DUMPRESTORE_H
+#define DUMPRESTORE_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QQueue>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+
+#include "sqlite3.h"
+
+/*! \brief Restores a directory dump written by DatabaseDump into the open
+database on a worker thread.
+schema.sql is run first and finish.sql last. The data files in between
+are read and parsed concurrently: each INSERT written by DatabaseDump is
+turned into rows of typed values, which the single writer binds to one
+prepared INSERT per table. Statements it doesn't recognise are run as
+they are. Everything happens in one savepoint, so a failed or cancelled
+restore leaves the database as it was. The writer uses the GUI's
+connection while the GUI waits.
+*/
+class DumpRestore : public QThread
+{
+	Q_OBJECT
+
+	public:
+		DumpRestore(const QString & directory, QObject * parent = 0);
+		~DumpRestore();
+
+		//! \brief Size of all the files to be restored
+		qint64 bytes() const { return m_bytes; }
+		qint64 bytesDone() const { return m_bytesDone.loadAcquire(); }
+		qint64 rowsDone() const { return m_rows.loadAcquire(); }
+
+		//! \brief Null if the restore completed, otherwise why it didn't
+		QString errorString() const { return m_error; }
+		bool wasCancelled() const { return m_cancelled.loadAcquire() != 0; }
+
+	public slots:
+		//! \brief Stop at the next statement and roll back.
+		void cancel();
+
+	protected:
+		void run();
+
+	private:
+		//! \brief A literal from the dump
+		typedef struct
+		{
+			int type; //!< SQLITE_INTEGER, SQLITE_FLOAT, ...
+			qint64 integer;
+			double real;
+			QByteArray bytes; //!< SQLITE_TEXT in UTF-8 or SQLITE_BLOB
+		}
+		Value;
+
+		/*! \brief One statement. If parsed is true, sql is the INSERT up
+		to VALUES and values holds its rows, otherwise sql is the whole
+		statement. */
+		typedef struct
+		{
+			QByteArray sql;
+			bool parsed;
+			int columns;
+			QVector<Value> values;
+			qint64 bytes;
+		}
+		Batch;
+
+		friend class ParseFiles;
+
+		//! \brief Take data files from m_files until none are left
+		void parseFiles();
+		/*! \brief Split a file into statements and queue them,
+		or execute them directly if \a queue is false */
+		bool splitFile(const QString & fileName, bool queue);
+		bool statement(const QByteArray & sql, bool queue);
+		static bool parseInsert(const QByteArray & sql, Batch & batch);
+		static bool parseValue(const char *& p, const char * end, Value & v);
+
+		bool push(const Batch & batch);
+		bool pop(Batch & batch);
+		//! \brief Make push() and pop() give up
+		void stop(const QString & error = QString());
+		bool stopping() const;
+
+		bool execBatch(const Batch & batch);
+		bool sqliteError(const QString & context);
+
+		QString m_directory;
+		QStringList m_files;
+		qint64 m_bytes;
+		sqlite3 * m_db;
+		//! \brief Prepared INSERTs by their text up to VALUES
+		QHash<QByteArray, sqlite3_stmt *> m_inserts;
+
+		QMutex m_mutex;
+		QWaitCondition m_notEmpty;
+		QWaitCondition m_notFull;
+		QQueue<Batch> m_queue;
+		int m_parsers;
+		QAtomicInt m_nextFile;
+		QAtomicInt m_stop;
+
+		QString m_error;
+		QAtomicInt m_cancelled;
+		QAtomicInteger<qint64> m_bytesDone;
+		QAtomicInteger<qint64> m_rows;
+};
+
+#endif
@@ -0,0 +1,213 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+
+#include "catalogue.h"
+#include "database.h"
+#include "explainanalyze.h"
+
+// Virtual machine instructions between checks for cancelling
+#define ANALYZE_PROGRESS_OPS 10000
+
+ExplainAnalyze::ExplainAnalyze(const QString & sql, QObject * parent)
+	: QThread(parent),
+	  m_sql(sql),
+	  m_runTime(-1),
+	  m_rows(-1),
+	  m_cycles(-1),
+	  m_rolledBack(false),
+	  m_cancelled(0)
+{
+	m_db = Database::sqlite3handle();
+}
+
+ExplainAnalyze::~ExplainAnalyze()
+{
+	cancel();
+	wait();
+}
+
+bool ExplainAnalyze::hasCounters()
+{
+#ifdef ENABLE_SCANSTATUS
+	return true;
+#else
+	return false;
+#endif
+}
+
+void ExplainAnalyze::cancel()
+{
+	m_cancelled.storeRelease(1);
+}
+
+int ExplainAnalyze::progressHandler(void * cancelled)
+{
+	return ((const QAtomicInt *)cancelled)->loadAcquire();
+}
+
+QString ExplainAnalyze::errorMessage() const
+{
+	return QString::fromUtf8(sqlite3_errmsg(m_db));
+}
+
+bool ExplainAnalyze::readPlan()
+{
+	QByteArray sql(("EXPLAIN QUERY PLAN " + m_sql).toUtf8());
+	sqlite3_stmt * stmt = 0;
+	if (sqlite3_prepare_v3(m_db, sql.constData(), -1, 0, &stmt, 0)
+		!= SQLITE_OK)
+	{
+		m_error = errorMessage();
+		sqlite3_finalize(stmt);
+		return false;
+	}
+	int rc;
+	while (stmt && ((rc = sqlite3_step(stmt)) == SQLITE_ROW))
+	{
+		PlanNode node;
+		node.id = sqlite3_column_int(stmt, 0);
+		node.parent = sqlite3_column_int(stmt, 1);
+		node.detail = QString::fromUtf8(
+			(const char *)sqlite3_column_text(stmt, 3));
+		node.estimated = -1;
+		node.loops = -1;
+		node.rows = -1;
+		node.cycles = -1;
+		m_nodes.append(node);
+	}
+	sqlite3_finalize(stmt);
+	if (m_nodes.isEmpty())
+	{
+		// BEGIN, ATTACH, most PRAGMAs...
+		m_error = tr("The statement has no query plan");
+		return false;
+	}
+	return true;
+}
+
+void ExplainAnalyze::readCounters(sqlite3_stmt * stmt)
+{
+#ifdef ENABLE_SCANSTATUS
+	QHash<int, int> byId;
+	for (int i = 0; i < m_nodes.count(); ++i)
+	{
+		byId.insert(m_nodes.at(i).id, i);
+	}
+	// SQLITE_SCANSTAT_COMPLEX includes the nodes which aren't loops
+	const int flags = SQLITE_SCANSTAT_COMPLEX;
+	for (int idx = 0; ; ++idx)
+	{
+		int id;
+		if (sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_SELECTID,
+									   flags, &id))
+		{
+			break;
+		}
+		if (!byId.contains(id)) { continue; }
+		PlanNode & node = m_nodes[byId.value(id)];
+		sqlite3_int64 loops = -1;
+		sqlite3_int64 rows = -1;
+		sqlite3_int64 cycles = -1;
+		double estimated = -1;
+		sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_NLOOP,
+								   flags, &loops);
+		sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_NVISIT,
+								   flags, &rows);
+		sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_NCYCLE,
+								   flags, &cycles);
+		sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_EST,
+								   flags, &estimated);
+		// a node can have more than one loop behind it
+		if (loops >= 0) { node.loops = qMax(node.loops, qint64(0)) + loops; }
+		if (rows >= 0) { node.rows = qMax(node.rows, qint64(0)) + rows; }
+		if (cycles >= 0)
+		{
+			node.cycles = qMax(node.cycles, qint64(0)) + cycles;
+		}
+		if (estimated >= 0) { node.estimated = estimated; }
+	}
+	sqlite3_int64 cycles = -1;
+	if (sqlite3_stmt_scanstatus_v2(stmt, -1, SQLITE_SCANSTAT_NCYCLE,
+								   flags, &cycles) == 0)
+	{
+		m_cycles = cycles;
+	}
+#else
+	Q_UNUSED(stmt);
+#endif
+}
+
+bool ExplainAnalyze::runStatement()
+{
+	QByteArray sql(m_sql.toUtf8());
+	sqlite3_stmt * stmt = 0;
+	if (sqlite3_prepare_v3(m_db, sql.constData(), -1, 0, &stmt, 0)
+		!= SQLITE_OK)
+	{
+		m_error = errorMessage();
+		sqlite3_finalize(stmt);
+		return false;
+	}
+	if (!stmt) { return false; }
+
+	bool savepoint = !sqlite3_stmt_readonly(stmt);
+	if (   savepoint
+		&& (sqlite3_exec(m_db, "SAVEPOINT EXPLAIN_ANALYZE;", 0, 0, 0)
+			!= SQLITE_OK))
+	{
+		m_error = errorMessage();
+		sqlite3_finalize(stmt);
+		return false;
+	}
+	sqlite3_progress_handler(m_db, ANALYZE_PROGRESS_OPS, progressHandler,
+							 (void *)&m_cancelled);
+	QElapsedTimer timer;
+	timer.start();
+	qint64 count = 0;
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) { ++count; }
+	m_runTime = timer.nsecsElapsed();
+	sqlite3_progress_handler(m_db, 0, 0, 0);
+	bool ok = (rc == SQLITE_DONE);
+	if (ok)
+	{
+		m_rows = (sqlite3_column_count(stmt) > 0)
+				 ? count : sqlite3_changes(m_db);
+		readCounters(stmt);
+	}
+	else if (!m_cancelled.loadAcquire())
+	{
+		m_error = errorMessage();
+	}
+	sqlite3_finalize(stmt);
+
+	if (savepoint)
+	{
+		sqlite3_exec(m_db, "ROLLBACK TO EXPLAIN_ANALYZE;", 0, 0, 0);
+		Catalogue::rolledBack();
+		sqlite3_exec(m_db, "RELEASE EXPLAIN_ANALYZE;", 0, 0, 0);
+		m_rolledBack = true;
+	}
+	return ok;
+}
+
+void ExplainAnalyze::run()
+{
+	m_error = QString();
+	if (!m_db)
+	{
+		m_error = tr("No database is open");
+		return;
+	}
+	if (readPlan() && !runStatement() && m_cancelled.loadAcquire())
+	{
+		m_error = tr("Cancelled");
+	}
+}
@@ -0,0 +1,88 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef EXPLAINANALYZE_H
+#define EXPLAINANALYZE_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
+#include <QtCore/QThread>
+
+#include "sqlite3.h"
+
+/*! \brief One row of EXPLAIN QUERY PLAN, with what it really did.
+The counters are -1 if they aren't known. */
+typedef struct
+{
+	int id;
+	int parent; //!< 0 at the top
+	QString detail;
+	double estimated; //!< rows per loop, the planner's guess
+	qint64 loops;
+	qint64 rows; //!< visited in all the loops
+	qint64 cycles;
+}
+PlanNode;
+
+/*! \brief Runs a statement to see how its query plan really went.
+The plan comes from EXPLAIN QUERY PLAN. Then the statement is run to the
+end, and if sqlite has sqlite3_stmt_scanstatus_v2() (ENABLE_SCANSTATUS,
+which needs SQLITE_ENABLE_STMT_SCANSTATUS) each node of the plan gets the
+loops, rows and cycles it took. Without it only the whole statement is
+measured.
+A statement which isn't read-only is run in a savepoint which is rolled
+back afterwards, so that looking at its plan changes nothing.
+It runs on a worker thread, using the GUI's connection while the GUI
+waits, as DumpRestore does.
+*/
+class ExplainAnalyze : public QThread
+{
+	Q_OBJECT
+
+	public:
+		ExplainAnalyze(const QString & sql, QObject * parent = 0);
+		~ExplainAnalyze();
+
+		QString sql() const { return m_sql; }
+		//! \brief In the order EXPLAIN QUERY PLAN gave them
+		const QList<PlanNode> & nodes() const { return m_nodes; }
+		//! \brief True if the nodes have their counters
+		static bool hasCounters();
+		qint64 runTime() const { return m_runTime; } //!< nanoseconds
+		qint64 rows() const { return m_rows; } //!< returned or changed
+		qint64 cycles() const { return m_cycles; } //!< -1 if not known
+		bool rolledBack() const { return m_rolledBack; }
+
+		//! \brief Null if it ran to the end, otherwise why it didn't
+		QString errorString() const { return m_error; }
+		bool wasCancelled() const { return m_cancelled.loadAcquire() != 0; }
+
+	public slots:
+		void cancel();
+
+	protected:
+		void run();
+
+	private:
+		bool readPlan();
+		bool runStatement();
+		void readCounters(sqlite3_stmt * stmt);
+		QString errorMessage() const;
+		static int progressHandler(void * cancelled);
+
+		QString m_sql;
+		sqlite3 * m_db;
+		QList<PlanNode> m_nodes;
+		qint64 m_runTime;
+		qint64 m_rows;
+		qint64 m_cycles;
+		bool m_rolledBack;
+		QString m_error;
+		QAtomicInt m_cancelled;
+};
+
+#endif
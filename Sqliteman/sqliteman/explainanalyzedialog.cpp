@@ -0,0 +1,105 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QtCore/QHash>
+
+#include "explainanalyzedialog.h"
+#include "preferences.h"
+#include "queryprofiler.h"
+
+ExplainAnalyzeDialog::ExplainAnalyzeDialog(const ExplainAnalyze & analyze,
+										   QWidget * parent)
+	: QDialog(parent)
+{
+	ui.setupUi(this);
+	Preferences * prefs = Preferences::instance();
+	resize(prefs->explainanalyzeWidth(), prefs->explainanalyzeHeight());
+
+	QStringList summary;
+	summary.append(tr("%1 ms, %L2 rows")
+				   .arg(QueryProfiler::formatTime(analyze.runTime()))
+				   .arg(analyze.rows()));
+	if (analyze.rolledBack())
+	{
+		summary.append(tr("The statement's changes were rolled back."));
+	}
+	if (!ExplainAnalyze::hasCounters())
+	{
+		summary.append(tr("This sqlite was built without "
+						  "SQLITE_ENABLE_STMT_SCANSTATUS, so only the "
+						  "whole statement was measured."));
+	}
+	ui.summaryLabel->setText(summary.join(" "));
+
+	const QList<PlanNode> & nodes = analyze.nodes();
+	// the hottest node: most cycles, or most rows visited
+	int hottest = -1;
+	qint64 most = 0;
+	for (int i = 0; i < nodes.count(); ++i)
+	{
+		qint64 cost = (analyze.cycles() >= 0) ? nodes.at(i).cycles
+											  : nodes.at(i).rows;
+		if (cost > most)
+		{
+			most = cost;
+			hottest = i;
+		}
+	}
+
+	QHash<int, QTreeWidgetItem *> items;
+	for (int i = 0; i < nodes.count(); ++i)
+	{
+		const PlanNode & node = nodes.at(i);
+		QTreeWidgetItem * parent = items.value(node.parent, 0);
+		QTreeWidgetItem * item = parent
+								 ? new QTreeWidgetItem(parent)
+								 : new QTreeWidgetItem(ui.planTreeWidget);
+		items.insert(node.id, item);
+		item->setText(0, node.detail);
+		if (node.estimated >= 0)
+		{
+			item->setText(1, QString::number(node.estimated, 'g', 6));
+		}
+		if (node.loops >= 0) { item->setText(2, QString::number(node.loops)); }
+		if (node.rows >= 0) { item->setText(3, QString::number(node.rows)); }
+		if ((node.loops > 0) && (node.rows >= 0))
+		{
+			item->setText(4, QString::number(double(node.rows) / node.loops,
+											 'g', 6));
+		}
+		if ((node.cycles >= 0) && (analyze.cycles() > 0))
+		{
+			item->setText(5, tr("%L1 (%2%)").arg(node.cycles)
+						  .arg(100.0 * node.cycles / analyze.cycles(),
+							   0, 'f', 1));
+		}
+		for (int c = 1; c < ui.planTreeWidget->columnCount(); ++c)
+		{
+			item->setTextAlignment(c, Qt::AlignRight);
+		}
+		if (i == hottest)
+		{
+			QFont font(item->font(0));
+			font.setBold(true);
+			for (int c = 0; c < ui.planTreeWidget->columnCount(); ++c)
+			{
+				item->setFont(c, font);
+				item->setForeground(c, QBrush(Qt::red));
+			}
+			item->setToolTip(0, tr("Most of the work was done here"));
+		}
+	}
+	ui.planTreeWidget->expandAll();
+	ui.planTreeWidget->resizeColumnToContents(0);
+}
+
+ExplainAnalyzeDialog::~ExplainAnalyzeDialog()
+{
+	Preferences * prefs = Preferences::instance();
+	prefs->setexplainanalyzeHeight(height());
+	prefs->setexplainanalyzeWidth(width());
+}
@@ -0,0 +1,35 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef EXPLAINANALYZEDIALOG_H
+#define EXPLAINANALYZEDIALOG_H
+
+#include <qdialog.h>
+
+#include "explainanalyze.h"
+#include "ui_explainanalyzedialog.h"
+
+/*! \brief Shows what ExplainAnalyze found as a tree.
+Each node of the query plan is under its parent, with the rows the planner
+expected beside the loops, rows and cycles it really took. The node which
+took the most cycles, or visited the most rows if cycles aren't counted,
+is highlighted: it is usually where a bad join order shows.
+*/
+class ExplainAnalyzeDialog : public QDialog
+{
+	Q_OBJECT
+
+	public:
+		ExplainAnalyzeDialog(const ExplainAnalyze & analyze,
+							 QWidget * parent = 0);
+		~ExplainAnalyzeDialog();
+
+	private:
+		Ui::ExplainAnalyzeDialog ui;
+};
+
+#endif
@@ -9,18 +9,17 @@ for which a new license (GPL+exception) is in place.
 */
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QProgressDialog>
 #include <QStandardItemModel>
 
-#if QT_VERSION >= 0x040300
-#include <QXmlStreamReader>
-#else
-#warning "QXmlStreamReader is disabled. Qt 4.3.x required."
-#endif
-
 #include <QSqlQuery>
 #include <QSqlError>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
 #include <QtCore/QTextStream>
-#include <QTreeWidgetItem>
 
 #include "database.h"
 #include "importtabledialog.h"
@@ -29,6 +28,13 @@ for which a new license (GPL+exception) is in place.
 #include "sqliteprocess.h"
 #include "utils.h"
 
+// The rest only go to the reject file
+#define MAX_LOGGED_REJECTS 100
+// How much of a JSON file is read at once
+#define JSON_BLOCK_SIZE 65536
+// How many JSON objects are decoded in parallel
+#define JSON_CHUNK_SIZE 4096
+
 ImportTableDialog::ImportTableDialog(LiteManWindow * parent,
 									 const QString & tableName,
 									 const QString & schema)
@@ -36,6 +42,7 @@ ImportTableDialog::ImportTableDialog(LiteManWindow * parent,
 	m_tableName(tableName), m_schema(schema)
 {
 	update = false;
+	m_cancelled = false;
 	creator = parent;
 	setupUi(this);
     Preferences * prefs = Preferences::instance();
@@ -79,7 +86,20 @@ ImportTableDialog::ImportTableDialog(LiteManWindow * parent,
     connect(skipHeaderBox, SIGNAL(textChanged(const QString &)),
             this, SLOT(createPreview()));
 
+	checkpointBox->setValue(prefs->importCheckpoint());
+	connect(tableComboBox, SIGNAL(currentIndexChanged(int)),
+			this, SLOT(checkCheckpoint()));
+	connect(fileEdit, SIGNAL(textChanged(const QString &)),
+			this, SLOT(checkCheckpoint()));
+	// json
+	setJsonColumns();
+	connect(tableComboBox, SIGNAL(currentIndexChanged(int)),
+			this, SLOT(setJsonColumns()));
+	connect(jsonExtraCombo, SIGNAL(currentIndexChanged(int)),
+			this, SLOT(createPreview()));
+
 	skipHeaderCheck_toggled(false);
+	checkCheckpoint();
 }
 
 ImportTableDialog::~ImportTableDialog()
@@ -185,7 +205,7 @@ void ImportTableDialog::fileButton_clicked()
 	pth = pth.isEmpty() ? QDir::currentPath() : pth;
 	QString fname = QFileDialog::getOpenFileName(this, tr("File to Import"),
 												 pth,
-												 tr("CSV Files (*.csv);;MS Excel XML (*.xls);;Text Files (*.txt);;All Files (*)"));
+												 tr("CSV Files (*.csv);;MS Excel XML (*.xls);;JSON Files (*.json *.ndjson *.jsonl);;Text Files (*.txt);;All Files (*)"));
 	if (fname.isEmpty())
 		return;
 
@@ -196,39 +216,88 @@ void ImportTableDialog::fileButton_clicked()
 
 void ImportTableDialog::slotAccepted()
 {
-	QList<QStringList> values;
-
 	if (fileEdit->text().isEmpty())
 	{
 		return;
 	}
 
+	if (   (m_tableName == tableComboBox->currentText())
+		&& (m_schema == schemaComboBox->currentText())
+		&& ((!creator) || !(creator->checkForPending())))
+	{
+		return;
+	}
+
 	int skipHeader = skipHeaderCheck->isChecked() ? skipHeaderBox->value() : 0;
 	QList<FieldInfo> fields
 		= Database::tableFields(tableComboBox->currentText(),
 								schemaComboBox->currentText());
+	int cols = fields.count();
+	int batchSize = checkpointBox->value();
+	Preferences::instance()->setImportCheckpoint(batchSize);
 
+	ImportTable::RowSource * source = 0;
 	switch (tabWidget->currentIndex())
 	{
 		case 0:
-			values = ImportTable::CSVModel(fileEdit->text(), fields,
-										   skipHeader, colSep->text(),
-										   quoteChar->text(),
-										   this, 0).m_values;
+			source = new ImportTable::CSVSource(fileEdit->text(),
+												colSep->text(),
+												quoteChar->text());
 			break;
 		case 1:
-			values = ImportTable::XMLModel(fileEdit->text(), fields,
-										   skipHeader, this, 0).m_values;
+			source = new ImportTable::XMLSource(fileEdit->text());
+			break;
+		case 2:
+		{
+			QStringList columns;
+			for (int i = 0; i < cols; ++i) { columns.append(fields[i].name); }
+			source = new ImportTable::JSONSource(fileEdit->text(), columns,
+				jsonExtraCombo->itemData(
+					jsonExtraCombo->currentIndex()).toInt());
+			break;
+		}
+		default:
+			return;
+	}
+	if (!source->isOpen())
+	{
+		QMessageBox::warning(this, tr("Data Import"),
+							 tr("Cannot open file %1 for reading.")
+							 .arg(fileEdit->text()));
+		delete source;
+		return;
 	}
 
 	// base import
 	bool result = true;
-    bool commitFailed = false;
-	QStringList l;
+	bool commitFailed = false;
 	QStringList log;
-	int cols = Database::tableFields(tableComboBox->currentText(),
-									 schemaComboBox->currentText()).count();
 	int row = 0;
+	int rejected = 0;
+	QStringList values;
+	bool resume = resumeCheck->isEnabled() && resumeCheck->isChecked();
+	if (resume)
+	{
+		qint64 offset;
+		if (!readCheckpoint(offset, row) || !source->seek(offset))
+		{
+			QMessageBox::warning(this, tr("Data Import"),
+				tr("Cannot resume the import of %1.").arg(fileEdit->text()));
+			delete source;
+			return;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < skipHeader; ++i)
+		{
+			if (!source->next(values)) { break; }
+		}
+		QFile::remove(rejectFileName());
+		// starting again, so an older checkpoint is out of date
+		clearCheckpoint();
+	}
+
 	QStringList binds;
 	for (int i = 0; i < cols; ++i) { binds << "?"; }
 	QString sql = QString("insert into ")
@@ -238,104 +307,354 @@ void ImportTableDialog::slotAccepted()
 				  + " values ("
 				  + binds.join(", ")
 				  + ");";
-		
+
+	QFile rejectFile(rejectFileName());
+	QTextStream rejects(&rejectFile);
+
+	m_cancelled = false;
+	QProgressDialog progress(tr("Importing %1").arg(fileEdit->text()),
+							 tr("Cancel"), 0, 1000, this);
+	connect(&progress, SIGNAL(canceled()), this, SLOT(cancel()));
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(1000);
+
 	QSqlQuery query(QSqlDatabase::database(SESSION_NAME));
+	QSqlQuery savepoint = Database::doSql("SAVEPOINT IMPORT_TABLE;");
+	if (savepoint.lastError().isValid())
+	{
+		log.append(QString("SAVEPOINT IMPORT_TABLE: %1")
+					.arg(savepoint.lastError().text()));
+		result = false;
+		commitFailed = true;
+	}
+	else if (!query.prepare(sql))
+	{
+		log.append(QString("%1: %2").arg(sql)
+					.arg(query.lastError().text()));
+		result = false;
+		commitFailed = true;
+		Database::execSql("ROLLBACK TO IMPORT_TABLE;");
+		Database::execSql("RELEASE IMPORT_TABLE;");
+	}
+	else
+	{
+		int inBatch = 0;
+		bool blobs = source->hasBlobs();
+		while (source->next(values))
+		{
+			++row;
+			// a row which couldn't be decoded holds the raw text
+			QString reason(source->rowError());
+			if (reason.isNull())
+			{
+				if (values.count() != cols)
+				{
+					reason = tr("Imported values = %1; Table columns count = %2")
+							 .arg(values.count()).arg(cols);
+				}
+				else
+				{
+					for (int i = 0; i < cols ; ++i)
+					{
+						query.bindValue(i, blobs ? importValue(values.at(i))
+												 : textValue(values.at(i)));
+					}
+					if (!query.exec())
+					{
+						reason = query.lastError().text();
+					}
+				}
+			}
+			if (!reason.isNull())
+			{
+				result = false;
+				if (rejected == 0)
+				{
+					rejectFile.open(resume
+						? QIODevice::WriteOnly | QIODevice::Append
+						: QIODevice::WriteOnly | QIODevice::Truncate);
+				}
+				writeReject(rejects, row, reason, values);
+				// only keep the first few for the log dialog
+				if (++rejected <= MAX_LOGGED_REJECTS)
+				{
+					log.append(tr("Row = %1; %2; Values = (%3)")
+							   .arg(row).arg(reason).arg(values.join(", ")));
+				}
+			}
 
-	if (   (m_tableName == tableComboBox->currentText())
-		&& (m_schema == schemaComboBox->currentText())
-		&& ((!creator) || !(creator->checkForPending())))
+			if ((batchSize > 0) && (++inBatch >= batchSize))
+			{
+				inBatch = 0;
+				qint64 offset = source->offset();
+				savepoint = Database::doSql("RELEASE IMPORT_TABLE;");
+				if (savepoint.lastError().isValid())
+				{
+					log.append(QString("RELEASE IMPORT_TABLE: %1")
+								.arg(savepoint.lastError().text()));
+					commitFailed = true;
+					break;
+				}
+				writeCheckpoint(offset, row);
+				rejects.flush();
+				savepoint = Database::doSql("SAVEPOINT IMPORT_TABLE;");
+				if (savepoint.lastError().isValid())
+				{
+					log.append(QString("SAVEPOINT IMPORT_TABLE: %1")
+								.arg(savepoint.lastError().text()));
+					commitFailed = true;
+					break;
+				}
+			}
+			if ((row % 1000) == 0)
+			{
+				qint64 size = source->size();
+				if (size > 0)
+				{
+					progress.setValue((int)(source->position() * 1000 / size));
+				}
+				qApp->processEvents();
+				if (m_cancelled) { break; }
+			}
+		}
+		QString error(source->errorString());
+		if (!error.isNull())
+		{
+			log.append(tr("Error reading %1 after row %2: %3")
+					   .arg(fileEdit->text()).arg(row).arg(error));
+			result = false;
+		}
+		if (commitFailed || m_cancelled)
+		{
+			// we can't meaningfully handle errors here
+			Database::execSql("ROLLBACK TO IMPORT_TABLE;");
+			Database::execSql("RELEASE IMPORT_TABLE;");
+		}
+	}
+	progress.setValue(1000);
+	delete source;
+	rejects.flush();
+	rejectFile.close();
+
+	if (m_cancelled && !commitFailed)
 	{
+		qint64 offset;
+		int done;
+		if (readCheckpoint(offset, done))
+		{
+			QMessageBox::information(this, tr("Data Import"),
+				tr("The import was cancelled. Rows up to the last checkpoint"
+				   " have been committed: use Resume Import to continue."));
+			checkCheckpoint();
+		}
 		return;
 	}
-	QSqlQuery savepoint = Database::doSql("SAVEPOINT IMPORT_TABLE;");
-    if (savepoint.lastError().isValid())
-    {
-        log.append(QString("SAVEPOINT IMPORT_TABLE: %1")
-                    .arg(query.lastError().text()));
-        result = false;
-        commitFailed = true;
-    } else {
-        QList<QStringList>::const_iterator it;
-        for (it = values.constBegin(); it != values.constEnd(); ++it) {
-            ++row;
-            if (it->count() != cols)
-            {
-                log.append(tr("Row = %1; Imported values = %2; "
-                            "Table columns count = %3; Values = (%4)")
-                        .arg(row).arg(it->count()).arg(cols).arg(it->join(", ")));
-                result = false;
-                continue;
-            }
-
-            query.prepare(sql);
-            for (int i = 0; i < cols ; ++i)
-            {
-                QString s(it->at(i));
-                if (s.isEmpty())
-                {
-                    query.addBindValue(QVariant(QVariant::String));
-                }
-                else
-                {
-                    if (s.startsWith("X'", Qt::CaseInsensitive))
-                    {
-                        QByteArray b;
-                        while (!s.startsWith("'"))
-                        {
-                            // blob
-                            s = s.remove(0, 2);
-                            b.append((hexValue(s[0]) << 4) + hexValue(s[1]));
-                        }
-                        query.addBindValue(QVariant(b));
-                    }
-                    else
-                    {
-                        query.addBindValue(s);
-                    }
-                }
-            }
-
-            query.exec();
-            if (query.lastError().isValid())
-            {
-                log.append(tr("Row = %1; %2")
-                        .arg(row).arg(query.lastError().text()));
-                result = false;
-            }
-        }
-    }
-    if (result)
-    {
-        savepoint = Database::doSql("RELEASE IMPORT_TABLE;");
-        if (savepoint.lastError().isValid())
-        {
-            log.append(QString("RELEASE IMPORT_TABLE: %1")
-                        .arg(query.lastError().text()));
-            result = false;
-            commitFailed = true;
-        }
-    }
-	if (!result)
+	if (rejected > 0)
+	{
+		log.prepend(tr("%1 rows were rejected. They have been written"
+					   " with the reasons to %2")
+					.arg(rejected).arg(rejectFileName()));
+		if (rejected > MAX_LOGGED_REJECTS)
+		{
+			log.append(tr("... see the reject file for the remaining rows"));
+		}
+	}
+	if ((!result) && (batchSize > 0) && !commitFailed)
+	{
+		// Earlier batches are already committed, so there is no choice
+		savepoint = Database::doSql("RELEASE IMPORT_TABLE;");
+		if (savepoint.lastError().isValid())
+		{
+			log.append(QString("RELEASE IMPORT_TABLE: %1")
+						.arg(savepoint.lastError().text()));
+			commitFailed = true;
+		}
+		else
+		{
+			// the whole file is in, the checkpoint isn't needed any more
+			clearCheckpoint();
+			ImportTableLogDialog dia(log, this);
+			dia.label->setText(tr("There have been import errors. The rows"
+								  " listed above have not been imported."));
+			dia.buttonBox->setStandardButtons(QDialogButtonBox::Ok);
+			dia.exec();
+			update = m_alteringActive;
+			accept();
+			return;
+		}
+	}
+	if (result && !commitFailed)
+	{
+		savepoint = Database::doSql("RELEASE IMPORT_TABLE;");
+		if (savepoint.lastError().isValid())
+		{
+			log.append(QString("RELEASE IMPORT_TABLE: %1")
+						.arg(savepoint.lastError().text()));
+			result = false;
+			commitFailed = true;
+		}
+	}
+	if ((!result) || commitFailed)
 	{
 		ImportTableLogDialog dia(log, this);
-        if (commitFailed)
-        {
-            // user can't accept if we've already failed to commit
-            dia.buttonBox->setStandardButtons(QDialogButtonBox::No|QDialogButtonBox::NoButton);
-            dia.exec();
-            return;
-        }
+		if (commitFailed)
+		{
+			// user can't accept if we've already failed to commit
+			dia.buttonBox->setStandardButtons(QDialogButtonBox::No|QDialogButtonBox::NoButton);
+			dia.exec();
+			return;
+		}
 		else if (!dia.exec())
 		{
-            // we can't meaningfully handle errors here
-            Database::execSql("ROLLBACK TO IMPORT_TABLE;");
-            Database::execSql("RELEASE IMPORT_TABLE;");
-            return;
+			// we can't meaningfully handle errors here
+			Database::execSql("ROLLBACK TO IMPORT_TABLE;");
+			Database::execSql("RELEASE IMPORT_TABLE;");
+			return;
+		}
+		else
+		{
+			Database::execSql("RELEASE IMPORT_TABLE;");
+		}
+	}
+	clearCheckpoint();
+	update = m_alteringActive;
+	accept();
+	return;
+}
+
+QVariant ImportTableDialog::importValue(const QString & s)
+{
+	if (s.isEmpty())
+	{
+		return QVariant(QVariant::String);
+	}
+	else if (   s.startsWith("X'", Qt::CaseInsensitive)
+			 && s.endsWith("'")
+			 && ((s.length() % 2) == 1))
+	{
+		// blob
+		QByteArray b;
+		for (int i = 2; i < s.length() - 1; i += 2)
+		{
+			b.append((hexValue(s[i]) << 4) + hexValue(s[i + 1]));
 		}
+		return QVariant(b);
+	}
+	else
+	{
+		return QVariant(s);
+	}
+}
+
+QVariant ImportTableDialog::textValue(const QString & s)
+{
+	// an empty cell or JSON null comes as a null string, "" as an empty one
+	return s.isNull() ? QVariant(QVariant::String) : QVariant(s);
+}
+
+QString ImportTableDialog::importFileName()
+{
+	return QFileInfo(fileEdit->text()).absoluteFilePath();
+}
+
+QString ImportTableDialog::rejectFileName()
+{
+	return importFileName() + ".rejects";
+}
+
+QString ImportTableDialog::checkpointKey()
+{
+	QString file(Database::getDatabases().value(schemaComboBox->currentText()));
+	// a temporary or in-memory database won't be there to resume into
+	if (file.isEmpty() || (file == ":memory:")) { return QString(); }
+	return importFileName() + "\n" + QFileInfo(file).absoluteFilePath()
+		   + "\n" + schemaComboBox->currentText()
+		   + "\n" + tableComboBox->currentText();
+}
+
+bool ImportTableDialog::readCheckpoint(qint64 & offset, int & row)
+{
+	Preferences * prefs = Preferences::instance();
+	QString key(checkpointKey());
+	if (key.isNull() || (prefs->importResume() != key)) { return false; }
+	offset = prefs->importResumeOffset();
+	row = prefs->importResumeRow();
+	return true;
+}
+
+void ImportTableDialog::writeCheckpoint(qint64 offset, int row)
+{
+	// inside a transaction of the user's, the batch isn't committed yet
+	if (!Database::isAutoCommit()) { return; }
+	QString key(checkpointKey());
+	if (!key.isNull())
+	{
+		Preferences::instance()->setImportResume(key, offset, row);
+	}
+}
+
+void ImportTableDialog::clearCheckpoint()
+{
+	Preferences * prefs = Preferences::instance();
+	QString key(checkpointKey());
+	if ((!key.isNull()) && (prefs->importResume() == key))
+	{
+		prefs->setImportResume(QString(), 0, 0);
+	}
+}
+
+void ImportTableDialog::writeReject(QTextStream & out, int row,
+									const QString & reason,
+									const QStringList & values)
+{
+	// row number, reason, then the original values, as CSV
+	out << row << "," << Utils::q(reason, "\"");
+	QStringList::const_iterator it;
+	for (it = values.constBegin(); it != values.constEnd(); ++it)
+	{
+		out << "," << Utils::q(*it, "\"");
+	}
+	out << "\n";
+}
+
+void ImportTableDialog::checkCheckpoint()
+{
+	qint64 offset;
+	int row;
+	if ((!fileEdit->text().isEmpty()) && readCheckpoint(offset, row))
+	{
+		resumeCheck->setEnabled(true);
+		resumeCheck->setText(tr("Resume Import after row %1").arg(row));
+	}
+	else
+	{
+		resumeCheck->setEnabled(false);
+		resumeCheck->setChecked(false);
+		resumeCheck->setText(tr("Resume Import"));
+	}
+}
+
+void ImportTableDialog::setJsonColumns()
+{
+	QString current(jsonExtraCombo->currentText());
+	jsonExtraCombo->blockSignals(true);
+	jsonExtraCombo->clear();
+	jsonExtraCombo->addItem(tr("Leave out"), -1);
+	QList<FieldInfo> fields
+		= Database::tableFields(tableComboBox->currentText(),
+								schemaComboBox->currentText());
+	for (int i = 0; i < fields.count(); ++i)
+	{
+		jsonExtraCombo->addItem(fields[i].name, i);
 	}
-    update = m_alteringActive;
-    accept();
-    return;
+	int ix = jsonExtraCombo->findText(current);
+	jsonExtraCombo->setCurrentIndex(ix < 0 ? 0 : ix);
+	jsonExtraCombo->blockSignals(false);
+}
+
+void ImportTableDialog::cancel()
+{
+	m_cancelled = true;
 }
 
 void ImportTableDialog::updateButton()
@@ -383,6 +702,13 @@ void ImportTableDialog::createPreview(int)
 				previewView->setModel(new ImportTable::XMLModel(
 					fileEdit->text(), fields, skipHeader, this, 3));
 				break;
+			case 2:
+				previewView->setModel(new ImportTable::JSONModel(
+					fileEdit->text(), fields, skipHeader,
+					jsonExtraCombo->itemData(
+						jsonExtraCombo->currentIndex()).toInt(),
+					this, 3));
+				break;
 		}
 	}
 	else
@@ -448,7 +774,8 @@ QVariant ImportTable::BaseModel::headerData(int section, Qt::Orientation orienta
 {
 	if (role != Qt::DisplayRole) { return QVariant(); }
 
-	if (orientation == Qt::Horizontal)
+	if (   (orientation == Qt::Horizontal)
+		&& (section < m_columnNames.count()))
 	{
 		return m_columnNames[section];
 	}
@@ -462,8 +789,8 @@ ImportTable::CSVModel::CSVModel(QString fileName, QList<FieldInfo> fields,
 								QObject * parent, int maxRows)
 	: BaseModel(fields, parent)
 {
-	QFile f(fileName);
-	if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+	CSVSource in(fileName, separator, quote);
+	if (!in.isOpen())
 	{
 		QMessageBox::warning(qobject_cast<QWidget*>(parent), tr("Data Import"),
 							 tr("Cannot open file %1 for reading.")
@@ -471,92 +798,550 @@ ImportTable::CSVModel::CSVModel(QString fileName, QList<FieldInfo> fields,
 		return;
 	}
 
-	QTextStream in(&f);
-	int r = 0;
 	QStringList row;
 	int tmpSkipHeader = 0;
-	while (!in.atEnd())
+	while (in.next(row))
 	{
-		row = ImportTableDialog::splitLine(&in, separator, quote);
 		if (tmpSkipHeader < skipHeader)
 		{
 			tmpSkipHeader++;
 			continue;
 		}
 		m_values.append(row);
-		if (r > maxRows)
+		if ((maxRows != 0) && (m_values.count() >= maxRows))
 			break;
-		if (maxRows != 0)
-			++r;
 	}
-	f.close();
+}
+
+ImportTable::CSVSource::CSVSource(const QString & fileName,
+								  const QString & separator,
+								  const QString & quote)
+	: m_file(fileName),
+	  m_separator(separator),
+	  m_quote(quote)
+{
+	if (m_file.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		m_in.setDevice(&m_file);
+	}
+}
+
+bool ImportTable::CSVSource::isOpen()
+{
+	return m_file.isOpen();
+}
+
+bool ImportTable::CSVSource::next(QStringList & row)
+{
+	if (m_in.atEnd()) { return false; }
+	row = ImportTableDialog::splitLine(&m_in, m_separator, m_quote);
+	return true;
+}
+
+qint64 ImportTable::CSVSource::offset()
+{
+	return m_in.pos();
+}
+
+bool ImportTable::CSVSource::seek(qint64 offset)
+{
+	return m_in.seek(offset);
+}
+
+qint64 ImportTable::CSVSource::position()
+{
+	// the device is a little ahead of the stream, but it's cheap
+	return m_file.pos();
+}
+
+qint64 ImportTable::CSVSource::size()
+{
+	return m_file.size();
+}
+
+ImportTable::XMLSource::XMLSource(const QString & fileName)
+	: m_file(fileName),
+	  m_rows(0)
+{
+	if (m_file.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		m_xml.setDevice(&m_file);
+	}
+}
+
+bool ImportTable::XMLSource::isOpen()
+{
+	return m_file.isOpen();
+}
+
+bool ImportTable::XMLSource::next(QStringList & row)
+{
+	bool isCell = false;
+	bool hasData = false;
+	row.clear();
+	while (!m_xml.atEnd())
+	{
+		m_xml.readNext();
+		if (m_xml.isStartElement())
+		{
+			if (m_xml.name() == "Row")
+			{
+				row.clear();
+				isCell = false;
+			}
+			else if (m_xml.name() == "Cell")
+			{
+				isCell = true;
+				hasData = false;
+				// ss:Index skips over empty cells (it counts from 1)
+				QString index = m_xml.attributes().value(
+					"urn:schemas-microsoft-com:office:spreadsheet",
+					"Index").toString();
+				if (!index.isEmpty())
+				{
+					int n = index.toInt();
+					while (row.count() < n - 1) { row.append(QString()); }
+				}
+			}
+			else if (isCell && m_xml.name() == "Data")
+			{
+				row.append(m_xml.readElementText(
+					QXmlStreamReader::IncludeChildElements));
+				hasData = true;
+			}
+		}
+		else if (m_xml.isEndElement())
+		{
+			if (m_xml.name() == "Cell")
+			{
+				// an empty cell still occupies a column
+				if (isCell && !hasData) { row.append(QString()); }
+				isCell = false;
+			}
+			else if (m_xml.name() == "Row")
+			{
+				++m_rows;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool ImportTable::XMLSource::seek(qint64 offset)
+{
+	if (!m_file.seek(0)) { return false; }
+	m_xml.clear();
+	m_xml.setDevice(&m_file);
+	m_rows = 0;
+	QStringList discard;
+	while (m_rows < offset)
+	{
+		if (!next(discard)) { return false; }
+	}
+	return true;
+}
+
+qint64 ImportTable::XMLSource::position()
+{
+	return m_file.pos();
+}
+
+qint64 ImportTable::XMLSource::size()
+{
+	return m_file.size();
+}
+
+QString ImportTable::XMLSource::errorString()
+{
+	if (   (!m_xml.hasError())
+		|| (m_xml.error() == QXmlStreamReader::PrematureEndOfDocumentError))
+	{
+		return QString();
+	}
+	return QString("%1:%2").arg(m_xml.lineNumber()).arg(m_xml.errorString());
 }
 
 ImportTable::XMLModel::XMLModel(QString fileName, QList<FieldInfo> fields,
 								int skipHeader, QObject * parent, int maxRows)
 	: BaseModel(fields, parent)
 {
-#if QT_VERSION >= 0x040300
-	QFile file(fileName);
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	XMLSource in(fileName);
+	if (!in.isOpen())
 	{
 		QMessageBox::warning(qobject_cast<QWidget*>(parent), tr("Data Import"),
 							 tr("Cannot open file %1 for reading.").arg(fileName));
 		return;
 	}
 
-	QXmlStreamReader xml(&file);
 	QStringList row;
-	bool isCell = false;
-	int r = 0;
 	int tmpSkipHeader = 0;
+	// for a preview we stop reading as soon as we have enough rows
+	while (in.next(row))
+	{
+		if (tmpSkipHeader < skipHeader)
+		{
+			tmpSkipHeader++;
+			continue;
+		}
+		m_values.append(row);
+		if (row.count() > m_columns)
+			m_columns = row.count();
+		if ((maxRows != 0) && (m_values.count() >= maxRows))
+			break;
+	}
+	QString error(in.errorString());
+	if (!error.isNull())
+	{
+		qDebug("XML ERROR:%s", error.toUtf8().data());
+	}
+}
+
+ImportTable::JSONSource::JSONSource(const QString & fileName,
+									const QStringList & columns,
+									int extraColumn)
+	: m_file(fileName),
+	  m_isArray(false),
+	  m_arrayEnded(false),
+	  m_pos(0),
+	  m_base(0),
+	  m_next(0),
+	  m_offset(0),
+	  m_columnCount(columns.count()),
+	  m_extraColumn(extraColumn)
+{
+	// sqlite column names are case insensitive
+	for (int i = 0; i < columns.count(); ++i)
+	{
+		m_columns.insert(columns[i].toLower(), i);
+	}
+	if (m_file.open(QIODevice::ReadOnly))
+	{
+		seek(0);
+	}
+}
+
+bool ImportTable::JSONSource::isOpen()
+{
+	return m_file.isOpen();
+}
+
+bool ImportTable::JSONSource::fillBuffer()
+{
+	// drop what has been consumed, then append the next block
+	m_buffer.remove(0, m_pos);
+	m_base += m_pos;
+	m_pos = 0;
+	QByteArray more(m_file.read(JSON_BLOCK_SIZE));
+	if (more.isEmpty()) { return false; }
+	m_buffer.append(more);
+	return true;
+}
+
+bool ImportTable::JSONSource::readLine(QByteArray & line)
+{
+	int i = m_pos;
+	while (true)
+	{
+		int nl = m_buffer.indexOf('\n', i);
+		if (nl >= 0)
+		{
+			line = m_buffer.mid(m_pos, nl - m_pos);
+			m_pos = nl + 1;
+			return true;
+		}
+		int rel = m_buffer.size() - m_pos;
+		if (!fillBuffer())
+		{
+			// last line without a newline
+			if (m_pos >= m_buffer.size()) { return false; }
+			line = m_buffer.mid(m_pos);
+			m_pos = m_buffer.size();
+			return true;
+		}
+		i = rel;
+	}
+}
 
-	while (!xml.atEnd())
+bool ImportTable::JSONSource::readElement(QByteArray & text)
+{
+	if (m_arrayEnded) { return false; }
+	// skip the separators in front of the element
+	while (true)
+	{
+		if ((m_pos >= m_buffer.size()) && !fillBuffer()) { return false; }
+		char c = m_buffer.at(m_pos);
+		if (c == ']')
+		{
+			m_arrayEnded = true;
+			++m_pos;
+			return false;
+		}
+		if ((c != ',') && (c != ' ') && (c != '\t')
+			&& (c != '\r') && (c != '\n'))
+		{
+			break;
+		}
+		++m_pos;
+	}
+	// find its end, we only need to track strings and nesting
+	int depth = 0;
+	bool inString = false;
+	bool escaped = false;
+	int i = m_pos;
+	while (true)
 	{
-		xml.readNext();
-		if (xml.isStartElement())
+		if (i >= m_buffer.size())
 		{
-			if (xml.name() == "Row")
+			int rel = i - m_pos;
+			if (!fillBuffer())
 			{
-				row.clear();
-				isCell = false;
+				// truncated file: let the decoder complain about it
+				text = m_buffer.mid(m_pos);
+				m_pos = m_buffer.size();
+				return true;
 			}
-			if (xml.name() == "Cell")
-				isCell = true;
-			if (isCell && xml.name() == "Data")
-				row.append(xml.readElementText());
+			i = rel;
 		}
-		if (xml.isEndElement())
+		char c = m_buffer.at(i);
+		if (inString)
 		{
-			if (xml.name() == "Cell")
-				isCell = false;
-			if (xml.name() == "Row")
+			if (escaped) { escaped = false; }
+			else if (c == '\\') { escaped = true; }
+			else if (c == '"') { inString = false; }
+		}
+		else if (c == '"') { inString = true; }
+		else if ((c == '{') || (c == '[')) { ++depth; }
+		else if ((c == '}') || (c == ']'))
+		{
+			if (depth == 0) { break; } // end of array after a scalar
+			if (--depth == 0) { ++i; break; }
+		}
+		else if ((c == ',') && (depth == 0)) { break; }
+		++i;
+	}
+	text = m_buffer.mid(m_pos, i - m_pos);
+	m_pos = i;
+	return true;
+}
+
+namespace ImportTable
+{
+	//! \brief QtConcurrent::map() functor for JSONSource::decode()
+	class JSONDecoder
+	{
+		public:
+			typedef void result_type;
+			JSONDecoder(const JSONSource * source) : m_source(source) {}
+			void operator()(JSONSource::Item & item) const
 			{
-				if (tmpSkipHeader < skipHeader)
-				{
-					tmpSkipHeader++;
-					continue;
-				}
-				m_values.append(row);
-				if (row.count() > m_columns)
-					m_columns = row.count();
-				row.clear();
-				isCell = false;
-				if (r > maxRows)
-					break;
-				if (maxRows != 0)
-					++r;
+				m_source->decode(item);
 			}
+		private:
+			const JSONSource * m_source;
+	};
+};
+
+bool ImportTable::JSONSource::fillChunk()
+{
+	m_chunk.clear();
+	m_next = 0;
+	Item item;
+	while (m_chunk.count() < JSON_CHUNK_SIZE)
+	{
+		if (m_isArray)
+		{
+			if (!readElement(item.text)) { break; }
+		}
+		else
+		{
+			if (!readLine(item.text)) { break; }
+			// blank lines are not rows
+			if (item.text.trimmed().isEmpty()) { continue; }
+		}
+		item.end = m_base + m_pos;
+		m_chunk.append(item);
+	}
+	if (m_chunk.isEmpty()) { return false; }
+	QtConcurrent::blockingMap(m_chunk, JSONDecoder(this));
+	return true;
+}
+
+void ImportTable::JSONSource::decode(Item & item) const
+{
+	QJsonParseError error;
+	QJsonDocument doc(QJsonDocument::fromJson(item.text, &error));
+	if (error.error != QJsonParseError::NoError)
+	{
+		item.error = tr("Invalid JSON at character %1: %2")
+					 .arg(error.offset).arg(error.errorString());
+	}
+	else if (!doc.isObject())
+	{
+		item.error = tr("Not a JSON object");
+	}
+	if (!item.error.isNull())
+	{
+		item.row = QStringList(QString::fromUtf8(item.text).trimmed());
+		return;
+	}
+	QJsonObject extra;
+	item.row.clear();
+	for (int i = 0; i < m_columnCount; ++i) { item.row.append(QString()); }
+	QJsonObject object(doc.object());
+	QJsonObject::const_iterator it;
+	for (it = object.constBegin(); it != object.constEnd(); ++it)
+	{
+		int i = m_columns.value(it.key().toLower(), -1);
+		if (i >= 0)
+		{
+			item.row[i] = jsonText(it.value());
+		}
+		else if (m_extraColumn >= 0)
+		{
+			extra.insert(it.key(), it.value());
 		}
 	}
-	if (xml.error() && xml.error() != QXmlStreamReader::PrematureEndOfDocumentError)
+	if ((m_extraColumn >= 0) && !extra.isEmpty())
 	{
-        qDebug("XML ERROR:%lld:%s",
-               xml.lineNumber(), xml.errorString().toUtf8().data());
-    }
+		item.row[m_extraColumn] = QString::fromUtf8(
+			QJsonDocument(extra).toJson(QJsonDocument::Compact));
+	}
+	// the raw text isn't needed any more
+	item.text.clear();
+}
 
-	file.close();
-#endif
+QString ImportTable::JSONSource::jsonText(const QJsonValue & v)
+{
+	switch (v.type())
+	{
+		case QJsonValue::Bool:
+			return v.toBool() ? "1" : "0";
+		case QJsonValue::Double:
+		{
+			// QJsonValue holds numbers as doubles: don't add ".0" to integers
+			double d = v.toDouble();
+			if ((d == (double)(qint64)d) && (qAbs(d) < 9007199254740992.0))
+			{
+				return QString::number((qint64)d);
+			}
+			return QString::number(d, 'g', 17);
+		}
+		case QJsonValue::String:
+			return v.toString();
+		case QJsonValue::Array:
+			return QString::fromUtf8(
+				QJsonDocument(v.toArray()).toJson(QJsonDocument::Compact));
+		case QJsonValue::Object:
+			return QString::fromUtf8(
+				QJsonDocument(v.toObject()).toJson(QJsonDocument::Compact));
+		default: // Null or Undefined
+			return QString();
+	}
+}
+
+bool ImportTable::JSONSource::next(QStringList & row)
+{
+	if ((m_next >= m_chunk.count()) && !fillChunk()) { return false; }
+	const Item & item = m_chunk.at(m_next++);
+	row = item.row;
+	m_rowError = item.error;
+	m_offset = item.end;
+	return true;
+}
+
+qint64 ImportTable::JSONSource::offset()
+{
+	return m_offset;
+}
+
+bool ImportTable::JSONSource::seek(qint64 offset)
+{
+	m_chunk.clear();
+	m_next = 0;
+	m_buffer.clear();
+	m_pos = 0;
+	m_arrayEnded = false;
+	m_rowError = QString();
+	if (!m_file.seek(0)) { return false; }
+	m_base = 0;
+	// an array is recognised by its first non-blank character
+	m_isArray = false;
+	while (fillBuffer())
+	{
+		QByteArray start(m_buffer.trimmed());
+		if (!start.isEmpty())
+		{
+			m_isArray = start.startsWith('[');
+			break;
+		}
+	}
+	if (offset == 0)
+	{
+		// the buffer still starts at the beginning of the file
+		if (m_isArray)
+		{
+			// step over the opening bracket
+			while ((m_pos < m_buffer.size()) || fillBuffer())
+			{
+				if (m_buffer.at(m_pos++) == '[') { break; }
+			}
+		}
+	}
+	else
+	{
+		// offsets are always just after an object, outside any string
+		m_buffer.clear();
+		m_pos = 0;
+		if (!m_file.seek(offset)) { return false; }
+		m_base = offset;
+	}
+	m_offset = offset;
+	return true;
+}
+
+qint64 ImportTable::JSONSource::position()
+{
+	return m_base + m_pos;
+}
+
+qint64 ImportTable::JSONSource::size()
+{
+	return m_file.size();
+}
+
+QString ImportTable::JSONSource::rowError()
+{
+	return m_rowError;
+}
+
+ImportTable::JSONModel::JSONModel(QString fileName, QList<FieldInfo> fields,
+								  int skipHeader, int extraColumn,
+								  QObject * parent, int maxRows)
+	: BaseModel(fields, parent)
+{
+	QStringList columns(m_columnNames);
+	JSONSource in(fileName, columns, extraColumn);
+	if (!in.isOpen())
+	{
+		QMessageBox::warning(qobject_cast<QWidget*>(parent), tr("Data Import"),
+							 tr("Cannot open file %1 for reading.").arg(fileName));
+		return;
+	}
+
+	QStringList row;
+	int tmpSkipHeader = 0;
+	while (in.next(row))
+	{
+		if (tmpSkipHeader < skipHeader)
+		{
+			tmpSkipHeader++;
+			continue;
+		}
+		m_values.append(row);
+		if ((maxRows != 0) && (m_values.count() >= maxRows))
+			break;
+	}
 }
 
 void ImportTableDialog::setTablesForSchema(const QString & schema)
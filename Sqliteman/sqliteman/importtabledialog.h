@@ -8,13 +8,19 @@ for which a new license (GPL+exception) is in place.
 #ifndef IMPORTTABLEDIALOG_H
 #define IMPORTTABLEDIALOG_H
 
+#include <QtCore/QCoreApplication>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QTextStream>
+#include <QtCore/QVector>
+#include <QtCore/QXmlStreamReader>
+
 #include "litemanwindow.h"
 #include "sqlparser.h"
 #include "ui_importtabledialog.h"
 
-class QTreeWidgetItem;
-
-
+class QJsonValue;
+class SchemaItem;
 
 /*! \brief Import data into table using various importer types.
 \note XML import requires Qt library at least in the 4.3.0 version.
@@ -37,7 +43,7 @@ class ImportTableDialog : public QDialog, public Ui::ImportTableDialog
 		QString m_tableName;
 		QString m_schema;
 		// and the originally active name (may be different)
-		QTreeWidgetItem * m_activeItem;
+		SchemaItem * m_activeItem;
 
 		// We ought to be able use use parent() for this, but for some reason
 		// qobject_cast<LiteManWindow*>(parent()) doesn't work
@@ -45,8 +51,40 @@ class ImportTableDialog : public QDialog, public Ui::ImportTableDialog
 		// true if altering currently active table
 		bool m_alteringActive;
 
+		//! \brief True if the user cancelled the import progress dialog
+		bool m_cancelled;
+
 		void updateButton();
-		char hexValue(QChar c);
+		static char hexValue(QChar c);
+		//! \brief Convert an imported string into the value to bind
+		static QVariant importValue(const QString & s);
+		//! \brief The value to bind for a source without blob literals
+		static QVariant textValue(const QString & s);
+
+		//! \brief Absolute name of the file being imported
+		QString importFileName();
+		//! \brief Sidecar file for rows which could not be imported
+		QString rejectFileName();
+		/*! \brief What a checkpoint is for: the file, the database and
+		the table, or null if the database can't be reopened to resume */
+		QString checkpointKey();
+		/*! \brief Look up the checkpoint of an interrupted import
+		of the current file into the current table.
+		\param offset set to the position in the file after the last
+		committed row
+		\param row set to the number of rows committed
+		\retval bool true if there is a checkpoint
+		*/
+		bool readCheckpoint(qint64 & offset, int & row);
+		/*! \brief Record the checkpoint in the preferences. This must be
+		called just after the batch it describes has been committed. */
+		void writeCheckpoint(qint64 offset, int row);
+		/*! \brief Forget the checkpoint when the import has completed
+		or is started again from the beginning */
+		void clearCheckpoint();
+		//! \brief Append a rejected row and the reason to the reject file
+		void writeReject(QTextStream & out, int row, const QString & reason,
+						 const QStringList & values);
 		
 	private slots:
 		void fileButton_clicked();
@@ -59,12 +97,166 @@ class ImportTableDialog : public QDialog, public Ui::ImportTableDialog
 		//
 		void setTablesForSchema(const QString & schema);
 		void skipHeaderCheck_toggled(bool checked);
+		//! \brief Enable "Resume Import" if there is a checkpoint
+		void checkCheckpoint();
+		//! \brief Offer the columns of the table for unmapped JSON keys
+		void setJsonColumns();
+		void cancel();
 };
 
 //! \brief A helper classes used for data import.
 namespace ImportTable
 {
 
+	/*! \brief A pull-based source of rows for the importer.
+	Each call of next() reads one more row from the input, so the
+	importer never holds more than one row in memory.
+	*/
+	class RowSource
+	{
+		public:
+			virtual ~RowSource() {}
+
+			//! \brief False if the input could not be opened
+			virtual bool isOpen() = 0;
+			/*! \brief Read the next row.
+			\param row set to the values of the row
+			\retval bool false at the end of the input
+			*/
+			virtual bool next(QStringList & row) = 0;
+			/*! \brief Exact position after the last row read.
+			This is what is recorded in a checkpoint. It may be
+			expensive, so it should only be called at batch boundaries. */
+			virtual qint64 offset() = 0;
+			//! \brief Continue reading at a position returned by offset()
+			virtual bool seek(qint64 offset) = 0;
+			//! \brief Cheap approximate position for progress reporting
+			virtual qint64 position() = 0;
+			//! \brief Size of the input in the units of position()
+			virtual qint64 size() = 0;
+			//! \brief Description of a malformed input, or a null string
+			virtual QString errorString() { return QString(); }
+			/*! \brief Why the row last returned by next() could not be
+			decoded, or a null string if it is fine. A row which could
+			not be decoded contains the raw input text. */
+			virtual QString rowError() { return QString(); }
+			/*! \brief Whether a value like X'0A1B' is a blob literal.
+			Otherwise values are text, and a null string is NULL. */
+			virtual bool hasBlobs() { return false; }
+	};
+
+	//! \brief Reads a CSV-like file one row at a time
+	class CSVSource : public RowSource
+	{
+		public:
+			CSVSource(const QString & fileName,
+					  const QString & separator, const QString & quote);
+
+			bool isOpen();
+			bool next(QStringList & row);
+			qint64 offset();
+			bool seek(qint64 offset);
+			qint64 position();
+			qint64 size();
+			//! \brief Blobs are written as in SQL, by the data exporter
+			bool hasBlobs() { return true; }
+
+		private:
+			QFile m_file;
+			QTextStream m_in;
+			QString m_separator;
+			QString m_quote;
+	};
+
+	/*! \brief Reads a MS Excel XML spreadsheet one row at a time.
+	QXmlStreamReader cannot be repositioned in the middle of a document,
+	so the offset is the number of rows read and seek() rereads the
+	document from the start, discarding rows without storing them.
+	*/
+	class XMLSource : public RowSource
+	{
+		public:
+			XMLSource(const QString & fileName);
+
+			bool isOpen();
+			bool next(QStringList & row);
+			qint64 offset() { return m_rows; }
+			bool seek(qint64 offset);
+			qint64 position();
+			qint64 size();
+			//! \brief Any XML error other than running out of input
+			QString errorString();
+
+		private:
+			QFile m_file;
+			QXmlStreamReader m_xml;
+			qint64 m_rows;
+	};
+
+	/*! \brief Reads JSON objects, either one per line (NDJSON)
+	or as the elements of a top level array.
+	The keys of each object are matched to the table columns.
+	Splitting the input into objects is cheap and done in order,
+	but the objects of each chunk are decoded in parallel.
+	*/
+	class JSONSource : public RowSource
+	{
+		Q_DECLARE_TR_FUNCTIONS(JSONSource)
+
+		public:
+			/*!
+			\param columns the names of the table columns, in order
+			\param extraColumn the column which gets the unmapped keys
+			as a JSON object, or -1 to leave them out
+			*/
+			JSONSource(const QString & fileName, const QStringList & columns,
+					   int extraColumn);
+
+			bool isOpen();
+			bool next(QStringList & row);
+			qint64 offset();
+			bool seek(qint64 offset);
+			qint64 position();
+			qint64 size();
+			QString rowError();
+
+			//! \brief One object: its text, where it ends and its values
+			typedef struct
+			{
+				QByteArray text;
+				qint64 end;
+				QStringList row;
+				QString error;
+			}
+			Item;
+
+			//! \brief Decode one item (called from worker threads)
+			void decode(Item & item) const;
+
+		private:
+			bool fillBuffer();
+			bool readLine(QByteArray & line);
+			bool readElement(QByteArray & text);
+			//! \brief Split and decode the next chunk of objects
+			bool fillChunk();
+			static QString jsonText(const QJsonValue & v);
+
+			QFile m_file;
+			bool m_isArray;
+			bool m_arrayEnded;
+			//! \brief Unconsumed input; m_base is its file position
+			QByteArray m_buffer;
+			int m_pos;
+			qint64 m_base;
+			QVector<Item> m_chunk;
+			int m_next;
+			qint64 m_offset;
+			QString m_rowError;
+			QHash<QString,int> m_columns;
+			int m_columnCount;
+			int m_extraColumn;
+	};
+
 	/*! \brief A base Model for all import "modules".
 	It's a model in qt4 mvc architecture. See Qt4 docs for
 	methods meanings.
@@ -104,6 +296,16 @@ namespace ImportTable
 					 QObject * parent = 0, int maxRows = 0);
 	};
 
+	//! \brief JSON importer
+	class JSONModel : public BaseModel
+	{
+		Q_OBJECT
+
+		public:
+			JSONModel(QString fileName, QList<FieldInfo> fields, int skipHeader,
+					  int extraColumn, QObject * parent = 0, int maxRows = 0);
+	};
+
 	/*! \brief MS Excel XML importer
 	\note XML import requires Qt library at least in the 4.3.0 version.
 	*/
@@ -0,0 +1,850 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <string.h>
+
+#include <QtCore/QRegExp>
+
+#include "database.h"
+#include "indexadvisor.h"
+#include "scriptrunner.h"
+#include "utils.h"
+
+// Rows read from a table to guess how selective a candidate index is
+#define ADVISOR_SAMPLE 100000
+// Candidates evaluated, since each has to be sampled
+#define ADVISOR_MAX_CANDIDATES 100
+// Virtual machine instructions between checks for cancelling
+#define ADVISOR_PROGRESS_OPS 10000
+
+// A table of the constraint collecting module
+typedef struct
+{
+	sqlite3_vtab base; // must come first
+	IndexAdvisor * advisor;
+	QString schema;
+	QString name;
+	QStringList columns;
+}
+AdvisorTable;
+
+sqlite3_module IndexAdvisor::s_module = {
+	0,                      // iVersion
+	IndexAdvisor::vtabConnect, // xCreate
+	IndexAdvisor::vtabConnect,
+	IndexAdvisor::vtabBestIndex,
+	IndexAdvisor::vtabDisconnect,
+	IndexAdvisor::vtabDisconnect, // xDestroy
+	IndexAdvisor::vtabOpen,
+	IndexAdvisor::vtabClose,
+	IndexAdvisor::vtabFilter,
+	IndexAdvisor::vtabNext,
+	IndexAdvisor::vtabEof,
+	IndexAdvisor::vtabColumn,
+	IndexAdvisor::vtabRowid,
+	IndexAdvisor::vtabUpdate,
+	0, 0, 0, 0, 0, 0        // xBegin to xRename
+};
+
+IndexAdvisor::IndexAdvisor(const QStringList & scripts, QObject * parent)
+	: QThread(parent),
+	  m_cancelled(0)
+{
+	m_db = Database::sqlite3handle();
+	splitStatements(scripts);
+}
+
+IndexAdvisor::~IndexAdvisor()
+{
+	cancel();
+	wait();
+}
+
+void IndexAdvisor::cancel()
+{
+	m_cancelled.storeRelease(1);
+}
+
+int IndexAdvisor::progressHandler(void * cancelled)
+{
+	return ((const QAtomicInt *)cancelled)->loadAcquire();
+}
+
+QString IndexAdvisor::key(const QString & schema, const QString & table)
+{
+	return (schema + "." + table).toLower();
+}
+
+void IndexAdvisor::splitStatements(const QStringList & scripts)
+{
+	// the history repeats itself
+	QSet<QString> seen;
+	foreach (const QString & script, scripts)
+	{
+		QByteArray utf8(script.toUtf8());
+		const char * p = utf8.constData();
+		const char * end = p + utf8.size();
+		while (p < end)
+		{
+			const char * next = ScriptRunner::statementEnd(p, end);
+			QString sql(QString::fromUtf8(p, next - p).trimmed());
+			p = next;
+			// the history has what the Explain actions ran
+			sql.remove(QRegExp("^EXPLAIN(\\s+QUERY\\s+PLAN)?\\s+",
+							   Qt::CaseInsensitive));
+			if (sql.isEmpty() || seen.contains(sql.simplified())) { continue; }
+			seen.insert(sql.simplified());
+			StatementAdvice statement;
+			statement.sql = sql;
+			m_statements.append(statement);
+		}
+	}
+}
+
+bool IndexAdvisor::query(sqlite3 * db, const QString & sql,
+						 QList<QStringList> & rows)
+{
+	rows.clear();
+	QByteArray utf8(sql.toUtf8());
+	sqlite3_stmt * stmt = 0;
+	if (sqlite3_prepare_v3(db, utf8.constData(), -1, 0, &stmt, 0)
+		!= SQLITE_OK)
+	{
+		sqlite3_finalize(stmt);
+		return false;
+	}
+	int rc = SQLITE_DONE;
+	while (stmt && ((rc = sqlite3_step(stmt)) == SQLITE_ROW))
+	{
+		QStringList row;
+		for (int i = 0; i < sqlite3_column_count(stmt); ++i)
+		{
+			const char * text = (const char *)sqlite3_column_text(stmt, i);
+			row.append(text ? QString::fromUtf8(text) : QString());
+		}
+		rows.append(row);
+	}
+	sqlite3_finalize(stmt);
+	return rc == SQLITE_DONE;
+}
+
+bool IndexAdvisor::exec(sqlite3 * db, const QString & sql)
+{
+	return sqlite3_exec(db, sql.toUtf8().constData(), 0, 0, 0) == SQLITE_OK;
+}
+
+bool IndexAdvisor::readSchema()
+{
+	QList<QStringList> rows;
+	if (!query(m_db, "PRAGMA database_list;", rows))
+	{
+		m_error = QString::fromUtf8(sqlite3_errmsg(m_db));
+		return false;
+	}
+	for (int i = 0; i < rows.count(); ++i) { m_schemas.append(rows[i][1]); }
+
+	foreach (const QString & schema, m_schemas)
+	{
+		QList<QStringList> objects;
+		if (!query(m_db, QString("SELECT type, name, tbl_name, sql "
+								 "FROM %1.sqlite_master ORDER BY rowid;")
+						 .arg(Utils::q(schema)), objects))
+		{
+			m_error = QString::fromUtf8(sqlite3_errmsg(m_db));
+			return false;
+		}
+		for (int i = 0; i < objects.count(); ++i)
+		{
+			SchemaObject o;
+			o.schema = schema;
+			o.type = objects[i][0];
+			o.name = objects[i][1];
+			o.table = objects[i][2];
+			o.sql = objects[i][3];
+			QString k(key(schema, o.table));
+			if (   (o.type == "table")
+				&& (o.name.compare("sqlite_stat1", Qt::CaseInsensitive) == 0))
+			{
+				m_analyzed.insert(schema);
+			}
+			if (   (o.type == "table")
+				&& !o.name.startsWith("sqlite_", Qt::CaseInsensitive)
+				&& !o.sql.startsWith("CREATE VIRTUAL", Qt::CaseInsensitive))
+			{
+				QList<QStringList> columns;
+				query(m_db, QString("PRAGMA %1.table_info(%2);")
+							.arg(Utils::q(schema), Utils::q(o.name)),
+					  columns);
+				QStringList declared;
+				for (int j = 0; j < columns.count(); ++j)
+				{
+					o.columns.append(columns[j][1]);
+					declared.append(Utils::q(columns[j][1]) + " "
+									+ columns[j][2]);
+				}
+				m_columns.insert(k, o.columns);
+				m_declarations.insert(k, "CREATE TABLE x("
+										 + declared.join(", ") + ");");
+			}
+			else if (o.type == "index")
+			{
+				QList<QStringList> columns;
+				query(m_db, QString("PRAGMA %1.index_info(%2);")
+							.arg(Utils::q(schema), Utils::q(o.name)),
+					  columns);
+				for (int j = 0; j < columns.count(); ++j)
+				{
+					// an expression has no name
+					if (columns[j][2].isNull())
+					{
+						o.columns.clear();
+						break;
+					}
+					o.columns.append(columns[j][2]);
+				}
+				m_indexColumns[k].append(o.columns);
+			}
+			m_objects.append(o);
+		}
+	}
+
+	// sqlite_ names are reserved, so the prefix is one of ours which no
+	// name in any schema starts with
+	m_scratchPrefix = "advisor_";
+	for (int n = 2; ; ++n)
+	{
+		bool clash = false;
+		foreach (const SchemaObject & o, m_objects)
+		{
+			if (o.name.startsWith(m_scratchPrefix, Qt::CaseInsensitive))
+			{
+				clash = true;
+				break;
+			}
+		}
+		if (!clash) { break; }
+		m_scratchPrefix = QString("advisor%1_").arg(n);
+	}
+	return true;
+}
+
+QString IndexAdvisor::qualified(const SchemaObject & o)
+{
+	// sqlite keeps the text from the name on after a fixed prefix
+	static const char * const prefixes[] = {
+		"CREATE TABLE ", "CREATE UNIQUE INDEX ", "CREATE INDEX ",
+		"CREATE VIEW ", 0 };
+	for (int i = 0; prefixes[i]; ++i)
+	{
+		QString prefix(prefixes[i]);
+		if (o.sql.startsWith(prefix, Qt::CaseInsensitive))
+		{
+			if (o.sql.mid(prefix.length()).startsWith("IF NOT EXISTS ",
+													 Qt::CaseInsensitive))
+			{
+				prefix += "IF NOT EXISTS ";
+			}
+			return prefix + Utils::q(o.schema) + "."
+				   + o.sql.mid(prefix.length());
+		}
+	}
+	return QString();
+}
+
+void IndexAdvisor::collationNeeded(void * context, sqlite3 * db, int rep,
+								   const char * name)
+{
+	Q_UNUSED(context);
+	Q_UNUSED(rep);
+	// LOCALIZED and any other collation the scratch databases don't have:
+	// the planner only needs to know that there is one
+	sqlite3_create_collation(db, name, SQLITE_UTF8, 0, compareBinary);
+}
+
+int IndexAdvisor::compareBinary(void * context, int n1, const void * s1,
+								int n2, const void * s2)
+{
+	Q_UNUSED(context);
+	int rc = memcmp(s1, s2, qMin(n1, n2));
+	return rc ? rc : n1 - n2;
+}
+
+sqlite3 * IndexAdvisor::openScratch()
+{
+	sqlite3 * db = 0;
+	if (sqlite3_open(":memory:", &db) != SQLITE_OK)
+	{
+		m_error = QString::fromUtf8(sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return 0;
+	}
+	sqlite3_collation_needed(db, 0, collationNeeded);
+	foreach (const QString & schema, m_schemas)
+	{
+		if (   (schema.compare("main", Qt::CaseInsensitive) != 0)
+			&& (schema.compare("temp", Qt::CaseInsensitive) != 0))
+		{
+			exec(db, QString("ATTACH ':memory:' AS %1;")
+					 .arg(Utils::q(schema)));
+		}
+	}
+	return db;
+}
+
+int IndexAdvisor::vtabConnect(sqlite3 * db, void * aux, int argc,
+							  const char * const * argv,
+							  sqlite3_vtab ** vtab, char ** err)
+{
+	Q_UNUSED(argc);
+	IndexAdvisor * advisor = (IndexAdvisor *)aux;
+	QString schema(QString::fromUtf8(argv[1]));
+	QString name(QString::fromUtf8(argv[2]));
+	QString k(key(schema, name));
+	if (!advisor->m_declarations.contains(k))
+	{
+		*err = sqlite3_mprintf("no such table: %s", argv[2]);
+		return SQLITE_ERROR;
+	}
+	int rc = sqlite3_declare_vtab(
+		db, advisor->m_declarations.value(k).toUtf8().constData());
+	if (rc != SQLITE_OK) { return rc; }
+	AdvisorTable * table = new AdvisorTable;
+	memset(&table->base, 0, sizeof(table->base));
+	table->advisor = advisor;
+	table->schema = schema;
+	table->name = name;
+	table->columns = advisor->m_columns.value(k);
+	*vtab = &table->base;
+	return SQLITE_OK;
+}
+
+int IndexAdvisor::vtabBestIndex(sqlite3_vtab * vtab,
+								sqlite3_index_info * info)
+{
+	AdvisorTable * table = (AdvisorTable *)vtab;
+	int n = table->columns.count();
+	QStringList equal;
+	QString range;
+	for (int i = 0; i < info->nConstraint; ++i)
+	{
+		int column = info->aConstraint[i].iColumn;
+		if (!info->aConstraint[i].usable || (column < 0) || (column >= n))
+		{
+			continue;
+		}
+		QString name(table->columns.at(column));
+		switch (info->aConstraint[i].op)
+		{
+			case SQLITE_INDEX_CONSTRAINT_EQ:
+			case SQLITE_INDEX_CONSTRAINT_IS:
+				if (!equal.contains(name)) { equal.append(name); }
+				break;
+			case SQLITE_INDEX_CONSTRAINT_GT:
+			case SQLITE_INDEX_CONSTRAINT_LE:
+			case SQLITE_INDEX_CONSTRAINT_LT:
+			case SQLITE_INDEX_CONSTRAINT_GE:
+				if (range.isNull()) { range = name; }
+				break;
+			default:
+				break;
+		}
+	}
+	QStringList order;
+	for (int i = 0; i < info->nOrderBy; ++i)
+	{
+		int column = info->aOrderBy[i].iColumn;
+		if ((column < 0) || (column >= n))
+		{
+			order.clear();
+			break;
+		}
+		order.append(table->columns.at(column));
+	}
+
+	table->advisor->m_referenced.insert(key(table->schema, table->name));
+	QStringList candidate(equal);
+	if (!range.isNull() && !candidate.contains(range))
+	{
+		candidate.append(range);
+	}
+	table->advisor->addCandidate(table->schema, table->name, candidate);
+	if (!order.isEmpty())
+	{
+		candidate = equal;
+		foreach (const QString & column, order)
+		{
+			if (!candidate.contains(column)) { candidate.append(column); }
+		}
+		table->advisor->addCandidate(table->schema, table->name, candidate);
+	}
+
+	// cheaper with more constraints, so that the planner tries each way
+	// round a join and tells us the constraints for each
+	info->estimatedCost =
+		1000000.0 / (1 + 10 * equal.count() + (range.isNull() ? 0 : 1));
+	return SQLITE_OK;
+}
+
+int IndexAdvisor::vtabDisconnect(sqlite3_vtab * vtab)
+{
+	delete (AdvisorTable *)vtab;
+	return SQLITE_OK;
+}
+
+int IndexAdvisor::vtabOpen(sqlite3_vtab * vtab,
+						   sqlite3_vtab_cursor ** cursor)
+{
+	Q_UNUSED(vtab);
+	*cursor = new sqlite3_vtab_cursor;
+	memset(*cursor, 0, sizeof(sqlite3_vtab_cursor));
+	return SQLITE_OK;
+}
+
+int IndexAdvisor::vtabClose(sqlite3_vtab_cursor * cursor)
+{
+	delete cursor;
+	return SQLITE_OK;
+}
+
+int IndexAdvisor::vtabFilter(sqlite3_vtab_cursor * cursor, int idxNum,
+							 const char * idxStr, int argc,
+							 sqlite3_value ** argv)
+{
+	Q_UNUSED(cursor);
+	Q_UNUSED(idxNum);
+	Q_UNUSED(idxStr);
+	Q_UNUSED(argc);
+	Q_UNUSED(argv);
+	return SQLITE_OK;
+}
+
+int IndexAdvisor::vtabNext(sqlite3_vtab_cursor * cursor)
+{
+	Q_UNUSED(cursor);
+	return SQLITE_OK;
+}
+
+int IndexAdvisor::vtabEof(sqlite3_vtab_cursor * cursor)
+{
+	Q_UNUSED(cursor);
+	return 1; // the statements are only prepared
+}
+
+int IndexAdvisor::vtabColumn(sqlite3_vtab_cursor * cursor,
+							 sqlite3_context * context, int i)
+{
+	Q_UNUSED(cursor);
+	Q_UNUSED(i);
+	sqlite3_result_null(context);
+	return SQLITE_OK;
+}
+
+int IndexAdvisor::vtabRowid(sqlite3_vtab_cursor * cursor,
+							sqlite3_int64 * rowid)
+{
+	Q_UNUSED(cursor);
+	*rowid = 0;
+	return SQLITE_OK;
+}
+
+int IndexAdvisor::vtabUpdate(sqlite3_vtab * vtab, int argc,
+							 sqlite3_value ** argv, sqlite3_int64 * rowid)
+{
+	// only there so that INSERT, UPDATE and DELETE can be prepared
+	Q_UNUSED(vtab);
+	Q_UNUSED(argc);
+	Q_UNUSED(argv);
+	Q_UNUSED(rowid);
+	return SQLITE_OK;
+}
+
+void IndexAdvisor::addCandidate(const QString & schema, const QString & table,
+								const QStringList & columns)
+{
+	if (columns.isEmpty()) { return; }
+	QString k(key(schema, table) + ":" + columns.join(",").toLower());
+	if (m_candidateKeys.contains(k)) { return; }
+	m_candidateKeys.insert(k);
+	// an existing index which starts with the same columns will do
+	foreach (const QStringList & index,
+			 m_indexColumns.value(key(schema, table)))
+	{
+		if (index.mid(0, columns.count()).join(",").toLower()
+			== columns.join(",").toLower())
+		{
+			return;
+		}
+	}
+	if (m_candidates.count() >= ADVISOR_MAX_CANDIDATES) { return; }
+	Candidate candidate;
+	candidate.schema = schema;
+	candidate.table = table;
+	candidate.columns = columns;
+	candidate.scratchName = m_scratchPrefix
+							+ QString::number(m_candidates.count());
+	candidate.used = false;
+	m_candidates.append(candidate);
+}
+
+void IndexAdvisor::collectCandidates()
+{
+	sqlite3 * db = openScratch();
+	if (!db) { return; }
+	sqlite3_create_module_v2(db, "advisor", &s_module, this, 0);
+	foreach (const SchemaObject & o, m_objects)
+	{
+		if (   (o.type == "table")
+			&& m_declarations.contains(key(o.schema, o.name)))
+		{
+			exec(db, QString("CREATE VIRTUAL TABLE %1.%2 USING advisor;")
+					 .arg(Utils::q(o.schema), Utils::q(o.name)));
+		}
+		else if (o.type == "view")
+		{
+			exec(db, qualified(o));
+		}
+	}
+	for (int i = 0; i < m_statements.count(); )
+	{
+		QByteArray sql(m_statements[i].sql.toUtf8());
+		sqlite3_stmt * stmt = 0;
+		int rc = sqlite3_prepare_v3(db, sql.constData(), -1, 0, &stmt, 0);
+		if (rc != SQLITE_OK)
+		{
+			m_statements[i].error = QString::fromUtf8(sqlite3_errmsg(db));
+		}
+		else if (!stmt)
+		{
+			// only comments
+			m_statements.removeAt(i);
+			continue;
+		}
+		sqlite3_finalize(stmt);
+		++i;
+	}
+	sqlite3_close(db);
+}
+
+qint64 IndexAdvisor::rowCount(const QString & schema, const QString & table)
+{
+	QString k(key(schema, table));
+	if (m_rowCounts.contains(k)) { return m_rowCounts.value(k); }
+	QList<QStringList> rows;
+	qint64 count = -1;
+	bool ok = false;
+	// the first number is the rows in the table, whichever index it's for
+	if (   m_analyzed.contains(schema)
+		&& query(m_db, QString("SELECT stat FROM %1.sqlite_stat1 "
+							   "WHERE tbl = %2 LIMIT 1;")
+					   .arg(Utils::q(schema), Utils::q(table, "'")), rows)
+		&& !rows.isEmpty())
+	{
+		count = rows[0][0].section(' ', 0, 0).toLongLong(&ok);
+	}
+	if (   !ok
+		&& query(m_db, QString("SELECT count(*) FROM %1.%2;")
+					   .arg(Utils::q(schema), Utils::q(table)), rows)
+		&& !rows.isEmpty())
+	{
+		count = rows[0][0].toLongLong(&ok);
+	}
+	if (!ok) { count = -1; }
+	m_rowCounts.insert(k, count);
+	return count;
+}
+
+QString IndexAdvisor::sampleStat(const QString & schema, const QString & table,
+								 const QStringList & columns)
+{
+	qint64 count = rowCount(schema, table);
+	if (count < 0) { return QString(); }
+	QString sample(QString("(SELECT %1 FROM %2.%3 LIMIT %4)")
+				   .arg(Utils::q(columns, "\""), Utils::q(schema),
+						Utils::q(table)).arg(ADVISOR_SAMPLE));
+	QList<QStringList> rows;
+	if (   !query(m_db, QString("SELECT count(*) FROM %1;").arg(sample), rows)
+		|| rows.isEmpty())
+	{
+		return QString();
+	}
+	qint64 sampled = rows[0][0].toLongLong();
+	// the rows for each value of each prefix of the columns
+	QString stat(QString::number(count));
+	for (int i = 1; i <= columns.count(); ++i)
+	{
+		if (   !query(m_db, QString("SELECT count(*) FROM "
+									"(SELECT DISTINCT %1 FROM %2);")
+							.arg(Utils::q(columns.mid(0, i), "\""), sample),
+					  rows)
+			|| rows.isEmpty())
+		{
+			return QString();
+		}
+		qint64 distinct = qMax(rows[0][0].toLongLong(), qint64(1));
+		stat += " " + QString::number(
+			qMax((sampled + distinct - 1) / distinct, qint64(1)));
+	}
+	return stat;
+}
+
+bool IndexAdvisor::insertStat(sqlite3 * db, const QString & schema,
+							  const QString & table, const QString & index,
+							  const QString & stat)
+{
+	QByteArray sql(QString("INSERT INTO %1.sqlite_stat1 (tbl, idx, stat) "
+						   "VALUES (?1, ?2, ?3);")
+				   .arg(Utils::q(schema)).toUtf8());
+	QByteArray tbl(table.toUtf8());
+	QByteArray idx(index.toUtf8());
+	QByteArray st(stat.toUtf8());
+	sqlite3_stmt * stmt = 0;
+	if (sqlite3_prepare_v3(db, sql.constData(), -1, 0, &stmt, 0) != SQLITE_OK)
+	{
+		sqlite3_finalize(stmt);
+		return false;
+	}
+	sqlite3_bind_text(stmt, 1, tbl.constData(), tbl.size(), SQLITE_STATIC);
+	if (index.isNull()) { sqlite3_bind_null(stmt, 2); }
+	else
+	{
+		sqlite3_bind_text(stmt, 2, idx.constData(), idx.size(),
+						  SQLITE_STATIC);
+	}
+	sqlite3_bind_text(stmt, 3, st.constData(), st.size(), SQLITE_STATIC);
+	bool ok = (sqlite3_step(stmt) == SQLITE_DONE);
+	sqlite3_finalize(stmt);
+	return ok;
+}
+
+void IndexAdvisor::reloadStats(sqlite3 * db)
+{
+	// analyzing sqlite_master makes the planner read sqlite_stat1 again
+	foreach (const QString & schema, m_schemas)
+	{
+		exec(db, QString("ANALYZE %1.sqlite_master;").arg(Utils::q(schema)));
+	}
+}
+
+bool IndexAdvisor::writeStats(sqlite3 * db)
+{
+	// Counting and sampling read the real data on the GUI's connection, so
+	// only the tables which the statements read get rows: the planner
+	// doesn't look at the others, and every candidate is on one of them.
+	foreach (const QString & schema, m_schemas)
+	{
+		// analyzing the empty tables makes sqlite_stat1
+		exec(db, QString("ANALYZE %1;").arg(Utils::q(schema)));
+		exec(db, QString("DELETE FROM %1.sqlite_stat1;")
+				 .arg(Utils::q(schema)));
+		QSet<QString> done;
+		if (m_analyzed.contains(schema))
+		{
+			QList<QStringList> rows;
+			query(m_db, QString("SELECT tbl, idx, stat FROM %1.sqlite_stat1;")
+						.arg(Utils::q(schema)), rows);
+			for (int i = 0; i < rows.count(); ++i)
+			{
+				if (!m_referenced.contains(key(schema, rows[i][0])))
+				{
+					continue;
+				}
+				insertStat(db, schema, rows[i][0], rows[i][1], rows[i][2]);
+				done.insert(rows[i][0].toLower());
+				done.insert((rows[i][0] + "." + rows[i][1]).toLower());
+			}
+		}
+		foreach (const SchemaObject & o, m_objects)
+		{
+			if (m_cancelled.loadAcquire()) { return false; }
+			if (   (o.schema != schema)
+				|| !m_referenced.contains(key(o.schema, o.table)))
+			{
+				continue;
+			}
+			if (   (o.type == "table")
+				&& m_declarations.contains(key(o.schema, o.name))
+				&& !done.contains(o.name.toLower()))
+			{
+				qint64 count = rowCount(schema, o.name);
+				if (count >= 0)
+				{
+					insertStat(db, schema, o.name, QString(),
+							   QString::number(count));
+				}
+			}
+			else if (   (o.type == "index") && !o.columns.isEmpty()
+					 && !done.contains((o.table + "." + o.name).toLower()))
+			{
+				QString stat(sampleStat(schema, o.table, o.columns));
+				if (!stat.isNull())
+				{
+					insertStat(db, schema, o.table, o.name, stat);
+				}
+			}
+		}
+	}
+	return !m_cancelled.loadAcquire();
+}
+
+bool IndexAdvisor::plan(sqlite3 * db, const QString & sql,
+						QStringList & lines, QString & error)
+{
+	lines.clear();
+	QByteArray utf8(("EXPLAIN QUERY PLAN " + sql).toUtf8());
+	sqlite3_stmt * stmt = 0;
+	if (sqlite3_prepare_v3(db, utf8.constData(), -1, 0, &stmt, 0)
+		!= SQLITE_OK)
+	{
+		error = QString::fromUtf8(sqlite3_errmsg(db));
+		sqlite3_finalize(stmt);
+		return false;
+	}
+	QHash<int, int> depths;
+	while (stmt && (sqlite3_step(stmt) == SQLITE_ROW))
+	{
+		int depth = depths.value(sqlite3_column_int(stmt, 1), -1) + 1;
+		depths.insert(sqlite3_column_int(stmt, 0), depth);
+		lines.append(QString(2 * depth, ' ') + QString::fromUtf8(
+			(const char *)sqlite3_column_text(stmt, 3)));
+	}
+	sqlite3_finalize(stmt);
+	return true;
+}
+
+void IndexAdvisor::evaluate()
+{
+	sqlite3 * db = openScratch();
+	if (!db) { return; }
+	foreach (const SchemaObject & o, m_objects)
+	{
+		if (   ((o.type == "table") && m_declarations.contains(
+					key(o.schema, o.name)))
+			|| ((o.type == "index") && !o.sql.isNull())
+			|| (o.type == "view"))
+		{
+			exec(db, qualified(o));
+		}
+	}
+	if (!writeStats(db))
+	{
+		sqlite3_close(db);
+		return;
+	}
+	reloadStats(db);
+	for (int i = 0; i < m_statements.count(); ++i)
+	{
+		StatementAdvice & statement = m_statements[i];
+		if (statement.error.isNull())
+		{
+			plan(db, statement.sql, statement.before, statement.error);
+		}
+	}
+
+	for (int i = 0; i < m_candidates.count(); ++i)
+	{
+		if (m_cancelled.loadAcquire()) { break; }
+		const Candidate & c = m_candidates.at(i);
+		QString stat(sampleStat(c.schema, c.table, c.columns));
+		if (   exec(db, QString("CREATE INDEX %1.%2 ON %3 (%4);")
+							.arg(Utils::q(c.schema), c.scratchName,
+								 Utils::q(c.table),
+								 Utils::q(c.columns, "\"")))
+			&& !stat.isNull())
+		{
+			insertStat(db, c.schema, c.table, c.scratchName, stat);
+		}
+	}
+	reloadStats(db);
+	for (int i = 0; i < m_statements.count(); ++i)
+	{
+		StatementAdvice & statement = m_statements[i];
+		if (statement.error.isNull())
+		{
+			plan(db, statement.sql, statement.after, statement.error);
+		}
+	}
+	sqlite3_close(db);
+}
+
+void IndexAdvisor::advise()
+{
+	QSet<QString> names;
+	foreach (const SchemaObject & o, m_objects)
+	{
+		names.insert(o.name.toLower());
+	}
+	QHash<QString, int> byScratchName;
+	for (int i = 0; i < m_candidates.count(); ++i)
+	{
+		byScratchName.insert(m_candidates.at(i).scratchName, i);
+	}
+	// which candidates made a difference, and to which statements
+	QHash<int, int> adviceFor;
+	QRegExp used("INDEX (" + QRegExp::escape(m_scratchPrefix) + "\\d+)");
+	for (int i = 0; i < m_statements.count(); ++i)
+	{
+		StatementAdvice & statement = m_statements[i];
+		if (statement.before == statement.after) { continue; }
+		for (int j = 0; j < statement.after.count(); ++j)
+		{
+			if (used.indexIn(statement.after.at(j)) < 0) { continue; }
+			int c = byScratchName.value(used.cap(1), -1);
+			if (c < 0) { continue; }
+			if (!adviceFor.contains(c))
+			{
+				const Candidate & candidate = m_candidates.at(c);
+				IndexAdvice advice;
+				advice.schema = candidate.schema;
+				advice.table = candidate.table;
+				advice.columns = candidate.columns;
+				QString name(candidate.table + "_"
+							 + candidate.columns.join("_"));
+				name.replace(QRegExp("[^A-Za-z0-9_]"), "_");
+				advice.name = name;
+				for (int n = 2; names.contains(advice.name.toLower()); ++n)
+				{
+					advice.name = QString("%1_%2").arg(name).arg(n);
+				}
+				names.insert(advice.name.toLower());
+				advice.sql = QString("CREATE INDEX %1.%2 ON %3 (%4);")
+							 .arg(Utils::q(advice.schema),
+								  Utils::q(advice.name),
+								  Utils::q(advice.table),
+								  Utils::q(advice.columns, "\""));
+				adviceFor.insert(c, m_advice.count());
+				m_advice.append(advice);
+			}
+			m_candidates[c].used = true;
+			IndexAdvice & advice = m_advice[adviceFor.value(c)];
+			if (!advice.statements.contains(i))
+			{
+				advice.statements.append(i);
+			}
+			statement.after[j].replace(used.cap(1), advice.name);
+		}
+	}
+}
+
+void IndexAdvisor::run()
+{
+	m_error = QString();
+	if (!m_db)
+	{
+		m_error = tr("No database is open");
+		return;
+	}
+	sqlite3_progress_handler(m_db, ADVISOR_PROGRESS_OPS, progressHandler,
+							 (void *)&m_cancelled);
+	if (readSchema())
+	{
+		collectCandidates();
+		if (m_error.isNull() && !m_cancelled.loadAcquire()) { evaluate(); }
+		if (m_error.isNull() && !m_cancelled.loadAcquire()) { advise(); }
+	}
+	sqlite3_progress_handler(m_db, 0, 0, 0);
+	if (m_cancelled.loadAcquire()) { m_error = tr("Cancelled"); }
+}
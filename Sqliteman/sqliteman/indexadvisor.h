@@ -0,0 +1,188 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef INDEXADVISOR_H
+#define INDEXADVISOR_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+
+#include "sqlite3.h"
+
+//! \brief An index which would change the plan of some statements
+typedef struct
+{
+	QString schema;
+	QString table;
+	QString name; //!< not used by anything else
+	QStringList columns;
+	QString sql; //!< the CREATE INDEX statement
+	QList<int> statements; //!< which ones it helps, see IndexAdvisor
+}
+IndexAdvice;
+
+//! \brief What the advisor made of one statement
+typedef struct
+{
+	QString sql;
+	QStringList before; //!< EXPLAIN QUERY PLAN, indented
+	QStringList after; //!< with the advised indexes
+	QString error; //!< why it couldn't be planned, otherwise null
+}
+StatementAdvice;
+
+/*! \brief Suggests indexes for a workload of statements.
+This works the way sqlite's own sqlite3expert does, which isn't built into
+the library and so can't be used.
+First the constraints and ORDER BY terms which the planner could use are
+collected: each table is copied, without its data, into a scratch
+database as a virtual table whose xBestIndex() records what it is asked
+for, and the statements are prepared against them. Each distinct set of
+equality columns, followed by a range or ORDER BY column, is a candidate.
+Then the real schema is copied, still without data, into another scratch
+database, with sqlite_stat1 rows from the real database or, for the
+candidates, from a sample of its rows, so that the planner plans as if
+the data were there. Only the tables which the statements read, and their
+indexes, are counted or sampled: no candidate is on any other table.
+Candidates are created there under names with a prefix which no real
+object's name starts with, so that they can't clash with the copies of
+the real indexes or be mistaken for them in a plan. The statements are
+planned without the candidates and with them, and the candidates which
+are used are advised.
+It runs on a worker thread and reads the real database on the GUI's
+connection while the GUI waits, as DumpRestore does.
+*/
+class IndexAdvisor : public QThread
+{
+	Q_OBJECT
+
+	public:
+		//! \brief Advise for \a scripts, each of which can hold statements
+		IndexAdvisor(const QStringList & scripts, QObject * parent = 0);
+		~IndexAdvisor();
+
+		const QList<IndexAdvice> & indexes() const { return m_advice; }
+		const QList<StatementAdvice> & statements() const
+			{ return m_statements; }
+
+		//! \brief Null if it ran to the end, otherwise why it didn't
+		QString errorString() const { return m_error; }
+		bool wasCancelled() const { return m_cancelled.loadAcquire() != 0; }
+
+	public slots:
+		void cancel();
+
+	protected:
+		void run();
+
+	private:
+		typedef struct
+		{
+			QString schema;
+			QString type;
+			QString name;
+			QString table;
+			QString sql;
+			//! \brief A table's, or an index's if it has no expressions
+			QStringList columns;
+		}
+		SchemaObject;
+
+		typedef struct
+		{
+			QString schema;
+			QString table;
+			QStringList columns;
+			QString scratchName;
+			bool used;
+		}
+		Candidate;
+
+		//! \brief Run \a sql on \a db, returning every row as text
+		bool query(sqlite3 * db, const QString & sql,
+				   QList<QStringList> & rows);
+		bool exec(sqlite3 * db, const QString & sql);
+		void splitStatements(const QStringList & scripts);
+		bool readSchema();
+		sqlite3 * openScratch();
+		void collectCandidates();
+		void addCandidate(const QString & schema, const QString & table,
+						  const QStringList & columns);
+		void evaluate();
+		bool writeStats(sqlite3 * db);
+		bool insertStat(sqlite3 * db, const QString & schema,
+						const QString & table, const QString & index,
+						const QString & stat);
+		void reloadStats(sqlite3 * db);
+		QString sampleStat(const QString & schema, const QString & table,
+						   const QStringList & columns);
+		qint64 rowCount(const QString & schema, const QString & table);
+		bool plan(sqlite3 * db, const QString & sql, QStringList & lines,
+				  QString & error);
+		void advise();
+		//! \brief \a o's CREATE statement, made to create it in its schema
+		static QString qualified(const SchemaObject & o);
+		static QString key(const QString & schema, const QString & table);
+
+		// the virtual table module
+		static int vtabConnect(sqlite3 * db, void * aux, int argc,
+							   const char * const * argv,
+							   sqlite3_vtab ** vtab, char ** err);
+		static int vtabBestIndex(sqlite3_vtab * vtab,
+								 sqlite3_index_info * info);
+		static int vtabDisconnect(sqlite3_vtab * vtab);
+		static int vtabOpen(sqlite3_vtab * vtab,
+							sqlite3_vtab_cursor ** cursor);
+		static int vtabClose(sqlite3_vtab_cursor * cursor);
+		static int vtabFilter(sqlite3_vtab_cursor * cursor, int idxNum,
+							  const char * idxStr, int argc,
+							  sqlite3_value ** argv);
+		static int vtabNext(sqlite3_vtab_cursor * cursor);
+		static int vtabEof(sqlite3_vtab_cursor * cursor);
+		static int vtabColumn(sqlite3_vtab_cursor * cursor,
+							  sqlite3_context * context, int i);
+		static int vtabRowid(sqlite3_vtab_cursor * cursor,
+							 sqlite3_int64 * rowid);
+		static int vtabUpdate(sqlite3_vtab * vtab, int argc,
+							  sqlite3_value ** argv, sqlite3_int64 * rowid);
+		static sqlite3_module s_module;
+
+		static void collationNeeded(void * context, sqlite3 * db, int rep,
+									const char * name);
+		static int compareBinary(void * context, int n1, const void * s1,
+								 int n2, const void * s2);
+		static int progressHandler(void * cancelled);
+
+		sqlite3 * m_db;
+		QStringList m_schemas;
+		QList<SchemaObject> m_objects;
+		//! \brief By key(), the columns of each table
+		QHash<QString, QStringList> m_columns;
+		//! \brief By key(), the CREATE TABLE for the virtual table
+		QHash<QString, QString> m_declarations;
+		//! \brief By key(), the columns of each index of each table
+		QHash<QString, QList<QStringList> > m_indexColumns;
+		//! \brief Schemas which have been analyzed
+		QSet<QString> m_analyzed;
+		//! \brief By key(), the tables which the statements read
+		QSet<QString> m_referenced;
+		//! \brief Starts the name of each candidate in the scratch database
+		QString m_scratchPrefix;
+		QHash<QString, qint64> m_rowCounts;
+		QList<Candidate> m_candidates;
+		QSet<QString> m_candidateKeys;
+
+		QList<StatementAdvice> m_statements;
+		QList<IndexAdvice> m_advice;
+		QString m_error;
+		QAtomicInt m_cancelled;
+};
+
+#endif
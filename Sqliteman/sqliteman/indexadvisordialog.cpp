@@ -0,0 +1,162 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QApplication>
+#include <QProgressDialog>
+#include <QPushButton>
+
+#include "indexadvisordialog.h"
+#include "litemanwindow.h"
+#include "preferences.h"
+
+IndexAdvisorDialog::IndexAdvisorDialog(const QString & editorText,
+									   const QStringList & history,
+									   LiteManWindow * creator)
+	: QDialog(creator),
+	  m_creator(creator),
+	  m_editorText(editorText),
+	  m_history(history)
+{
+	ui.setupUi(this);
+	Preferences * prefs = Preferences::instance();
+	resize(prefs->indexadvisorWidth(), prefs->indexadvisorHeight());
+
+	ui.editorRadio->setEnabled(!editorText.trimmed().isEmpty());
+	ui.historyRadio->setEnabled(!history.isEmpty());
+	ui.historyRadio->setChecked(!ui.editorRadio->isEnabled());
+	ui.analyzeButton->setEnabled(   ui.editorRadio->isEnabled()
+								 || ui.historyRadio->isEnabled());
+	m_createButton = ui.buttonBox->addButton(tr("Create Index..."),
+											 QDialogButtonBox::ApplyRole);
+	m_createButton->setEnabled(false);
+
+	connect(ui.analyzeButton, SIGNAL(clicked()),
+			this, SLOT(analyzeButton_clicked()));
+	connect(m_createButton, SIGNAL(clicked()),
+			this, SLOT(createButton_clicked()));
+	connect(ui.resultTree,
+			SIGNAL(currentItemChanged(QTreeWidgetItem *, QTreeWidgetItem *)),
+			this, SLOT(resultTree_currentItemChanged()));
+}
+
+IndexAdvisorDialog::~IndexAdvisorDialog()
+{
+	Preferences * prefs = Preferences::instance();
+	prefs->setindexadvisorHeight(height());
+	prefs->setindexadvisorWidth(width());
+}
+
+void IndexAdvisorDialog::showPlan(QTreeWidgetItem * parent,
+								  const QString & title,
+								  const QStringList & lines)
+{
+	QTreeWidgetItem * item = new QTreeWidgetItem(parent);
+	item->setText(0, title);
+	foreach (const QString & line, lines)
+	{
+		QTreeWidgetItem * child = new QTreeWidgetItem(item);
+		child->setText(0, line);
+	}
+}
+
+void IndexAdvisorDialog::analyzeButton_clicked()
+{
+	if (!m_creator->checkForPending()) { return; }
+	ui.resultTree->clear();
+	m_advice.clear();
+	m_createButton->setEnabled(false);
+
+	QStringList scripts;
+	if (ui.editorRadio->isChecked()) { scripts.append(m_editorText); }
+	else { scripts = m_history; }
+	IndexAdvisor advisor(scripts);
+	QProgressDialog progress(tr("Looking for useful indexes"), tr("Cancel"),
+							 0, 0, this);
+	connect(&progress, SIGNAL(canceled()), &advisor, SLOT(cancel()));
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(1000);
+	advisor.start();
+	while (!advisor.wait(100)) { qApp->processEvents(); }
+	progress.reset();
+
+	if (!advisor.errorString().isNull())
+	{
+		QTreeWidgetItem * item = new QTreeWidgetItem(ui.resultTree);
+		item->setText(0, advisor.errorString());
+		item->setForeground(0, QBrush(Qt::red));
+		return;
+	}
+
+	m_advice = advisor.indexes();
+	const QList<StatementAdvice> & statements = advisor.statements();
+	for (int i = 0; i < m_advice.count(); ++i)
+	{
+		const IndexAdvice & advice = m_advice.at(i);
+		QTreeWidgetItem * item = new QTreeWidgetItem(ui.resultTree);
+		item->setText(0, advice.sql);
+		item->setData(0, Qt::UserRole, i);
+		QFont font(item->font(0));
+		font.setBold(true);
+		item->setFont(0, font);
+		foreach (int s, advice.statements)
+		{
+			const StatementAdvice & statement = statements.at(s);
+			QTreeWidgetItem * child = new QTreeWidgetItem(item);
+			child->setText(0, statement.sql.simplified());
+			child->setToolTip(0, statement.sql);
+			showPlan(child, tr("Before"), statement.before);
+			showPlan(child, tr("After"), statement.after);
+		}
+		item->setExpanded(true);
+	}
+	if (m_advice.isEmpty())
+	{
+		QTreeWidgetItem * item = new QTreeWidgetItem(ui.resultTree);
+		item->setText(0, statements.isEmpty()
+						 ? tr("There are no statements to analyze")
+						 : tr("No new index would help these statements"));
+	}
+
+	QTreeWidgetItem * failed = 0;
+	foreach (const StatementAdvice & statement, statements)
+	{
+		if (statement.error.isNull()) { continue; }
+		if (!failed)
+		{
+			failed = new QTreeWidgetItem(ui.resultTree);
+			failed->setText(0, tr("Statements which could not be analyzed"));
+		}
+		QTreeWidgetItem * child = new QTreeWidgetItem(failed);
+		child->setText(0, statement.sql.simplified());
+		child->setToolTip(0, statement.sql);
+		QTreeWidgetItem * error = new QTreeWidgetItem(child);
+		error->setText(0, statement.error);
+		error->setForeground(0, QBrush(Qt::red));
+	}
+	if (ui.resultTree->topLevelItemCount() > 0)
+	{
+		ui.resultTree->setCurrentItem(ui.resultTree->topLevelItem(0));
+	}
+}
+
+void IndexAdvisorDialog::createButton_clicked()
+{
+	QTreeWidgetItem * item = ui.resultTree->currentItem();
+	while (item && item->parent()) { item = item->parent(); }
+	if (!item || !item->data(0, Qt::UserRole).isValid()) { return; }
+	const IndexAdvice & advice =
+		m_advice.at(item->data(0, Qt::UserRole).toInt());
+	m_creator->createIndexFromAdvice(advice.table, advice.schema,
+									 advice.name, advice.columns);
+}
+
+void IndexAdvisorDialog::resultTree_currentItemChanged()
+{
+	QTreeWidgetItem * item = ui.resultTree->currentItem();
+	while (item && item->parent()) { item = item->parent(); }
+	m_createButton->setEnabled(item && item->data(0, Qt::UserRole).isValid());
+}
@@ -0,0 +1,56 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef INDEXADVISORDIALOG_H
+#define INDEXADVISORDIALOG_H
+
+#include <qdialog.h>
+
+#include "indexadvisor.h"
+#include "ui_indexadvisordialog.h"
+
+class LiteManWindow;
+class QPushButton;
+
+/*! \brief Runs IndexAdvisor and shows what it advises.
+Each advised index is a top level item, with the statements it helps
+under it and the plan of each without and with the index. The selected
+index can be taken on to the Create Index dialog.
+*/
+class IndexAdvisorDialog : public QDialog
+{
+	Q_OBJECT
+
+	public:
+		/*! \brief Create the dialog
+		\param editorText the SQL editor's statements
+		\param history the SQL editor's history, oldest first
+		\param creator the main window, for Create Index
+		*/
+		IndexAdvisorDialog(const QString & editorText,
+						   const QStringList & history,
+						   LiteManWindow * creator);
+		~IndexAdvisorDialog();
+
+	private:
+		Ui::IndexAdvisorDialog ui;
+		LiteManWindow * m_creator;
+		QPushButton * m_createButton;
+		QString m_editorText;
+		QStringList m_history;
+		QList<IndexAdvice> m_advice;
+
+		void showPlan(QTreeWidgetItem * parent, const QString & title,
+					  const QStringList & lines);
+
+	private slots:
+		void analyzeButton_clicked();
+		void createButton_clicked();
+		void resultTree_currentItemChanged();
+};
+
+#endif
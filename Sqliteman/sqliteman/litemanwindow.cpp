@@ -6,16 +6,17 @@
  * for which a new license (GPL+exception) is in place.
  */
 
-#include <QTreeWidget>
 #include <QTableView>
 #include <QSplitter>
 #include <QMenuBar>
 #include <QMenu>
 #include <QtCore/QTime>
 
+#include <QApplication>
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QFileDialog>
+#include <QProgressDialog>
 
 #include <QSqlDatabase>
 #include <QSqlError>
@@ -23,6 +24,7 @@
 
 #include <QtCore/QCoreApplication>
 #include <QCloseEvent>
+#include <QtCore/QDateTime>
 #include <QtCore/QFileInfo>
 #include <QAction>
 #include <QtCore/QFile>
@@ -35,21 +37,28 @@
 #include "alterviewdialog.h"
 #include "analyzedialog.h"
 #include "buildtime.h"
+#include "catalogue.h"
+#include "changerecorder.h"
 #include "constraintsdialog.h"
 #include "createindexdialog.h"
 #include "createtabledialog.h"
 #include "createtriggerdialog.h"
 #include "createviewdialog.h"
 #include "database.h"
+#include "databasebackup.h"
+#include "databasedump.h"
 #include "dataviewer.h"
+#include "dumprestore.h"
 #include "helpbrowser.h"
 #include "importtabledialog.h"
+#include "importtablelogdialog.h"
 #include "litemanwindow.h"
 #include "populatordialog.h"
 #include "preferences.h"
 #include "preferencesdialog.h"
 #include "queryeditordialog.h"
 #include "schemabrowser.h"
+#include "scriptrunner.h"
 #include "sqleditor.h"
 #include "sqliteprocess.h"
 #include "sqlmodels.h"
@@ -154,6 +163,12 @@ void LiteManWindow::closeEvent(QCloseEvent * e)
 		e->ignore ();
 	}
 	
+	stopBackup();
+#ifdef ENABLE_CHANGESETS
+	// the session must go before the connection
+	delete m_changes;
+	m_changes = 0;
+#endif
 	writeSettings();
 
 	invalidateTable();
@@ -198,8 +213,8 @@ void LiteManWindow::initUI()
 
     // schema browser
 	connect(schemaBrowser->tableTree,
-			SIGNAL(itemActivated(QTreeWidgetItem *, int)),
-			this, SLOT(treeItemActivated(QTreeWidgetItem *, int)));
+			SIGNAL(itemActivated(SchemaItem *, int)),
+			this, SLOT(treeItemActivated(SchemaItem *, int)));
 	connect(schemaBrowser->tableTree,
 			SIGNAL(customContextMenuRequested(const QPoint &)),
 			this, SLOT(treeContextMenuOpened(const QPoint &)));
@@ -212,7 +227,7 @@ void LiteManWindow::initUI()
 	connect(sqlEditor, SIGNAL(showSqlScriptResult(QString)),
 			dataViewer, SLOT(showSqlScriptResult(QString)));
 	connect(sqlEditor, SIGNAL(buildTree()),
-			schemaBrowser->tableTree, SLOT(buildTree()));
+			schemaBrowser->tableTree, SLOT(refresh()));
 	connect(sqlEditor, SIGNAL(refreshTable()),
 			this, SLOT(refreshTable()));
 	connect(dataViewer, SIGNAL(tableUpdated()),
@@ -296,6 +311,42 @@ void LiteManWindow::initActions()
 	dumpDatabaseAct = new QAction(tr("&Dump Database..."), this);
 	connect(dumpDatabaseAct, SIGNAL(triggered()), this, SLOT(dumpDatabase()));
 
+	dumpDirectoryAct = new QAction(tr("Dump Database into Director&y..."), this);
+	connect(dumpDirectoryAct, SIGNAL(triggered()),
+			this, SLOT(dumpDatabaseDirectory()));
+
+	restoreDumpAct = new QAction(tr("Restore Dump Director&y..."), this);
+	connect(restoreDumpAct, SIGNAL(triggered()),
+			this, SLOT(restoreDumpDirectory()));
+
+	executeSqlFileAct = new QAction(tr("E&xecute SQL File..."), this);
+	connect(executeSqlFileAct, SIGNAL(triggered()),
+			this, SLOT(executeSqlFile()));
+
+	backupDatabaseAct = new QAction(tr("&Backup Database..."), this);
+	connect(backupDatabaseAct, SIGNAL(triggered()),
+			this, SLOT(backupDatabase()));
+
+	restoreIntoMemoryAct = new QAction(tr("&Restore into Memory..."), this);
+	connect(restoreIntoMemoryAct, SIGNAL(triggered()),
+			this, SLOT(restoreIntoMemory()));
+
+#ifdef ENABLE_CHANGESETS
+	recordChangesAct = new QAction(tr("Record &Changes"), this);
+	recordChangesAct->setCheckable(true);
+	recordChangesAct->setChecked(Preferences::instance()->recordChanges());
+	connect(recordChangesAct, SIGNAL(toggled(bool)),
+			this, SLOT(recordChanges(bool)));
+
+	saveChangesAct = new QAction(tr("&Save Changes since Checkpoint..."), this);
+	saveChangesAct->setEnabled(false);
+	connect(saveChangesAct, SIGNAL(triggered()), this, SLOT(saveChanges()));
+
+	applyChangesetAct = new QAction(tr("A&pply Changeset..."), this);
+	connect(applyChangesetAct, SIGNAL(triggered()),
+			this, SLOT(applyChangeset()));
+#endif
+
 	createTableAct = new QAction(Utils::getIcon("table.png"),
 								 tr("&Create Table..."), this);
 	createTableAct->setShortcut(tr("Ctrl+T"));
@@ -412,6 +463,17 @@ void LiteManWindow::initMenus()
 	databaseMenu->addSeparator();
 	databaseMenu->addAction(exportSchemaAct);
 	databaseMenu->addAction(dumpDatabaseAct);
+	databaseMenu->addAction(dumpDirectoryAct);
+	databaseMenu->addAction(restoreDumpAct);
+	databaseMenu->addAction(executeSqlFileAct);
+	databaseMenu->addAction(backupDatabaseAct);
+	databaseMenu->addAction(restoreIntoMemoryAct);
+#ifdef ENABLE_CHANGESETS
+	databaseMenu->addSeparator();
+	databaseMenu->addAction(recordChangesAct);
+	databaseMenu->addAction(saveChangesAct);
+	databaseMenu->addAction(applyChangesetAct);
+#endif
 	databaseMenu->addAction(importTableAct);
 
 	adminMenu = menuBar()->addMenu(tr("&System"));
@@ -588,7 +650,16 @@ void LiteManWindow::openDatabase(QString fileName)
             return; // Reopening same file, do nothing
         }
 		// Clean tree and model here because we're closing old db
+		stopBackup();
+#ifdef ENABLE_CHANGESETS
+		// unsaved changes are lost with the connection
+		delete m_changes;
+		m_changes = 0;
+#endif
+		schemaBrowser->tableTree->closeReaders();
+		sqlEditor->closeReaders();
 		db.close();
+		Catalogue::clear();
 	} else {
 #ifdef INTERNAL_SQLDRIVER
 		db = QSqlDatabase::addDatabase(new QSQLiteDriver(this), SESSION_NAME);
@@ -724,6 +795,9 @@ void LiteManWindow::openDatabase(QString fileName)
 				+ sqlite3_errstr(n)
 				+ "<br/></span>");
 		}
+#ifdef ENABLE_CHANGESETS
+		startRecording();
+#endif
 	}
     updateContextMenu();
 }
@@ -749,17 +823,17 @@ void LiteManWindow::handleExtensions(bool enable)
 }
 #endif
 
-void LiteManWindow::setActiveItem(QTreeWidgetItem * item)
+void LiteManWindow::setActiveItem(SchemaItem * item)
 {
 	// this sets the active item without any side-effects
 	// used when the item was already active but has been recreated
 	disconnect(schemaBrowser->tableTree,
-			   SIGNAL(itemActivated(QTreeWidgetItem *, int)),
-			   this, SLOT(treeItemActivated(QTreeWidgetItem *, int)));
+			   SIGNAL(itemActivated(SchemaItem *, int)),
+			   this, SLOT(treeItemActivated(SchemaItem *, int)));
 	schemaBrowser->tableTree->setCurrentItem(item);
 	connect(schemaBrowser->tableTree,
-			SIGNAL(itemActivated(QTreeWidgetItem *, int)),
-			this, SLOT(treeItemActivated(QTreeWidgetItem *, int)));
+			SIGNAL(itemActivated(SchemaItem *, int)),
+			this, SLOT(treeItemActivated(SchemaItem *, int)));
 	m_activeItem = item;
     m_currentItem = item;
 }
@@ -902,19 +976,539 @@ void LiteManWindow::dumpDatabase()
 	if (fileName.isNull())
 		return;
 
-	if (Database::dumpDatabase(fileName))
+	runDump(fileName, DatabaseDump::SingleFile);
+}
+
+void LiteManWindow::dumpDatabaseDirectory()
+{
+	dataViewer->removeErrorMessage();
+	QString dirName = QFileDialog::getExistingDirectory(this,
+                                                    tr("Dump Database into Directory"),
+                                                    QDir::currentPath());
+
+	if (dirName.isNull())
+		return;
+
+	runDump(dirName, DatabaseDump::Directory);
+}
+
+void LiteManWindow::runDump(const QString & path, int mode)
+{
+	DatabaseDump dump(path, (DatabaseDump::Mode)mode);
+	QProgressDialog progress(tr("Dumping database into %1").arg(path),
+							 tr("Cancel"), 0, 0, this);
+	connect(&progress, SIGNAL(canceled()), &dump, SLOT(cancel()));
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(1000);
+	dump.start();
+	while (!dump.wait(100))
+	{
+		if (dump.tables() > 0) { progress.setMaximum(dump.tables()); }
+		progress.setLabelText(tr("Dumping database into %1\n"
+								 "%2 rows, %3 MB written")
+							  .arg(path).arg(dump.rowsDone())
+							  .arg(dump.bytesWritten() / 1048576));
+		progress.setValue(dump.tablesDone());
+		qApp->processEvents();
+	}
+	progress.reset();
+
+	if (dump.wasCancelled())
+	{
+		dataViewer->setStatusText(tr("Dump cancelled"));
+	}
+	else if (!dump.errorString().isNull())
+	{
+		QMessageBox::warning(this, m_appName, dump.errorString());
+	}
+	else
 	{
 		QMessageBox::information(this, m_appName,
-								 tr("Dump written into: %1").arg(fileName));
+								 tr("Dump written into: %1").arg(path));
+	}
+}
+
+void LiteManWindow::restoreDumpDirectory()
+{
+	dataViewer->removeErrorMessage();
+	QString dirName = QFileDialog::getExistingDirectory(this,
+                                                    tr("Restore Dump Directory"),
+                                                    QDir::currentPath());
+
+	if (dirName.isNull())
+		return;
+
+	if (!QFile::exists(DatabaseDump::schemaFile(dirName)))
+	{
+		dataViewer->setStatusText(
+			tr("Cannot restore ") + dirName
+			+ ":<br/><span style=\" color:#ff0000;\">"
+			+ tr("it is not a dump directory"));
+		return;
+	}
+
+	DumpRestore restore(dirName);
+	QProgressDialog progress(tr("Restoring %1").arg(dirName),
+							 tr("Cancel"), 0, 1000, this);
+	connect(&progress, SIGNAL(canceled()), &restore, SLOT(cancel()));
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(1000);
+	restore.start();
+	while (!restore.wait(100))
+	{
+		progress.setLabelText(tr("Restoring %1\n%2 rows, %3 of %4 MB read")
+							  .arg(dirName).arg(restore.rowsDone())
+							  .arg(restore.bytesDone() / 1048576)
+							  .arg(restore.bytes() / 1048576));
+		if (restore.bytes() > 0)
+		{
+			progress.setValue(restore.bytesDone() * 1000 / restore.bytes());
+		}
+		qApp->processEvents();
+	}
+	progress.reset();
+
+	// the restored schema may have the same schema_version as the old one
+	Catalogue::clear();
+	schemaBrowser->tableTree->buildTree();
+	schemaBrowser->buildPragmasTree();
+	queryEditor->resetSchemaList();
+	if (restore.wasCancelled())
+	{
+		dataViewer->setStatusText(tr("Restore cancelled"));
+	}
+	else if (!restore.errorString().isNull())
+	{
+		QMessageBox::warning(this, m_appName,
+							 tr("Cannot restore %1: %2")
+							 .arg(dirName).arg(restore.errorString()));
+	}
+	else
+	{
+		dataViewer->setStatusText(tr("Restored %1 rows from %2")
+								  .arg(restore.rowsDone()).arg(dirName));
+	}
+}
+
+void LiteManWindow::executeSqlFile()
+{
+	dataViewer->removeErrorMessage();
+	if (!checkForPending()) { return; }
+	QString fileName = QFileDialog::getOpenFileName(this,
+                                                    tr("Execute SQL File"),
+                                                    QDir::currentPath(),
+                                                    tr("SQL File (*.sql);;All Files (*)"));
+
+	if (fileName.isNull())
+		return;
+
+	Preferences * prefs = Preferences::instance();
+	qint64 start = 0;
+	// The file must be the one that was run, not just the same size: an
+	// edit which keeps the size would otherwise resume at the wrong place.
+	// It is taken before running, so that a file changed meanwhile won't
+	// be resumed either.
+	QFileInfo info(fileName);
+	qint64 modified = info.lastModified().toMSecsSinceEpoch();
+	if (   (prefs->sqlFileResume() == info.absoluteFilePath())
+		&& (prefs->sqlFileResumeSize() == info.size())
+		&& (prefs->sqlFileResumeModified() == modified)
+		&& (prefs->sqlFileResumeOffset() > 0))
+	{
+		int ret = QMessageBox::question(this, m_appName,
+			tr("%1 was not executed to the end.\n"
+			   "Resume it after the first %2 MB which were committed?")
+			.arg(fileName)
+			.arg(prefs->sqlFileResumeOffset() / 1048576.0, 0, 'f', 1),
+			QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel,
+			QMessageBox::Yes);
+		if (ret == QMessageBox::Cancel) { return; }
+		if (ret == QMessageBox::Yes) { start = prefs->sqlFileResumeOffset(); }
+	}
+
+	ScriptRunner runner(fileName, start);
+	QProgressDialog progress(tr("Executing %1").arg(fileName),
+							 tr("Cancel"), 0, 1000, this);
+	connect(&progress, SIGNAL(canceled()), &runner, SLOT(cancel()));
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(1000);
+	QElapsedTimer time;
+	time.start();
+	runner.start();
+	bool abandoned = false;
+	// what has been committed is recorded as it is, in case of a crash
+	qint64 saved = start;
+	while (!runner.wait(100))
+	{
+		if (runner.committed() > saved)
+		{
+			saved = runner.committed();
+			prefs->setSqlFileResume(info.absoluteFilePath(), saved,
+									info.size(), modified);
+		}
+		QString message, sql;
+		qint64 from, to;
+		if (runner.failed(message, sql, from, to))
+		{
+			int ret = QMessageBox::question(this, m_appName,
+				tr("Statement at byte %L1 failed:\n%2\n\n%3")
+				.arg(from).arg(message).arg(sql),
+				QMessageBox::Ignore, QMessageBox::Abort);
+			abandoned = (ret == QMessageBox::Abort);
+			runner.resume(!abandoned);
+		}
+		qint64 done = runner.offset() - runner.firstOffset();
+		qint64 size = runner.size() - runner.firstOffset();
+		double seconds = qMax(time.elapsed(), qint64(1)) / 1000.0;
+		progress.setLabelText(
+			tr("Executing %1\n%2 of %3 MB, %4 MB/s\n"
+			   "%5 statements, %6 statements/s")
+			.arg(fileName)
+			.arg(done / 1048576).arg(size / 1048576)
+			.arg(done / 1048576.0 / seconds, 0, 'f', 1)
+			.arg(runner.statements())
+			.arg(runner.statements() / seconds, 0, 'f', 0));
+		if (size > 0) { progress.setValue(done * 1000 / size); }
+		qApp->processEvents();
+	}
+	progress.reset();
+
+	// remember where to resume, or forget a finished file
+	if (runner.committed() < runner.size())
+	{
+		prefs->setSqlFileResume(info.absoluteFilePath(), runner.committed(),
+								info.size(), modified);
+	}
+	else
+	{
+		prefs->setSqlFileResume(QString(), 0, 0, 0);
+	}
+
+	if (runner.changed())
+	{
+		// the file may have attached or detached databases too
+		Catalogue::clear();
+		schemaBrowser->tableTree->buildTree();
+		schemaBrowser->buildPragmasTree();
+		queryEditor->resetSchemaList();
+	}
+	if (runner.wasCancelled())
+	{
+		dataViewer->setStatusText(
+			tr("Execution of %1 cancelled after %2 statements")
+			.arg(fileName).arg(runner.statements()));
+	}
+	else if (!runner.errorString().isNull() && !abandoned)
+	{
+		QMessageBox::warning(this, m_appName,
+							 tr("Cannot execute %1: %2")
+							 .arg(fileName).arg(runner.errorString()));
+	}
+	else if (abandoned)
+	{
+		dataViewer->setStatusText(
+			tr("Execution of %1 abandoned after %2 statements")
+			.arg(fileName).arg(runner.statements()));
+	}
+	else
+	{
+		dataViewer->setStatusText(
+			tr("Executed %1 statements from %2, %3 errors, in %4 seconds")
+			.arg(runner.statements()).arg(fileName).arg(runner.failures())
+			.arg(time.elapsed() / 1000.0));
+	}
+}
+
+void LiteManWindow::backupDatabase()
+{
+	dataViewer->removeErrorMessage();
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Backup Database"),
+                                                    QDir::currentPath(),
+                                                    tr("Sqlite database(*.sqlite);;All files(*.*)"));
+
+	if (fileName.isNull())
+		return;
+
+	QString current = QSqlDatabase::database(SESSION_NAME).databaseName();
+	if (QFileInfo(fileName) == QFileInfo(current))
+	{
+		dataViewer->setStatusText(
+			tr("Cannot back up ") + fileName
+			+ ":<br/><span style=\" color:#ff0000;\">"
+			+ tr("it is the open database"));
+		return;
+	}
+	startBackup(QString(), fileName);
+}
+
+void LiteManWindow::restoreIntoMemory()
+{
+	dataViewer->removeErrorMessage();
+	QString fileName = QFileDialog::getOpenFileName(this,
+                                                    tr("Restore into Memory"),
+                                                    QDir::currentPath(),
+                                                    tr("Sqlite database(*.sqlite);;All files(*.*)"));
+
+	if (fileName.isNull())
+		return;
+
+	openDatabase(":memory:");
+	if (QSqlDatabase::database(SESSION_NAME).databaseName() != ":memory:")
+		return; // openDatabase has said why
+
+	startBackup(fileName, ":memory:");
+	setWindowTitle(tr("%1 (in memory)").arg(QFileInfo(fileName).fileName())
+				   + " - " + m_appName);
+}
+
+void LiteManWindow::startBackup(const QString & source, const QString & target)
+{
+	bool restore = DatabaseBackup::isShared(target);
+	m_backup = new DatabaseBackup(source, target, this);
+	m_backupProgress = new QProgressDialog(
+		restore ? tr("Restoring %1 into memory").arg(source)
+				: tr("Backing up into %1").arg(target),
+		tr("Cancel"), 0, 0, this);
+	// the user can go on working during a backup,
+	// but not with a database which is still being restored
+	m_backupProgress->setWindowModality(restore ? Qt::WindowModal
+												: Qt::NonModal);
+	m_backupProgress->setAutoClose(false);
+	m_backupProgress->setAutoReset(false);
+	connect(m_backupProgress, SIGNAL(canceled()), m_backup, SLOT(cancel()));
+	connect(m_backup, SIGNAL(progress(int, int)),
+			this, SLOT(backupProgress(int, int)));
+	connect(m_backup, SIGNAL(finished()), this, SLOT(backupFinished()));
+	backupDatabaseAct->setEnabled(false);
+	restoreIntoMemoryAct->setEnabled(false);
+	m_backupRestarts = 0;
+	m_backupTimer.start();
+	m_backup->start();
+}
+
+void LiteManWindow::stopBackup()
+{
+	if (m_backup)
+	{
+		m_backup->cancel();
+		m_backup->wait();
+		backupFinished();
+	}
+}
+
+void LiteManWindow::backupProgress(int remaining, int pageCount)
+{
+	if (!m_backup) { return; }
+	if (m_backup->restarts() != m_backupRestarts)
+	{
+		// the throughput is of the current pass
+		m_backupRestarts = m_backup->restarts();
+		m_backupTimer.restart();
+	}
+	qint64 ms = qMax(m_backupTimer.elapsed(), (qint64)1);
+	double mb = (double)(pageCount - remaining) * m_backup->pageSize()
+				/ 1048576.0;
+	QString text(m_backupProgress->labelText().section('\n', 0, 0));
+	text += "\n" + tr("%1 of %2 pages remaining, %3 MB/s")
+				   .arg(remaining).arg(pageCount)
+				   .arg(mb * 1000.0 / ms, 0, 'f', 1);
+	if (m_backupRestarts > 0)
+	{
+		text += "\n" + tr("Started again %n time(s) because the database "
+						  "was changed", 0, m_backupRestarts);
+	}
+	m_backupProgress->setLabelText(text);
+	m_backupProgress->setMaximum(pageCount);
+	m_backupProgress->setValue(pageCount - remaining);
+}
+
+void LiteManWindow::backupFinished()
+{
+	// stopBackup() may have got here first
+	if (!m_backup) { return; }
+	DatabaseBackup * backup = m_backup;
+	m_backup = 0;
+	delete m_backupProgress;
+	m_backupProgress = 0;
+	backupDatabaseAct->setEnabled(true);
+	restoreIntoMemoryAct->setEnabled(true);
+
+	bool restore = DatabaseBackup::isShared(backup->target());
+	if (restore)
+	{
+		Catalogue::clear();
+		schemaBrowser->tableTree->buildTree();
+		schemaBrowser->buildPragmasTree();
+		queryEditor->resetSchemaList();
+	}
+	if (backup->wasCancelled())
+	{
+		dataViewer->setStatusText(restore ? tr("Restore cancelled")
+										  : tr("Backup cancelled"));
+	}
+	else if (!backup->errorString().isNull())
+	{
+		QString source = backup->source();
+		QString target = backup->target();
+		QString message = (restore ? tr("Cannot restore %1: %2").arg(source)
+								   : tr("Cannot back up into %1: %2").arg(target))
+						  .arg(backup->errorString());
+		if (restore)
+		{
+			QMessageBox::warning(this, m_appName, message);
+		}
+		else if (QMessageBox::question(this, m_appName,
+									   message + "\n\n" + tr("Try again?"),
+									   QMessageBox::Yes | QMessageBox::No)
+				 == QMessageBox::Yes)
+		{
+			backup->deleteLater();
+			startBackup(source, target);
+			return;
+		}
+	}
+	else
+	{
+		dataViewer->setStatusText(restore
+			? tr("Restored %1 into memory").arg(backup->source())
+			: tr("Backup written into: %1").arg(backup->target()));
 	}
+	backup->deleteLater();
 }
 
+#ifdef ENABLE_CHANGESETS
+void LiteManWindow::startRecording()
+{
+	delete m_changes;
+	m_changes = 0;
+	if (m_isOpen && Preferences::instance()->recordChanges())
+	{
+		m_changes = new ChangeRecorder(Database::sqlite3handle());
+		if (!m_changes->isValid())
+		{
+			dataViewer->setStatusText(
+				tr("Cannot record changes")
+				+ ":<br/><span style=\" color:#ff0000;\">"
+				+ m_changes->errorString());
+			delete m_changes;
+			m_changes = 0;
+		}
+	}
+	saveChangesAct->setEnabled(m_changes != 0);
+}
+
+void LiteManWindow::recordChanges(bool enable)
+{
+	if (!enable && m_changes && !m_changes->isEmpty())
+	{
+		int ret = QMessageBox::question(this, m_appName,
+			tr("The changes since the last checkpoint have not been saved.\n"
+			   "Stop recording and forget them?"),
+			QMessageBox::Yes | QMessageBox::No);
+		if (ret == QMessageBox::No)
+		{
+			recordChangesAct->blockSignals(true);
+			recordChangesAct->setChecked(true);
+			recordChangesAct->blockSignals(false);
+			return;
+		}
+	}
+	Preferences::instance()->setRecordChanges(enable);
+	startRecording();
+}
+
+void LiteManWindow::saveChanges()
+{
+	dataViewer->removeErrorMessage();
+	if (!m_changes) { return; }
+	if (m_changes->isEmpty())
+	{
+		dataViewer->setStatusText(tr("Nothing has changed since the last checkpoint"));
+		return;
+	}
+	QString fileName = QFileDialog::getSaveFileName(this,
+		tr("Save Changes since Checkpoint"),
+		QDir::currentPath(),
+		tr("Changeset (*.changeset);;All files(*.*)"));
+
+	if (fileName.isNull())
+		return;
+
+	if (m_changes->save(fileName))
+	{
+		dataViewer->setStatusText(tr("Changes written into: %1").arg(fileName));
+	}
+	else
+	{
+		dataViewer->setStatusText(
+			tr("Cannot write changes into ") + fileName
+			+ ":<br/><span style=\" color:#ff0000;\">"
+			+ m_changes->errorString());
+	}
+}
+
+void LiteManWindow::applyChangeset()
+{
+	dataViewer->removeErrorMessage();
+	if (!checkForPending()) { return; }
+	QString fileName = QFileDialog::getOpenFileName(this,
+		tr("Apply Changeset"),
+		QDir::currentPath(),
+		tr("Changeset (*.changeset);;All files(*.*)"));
+
+	if (fileName.isNull())
+		return;
+
+	QStringList policies;
+	policies << tr("Skip conflicting changes")
+			 << tr("Overwrite with the changeset's rows")
+			 << tr("Stop and change nothing");
+	bool ok;
+	QString policy = QInputDialog::getItem(this, tr("Apply Changeset"),
+		tr("When a change conflicts with the database:"),
+		policies, 0, false, &ok);
+	if (!ok) { return; }
+
+	QStringList log;
+	QString error;
+	QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+	bool applied = ChangeRecorder::apply(Database::sqlite3handle(), fileName,
+		(ChangeRecorder::Policy)policies.indexOf(policy), log, error);
+	QApplication::restoreOverrideCursor();
+	refreshTable();
+
+	if (!log.isEmpty())
+	{
+		ImportTableLogDialog dia(log, this);
+		dia.setWindowTitle(tr("Changeset Conflicts"));
+		dia.label->setText(applied
+			? tr("These changes conflicted with the database.")
+			: tr("The changeset has not been applied."));
+		dia.buttonBox->setStandardButtons(QDialogButtonBox::Ok);
+		dia.exec();
+	}
+	if (applied)
+	{
+		dataViewer->setStatusText(
+			tr("Changeset applied with %n conflict(s)", 0, log.count()));
+	}
+	else
+	{
+		dataViewer->setStatusText(
+			tr("Cannot apply ") + fileName
+			+ ":<br/><span style=\" color:#ff0000;\">" + error);
+	}
+}
+#endif
+
 void LiteManWindow::createTable()
 {
-	QTreeWidgetItem old;
+	QString oldName;
+	QString oldSchema;
 	if (m_currentItem != NULL)
 	{
-		old = QTreeWidgetItem(*m_currentItem);
+		oldName = m_currentItem->text(0);
+		oldSchema = m_currentItem->text(1);
 	}
 	dataViewer->removeErrorMessage();
 	CreateTableDialog dlg(this, m_currentItem);
@@ -925,27 +1519,23 @@ void LiteManWindow::createTable()
 			schemaBrowser->tableTree, SLOT(buildTableTree(QString)));
 	if (dlg.m_updated)
 	{
-        QList<QTreeWidgetItem*> l =
+        QList<SchemaItem*> l =
             schemaBrowser->tableTree->searchMask(
                 schemaBrowser->tableTree->trTables);
-        QList<QTreeWidgetItem*>::const_iterator it;
+        QList<SchemaItem*>::const_iterator it;
         for (it = l.constBegin(); it != l.constEnd(); ++it) {
-            QTreeWidgetItem* p = *it;
+            SchemaItem* p = *it;
 			if (   (p->type() == TableTree::TablesItemType)
 				&& (p->text(1) == dlg.schema()))
 			{
 				if (m_activeItem && (m_currentItem != NULL))
 				{
 					// item recreated but should still be current
-					if (dlg.schema() == old.text(1))
+					if (dlg.schema() == oldSchema)
 					{
-						for (int i = 0; i < p->childCount(); ++i)
-						{
-							if (p->child(i)->text(0) == old.text(0))
-							{
-								setActiveItem(p->child(i));
-							}
-						}
+						SchemaItem * item = schemaBrowser->tableTree
+							->findTable(oldSchema, oldName);
+						if (item) { setActiveItem(item); }
 					}
 				}
 			}
@@ -1170,6 +1760,19 @@ void LiteManWindow::createViewFromSql(QString query)
 	}
 }
 
+void LiteManWindow::createIndexFromAdvice(const QString & table,
+										  const QString & schema,
+										  const QString & name,
+										  const QStringList & columns)
+{
+	CreateIndexDialog dlg(table, schema, this);
+	connect(&dlg, SIGNAL(rebuildTableTree(QString)),
+			schemaBrowser->tableTree, SLOT(buildTableTree(QString)));
+	dlg.setIndex(name, columns);
+	dlg.exec();
+	if (dlg.m_updated) { checkForCatalogue(); }
+}
+
 void LiteManWindow::setTableModel(SqlQueryModel * model)
 {
 	dataViewer->setTableModel(model, false);
@@ -1198,6 +1801,7 @@ bool LiteManWindow::doExecSql(QString query, bool isBuilt)
 	// Run query
 	SqlQueryModel * model = new SqlQueryModel(this);
 	model->setQuery(query, QSqlDatabase::database(SESSION_NAME));
+	if (Utils::rollsBack(query)) { Catalogue::rolledBack(); }
 
 	sqlEditor->setStatusMessage(
         tr("Duration: %1 seconds").arg(time.elapsed() / 1000.0));
@@ -1238,31 +1842,18 @@ bool LiteManWindow::doExecSql(QString query, bool isBuilt)
 QStringList LiteManWindow::visibleDatabases()
 {
     QStringList result;
-    QList<QTreeWidgetItem *> schemas =
-        schemaBrowser->tableTree->findItems("*", Qt::MatchWildcard);
-    QList<QTreeWidgetItem*>::const_iterator i;
-    for (i = schemas.constBegin(); i != schemas.constEnd(); ++i) {
-        result.append((*i)->text(0));
+    TableTree * tree = schemaBrowser->tableTree;
+    for (int i = 0; i < tree->topLevelItemCount(); ++i) {
+        result.append(tree->topLevelItem(i)->text(0));
     }
     return result;
 }
 
-QTreeWidgetItem * LiteManWindow::findTreeItem(QString database, QString table)
+SchemaItem * LiteManWindow::findTreeItem(QString database, QString table)
 {
-    QList<QTreeWidgetItem*> l =
-        schemaBrowser->tableTree->searchMask(
-            schemaBrowser->tableTree->trTables);
-    QList<QTreeWidgetItem*>::const_iterator it;
-    for (it = l.constBegin(); it != l.constEnd(); ++it) {
-        QTreeWidgetItem* p = *it;
-        if (p->text(1) == database) {
-            int count = p->childCount();
-            for (int i = 0; i < count; ++i) {
-                QTreeWidgetItem* q = p->child(i);
-                if (q->text(0) == table) { return q; }
-            }
-        }
-    }
+    SchemaItem * item =
+        schemaBrowser->tableTree->findTable(database, table);
+    if (item) { return item; }
     QMessageBox::critical(
         this, tr("sqliteman internal error"),
         tr("Please report to maintainer\ndatabase %s table %s not found in tree")
@@ -1286,7 +1877,7 @@ void LiteManWindow::alterView()
 	dia.exec();
 	if (dia.m_updated)
 	{
-		QTreeWidgetItem * triggers = m_currentItem->child(0);
+		SchemaItem * triggers = m_currentItem->child(0);
 		if (triggers)
 		{
 			schemaBrowser->tableTree->buildTriggers(
@@ -1425,7 +2016,7 @@ void LiteManWindow::dropIndex()
 	}
 }
 
-void LiteManWindow::treeItemActivated(QTreeWidgetItem * item, int column)
+void LiteManWindow::treeItemActivated(SchemaItem * item, int column)
 {
 	dataViewer->removeErrorMessage();
 	if (   (!item)
@@ -1508,7 +2099,7 @@ void LiteManWindow::describeIndex() {
     }
 }
 
-void LiteManWindow::updateContextMenu(QTreeWidgetItem * cur)
+void LiteManWindow::updateContextMenu(SchemaItem * cur)
 {
 	contextMenu->clear();
 	if (!cur) { return; }
@@ -1604,12 +2195,12 @@ void LiteManWindow::analyzeDialog()
 	AnalyzeDialog *dia = new AnalyzeDialog(this);
 	dia->exec();
 	delete dia;
-    QList<QTreeWidgetItem*> l =
+    QList<SchemaItem*> l =
         schemaBrowser->tableTree->searchMask(
             schemaBrowser->tableTree->trSys);
-    QList<QTreeWidgetItem*>::const_iterator it;
+    QList<SchemaItem*>::const_iterator it;
     for (it = l.constBegin(); it != l.constEnd(); ++it) {
-        QTreeWidgetItem* p = *it;
+        SchemaItem* p = *it;
 		if (p->type() == TableTree::SystemItemType)
 			schemaBrowser->tableTree->buildCatalogue(p, p->text(1));
 	}
@@ -1708,6 +2299,8 @@ void LiteManWindow::attachDatabase()
 		}
 		else
 		{
+			// the name may have been used before for another file
+			Catalogue::clear();
 			schemaBrowser->tableTree->buildDatabase(schema);
 			queryEditor->schemaAdded(schema);
 		}
@@ -1742,8 +2335,9 @@ void LiteManWindow::detachDatabase()
 	}
 	else
 	{
+		Catalogue::clear();
 		// this removes the item from the tree as well as deleting it
-		delete m_currentItem;
+		schemaBrowser->tableTree->removeItem(m_currentItem);
         m_currentItem = NULL;
 		queryEditor->schemaGone(dbname);
 		dataViewer->setBuiltQuery(false);
@@ -1776,7 +2370,7 @@ void LiteManWindow::createTrigger()
 {
     if (!m_currentItem) { return; }
 	dataViewer->removeErrorMessage();
-	QTreeWidgetItem * triggers = NULL;
+	SchemaItem * triggers = NULL;
 	if (m_currentItem->type() == TableTree::TriggerType)
 	{
 		m_currentItem = m_currentItem->parent();
@@ -1788,6 +2382,12 @@ void LiteManWindow::createTrigger()
 	}
 	else
 	{
+		if (   (m_currentItem->type() == TableTree::TableType)
+			|| (m_currentItem->type() == TableTree::ViewType))
+		{
+			// its children may not have been read yet
+			schemaBrowser->tableTree->buildTableItem(m_currentItem, false);
+		}
 		for (int i = 0; i < m_currentItem->childCount(); ++i)
 		{
 			if (m_currentItem->child(i)->type() == TableTree::TriggersItemType)
@@ -1816,7 +2416,7 @@ void LiteManWindow::alterTrigger()
     {
         return;
     }
-	QTreeWidgetItem * triglist = m_currentItem->parent();
+	SchemaItem * triglist = m_currentItem->parent();
 	QString trigger(m_currentItem->text(0));
 	QString table(triglist->parent()->text(0));
 	QString schema(m_currentItem->text(1));
@@ -1978,13 +2578,13 @@ void LiteManWindow::preferences()
 }
 
 void LiteManWindow::tableTreeSelectionChanged() {
-    QList<QTreeWidgetItem *> selection(
+    QList<SchemaItem *> selection(
         schemaBrowser->tableTree->selectedItems());
     if (selection.isEmpty()) {
         m_currentItem = NULL;
     } else {
         m_currentItem = selection.first();
-        QTreeWidgetItem * currentitem =
+        SchemaItem * currentitem =
             schemaBrowser->tableTree->currentItem();
         updateContextMenu(currentitem);
     }
@@ -1993,5 +2593,6 @@ void LiteManWindow::tableTreeSelectionChanged() {
 // Called by sqleditor if it executes a DETACH or an EXEC
 // which might contain a DETACH
 void LiteManWindow::detaches() {
+	Catalogue::clear();
 	queryEditor->schemaGone(QString());
 }
@@ -10,15 +10,19 @@
 #define LITEMANWINDOW_H
 
 #include <QMainWindow>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QPointer>
 #include <QtCore/QMap>
 
 class QAction;
 class QLabel;
 class QMenu;
+class QProgressDialog;
 class QSplitter;
-class QTreeWidgetItem;
+class SchemaItem;
 
+class ChangeRecorder;
+class DatabaseBackup;
 class DataViewer;
 class HelpBrowser;
 class QueryEditorDialog;
@@ -55,10 +59,14 @@ class LiteManWindow : public QMainWindow
 		void buildPragmasTree();
 		void checkForCatalogue();
 		void createViewFromSql(QString query);
+		//! \brief Create Index, starting from an index the advisor suggests
+		void createIndexFromAdvice(const QString & table, const QString & schema,
+								   const QString & name,
+								   const QStringList & columns);
 		void setTableModel(SqlQueryModel * model);
         bool doExecSql(QString query, bool isBuilt);
         QStringList visibleDatabases();
-        QTreeWidgetItem * findTreeItem(QString database, QString table);
+        SchemaItem * findTreeItem(QString database, QString table);
 
 		QueryEditorDialog * queryEditor = 0;
         QAction * actToggleSqlEditorToolBar;
@@ -103,11 +111,22 @@ class LiteManWindow : public QMainWindow
 		void handleExtensions(bool enable);
 #endif
 
-		void setActiveItem(QTreeWidgetItem * item);
+		void setActiveItem(SchemaItem * item);
 		void describeObject(QString type);
-		void updateContextMenu(QTreeWidgetItem * item);
+		void updateContextMenu(SchemaItem * item);
         QString getOSName();
 		void doBuildQuery();
+		//! \brief Run a DatabaseDump of the given DatabaseDump::Mode
+		void runDump(const QString & path, int mode);
+		/*! \brief Copy \a source into \a target in the background.
+		An empty name means the open database. */
+		void startBackup(const QString & source, const QString & target);
+		//! \brief Cancel a running backup and wait for it
+		void stopBackup();
+#ifdef ENABLE_CHANGESETS
+		//! \brief (Re)start recording changes if the preference says so
+		void startRecording();
+#endif
 
 	protected:
 		/*! \brief This method handles closing of the main window by saving the window's state and accepting
@@ -132,6 +151,18 @@ class LiteManWindow : public QMainWindow
 		void buildAnyQuery();
 		void exportSchema();
 		void dumpDatabase();
+		void dumpDatabaseDirectory();
+		void restoreDumpDirectory();
+		void executeSqlFile();
+		void backupDatabase();
+		void restoreIntoMemory();
+		void backupProgress(int remaining, int pageCount);
+		void backupFinished();
+#ifdef ENABLE_CHANGESETS
+		void recordChanges(bool enable);
+		void saveChanges();
+		void applyChangeset();
+#endif
 
 		void createTable();
 		void dropTable();
@@ -153,7 +184,7 @@ class LiteManWindow : public QMainWindow
 		void describeIndex();
 		void reindex();
 
-		void treeItemActivated(QTreeWidgetItem * item, int column);
+		void treeItemActivated(SchemaItem * item, int column);
 		void updateContextMenu();
 		void treeContextMenuOpened(const QPoint & pos);
 
@@ -187,8 +218,8 @@ class LiteManWindow : public QMainWindow
 		QString m_lastSqlFile;
 		QString m_appName = "Sqliteman";
 		QString m_lang;
-		QTreeWidgetItem * m_activeItem;
-		QTreeWidgetItem * m_currentItem;
+		SchemaItem * m_activeItem;
+		SchemaItem * m_currentItem;
 		QLabel * m_sqliteVersionLabel;
 		QLabel * m_extensionLabel;
 		bool tableTreeTouched;
@@ -204,6 +235,17 @@ class LiteManWindow : public QMainWindow
 		SqlEditor* sqlEditor;
 		QSplitter* splitterSql;
 		HelpBrowser * helpBrowser = 0;
+
+		// the running backup or restore, if any
+		DatabaseBackup * m_backup = 0;
+		QProgressDialog * m_backupProgress = 0;
+		QElapsedTimer m_backupTimer;
+		int m_backupRestarts;
+
+#ifdef ENABLE_CHANGESETS
+		// changes since the last checkpoint, if they are being recorded
+		ChangeRecorder * m_changes = 0;
+#endif
 		
 		QMenu * databaseMenu;
 		QMenu * adminMenu;
@@ -250,6 +292,16 @@ class LiteManWindow : public QMainWindow
 		QAction * contextBuildQueryAct;
 		QAction * exportSchemaAct;
 		QAction * dumpDatabaseAct;
+		QAction * dumpDirectoryAct;
+		QAction * restoreDumpAct;
+		QAction * executeSqlFileAct;
+		QAction * backupDatabaseAct;
+		QAction * restoreIntoMemoryAct;
+#ifdef ENABLE_CHANGESETS
+		QAction * recordChangesAct;
+		QAction * saveChangesAct;
+		QAction * applyChangesetAct;
+#endif
 
 		QAction * analyzeAct;
 		QAction * vacuumAct;
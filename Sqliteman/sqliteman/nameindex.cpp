@@ -0,0 +1,99 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <algorithm>
+
+#include "nameindex.h"
+
+namespace {
+	//! \brief Orders name numbers by their lower case names
+	class ByName
+	{
+		public:
+			explicit ByName(const QStringList & lower) : m_lower(lower) {}
+			bool operator()(int a, int b) const
+			{
+				return m_lower.at(a) < m_lower.at(b);
+			}
+			bool operator()(int a, const QString & b) const
+			{
+				return m_lower.at(a) < b;
+			}
+
+		private:
+			const QStringList & m_lower;
+	};
+}
+
+NameIndex::NameIndex(const QStringList & names)
+	: m_names(names)
+{
+	m_sorted.reserve(names.size());
+	for (int i = 0; i < names.size(); ++i)
+	{
+		QString lower(names.at(i).toLower());
+		m_lower.append(lower);
+		m_sorted.append(i);
+		for (int j = 0; j + TrigramLength <= lower.size(); ++j)
+		{
+			QVector<int> & list = m_trigrams[lower.mid(j, TrigramLength)];
+			// a name may contain the same trigram more than once
+			if (list.isEmpty() || (list.last() != i)) { list.append(i); }
+		}
+	}
+	std::sort(m_sorted.begin(), m_sorted.end(), ByName(m_lower));
+}
+
+QStringList NameIndex::match(const QString & text) const
+{
+	QString lower(text.toLower());
+	if (lower.isEmpty()) { return m_names; }
+
+	QVector<int> found;
+	if (lower.size() < TrigramLength)
+	{
+		// the names starting with it are together in sorted order
+		QVector<int>::const_iterator i = std::lower_bound(
+			m_sorted.constBegin(), m_sorted.constEnd(), lower,
+			ByName(m_lower));
+		for (; i != m_sorted.constEnd(); ++i)
+		{
+			if (!m_lower.at(*i).startsWith(lower)) { break; }
+			found.append(*i);
+		}
+		std::sort(found.begin(), found.end());
+	}
+	else
+	{
+		// a name containing the text contains all of its trigrams
+		const QVector<int> * shortest = 0;
+		for (int j = 0; j + TrigramLength <= lower.size(); ++j)
+		{
+			QHash<QString, QVector<int> >::const_iterator t =
+				m_trigrams.constFind(lower.mid(j, TrigramLength));
+			if (t == m_trigrams.constEnd()) { return QStringList(); }
+			if (!shortest || (t.value().size() < shortest->size()))
+			{
+				shortest = &t.value();
+			}
+		}
+		QVector<int>::const_iterator i;
+		for (i = shortest->constBegin(); i != shortest->constEnd(); ++i)
+		{
+			if (m_lower.at(*i).contains(lower)) { found.append(*i); }
+		}
+	}
+
+	QStringList result;
+	result.reserve(found.size());
+	QVector<int>::const_iterator i;
+	for (i = found.constBegin(); i != found.constEnd(); ++i)
+	{
+		result.append(m_names.at(*i));
+	}
+	return result;
+}
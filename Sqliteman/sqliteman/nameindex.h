@@ -0,0 +1,45 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef NAMEINDEX_H
+#define NAMEINDEX_H
+
+#include <QtCore/QHash>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+/*! \brief Finds the names containing some text without looking at them all.
+The names are kept sorted in lower case, so that text of one or two
+characters, which would match too much of anything, finds the names
+starting with it by a binary search. Longer text finds the names containing
+it anywhere: each of its three character pieces (trigrams) has a list of
+the names containing it, and only the names on the shortest of those lists
+need to be checked.
+Matching is case insensitive, like sqlite's names.
+*/
+class NameIndex
+{
+	public:
+		NameIndex() {}
+		explicit NameIndex(const QStringList & names);
+
+		//! \brief The names matching \a text, in the order they were given
+		QStringList match(const QString & text) const;
+
+		//! \brief Text shorter than this only matches the start of names
+		static const int TrigramLength = 3;
+
+	private:
+		QStringList m_names;
+		//! \brief m_names in lower case, and the order to sort them
+		QStringList m_lower;
+		QVector<int> m_sorted;
+		//! \brief the names containing each trigram, in ascending order
+		QHash<QString, QVector<int> > m_trigrams;
+};
+
+#endif
@@ -862,7 +862,7 @@ void pd::dump(QVector<QVariant> &v) {
 void pd::dump(QWidget * w) { dump(prepareWidget((QWidget *)w)); }
 // The following are for sqliteman's own application types
 void pd::dump(const struct Token & t) {
-    dump(preparetokenType(t.type) + '(' + t.name + ')');
+    dump(preparetokenType(t.type) + '(' + t.name() + ')');
 }
 void pd::dump(QList<Token> &l) {
     if (l.isEmpty()) { qDebug ("Empty QList<Token>"); }
@@ -8,14 +8,61 @@ for which a new license (GPL+exception) is in place.
 #include <QSqlError>
 #include <QHeaderView>
 #include <QtCore/QDateTime>
-#include <QMessageBox>
-#include <math.h>
+#include <QtCore/QVector>
+#include <QtCore/QThread>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QApplication>
+#include <QProgressDialog>
 
 #include "populatordialog.h"
 #include "populatorcolumnwidget.h"
 #include "preferences.h"
 #include "utils.h"
 
+// Rows inserted between commits when not inside a transaction
+#define POPULATOR_BATCH_SIZE 100000
+// Rows made together by one thread; chunk n always starts at row n * this
+#define POPULATOR_CHUNK_ROWS 4096
+// Rows inserted between progress updates
+#define POPULATOR_PROGRESS_ROWS 10000
+// Insert errors shown in the result pane
+#define MAX_LOGGED_ERRORS 20
+
+/* Functor for QtConcurrent::map: fills a chunk with the values of its rows.
+ * Chunks start at multiples of POPULATOR_CHUNK_ROWS, so seeding from the
+ * chunk number makes the same rows from the same seed every time.
+ */
+class MakeChunk
+{
+	public:
+		typedef void result_type;
+
+		MakeChunk(const QList<Populator::Generator> & generators, quint64 seed)
+			: m_generators(generators), m_seed(seed) {}
+
+		void operator()(Populator::Chunk & chunk) const
+		{
+			quint64 n = chunk.first / POPULATOR_CHUNK_ROWS;
+			Populator::Random random(
+				Populator::Random::mix(m_seed ^ Populator::Random::mix(n)));
+			int cols = m_generators.count();
+			chunk.values.resize(chunk.rows * cols);
+			Populator::Value * v = chunk.values.data();
+			for (int r = 0; r < chunk.rows; ++r)
+			{
+				for (int j = 0; j < cols; ++j)
+				{
+					m_generators.at(j).value(chunk.first + r, *v++, random);
+				}
+			}
+		}
+
+	private:
+		// the same list for all the chunks, it must outlive the map
+		const QList<Populator::Generator> & m_generators;
+		quint64 m_seed;
+};
+
 PopulatorDialog::PopulatorDialog(
     LiteManWindow * parent, const QString & table, const QString & schema)
 	: DialogCommon(parent)
@@ -103,122 +150,204 @@ void PopulatorDialog::checkActionTypes()
 	populateButton->setEnabled(enable);
 }
 
-qlonglong PopulatorDialog::tableRowCount()
+QString PopulatorDialog::sqlColumns()
 {
-	QString sql = QString("select count(1) from ")
-				  + Utils::q(m_databaseName)
-				  + "."
-				  + Utils::q(m_tableName)
-				  + ";";
-	QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
-	if (!execSql(sql, tr("Cannot get statistics for table")))
-	{
-		return -1;
+	QStringList s;
+    QList<Populator::PopColumn>::const_iterator i;
+    for (i = m_columnList.constBegin(); i != m_columnList.constEnd(); ++i) {
+		if (i->action != Populator::T_IGNORE) { s.append(i->name); }
 	}
-	while(query.next())
-		return query.value(0).toLongLong();
-	return -1;
+	return Utils::q(s, "\"");
 }
 
-QString PopulatorDialog::sqlColumns()
+QString PopulatorDialog::sqlBinds()
 {
 	QStringList s;
     QList<Populator::PopColumn>::const_iterator i;
     for (i = m_columnList.constBegin(); i != m_columnList.constEnd(); ++i) {
-		if (i->action != Populator::T_IGNORE) { s.append(i->name); }
+		if (i->action != Populator::T_IGNORE) { s.append("?"); }
 	}
-	return Utils::q(s, "\"");
+	return s.join(",");
+}
+
+qint64 PopulatorDialog::nextWindow(QVector<Populator::Chunk> & chunks,
+								   int count, qint64 first, qint64 rows)
+{
+	chunks.clear();
+	while ((chunks.count() < count) && (first < rows))
+	{
+		Populator::Chunk chunk;
+		chunk.first = first;
+		chunk.rows = (int)qMin((qint64)POPULATOR_CHUNK_ROWS, rows - first);
+		chunks.append(chunk);
+		first += chunk.rows;
+	}
+	return first;
+}
+
+void PopulatorDialog::cancel()
+{
+	m_cancelled = true;
 }
 
 void PopulatorDialog::populateButton_clicked()
 {
-	// Avoid QVariantList extension because it doesn't work for column names
-	// containing special characters
 	resultEdit->setHtml("");
 	m_columnList.clear();
 	for (int i = 0; i < columnTable->rowCount(); ++i)
 		m_columnList.append(qobject_cast<PopulatorColumnWidget*>(columnTable->cellWidget(i, 2))->column());
 
-	QList<QVariantList> values;
+	QDateTime now(QDateTime::currentDateTime());
+
+	QList<Populator::Generator> generators;
     QList<Populator::PopColumn>::const_iterator it;
     for (it = m_columnList.constBegin(); it != m_columnList.constEnd(); ++it) {
-		switch (it->action)
+		if (it->action == Populator::T_IGNORE) { continue; }
+		qint64 start = 0;
+		if ((it->action == Populator::T_AUTO) && !autoStart(*it, start))
 		{
-			case Populator::T_AUTO:
-				values.append(autoValues(*it));
-				break;
-			case Populator::T_AUTO_FROM:
-				values.append(autoFromValues(*it));
-				break;
-			case Populator::T_NUMB:
-				values.append(numberValues(*it));
-				break;
-			case Populator::T_TEXT:
-				values.append(textValues(*it));
-				break;
-			case Populator::T_PREF:
-				values.append(textPrefixedValues(*it));
-				break;
-			case Populator::T_STAT:
-				values.append(staticValues(*it));
-				break;
-			case Populator::T_DT_NOW:
-			case Populator::T_DT_NOW_UNIX:
-			case Populator::T_DT_NOW_JULIAN:
-			case Populator::T_DT_RAND:
-			case Populator::T_DT_RAND_UNIX:
-			case Populator::T_DT_RAND_JULIAN:
-				values.append(dateValues(*it));
-				break;
-			case Populator::T_IGNORE:
-				break;
-		};
+			return;
+		}
+		generators.append(Populator::Generator(*it, start, now));
 	}
 
-	if (!execSql("SAVEPOINT POPULATOR;", tr("Cannot create savepoint")))
+	// prepared once, the values are bound natively for each row
+	QString sql = QString("INSERT ")
+				  + (constraintBox->isChecked() ? "OR IGNORE" : "")
+				  + " INTO "
+				  + Utils::q(m_databaseName)
+				  + "."
+				  + Utils::q(m_tableName)
+				  + " ("
+				  + sqlColumns()
+				  + ") VALUES ("
+				  + sqlBinds()
+				  + ");";
+	sqlite3 * db = Database::sqlite3handle();
+	sqlite3_stmt * stmt = 0;
+	QByteArray utf8(sql.toUtf8());
+	if (sqlite3_prepare_v2(db, utf8.constData(), utf8.size(), &stmt, 0)
+		!= SQLITE_OK)
 	{
-		execSql("ROLLBACK TO POPULATOR;", tr("Cannot roll back after error"));
+		insertError(tr("Cannot prepare insert statement"), sql);
+		sqlite3_finalize(stmt);
 		return;
 	}
 
-	qlonglong cntPre, cntPost;
-	resultEdit->clear();
+	if (!execSql("SAVEPOINT POPULATOR;", tr("Cannot create savepoint")))
+	{
+		sqlite3_finalize(stmt);
+		return;
+	}
 
-	cntPre = tableRowCount();
-	QSqlQuery query(QSqlDatabase::database(SESSION_NAME));
-	for (int i = 0; i < spinBox->value(); ++i)
+	qint64 rows = spinBox->value();
+	qint64 inserted = 0;
+	qint64 committed = 0;
+	int errors = 0;
+	bool failed = false;
+	m_cancelled = false;
+	QProgressDialog progress(tr("Populating %1").arg(m_tableName),
+							 tr("Cancel"), 0, 1000, this);
+	connect(&progress, SIGNAL(canceled()), this, SLOT(cancel()));
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(1000);
+
+	/* The rows are made in chunks of POPULATOR_CHUNK_ROWS by all the
+	 * cores, a window of chunks at a time, while this thread inserts the
+	 * previous window. Each chunk has its own Random seeded from the seed
+	 * and the chunk number, so the values don't depend on the threads.
+	 */
+	if (newSeedBox->isChecked())
 	{
-		QStringList slr;
-		for (int j = 0; j < values.count(); ++j)
-		{
-			slr.append(Utils::q(values.at(j).at(i).toString()));
-		}
-		QString sql = QString("INSERT ")
-					  + (constraintBox->isChecked() ? "OR IGNORE" : "")
-					  + " INTO "
-					  + Utils::q(m_databaseName)
-					  + "."
-					  + Utils::q(m_tableName)
-					  + " ("
-					  + sqlColumns()
-					  + ") VALUES ("
-					  + slr.join(",")
-					  + ");";
-
-		query.prepare(sql);
-		if (!query.exec())
+		// shown, so that this run can be repeated
+		quint64 now = QDateTime::currentMSecsSinceEpoch();
+		seedBox->setValue(int(Populator::Random::mix(now) & 0x7fffffff));
+	}
+	MakeChunk maker(generators, (quint64)seedBox->value());
+	int window = qMax(QThread::idealThreadCount(), 1) * 2;
+	QVector<Populator::Chunk> chunks[2];
+	int current = 0;
+	qint64 nextRow = 0;
+	nextRow = nextWindow(chunks[current], window, nextRow, rows);
+	QFuture<void> making = QtConcurrent::map(chunks[current], maker);
+	bool stop = false;
+	qint64 row = 0;
+	while (!stop && !chunks[current].isEmpty())
+	{
+		making.waitForFinished();
+		// start on the next window before inserting this one
+		QVector<Populator::Chunk> & ready = chunks[current];
+		current = 1 - current;
+		nextRow = nextWindow(chunks[current], window, nextRow, rows);
+		making = QtConcurrent::map(chunks[current], maker);
+
+		for (int c = 0; !stop && (c < ready.count()); ++c)
 		{
-			QString errtext = tr("Cannot insert values")
-							  + ":<br/><span style=\" color:#ff0000;\">"
-							  + query.lastError().text()
-							  + "<br/></span>" + tr("using sql statement:")
-							  + "<br/><code>" + sql;
-			resultAppend(errtext);
-			if (!constraintBox->isChecked()) { break; }
+			const Populator::Chunk & chunk = ready.at(c);
+			const Populator::Value * v = chunk.values.constData();
+			for (int r = 0; r < chunk.rows; ++r)
+			{
+				for (int j = 0; j < generators.count(); ++j)
+				{
+					Populator::Generator::bind(stmt, j + 1, *v++);
+				}
+				if (sqlite3_step(stmt) == SQLITE_DONE)
+				{
+					inserted += sqlite3_changes(db);
+				}
+				else
+				{
+					// only the first few, there may be millions
+					if (++errors <= MAX_LOGGED_ERRORS)
+					{
+						insertError(tr("Cannot insert values"), sql);
+					}
+					if (!constraintBox->isChecked()) { stop = true; }
+				}
+				sqlite3_reset(stmt);
+				if (stop) { break; }
+
+				++row;
+				if ((row % POPULATOR_BATCH_SIZE) == 0)
+				{
+					// commit what we have if we aren't inside a transaction
+					if (   !execSql("RELEASE POPULATOR;", tr("Cannot release savepoint"))
+						|| !execSql("SAVEPOINT POPULATOR;", tr("Cannot create savepoint")))
+					{
+						failed = true;
+						stop = true;
+						break;
+					}
+					committed = inserted;
+				}
+				if ((row % POPULATOR_PROGRESS_ROWS) == 0)
+				{
+					progress.setValue((int)(row * 1000 / rows));
+					qApp->processEvents();
+					if (m_cancelled) { stop = true; break; }
+				}
+			}
 		}
-		else { m_updated = true; }
 	}
+	// the chunks must outlive the threads making them
+	making.waitForFinished();
+	sqlite3_finalize(stmt);
+	progress.setValue(1000);
 
+	if (failed)
+	{
+		resultAppend(tr(
+			"Database may be left with a pending savepoint."));
+		m_updated = true;
+		return;
+	}
+	if (m_cancelled)
+	{
+		// rows in earlier batches have been committed
+		execSql("ROLLBACK TO POPULATOR;", tr("Cannot roll back after cancel"));
+		inserted = committed;
+		resultAppend(tr("Cancelled"));
+	}
 	if (!execSql("RELEASE POPULATOR;", tr("Cannot release savepoint")))
 	{
 		if (!execSql("ROLLBACK TO POPULATOR;", tr("Cannot roll back either")))
@@ -229,14 +358,26 @@ void PopulatorDialog::populateButton_clicked()
 		m_updated = false;
 		return;
 	}
+	if (errors > MAX_LOGGED_ERRORS)
+	{
+		resultAppend(tr("%n more error(s) not shown", 0,
+						errors - MAX_LOGGED_ERRORS));
+	}
+	if (inserted > 0) { m_updated = true; }
+	resultAppend(tr("Row(s) inserted: %1").arg(inserted));
+}
 
-	cntPost = tableRowCount();
-
-	if (cntPre != -1 && cntPost != -1)
-		resultAppend(tr("Row(s) inserted: %1").arg(cntPost-cntPre));
+void PopulatorDialog::insertError(const QString & message, const QString & sql)
+{
+	QString errtext = message
+					  + ":<br/><span style=\" color:#ff0000;\">"
+					  + QString::fromUtf8(sqlite3_errmsg(Database::sqlite3handle()))
+					  + "<br/></span>" + tr("using sql statement:")
+					  + "<br/><code>" + sql;
+	resultAppend(errtext);
 }
 
-QVariantList PopulatorDialog::autoValues(Populator::PopColumn c)
+bool PopulatorDialog::autoStart(const Populator::PopColumn & c, qint64 & start)
 {
 	QString sql = QString("select max(")
 				  + Utils::q(c.name)
@@ -256,122 +397,11 @@ QVariantList PopulatorDialog::autoValues(Populator::PopColumn c)
 						  + "<br/></span>" + tr("using sql statement:")
 						  + "<br/><code>" + sql;
 		resultAppend(errtext);
-		return QVariantList();
+		return false;
 	}
 
-	int max = 0;
+	start = 0;
 	while(query.next())
-		max = query.value(0).toInt();
-
-	QVariantList ret;
-	for (int i = 0; i < spinBox->value(); ++i)
-		ret.append(i+max+1);
-
-	return ret;
-}
-
-QVariantList PopulatorDialog::autoFromValues(Populator::PopColumn c)
-{
-	int min = c.userValue.toInt();
-
-	QVariantList ret;
-	for (int i = 0; i < spinBox->value(); ++i)
-		ret.append(i + min + 1);
-	return ret;
-}
-
-QVariantList PopulatorDialog::numberValues(Populator::PopColumn c)
-{
-	QVariantList ret;
-	for (int i = 0; i < spinBox->value(); ++i)
-		ret.append(qrand() % (int)pow(10.0, c.size));
-	return ret;
-}
-
-QVariantList PopulatorDialog::textValues(Populator::PopColumn c)
-{
-	QVariantList ret;
-	for (int i = 0; i < spinBox->value(); ++i)
-	{
-		QStringList l;
-		for (int j = 0; j < c.size; ++j)
-			l.append(QChar((qrand() % 58) + 65));
-		ret.append(l.join("")
-				.replace(QRegExp("(\\[|\\'|\\\\|\\]|\\^|\\_|\\`)"), " ")
-				.simplified());
-	}
-	return ret;
-}
-
-QVariantList PopulatorDialog::textPrefixedValues(Populator::PopColumn c)
-{
-	QVariantList ret;
-	for (int i = 0; i < spinBox->value(); ++i)
-		ret.append(c.userValue + QString("%1").arg(i+1));
-	return ret;
-}
-
-QVariantList PopulatorDialog::staticValues(Populator::PopColumn c)
-{
-	QVariantList ret;
-	for (int i = 0; i < spinBox->value(); ++i)
-		ret.append(c.userValue);
-	return ret;
-}
-
-// a helper function used only for PopulatorDialog::dateValues()
-float getJulianFromUnix( int unixSecs )
-{
-	return ( unixSecs / 86400.0 ) + 2440587;
-}
-
-QVariantList PopulatorDialog::dateValues(Populator::PopColumn c)
-{
-	QVariantList ret;
-
-	// prepare some variables to speed up things on the loop
-	// current time
-	QDateTime now(QDateTime::currentDateTime());
-	// timestamp of "now"
-	uint now_tstamp = now.toTime_t();
-	// pseudo random generator init
-	qsrand(now_tstamp);
-
-	for (int i = 0; i < spinBox->value(); ++i)
-	{
-		switch (c.action)
-		{
-			case Populator::T_DT_NOW:
-				ret.append(now.toString("yyyy-MM-dd hh:mm:ss.z"));
-				break;
-			case Populator::T_DT_NOW_UNIX:
-				ret.append(now_tstamp);
-				break;
-			case Populator::T_DT_NOW_JULIAN:
-				ret.append(getJulianFromUnix(now_tstamp));
-				break;
-			case Populator::T_DT_RAND:
-			{
-				QDateTime dt;
-				dt.setTime_t( qrand() % now_tstamp );
-				ret.append(dt.toString("yyyy-MM-dd hh:mm:ss.z"));
-				break;
-			}
-			case Populator::T_DT_RAND_UNIX:
-				ret.append( qrand() % now_tstamp);
-				break;
-			case Populator::T_DT_RAND_JULIAN:
-			{
-				QDateTime dt;
-				dt.setTime_t( qrand() % now_tstamp );
-				ret.append(getJulianFromUnix(dt.toTime_t()));
-				break;
-			}
-			default:
-				QMessageBox::critical(this, "Critical error",
-								   QString("PopulatorDialog::dateValues unknown type %1").arg(c.userValue));
-		} // switch
-	} // for
-
-	return ret;
+		start = query.value(0).toLongLong();
+	return true;
 }
@@ -8,7 +8,7 @@ for which a new license (GPL+exception) is in place.
 #define POPULATORDIALOG_H
 
 #include "ui_populatordialog.h"
-#include "populatorstructs.h"
+#include "populatorgenerator.h"
 #include "database.h"
 
 
@@ -25,11 +25,17 @@ Currently implemented actions:
 T_AUTO: it populates values with max(column)+1 number values
 T_NUMB: random number for column size
 T_TEXT: random text for column size
-T_PREF: prefixed text. See textPrefixedValues() for more info.
+T_PREF: prefixed text: ${prefix}1, ${prefix}2, ..., ${prefix}N
 T_STAT: static value. No computings, only user given string/number.
 T_DT_NOW: datetime now
 T_DT_RAND: random datetime
 T_IGNORE: nothing inserted. It's left for table default/null value.
+
+The values are made a row at a time by Populator::Generator, in chunks on
+all the cores, and bound to one prepared INSERT in row order, committing
+every POPULATOR_BATCH_SIZE rows. The random values depend only on the
+seed, so a run can be repeated exactly. Unless New Seed is unchecked,
+each run takes a new seed from the clock and shows it.
 \author Petr Vanek <petr@scribus.ifno>
 */
 
@@ -56,35 +62,21 @@ class PopulatorDialog : public DialogCommon, // ->QDialog
 		//! Generate the bind part of SQL statement
 		QString sqlBinds();
 
-		//! Create PK values (max()+1)
-		QVariantList autoValues(Populator::PopColumn c);
-		/*! Create auto number from given min value.
-		    It can raise SQL erros if there is some constraint
-		    violated of course.
-		 */
-		QVariantList autoFromValues(Populator::PopColumn c);
-		//! Calculate pseudo-random numbers for given column
-		QVariantList numberValues(Populator::PopColumn c);
-		//! Create a text for given column
-		QVariantList textValues(Populator::PopColumn c);
-		/*! \brief Create a text with prefix for given column.
-		The prefix is specified by user in the PopulatorColumnWidget
-		instance if the c.action is T_PREF. Values are returned as:
-		${prefix}1, ${prefix}2, ..., ${prefix}N */
-		QVariantList textPrefixedValues(Populator::PopColumn c);
-		//! User given value only.
-		QVariantList staticValues(Populator::PopColumn c);
-		
-		//! Get dates dependently on c.action. T_DT_* are supported only.
-		QVariantList dateValues(Populator::PopColumn c);
+		/*! \brief Get MAX() of a T_AUTO column; the values start after it.
+		Reports the error and returns false if it can't. */
+		bool autoStart(const Populator::PopColumn & c, qint64 & start);
+		/*! \brief Set up the next \a count chunks from row \a first,
+		not going past \a rows. Returns the row after them. */
+		qint64 nextWindow(QVector<Populator::Chunk> & chunks, int count,
+						  qint64 first, qint64 rows);
+		//! Report the connection's last error for \a sql
+		void insertError(const QString & message, const QString & sql);
 
-		/*! Performs select count from table to simulate
-		QSqlQuery::numRowsAffected() for execBatch() method (it returns
-		1/0/-1 in the case of execBatch()). */
-		qlonglong tableRowCount();
+		bool m_cancelled;
 
 	private slots:
 		void populateButton_clicked();
+		void cancel();
 		void spinBox_valueChanged(int);
 		//! Set populateButton state (enabled/disabled) as required.
 		void checkActionTypes();
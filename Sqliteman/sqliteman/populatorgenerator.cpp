@@ -0,0 +1,122 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+#include <QtCore/QtGlobal>
+
+#include "populatorgenerator.h"
+
+using namespace Populator;
+
+// a helper function used only for the julian date actions
+static double getJulianFromUnix(qint64 unixSecs)
+{
+	return (unixSecs / 86400.0) + 2440587;
+}
+
+Generator::Generator(const PopColumn & column, qint64 start,
+					 const QDateTime & now)
+	: m_action(column.action),
+	  m_size(column.size),
+	  m_start(start),
+	  m_user(column.userValue.toUtf8())
+{
+	if (m_action == T_AUTO_FROM) { m_start = column.userValue.toLongLong(); }
+	m_modulus = 1;
+	for (int i = 0; (i < m_size) && (m_modulus < Q_INT64_C(100000000000000000)); ++i)
+	{
+		m_modulus *= 10;
+	}
+	m_nowSecs = now.toSecsSinceEpoch();
+	m_nowText = now.toString("yyyy-MM-dd hh:mm:ss.z").toUtf8();
+}
+
+QByteArray Generator::dateText(qint64 secs)
+{
+	return QDateTime::fromSecsSinceEpoch(secs)
+		.toString("yyyy-MM-dd hh:mm:ss.z").toUtf8();
+}
+
+void Generator::value(qint64 row, Value & v, Random & random) const
+{
+	switch (m_action)
+	{
+		case T_AUTO:
+		case T_AUTO_FROM:
+			v.type = SQLITE_INTEGER;
+			v.integer = m_start + row + 1;
+			break;
+		case T_NUMB:
+			v.type = SQLITE_INTEGER;
+			v.integer = (qint64)(random.next() % (quint64)m_modulus);
+			break;
+		case T_TEXT:
+		{
+			v.type = SQLITE_TEXT;
+			v.text.resize(m_size);
+			char * p = v.text.data();
+			for (int j = 0; j < m_size; ++j)
+			{
+				char c = (char)((random.next() % 58) + 65);
+				// [ \ ] ^ _ ` are between the upper and lower case letters
+				p[j] = ((c >= '[') && (c <= '`')) ? ' ' : c;
+			}
+			v.text = v.text.simplified();
+			break;
+		}
+		case T_PREF:
+			v.type = SQLITE_TEXT;
+			v.text = m_user + QByteArray::number(row + 1);
+			break;
+		case T_STAT:
+			v.type = SQLITE_TEXT;
+			v.text = m_user;
+			break;
+		case T_DT_NOW:
+			v.type = SQLITE_TEXT;
+			v.text = m_nowText;
+			break;
+		case T_DT_NOW_UNIX:
+			v.type = SQLITE_INTEGER;
+			v.integer = m_nowSecs;
+			break;
+		case T_DT_NOW_JULIAN:
+			v.type = SQLITE_FLOAT;
+			v.real = getJulianFromUnix(m_nowSecs);
+			break;
+		case T_DT_RAND:
+			v.type = SQLITE_TEXT;
+			v.text = dateText(random.next() % m_nowSecs);
+			break;
+		case T_DT_RAND_UNIX:
+			v.type = SQLITE_INTEGER;
+			v.integer = random.next() % m_nowSecs;
+			break;
+		case T_DT_RAND_JULIAN:
+			v.type = SQLITE_FLOAT;
+			v.real = getJulianFromUnix(random.next() % m_nowSecs);
+			break;
+		default:
+			v.type = SQLITE_NULL;
+			break;
+	}
+}
+
+int Generator::bind(sqlite3_stmt * stmt, int i, const Value & v)
+{
+	switch (v.type)
+	{
+		case SQLITE_INTEGER:
+			return sqlite3_bind_int64(stmt, i, v.integer);
+		case SQLITE_FLOAT:
+			return sqlite3_bind_double(stmt, i, v.real);
+		case SQLITE_TEXT:
+			// v lives until the row has been stepped
+			return sqlite3_bind_text(stmt, i, v.text.constData(),
+									 v.text.size(), SQLITE_STATIC);
+		default:
+			return sqlite3_bind_null(stmt, i);
+	}
+}
@@ -0,0 +1,100 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+#ifndef POPULATORGENERATOR_H
+#define POPULATORGENERATOR_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QDateTime>
+#include <QtCore/QVector>
+
+#include "populatorstructs.h"
+#include "sqlite3.h"
+
+namespace Populator
+{
+	//! \brief One generated value, in the storage class it is bound as
+	typedef struct
+	{
+		int type; //!< SQLITE_INTEGER, SQLITE_FLOAT or SQLITE_TEXT
+		qint64 integer;
+		double real;
+		QByteArray text; //!< UTF-8
+	}
+	Value;
+
+	//! \brief Consecutive rows of values, made together by one thread
+	typedef struct
+	{
+		qint64 first; //!< the first row number
+		int rows;
+		QVector<Value> values; //!< row by row, one for each Generator
+	}
+	Chunk;
+
+	/*! \brief A small seedable pseudo random generator (splitmix64).
+	Unlike qrand() it has no shared state, so each chunk of rows can have
+	its own one seeded from the user's seed and the chunk number: the
+	values then don't depend on which thread makes them or when.
+	*/
+	class Random
+	{
+		public:
+			explicit Random(quint64 seed) : m_state(seed) {}
+
+			quint64 next()
+			{
+				return mix(m_state += Q_UINT64_C(0x9E3779B97F4A7C15));
+			}
+
+			//! \brief Scramble \a z, for deriving seeds
+			static quint64 mix(quint64 z)
+			{
+				z = (z ^ (z >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+				z = (z ^ (z >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+				return z ^ (z >> 31);
+			}
+
+		private:
+			quint64 m_state;
+	};
+
+	/*! \brief Generates the values of one column a row at a time.
+	Nothing is computed in advance: value() works out the value for any
+	row number from the column's action and the caller's Random, so that
+	rows can be inserted as they are made. It is const, so several threads
+	can use one Generator. See PopulatorDialog for the actions.
+	*/
+	class Generator
+	{
+		public:
+			/*! \param column what to generate
+			\param start the current MAX() of the column, used by T_AUTO
+			\param now the time for the T_DT_* actions */
+			Generator(const PopColumn & column, qint64 start,
+					  const QDateTime & now);
+
+			//! \brief Make the value for row \a row (from 0) into \a v
+			void value(qint64 row, Value & v, Random & random) const;
+
+			//! \brief Bind \a v natively to parameter \a i of \a stmt
+			static int bind(sqlite3_stmt * stmt, int i, const Value & v);
+
+		private:
+			static QByteArray dateText(qint64 secs);
+
+			int m_action;
+			int m_size;
+			qint64 m_start;
+			//! \brief 10^size for T_NUMB, limited to what fits
+			qint64 m_modulus;
+			QByteArray m_user;
+			qint64 m_nowSecs;
+			QByteArray m_nowText;
+	};
+}; // namespace
+
+#endif
@@ -53,6 +53,11 @@ Preferences::Preferences(QObject *parent)
 	m_lastDB = s.value("lastDatabase", QString()).toString();
 	m_lastSqlFile = s.value("lastSqlFile", QString()).toString();
     m_extensionDirectory = s.value("extensionDirectory", QString()).toString();
+    m_sqlFileResume = s.value("sqlfile/resume", QString()).toString();
+    m_sqlFileResumeOffset = s.value("sqlfile/resumeoffset", 0).toLongLong();
+    m_sqlFileResumeSize = s.value("sqlfile/resumesize", 0).toLongLong();
+    m_sqlFileResumeModified =
+        s.value("sqlfile/resumemodified", 0).toLongLong();
     m_recentFiles = s.value("recentDocs/files").toStringList();
 	m_newInItemView = s.value("prefs/openNewInItemView", false).toBool();
     m_prefillNew = s.value("prefs/prefillNew", false).toBool();
@@ -75,6 +80,7 @@ Preferences::Preferences(QObject *parent)
         "prefs/sqleditor/useCodeCompletion", false).toBool();
 	m_codeCompletionLength = s.value(
         "prefs/sqleditor/completionLengthBox", 3).toInt();
+	m_queryLint = s.value("prefs/sqleditor/useQueryLint", true).toBool();
 	m_useShortcuts = s.value("prefs/sqleditor/useShortcuts", false).toBool();
 	m_shortcuts = s.value(
         "prefs/sqleditor/shortcuts", QMap<QString,QVariant>()).toMap();
@@ -103,6 +109,13 @@ Preferences::Preferences(QObject *parent)
 	m_exportHeaders = s.value("dataExport/headers", true).toBool();
 	m_exportEncoding = s.value("dataExport/encoding", "UTF-8").toString();
 	m_exportEol = s.value("dataExport/eol", 0).toInt();
+	// data import
+	m_importCheckpoint = s.value("dataImport/checkpoint", 10000).toInt();
+	m_importResume = s.value("dataImport/resume", QString()).toString();
+	m_importResumeOffset = s.value("dataImport/resumeoffset", 0).toLongLong();
+	m_importResumeRow = s.value("dataImport/resumerow", 0).toInt();
+	// incremental dumps
+	m_recordChanges = s.value("changesets/record", false).toBool();
     // extensions
     m_allowExtensionLoading = s.value("extensions/allowLoading", true).toBool();
     m_extensionList = s.value("extensions/list", QStringList()).toStringList();
@@ -128,6 +141,8 @@ Preferences::Preferences(QObject *parent)
     m_dataexportWidth = s.value("dataexport/width", 600).toInt();
     m_dataviewerHeight = s.value("dataviewer/height", 500).toInt();
     m_dataviewerWidth = s.value("dataviewer/width", 600).toInt();
+    m_explainanalyzeHeight = s.value("explainanalyze/height", 500).toInt();
+    m_explainanalyzeWidth = s.value("explainanalyze/width", 800).toInt();
     m_finddialogHeight = s.value("finddialog/height", 500).toInt();
     m_finddialogWidth = s.value("finddialog/width", 600).toInt();
     m_helpHeight = s.value("help/height", 500).toInt();
@@ -136,6 +151,8 @@ Preferences::Preferences(QObject *parent)
     m_importtableWidth = s.value("importtable/width", 600).toInt();
     m_importtablelogHeight = s.value("importtablelog/height", 500).toInt();
     m_importtablelogWidth = s.value("importtablelog/width", 600).toInt();
+    m_indexadvisorHeight = s.value("indexadvisor/height", 500).toInt();
+    m_indexadvisorWidth = s.value("indexadvisor/width", 700).toInt();
     m_litemanwindowHeight = s.value("litemanwindow/height", 500).toInt();
     m_litemanwindowWidth = s.value("litemanwindow/width", 600).toInt();
     m_multieditHeight = s.value("multiedit/height", 500).toInt();
@@ -161,6 +178,8 @@ Preferences::Preferences(QObject *parent)
     m_sqlsplitterState 
         = s.value("sqleditor/splitter", QByteArray()).toByteArray();
     m_sqleditorState = s.value("sqleditorstate", QByteArray()).toByteArray();
+    m_scriptTransaction =
+        s.value("sqleditor/scripttransaction", false).toBool();
 }
 
 Preferences::~Preferences()
@@ -177,6 +196,10 @@ Preferences::~Preferences()
     settings.setValue("lastDatabase", m_lastDB);
     settings.setValue("lastSqlFile", m_lastSqlFile);
     settings.setValue("extensionDirectory", m_extensionDirectory);
+    settings.setValue("sqlfile/resume", m_sqlFileResume);
+    settings.setValue("sqlfile/resumeoffset", m_sqlFileResumeOffset);
+    settings.setValue("sqlfile/resumesize", m_sqlFileResumeSize);
+    settings.setValue("sqlfile/resumemodified", m_sqlFileResumeModified);
 	settings.setValue("recentDocs/files", m_recentFiles);
 	settings.setValue("prefs/openNewInItemView", m_newInItemView);
     settings.setValue("prefs/prefillNew", m_prefillNew);
@@ -198,6 +221,7 @@ Preferences::~Preferences()
 	settings.setValue("prefs/sqleditor/textWidthMarkSpinBox", m_textWidthMarkSize);
 	settings.setValue("prefs/sqleditor/useCodeCompletion", m_codeCompletion);
 	settings.setValue("prefs/sqleditor/completionLengthBox", m_codeCompletionLength);
+	settings.setValue("prefs/sqleditor/useQueryLint", m_queryLint);
 	settings.setValue("prefs/sqleditor/useShortcuts", m_useShortcuts);
 	settings.setValue("prefs/sqleditor/shortcuts", m_shortcuts);
 	// qscintilla editor
@@ -214,6 +238,13 @@ Preferences::~Preferences()
 	settings.setValue("dataExport/headers", m_exportHeaders);
 	settings.setValue("dataExport/encoding", m_exportEncoding);
 	settings.setValue("dataExport/eol", m_exportEol);
+	// data import
+	settings.setValue("dataImport/checkpoint", m_importCheckpoint);
+	settings.setValue("dataImport/resume", m_importResume);
+	settings.setValue("dataImport/resumeoffset", m_importResumeOffset);
+	settings.setValue("dataImport/resumerow", m_importResumeRow);
+	// incremental dumps
+	settings.setValue("changesets/record", m_recordChanges);
     // extensions
     settings.setValue("extensions/allowLoading", m_allowExtensionLoading);
     settings.setValue("extensions/list", m_extensionList);
@@ -239,6 +270,8 @@ Preferences::~Preferences()
     settings.setValue("dataexport/width", m_dataexportWidth);
     settings.setValue("dataviewer/height", m_dataviewerHeight);
     settings.setValue("dataviewer/width", m_dataviewerWidth);
+    settings.setValue("explainanalyze/height", m_explainanalyzeHeight);
+    settings.setValue("explainanalyze/width", m_explainanalyzeWidth);
     settings.setValue("finddialog/height", m_finddialogHeight);
     settings.setValue("finddialog/width", m_finddialogWidth);
     settings.setValue("help/height", m_helpHeight);
@@ -247,6 +280,8 @@ Preferences::~Preferences()
     settings.setValue("importtable/width", m_importtableWidth);
     settings.setValue("importtablelog/height", m_importtablelogHeight);
     settings.setValue("importtablelog/width", m_importtablelogWidth);
+    settings.setValue("indexadvisor/height", m_indexadvisorHeight);
+    settings.setValue("indexadvisor/width", m_indexadvisorWidth);
     settings.setValue("litemanwindow/height", m_litemanwindowHeight);
     settings.setValue("litemanwindow/width", m_litemanwindowWidth);
     settings.setValue("multiedit/height", m_multieditHeight);
@@ -268,6 +303,7 @@ Preferences::~Preferences()
     settings.setValue("help/splitter", m_helpsplitterState);
     settings.setValue("window/splitter", m_litemansplitterState);
     settings.setValue("sqleditorstate", m_sqleditorState);
+    settings.setValue("sqleditor/scripttransaction", m_scriptTransaction);
 }
 
 Preferences* Preferences::instance()
@@ -281,3 +317,28 @@ void Preferences::deleteInstance()
     if (_instance) { delete _instance; }
     _instance = 0;
 }
+
+void Preferences::setImportResume(const QString & key, qint64 offset, int row)
+{
+    m_importResume = key;
+    m_importResumeOffset = offset;
+    m_importResumeRow = row;
+    QSettings settings("yarpen.cz", "sqliteman");
+    settings.setValue("dataImport/resume", m_importResume);
+    settings.setValue("dataImport/resumeoffset", m_importResumeOffset);
+    settings.setValue("dataImport/resumerow", m_importResumeRow);
+}
+
+void Preferences::setSqlFileResume(const QString & fileName, qint64 offset,
+                                   qint64 size, qint64 modified)
+{
+    m_sqlFileResume = fileName;
+    m_sqlFileResumeOffset = offset;
+    m_sqlFileResumeSize = size;
+    m_sqlFileResumeModified = modified;
+    QSettings settings("yarpen.cz", "sqliteman");
+    settings.setValue("sqlfile/resume", m_sqlFileResume);
+    settings.setValue("sqlfile/resumeoffset", m_sqlFileResumeOffset);
+    settings.setValue("sqlfile/resumesize", m_sqlFileResumeSize);
+    settings.setValue("sqlfile/resumemodified", m_sqlFileResumeModified);
+}
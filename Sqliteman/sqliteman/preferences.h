@@ -71,6 +71,17 @@ class Preferences : public QObject
         void setlastSqlFile(QString v) { m_lastSqlFile = v; }
         QString extensionDirectory() { return m_extensionDirectory; }
         void setextensionDirectory(QString v) { m_extensionDirectory = v; }
+        /*! \brief An SQL file which wasn't executed to the end,
+        where to resume it, and how big it was and when it was last
+        modified (in ms since the epoch) then */
+        QString sqlFileResume() { return m_sqlFileResume; }
+        qint64 sqlFileResumeOffset() { return m_sqlFileResumeOffset; }
+        qint64 sqlFileResumeSize() { return m_sqlFileResumeSize; }
+        qint64 sqlFileResumeModified() { return m_sqlFileResumeModified; }
+        /*! \brief Record how much of an SQL file was committed. Like
+        setImportResume() this is written out at once. */
+        void setSqlFileResume(const QString & fileName, qint64 offset,
+                              qint64 size, qint64 modified);
         QStringList recentFiles() { return m_recentFiles; }
         void setrecentFIles(QStringList v) { m_recentFiles = v; }
 		
@@ -121,6 +132,9 @@ class Preferences : public QObject
 		int codeCompletionLength() { return m_codeCompletionLength; }
 		void setCodeCompletionLength(int v) { m_codeCompletionLength = v; }
 
+		bool queryLint() { return m_queryLint; }
+		void setQueryLint(bool v) { m_queryLint = v; }
+
 		bool useShortcuts() { return m_useShortcuts; }
 		void setUseShortcuts(bool v) { m_useShortcuts = v; }
 
@@ -146,6 +160,22 @@ class Preferences : public QObject
 		int exportEol() { return m_exportEol; }
 		void setExportEol(int v) { m_exportEol = v; }
 
+		// data import
+		int importCheckpoint() { return m_importCheckpoint; }
+		void setImportCheckpoint(int v) { m_importCheckpoint = v; }
+		/*! \brief The import which was interrupted after a checkpoint,
+		where to resume it, and how many rows it had done */
+		QString importResume() { return m_importResume; }
+		qint64 importResumeOffset() { return m_importResumeOffset; }
+		int importResumeRow() { return m_importResumeRow; }
+		/*! \brief Record a checkpoint. Unlike other preferences this is
+		written out at once, since it's needed after a crash. */
+		void setImportResume(const QString & key, qint64 offset, int row);
+
+		// incremental dumps
+		bool recordChanges() { return m_recordChanges; }
+		void setRecordChanges(bool v) { m_recordChanges = v; }
+
 		// qscintilla syntax
 		QColor syDefaultColor() { return m_syDefaultColor; }
 		void setSyDefaultColor(const QColor & v ) { m_syDefaultColor = v; }
@@ -214,6 +244,10 @@ class Preferences : public QObject
         void setdataviewerHeight(int v) { m_dataviewerHeight = v; }
         int dataviewerWidth() { return m_dataviewerWidth; }
         void setdataviewerWidth(int v) { m_dataviewerWidth = v; }
+        int explainanalyzeHeight() { return m_explainanalyzeHeight; }
+        void setexplainanalyzeHeight(int v) { m_explainanalyzeHeight = v; }
+        int explainanalyzeWidth() { return m_explainanalyzeWidth; }
+        void setexplainanalyzeWidth(int v) { m_explainanalyzeWidth = v; }
         int finddialogHeight() { return m_finddialogHeight; }
         void setfinddialogHeight(int v) { m_finddialogHeight = v; }
         int finddialogWidth() { return m_finddialogWidth; }
@@ -230,6 +264,10 @@ class Preferences : public QObject
         void setimporttablelogHeight(int v) { m_importtablelogHeight = v; }
         int importtablelogWidth() { return m_importtablelogWidth; }
         void setimporttablelogWidth(int v) { m_importtablelogWidth = v; }
+        int indexadvisorHeight() { return m_indexadvisorHeight; }
+        void setindexadvisorHeight(int v) { m_indexadvisorHeight = v; }
+        int indexadvisorWidth() { return m_indexadvisorWidth; }
+        void setindexadvisorWidth(int v) { m_indexadvisorWidth = v; }
         int litemanwindowHeight() { return m_litemanwindowHeight; }
         void setlitemanwindowHeight(int v) { m_litemanwindowHeight = v; }
         int litemanwindowWidth() { return m_litemanwindowWidth; }
@@ -276,6 +314,8 @@ class Preferences : public QObject
         void setsqlsplitter(QByteArray v) { m_sqlsplitterState = v; }
         QByteArray sqleditorState() { return m_sqleditorState; }
         void setsqleditorState(QByteArray v) { m_sqleditorState = v; }
+        bool scriptTransaction() { return m_scriptTransaction; }
+        void setscriptTransaction(bool v) { m_scriptTransaction = v; }
 
 	signals:
 		void prefsChanged();
@@ -301,6 +341,10 @@ class Preferences : public QObject
 		QString m_lastDB;
         QString m_lastSqlFile;
         QString m_extensionDirectory;
+        QString m_sqlFileResume;
+        qint64 m_sqlFileResumeOffset;
+        qint64 m_sqlFileResumeSize;
+        qint64 m_sqlFileResumeModified;
         QStringList m_recentFiles;
 		bool m_newInItemView;
         bool m_prefillNew;
@@ -316,6 +360,7 @@ class Preferences : public QObject
 		int m_textWidthMarkSize;
 		bool m_codeCompletion;
 		int m_codeCompletionLength;
+		bool m_queryLint;
 		bool m_useShortcuts;
 		QMap<QString,QVariant> m_shortcuts;
 		// qscintilla syntax
@@ -330,6 +375,13 @@ class Preferences : public QObject
 		bool m_exportHeaders;
 		QString m_exportEncoding;
 		int m_exportEol;
+		// data import
+		int m_importCheckpoint;
+		QString m_importResume;
+		qint64 m_importResumeOffset;
+		int m_importResumeRow;
+		// incremental dumps
+		bool m_recordChanges;
         // extensions
         bool m_allowExtensionLoading;
         QStringList m_extensionList;
@@ -355,6 +407,8 @@ class Preferences : public QObject
         int m_dataexportWidth;
         int m_dataviewerHeight;
         int m_dataviewerWidth;
+        int m_explainanalyzeHeight;
+        int m_explainanalyzeWidth;
         int m_finddialogHeight;
         int m_finddialogWidth;
         int m_helpHeight;
@@ -363,6 +417,8 @@ class Preferences : public QObject
         int m_importtableWidth;
         int m_importtablelogHeight;
         int m_importtablelogWidth;
+        int m_indexadvisorHeight;
+        int m_indexadvisorWidth;
         int m_litemanwindowHeight;
         int m_litemanwindowWidth;
         int m_multieditHeight;
@@ -385,6 +441,7 @@ class Preferences : public QObject
         QByteArray m_litemansplitterState;
         QByteArray m_sqlsplitterState;
         QByteArray m_sqleditorState;
+        bool m_scriptTransaction;
 
 		// used in MultieditDialog
 		QString m_dateTimeFormat;
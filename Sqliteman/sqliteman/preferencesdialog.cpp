@@ -243,6 +243,7 @@ PreferencesDialog::PreferencesDialog(QWidget * parent)
 	m_prefsSQL->textWidthMarkSpinBox->setValue(m_prefs->textWidthMarkSize());
 	m_prefsSQL->useCompletionCheck->setChecked(m_prefs->codeCompletion());
 	m_prefsSQL->completionLengthBox->setValue(m_prefs->codeCompletionLength());
+	m_prefsSQL->useQueryLintCheck->setChecked(m_prefs->queryLint());
 	m_prefsSQL->useShortcutsBox->setChecked(m_prefs->useShortcuts());
 
 	m_syDefaultColor = m_prefs->syDefaultColor();
@@ -293,6 +294,7 @@ bool PreferencesDialog::saveSettings()
 	m_prefs->setTextWidthMarkSize(m_prefsSQL->textWidthMarkSpinBox->value());
 	m_prefs->setCodeCompletion(m_prefsSQL->useCompletionCheck->isChecked());
 	m_prefs->setCodeCompletionLength(m_prefsSQL->completionLengthBox->value());
+	m_prefs->setQueryLint(m_prefsSQL->useQueryLintCheck->isChecked());
 	m_prefs->setUseShortcuts(m_prefsSQL->useShortcutsBox->isChecked());
 	// qscintilla
 	m_prefs->setSyDefaultColor(m_syDefaultColor);
@@ -337,6 +339,7 @@ void PreferencesDialog::restoreDefaults()
 	m_prefsSQL->textWidthMarkSpinBox->setValue(75);
 	m_prefsSQL->useCompletionCheck->setChecked(false);
 	m_prefsSQL->completionLengthBox->setValue(3);
+	m_prefsSQL->useQueryLintCheck->setChecked(true);
 	m_prefsSQL->useShortcutsBox->setChecked(false);
 	//
 	QsciLexerSQL syntaxLexer;
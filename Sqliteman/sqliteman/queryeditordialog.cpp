@@ -8,7 +8,6 @@ for which a new license (GPL+exception) is in place.
 #include <QScrollBar>
 #include <QComboBox>
 #include <QLineEdit>
-#include <QTreeWidgetItem>
 
 #include "preferences.h"
 #include "queryeditordialog.h"
@@ -36,7 +35,7 @@ QueryEditorDialog::~QueryEditorDialog()
     prefs->setqueryeditorWidth(width());
 }
 
-void QueryEditorDialog::setItem(QTreeWidgetItem * item)
+void QueryEditorDialog::setItem(SchemaItem * item)
 {
     QString databaseName;
     bool schemaMayChange;
@@ -92,7 +91,7 @@ void QueryEditorDialog::tableCreated()
 	ui.queryEditor->resetTableList();
 }
 
-void QueryEditorDialog::tableAltered(QString oldName, QTreeWidgetItem * item)
+void QueryEditorDialog::tableAltered(QString oldName, SchemaItem * item)
 {
 	ui.queryEditor->tableGone(oldName, item->text(0));
 }
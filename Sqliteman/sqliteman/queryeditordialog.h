@@ -8,7 +8,7 @@ for which a new license (GPL+exception) is in place.
 #ifndef QUERYEDITORDIALOG_H
 #define QUERYEDITORDIALOG_H
 
-class QTreeWidgetItem;
+class SchemaItem;
 
 #include "database.h"
 #include "ui_queryeditordialog.h"
@@ -30,7 +30,7 @@ class QueryEditorDialog : public QDialog
 		 */
 		QueryEditorDialog(QWidget * parent = 0);
 		~QueryEditorDialog();
-		void setItem(QTreeWidgetItem * item);
+		void setItem(SchemaItem * item);
 		//! \brief generates a valid SQL statement using the values in the dialog
 		QString statement(bool elide);
 		QString deleteStatement();
@@ -40,7 +40,7 @@ class QueryEditorDialog : public QDialog
                        bool schemaMayChange, bool tableMayChange);
 		void schemaAdded(QString schema);
 		void tableCreated();
-		void tableAltered(QString oldName, QTreeWidgetItem * item);
+		void tableAltered(QString oldName, SchemaItem * item);
 		void tableDropped(QString oldName);
 		void schemaGone(QString schema);
 		void resetSchemaList();
@@ -0,0 +1,513 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QMap>
+#include <QtCore/QRegExp>
+
+#include "database.h"
+#include "preferences.h"
+#include "querylint.h"
+#include "scriptrunner.h"
+#include "sqleditorwidget.h"
+#include "utils.h"
+
+// How long the editor must be still before the statement is planned, in ms
+#define LINT_DELAY 500
+// Fewer rows than this are quick to read, whatever the plan
+#define LINT_LARGE_ROWS 10000
+// How long the reader waits for a lock held by another connection, in ms
+#define LINT_BUSY_TIMEOUT 500
+
+struct LintReader
+{
+	sqlite3 * db;
+	QString databases; // what it has open, to see when that changes
+};
+
+namespace {
+	/*! \brief The first column of the first row of \a sql with \a arg
+	bound to ?1, or null if there is none */
+	QString value(sqlite3 * db, const QString & sql, const QString & arg)
+	{
+		QByteArray query(sql.toUtf8());
+		QByteArray bound(arg.toUtf8());
+		sqlite3_stmt * stmt = 0;
+		QString result;
+		if (sqlite3_prepare_v2(db, query.constData(), -1, &stmt, 0)
+			== SQLITE_OK)
+		{
+			sqlite3_bind_text(stmt, 1, bound.constData(), bound.size(),
+							  SQLITE_STATIC);
+			if (sqlite3_step(stmt) == SQLITE_ROW)
+			{
+				const char * text = (const char *)sqlite3_column_text(stmt, 0);
+				if (text) { result = QString::fromUtf8(text); }
+			}
+		}
+		sqlite3_finalize(stmt);
+		return result;
+	}
+
+	int compareBinary(void * context, int n1, const void * s1,
+					  int n2, const void * s2)
+	{
+		Q_UNUSED(context);
+		int rc = memcmp(s1, s2, qMin(n1, n2));
+		return rc ? rc : n1 - n2;
+	}
+
+	void collationNeeded(void * context, sqlite3 * db, int rep,
+						 const char * name)
+	{
+		Q_UNUSED(context);
+		Q_UNUSED(rep);
+		// LOCALIZED is only on the GUI's connection: any order will do
+		sqlite3_create_collation(db, name, SQLITE_UTF8, 0, compareBinary);
+	}
+
+	bool moreRows(const LintNote & a, const LintNote & b)
+	{
+		return a.rows > b.rows;
+	}
+
+	//! \brief Plans a statement on QueryLint's worker thread
+	class PlanStatement
+	{
+		public:
+			typedef LintResult result_type;
+
+			PlanStatement(LintReader * reader, const DbAttach & databases,
+						  const LintResult & result)
+				: m_reader(reader), m_databases(databases), m_result(result) {}
+
+			LintResult operator()()
+			{
+				LintResult result(m_result);
+				QString databases;
+				DbAttach::const_iterator i;
+				for (i = m_databases.constBegin();
+					 i != m_databases.constEnd(); ++i)
+				{
+					databases += i.key() + "=" + i.value() + "\n";
+				}
+				if (m_reader->db && (m_reader->databases != databases))
+				{
+					sqlite3_close(m_reader->db);
+					m_reader->db = 0;
+				}
+				if (!m_reader->db && !open(databases)) { return result; }
+				QueryLint::plan(m_reader->db, result);
+				return result;
+			}
+
+		private:
+			bool open(const QString & databases)
+			{
+				QByteArray file(m_databases.value("main").toUtf8());
+				if (sqlite3_open_v2(file.constData(), &m_reader->db,
+									SQLITE_OPEN_READONLY, 0) != SQLITE_OK)
+				{
+					sqlite3_close(m_reader->db);
+					m_reader->db = 0;
+					return false;
+				}
+				sqlite3_busy_timeout(m_reader->db, LINT_BUSY_TIMEOUT);
+				sqlite3_collation_needed(m_reader->db, 0, collationNeeded);
+				// attached the same way, so read only too
+				DbAttach::const_iterator i;
+				for (i = m_databases.constBegin();
+					 i != m_databases.constEnd(); ++i)
+				{
+					if (i.key() != "main")
+					{
+						value(m_reader->db, QString("ATTACH ?1 AS %1;")
+											.arg(Utils::q(i.key())),
+							  i.value());
+					}
+				}
+				m_reader->databases = databases;
+				return true;
+			}
+
+			LintReader * m_reader;
+			DbAttach m_databases;
+			LintResult m_result;
+	};
+}
+
+
+QueryLint::QueryLint(SqlEditorWidget * editor, QObject * parent)
+	: QObject(parent),
+	  m_editor(editor),
+	  m_enabled(false),
+	  m_generation(0),
+	  m_busy(false)
+{
+	m_reader = new LintReader;
+	m_reader->db = 0;
+	m_pool.setMaxThreadCount(1);
+	m_timer.setSingleShot(true);
+	m_timer.setInterval(LINT_DELAY);
+	connect(&m_timer, SIGNAL(timeout()), this, SLOT(check()));
+	connect(editor, SIGNAL(textChanged()), this, SLOT(textChanged()));
+	connect(editor, SIGNAL(cursorPositionChanged(int, int)),
+			this, SLOT(schedule()));
+	prefsChanged();
+}
+
+QueryLint::~QueryLint()
+{
+	closeReader();
+	delete m_reader;
+}
+
+void QueryLint::closeReader()
+{
+	// a result still to come is from before, so it'll be ignored
+	++m_generation;
+	m_pool.waitForDone();
+	sqlite3_close(m_reader->db);
+	m_reader->db = 0;
+	m_reader->databases.clear();
+	// check again whatever is open next
+	schedule();
+}
+
+void QueryLint::schedule()
+{
+	if (m_enabled) { m_timer.start(); }
+}
+
+void QueryLint::prefsChanged()
+{
+	m_enabled = Preferences::instance()->queryLint();
+	if (m_enabled) { schedule(); }
+	else
+	{
+		m_timer.stop();
+		LintResult none;
+		none.from = -1;
+		none.generation = m_generation;
+		show(none);
+	}
+}
+
+void QueryLint::textChanged()
+{
+	++m_generation;
+	schedule();
+}
+
+QString QueryLint::plannable(const QString & sql)
+{
+	QString s(sql);
+	while (true)
+	{
+		s = s.trimmed();
+		if (s.startsWith("--"))
+		{
+			int eol = s.indexOf('\n');
+			s = (eol < 0) ? QString() : s.mid(eol + 1);
+		}
+		else if (s.startsWith("/*"))
+		{
+			int end = s.indexOf("*/");
+			s = (end < 0) ? QString() : s.mid(end + 2);
+		}
+		else { break; }
+	}
+	QRegExp reads("^(SELECT|WITH|INSERT|UPDATE|DELETE|REPLACE|VALUES)\\b",
+				  Qt::CaseInsensitive);
+	return (reads.indexIn(s) == 0) ? s : QString();
+}
+
+void QueryLint::check()
+{
+	if (m_busy)
+	{
+		// try again when that one is done
+		schedule();
+		return;
+	}
+	QByteArray text(m_editor->text().toUtf8());
+	int cursor = int(m_editor->SendScintilla(
+		QsciScintilla::SCI_GETCURRENTPOS));
+	const char * begin = text.constData();
+	const char * end = begin + text.size();
+	// the statement the cursor is in or after, or the one before if
+	// there is nothing there yet
+	const char * from = begin;
+	const char * to = begin;
+	for (const char * p = begin; p < end; )
+	{
+		const char * next = ScriptRunner::statementEnd(p, end);
+		const char * start = p;
+		while ((start < next) && isspace((unsigned char)*start)) { ++start; }
+		if ((start < next) && (start - begin <= cursor))
+		{
+			from = start;
+			to = next;
+		}
+		if (next - begin >= cursor) { break; }
+		p = next;
+	}
+
+	LintResult result;
+	result.sql = QString::fromUtf8(from, to - from).trimmed();
+	result.from = from - begin;
+	result.generation = m_generation;
+
+	// the reader only sees what has been committed to files
+	DbAttach databases;
+	if (Database::sqlite3handle() && Database::isAutoCommit())
+	{
+		databases = Database::getDatabases();
+		databases.remove("temp");
+	}
+	if (   plannable(result.sql).isNull()
+		|| databases.value("main").isEmpty())
+	{
+		show(result);
+		return;
+	}
+	QMutableMapIterator<QString, QString> i(databases);
+	while (i.hasNext())
+	{
+		if (i.next().value().isEmpty()) { i.remove(); }
+	}
+
+	m_busy = true;
+	QFutureWatcher<LintResult> * watcher =
+		new QFutureWatcher<LintResult>(this);
+	connect(watcher, SIGNAL(finished()), this, SLOT(checked()));
+	watcher->setFuture(QtConcurrent::run(&m_pool,
+		PlanStatement(m_reader, databases, result)));
+}
+
+void QueryLint::checked()
+{
+	QFutureWatcher<LintResult> * watcher =
+		static_cast<QFutureWatcher<LintResult> *>(sender());
+	LintResult result = watcher->result();
+	watcher->deleteLater();
+	m_busy = false;
+	if (result.generation != m_generation)
+	{
+		// the text has changed since, so the offsets are wrong
+		schedule();
+		return;
+	}
+	show(result);
+}
+
+void QueryLint::show(const LintResult & result)
+{
+	m_editor->clearLint();
+	// by line, what to say under it
+	QMap<int, QStringList> lines;
+	int line, index;
+	foreach (const LintNote & note, result.notes)
+	{
+		QRegExp pattern(note.pattern, Qt::CaseInsensitive);
+		int first = -1;
+		for (int pos = 0;
+			 !note.pattern.isEmpty()
+			 && ((pos = pattern.indexIn(result.sql, pos)) >= 0);
+			 pos += qMax(pattern.matchedLength(), 1))
+		{
+			int start = result.from + result.sql.left(pos).toUtf8().size();
+			int length = pattern.cap(0).toUtf8().size();
+			m_editor->markLint(start, length);
+			if (first < 0) { first = start; }
+		}
+		m_editor->lineIndexFromPosition((first < 0) ? result.from : first,
+										&line, &index);
+		lines[line].append(note.message);
+	}
+	QMap<int, QStringList>::const_iterator i;
+	for (i = lines.constBegin(); i != lines.constEnd(); ++i)
+	{
+		m_editor->annotateLint(i.key(), i.value().join("\n"));
+	}
+}
+
+QString QueryLint::describe(const TableSize & size)
+{
+	return size.atLeast ? tr("more than %L1 rows").arg(size.rows)
+						: tr("about %L1 rows").arg(size.rows);
+}
+
+void QueryLint::countRows(sqlite3 * db, TableSize & size)
+{
+	// only as far as it takes to know that it's large
+	QString count(value(db, QString("SELECT count(*) FROM "
+									"(SELECT 1 FROM %1.%2 LIMIT %3);")
+							.arg(Utils::q(size.schema), Utils::q(size.name))
+							.arg(LINT_LARGE_ROWS + 1), QString()));
+	bool ok;
+	size.rows = count.toLongLong(&ok);
+	if (!ok) { size.rows = -1; }
+	size.atLeast = (size.rows > LINT_LARGE_ROWS);
+	if (size.atLeast) { size.rows = LINT_LARGE_ROWS; }
+}
+
+bool QueryLint::findTable(sqlite3 * db, const QString & schema,
+						  const QString & name, TableSize & size)
+{
+	QStringList schemas;
+	if (!schema.isEmpty()) { schemas.append(schema); }
+	else
+	{
+		// the order sqlite looks in, less temp which the reader hasn't
+		sqlite3_stmt * stmt = 0;
+		if (sqlite3_prepare_v2(db, "PRAGMA database_list;", -1, &stmt, 0)
+			== SQLITE_OK)
+		{
+			while (sqlite3_step(stmt) == SQLITE_ROW)
+			{
+				schemas.append(QString::fromUtf8(
+					(const char *)sqlite3_column_text(stmt, 1)));
+			}
+		}
+		sqlite3_finalize(stmt);
+	}
+	foreach (const QString & s, schemas)
+	{
+		QString found(value(db, QString("SELECT name FROM %1.sqlite_master "
+										"WHERE type = 'table' "
+										"AND name = ?1 COLLATE NOCASE "
+										"AND sql NOT LIKE 'CREATE VIRTUAL%';")
+								.arg(Utils::q(s)), name));
+		if (found.isNull()) { continue; }
+		size.schema = s;
+		size.name = found;
+		// the first number is the rows in the table, whichever index
+		QString stat(value(db, QString("SELECT stat FROM %1.sqlite_stat1 "
+									   "WHERE tbl = ?1 LIMIT 1;")
+							   .arg(Utils::q(s)), found));
+		bool ok = false;
+		size.rows = stat.section(' ', 0, 0).toLongLong(&ok);
+		size.atLeast = false;
+		if (!ok) { countRows(db, size); }
+		return size.rows >= 0;
+	}
+	return false;
+}
+
+bool QueryLint::tableSize(sqlite3 * db, const QString & sql,
+						  const QString & name, TableSize & size)
+{
+	if (findTable(db, QString(), name, size)) { return true; }
+	// attached tables are shown as schema.table
+	if (   name.contains('.')
+		&& findTable(db, name.section('.', 0, 0), name.section('.', 1),
+					 size))
+	{
+		return true;
+	}
+	// or it's an alias: look for "table [AS] name" in the statement
+	QRegExp alias("([\\w\"`\\[\\].]+)\\s+(?:AS\\s+)?"
+				  + QRegExp::escape(name) + "\\b", Qt::CaseInsensitive);
+	for (int pos = 0; (pos = alias.indexIn(sql, pos)) >= 0;
+		 pos += alias.matchedLength())
+	{
+		QString table(alias.cap(1));
+		table.remove(QRegExp("[\"`\\[\\]]"));
+		QString schema;
+		if (table.contains('.'))
+		{
+			schema = table.section('.', 0, 0);
+			table = table.section('.', 1);
+		}
+		if (findTable(db, schema, table, size)) { return true; }
+	}
+	return false;
+}
+
+bool QueryLint::plan(sqlite3 * db, LintResult & result)
+{
+	result.notes.clear();
+	QByteArray sql(("EXPLAIN QUERY PLAN " + result.sql).toUtf8());
+	sqlite3_stmt * stmt = 0;
+	if (sqlite3_prepare_v2(db, sql.constData(), -1, &stmt, 0) != SQLITE_OK)
+	{
+		// not finished typing, or uses something the reader hasn't got
+		sqlite3_finalize(stmt);
+		return false;
+	}
+	QStringList lines;
+	while (stmt && (sqlite3_step(stmt) == SQLITE_ROW))
+	{
+		lines.append(QString::fromUtf8(
+			(const char *)sqlite3_column_text(stmt, 3)));
+	}
+	sqlite3_finalize(stmt);
+
+	// older sqlite says SCAN TABLE t AS a, newer just SCAN a
+	QRegExp scan("^(SCAN|SEARCH)( TABLE)? (\\S+)( AS (\\S+))?");
+	QRegExp sort("^USE TEMP B-TREE FOR (.*)$");
+	TableSize largest;
+	largest.rows = -1;
+	foreach (const QString & line, lines)
+	{
+		LintNote note;
+		if (scan.indexIn(line) == 0)
+		{
+			bool full = (scan.cap(1) == "SCAN");
+			bool automatic = line.contains("AUTOMATIC");
+			if (   (!full && !automatic) || line.contains("VIRTUAL TABLE")
+				|| (line == "SCAN CONSTANT ROW"))
+			{
+				continue;
+			}
+			TableSize size;
+			if (   !tableSize(db, result.sql, scan.cap(3), size)
+				|| (size.rows < LINT_LARGE_ROWS))
+			{
+				continue;
+			}
+			if (full && (size.rows > largest.rows)) { largest = size; }
+			note.rows = size.rows;
+			note.message = full
+				? tr("%1: reads all of %2").arg(line, describe(size))
+				: tr("%1: indexes %2 every time").arg(line, describe(size));
+			QString name(scan.cap(5).isEmpty() ? scan.cap(3) : scan.cap(5));
+			name = name.section('.', -1);
+			// the name, but not as a qualifier of a column
+			note.pattern = "\\b" + QRegExp::escape(name) + "\\b(?!\\s*\\.)";
+		}
+		else if ((sort.indexIn(line) == 0) && (largest.rows >= 0))
+		{
+			// sorting what was read from the largest table scanned
+			note.rows = largest.rows;
+			note.message = tr("%1: sorts up to %2")
+						   .arg(line, describe(largest));
+			if (sort.cap(1).contains("ORDER BY"))
+			{
+				note.pattern = "\\bORDER\\s+BY\\b";
+			}
+			else if (sort.cap(1).contains("GROUP BY"))
+			{
+				note.pattern = "\\bGROUP\\s+BY\\b";
+			}
+			else if (sort.cap(1).contains("DISTINCT"))
+			{
+				note.pattern = "\\bDISTINCT\\b";
+			}
+		}
+		else { continue; }
+		result.notes.append(note);
+	}
+	std::stable_sort(result.notes.begin(), result.notes.end(), moreRows);
+	return true;
+}
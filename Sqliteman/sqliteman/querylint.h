@@ -0,0 +1,118 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef QUERYLINT_H
+#define QUERYLINT_H
+
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+#include <QtCore/QThreadPool>
+#include <QtCore/QTimer>
+
+#include "sqlite3.h"
+
+class SqlEditorWidget;
+struct LintReader;
+
+//! \brief Something slow in a query plan
+typedef struct
+{
+	QString message; //!< the plan line and why it matters
+	QString pattern; //!< QRegExp for the text it is about
+	qint64 rows; //!< how much it matters
+}
+LintNote;
+
+//! \brief The plan of one statement, and what is wrong with it
+typedef struct
+{
+	QString sql;
+	int from; //!< UTF-8 offset of sql in the editor
+	int generation;
+	QList<LintNote> notes; //!< most rows first
+}
+LintResult;
+
+/*! \brief Checks the query plan of the statement being edited.
+A little while after the text or the cursor stops moving, the statement
+under the cursor is run through EXPLAIN QUERY PLAN and SqlEditorWidget
+shows the steps which read a large table: full scans, automatic indexes
+and temporary b-trees for sorting. A table is large if sqlite_stat1 says
+so or, if it hasn't been analyzed, if counting stops at LINT_LARGE_ROWS.
+Like TableTree, it plans on a read only connection of its own on a worker
+thread, so nothing is checked while the GUI's connection has something
+uncommitted which that wouldn't see, or for temporary or in-memory
+databases. It never uses the GUI's connection, which a script may be
+running on. Only statements which read tables are planned, since
+preparing some PRAGMAs changes the connection.
+*/
+class QueryLint : public QObject
+{
+	Q_OBJECT
+
+	public:
+		QueryLint(SqlEditorWidget * editor, QObject * parent = 0);
+		~QueryLint();
+
+		/*! \brief Close the worker's connection.
+		Call it before closing the database, so that it doesn't keep the
+		file open. */
+		void closeReader();
+
+		/*! \brief Plan \a result.sql on \a db, filling in its notes.
+		\retval bool false if it can't be prepared there */
+		static bool plan(sqlite3 * db, LintResult & result);
+
+	public slots:
+		//! \brief Check again when the editor has been still for a while
+		void schedule();
+		//! \brief Apply new preferences
+		void prefsChanged();
+
+	private slots:
+		void textChanged();
+		void check();
+		void checked();
+
+	private:
+		typedef struct
+		{
+			QString schema;
+			QString name;
+			qint64 rows;
+			bool atLeast; //!< rows were counted up to a limit
+		}
+		TableSize;
+
+		//! \brief The table \a name refers to in \a sql, and its size
+		static bool tableSize(sqlite3 * db, const QString & sql,
+							  const QString & name, TableSize & size);
+		static bool findTable(sqlite3 * db, const QString & schema,
+							  const QString & name, TableSize & size);
+		static void countRows(sqlite3 * db, TableSize & size);
+		static QString describe(const TableSize & size);
+		/*! \brief Whether \a sql can be planned safely
+		\retval QString sql without leading comments, or null */
+		static QString plannable(const QString & sql);
+		void show(const LintResult & result);
+
+		SqlEditorWidget * m_editor;
+		QTimer m_timer;
+		bool m_enabled;
+		//! \brief Changes whenever the text does
+		int m_generation;
+		//! \brief A statement is being planned on the worker
+		bool m_busy;
+
+		//! \brief One thread, so the reader is used one at a time
+		QThreadPool m_pool;
+		//! \brief The read only connection, only used on m_pool
+		LintReader * m_reader;
+};
+
+#endif
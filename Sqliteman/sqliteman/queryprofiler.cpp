@@ -0,0 +1,129 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include "queryprofiler.h"
+
+// Statements kept from one run, so that a long script can't eat the memory
+#define PROFILER_MAX 10000
+
+QueryProfiler::QueryProfiler()
+	: m_db(0),
+	  m_dropped(0),
+	  m_prepare(-1),
+	  m_awaitingRows(false)
+{
+}
+
+QueryProfiler::~QueryProfiler()
+{
+	stop();
+}
+
+void QueryProfiler::start(sqlite3 * db)
+{
+	stop();
+	m_profiles.clear();
+	m_dropped = 0;
+	m_prepare = -1;
+	m_awaitingRows = false;
+	m_db = db;
+	if (!m_db) { return; }
+	// throw away what earlier statements did to the page cache
+	dbStatus(SQLITE_DBSTATUS_CACHE_HIT);
+	dbStatus(SQLITE_DBSTATUS_CACHE_MISS);
+	dbStatus(SQLITE_DBSTATUS_CACHE_WRITE);
+	sqlite3_trace_v2(m_db, SQLITE_TRACE_PROFILE, traceCallback, this);
+	m_timer.start();
+}
+
+void QueryProfiler::stop()
+{
+	if (m_db)
+	{
+		sqlite3_trace_v2(m_db, 0, 0, 0);
+		m_db = 0;
+	}
+}
+
+void QueryProfiler::prepared(qint64 ns)
+{
+	m_prepare = ns;
+}
+
+void QueryProfiler::prepare(const QString & sql)
+{
+	if (!m_db) { return; }
+	QByteArray utf8(sql.toUtf8());
+	sqlite3_stmt * stmt = 0;
+	QElapsedTimer timer;
+	timer.start();
+	int rc = sqlite3_prepare_v3(m_db, utf8.constData(), -1, 0, &stmt, 0);
+	qint64 ns = timer.nsecsElapsed();
+	sqlite3_finalize(stmt);
+	m_prepare = (rc == SQLITE_OK) ? ns : -1;
+}
+
+void QueryProfiler::finished(qint64 rows)
+{
+	if (m_awaitingRows) { m_profiles.last().rows = rows; }
+	m_awaitingRows = false;
+}
+
+QString QueryProfiler::formatTime(qint64 ns)
+{
+	if (ns < 0) { return QString(); }
+	return tr("%L1").arg(ns / 1000000.0, 0, 'f', 3);
+}
+
+int QueryProfiler::traceCallback(unsigned type, void * context,
+								 void * p, void * x)
+{
+	if (type == SQLITE_TRACE_PROFILE)
+	{
+		((QueryProfiler *)context)->profile((sqlite3_stmt *)p,
+											*(sqlite3_int64 *)x);
+	}
+	return 0;
+}
+
+int QueryProfiler::dbStatus(int op)
+{
+	int current = 0;
+	int highwater = 0;
+	if (sqlite3_db_status(m_db, op, &current, &highwater, 1) != SQLITE_OK)
+	{
+		return -1;
+	}
+	return current;
+}
+
+void QueryProfiler::profile(sqlite3_stmt * stmt, qint64 ns)
+{
+	StatementProfile p;
+	p.sql = QString::fromUtf8(sqlite3_sql(stmt)).trimmed();
+	p.start = m_timer.nsecsElapsed() - ns;
+	p.prepare = m_prepare;
+	p.run = ns;
+	p.rows = -1;
+	p.vmSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+	p.fullScanSteps =
+		sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+	p.sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+	p.autoIndexes = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+	p.cacheHits = dbStatus(SQLITE_DBSTATUS_CACHE_HIT);
+	p.cacheMisses = dbStatus(SQLITE_DBSTATUS_CACHE_MISS);
+	p.cacheWrites = dbStatus(SQLITE_DBSTATUS_CACHE_WRITE);
+	m_prepare = -1;
+	if (m_profiles.count() >= PROFILER_MAX)
+	{
+		++m_dropped;
+		m_awaitingRows = false;
+		return;
+	}
+	m_profiles.append(p);
+	m_awaitingRows = true;
+}
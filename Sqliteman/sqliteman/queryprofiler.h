@@ -0,0 +1,91 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef QUERYPROFILER_H
+#define QUERYPROFILER_H
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+#include "sqlite3.h"
+
+/*! \brief What one statement cost.
+Times are in nanoseconds, and each number is -1 if it isn't known. */
+typedef struct
+{
+	QString sql;
+	qint64 start; //!< since the profiler was started
+	qint64 prepare;
+	qint64 run; //!< from the first step to the last, measured by sqlite
+	qint64 rows; //!< returned, or changed if it returns none
+	int vmSteps;
+	int fullScanSteps;
+	int sorts;
+	int autoIndexes;
+	int cacheHits;
+	int cacheMisses;
+	int cacheWrites;
+}
+StatementProfile;
+
+/*! \brief Collects a StatementProfile for each statement run on a
+connection.
+While it is started, sqlite3_trace_v2() tells it when each statement
+finishes and how long it ran for, and it reads the statement's counters
+from sqlite3_stmt_status() and the connection's page cache counters from
+sqlite3_db_status(), resetting both so that each statement gets its own.
+sqlite only knows the time to the millisecond. Preparing isn't traced, so
+whoever runs the statements says how long it took with prepared() or
+prepare(), and how many rows there were with finished().
+The trace runs on whichever thread steps the statements, so profiles()
+should only be read after the profiler is stopped.
+*/
+class QueryProfiler
+{
+		Q_DECLARE_TR_FUNCTIONS(QueryProfiler)
+
+	public:
+		QueryProfiler();
+		~QueryProfiler();
+
+		//! \brief Start tracing \a db, forgetting any earlier profiles
+		void start(sqlite3 * db);
+		void stop();
+
+		//! \brief The next statement to finish took \a ns to prepare
+		void prepared(qint64 ns);
+		/*! \brief Time preparing \a sql on its own, for statements which
+		are prepared where they can't be timed */
+		void prepare(const QString & sql);
+		//! \brief The statement which has just finished had \a rows
+		void finished(qint64 rows);
+
+		const QList<StatementProfile> & profiles() const { return m_profiles; }
+		//! \brief Statements which weren't kept, past PROFILER_MAX
+		int dropped() const { return m_dropped; }
+
+		//! \brief \a ns as milliseconds, or empty if it is unknown
+		static QString formatTime(qint64 ns);
+
+	private:
+		static int traceCallback(unsigned type, void * context,
+								 void * p, void * x);
+		void profile(sqlite3_stmt * stmt, qint64 ns);
+		int dbStatus(int op);
+
+		sqlite3 * m_db;
+		QElapsedTimer m_timer;
+		QList<StatementProfile> m_profiles;
+		int m_dropped;
+		qint64 m_prepare;
+		//! \brief The last profile is waiting for finished()
+		bool m_awaitingRows;
+};
+
+#endif
@@ -32,6 +32,8 @@ SchemaBrowser::SchemaBrowser(QWidget * parent, Qt::WindowFlags f)
 			this, SLOT(tabWidget_currentChanged(int)));
 
 	connect(setPragmaButton, SIGNAL(clicked()), this, SLOT(setPragmaButton_clicked()));
+	connect(filterEdit, SIGNAL(textChanged(const QString &)),
+			tableTree, SLOT(setFilter(const QString &)));
 }
 
 void SchemaBrowser::buildPragmasTree()
@@ -0,0 +1,501 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+#include <algorithm>
+
+#include <QIcon>
+
+#include "schemamodel.h"
+#include "tabletree.h"
+#include "utils.h"
+
+
+SchemaItem::SchemaItem(SchemaModel * model, SchemaItem * parent, int type,
+					   const QString & text, const QString & schema)
+	: m_model(model),
+	  m_parent(parent),
+	  m_type(type),
+	  m_text(text),
+	  m_schema(schema),
+	  m_key(false),
+	  m_filled(false),
+	  m_position(0),
+	  m_childType(type),
+	  m_filtered(false)
+{
+}
+
+SchemaItem::~SchemaItem()
+{
+	deleteChildren();
+}
+
+QString SchemaItem::text(int column) const
+{
+	switch (column)
+	{
+		case 0: return m_text;
+		case 1: return m_schema;
+		default: return QString();
+	}
+}
+
+void SchemaItem::setText(int column, const QString & text)
+{
+	if (column == 0) { m_model->setText(this, text); }
+}
+
+SchemaItem * SchemaItem::parent() const
+{
+	// the model's root isn't an item as far as anyone else knows
+	return (m_parent && m_parent->m_parent) ? m_parent : 0;
+}
+
+int SchemaItem::childCount() const
+{
+	return m_filtered ? m_shown.size() : m_names.size();
+}
+
+SchemaItem * SchemaItem::child(int row)
+{
+	if ((row < 0) || (row >= childCount())) { return 0; }
+	return childAt(positionOf(row));
+}
+
+SchemaItem * SchemaItem::childAt(int position)
+{
+	SchemaItem * item = m_children.at(position);
+	if (!item)
+	{
+		item = new SchemaItem(m_model, this, m_childType,
+							  m_names.at(position), m_schema);
+		item->m_key = !m_keys.isEmpty() && m_keys.at(position);
+		item->m_position = position;
+		m_children[position] = item;
+	}
+	return item;
+}
+
+int SchemaItem::rowOf(int position) const
+{
+	if (!m_filtered) { return position; }
+	QVector<int>::const_iterator i =
+		std::lower_bound(m_shown.constBegin(), m_shown.constEnd(), position);
+	if ((i == m_shown.constEnd()) || (*i != position)) { return -1; }
+	return i - m_shown.constBegin();
+}
+
+int SchemaItem::rowsBefore(int position) const
+{
+	if (!m_filtered) { return position; }
+	return std::lower_bound(m_shown.constBegin(), m_shown.constEnd(), position)
+		   - m_shown.constBegin();
+}
+
+void SchemaItem::insertAt(int position, const QString & name, bool key,
+						  SchemaItem * item, bool shown)
+{
+	m_names.insert(position, name);
+	if (!m_keys.isEmpty()) { m_keys.insert(position, key); }
+	m_children.insert(position, item);
+	if (item) { item->m_parent = this; }
+	renumber(position);
+	if (m_filtered)
+	{
+		int row = rowsBefore(position);
+		for (int i = row; i < m_shown.size(); ++i) { ++m_shown[i]; }
+		if (shown) { m_shown.insert(row, position); }
+	}
+}
+
+SchemaItem * SchemaItem::takeAt(int position)
+{
+	SchemaItem * item = m_children.at(position);
+	m_names.removeAt(position);
+	if (!m_keys.isEmpty()) { m_keys.removeAt(position); }
+	m_children.remove(position);
+	renumber(position);
+	if (m_filtered)
+	{
+		int row = rowsBefore(position);
+		if ((row < m_shown.size()) && (m_shown.at(row) == position))
+		{
+			m_shown.remove(row);
+		}
+		for (int i = row; i < m_shown.size(); ++i) { --m_shown[i]; }
+	}
+	return item;
+}
+
+void SchemaItem::renumber(int from)
+{
+	for (int i = from; i < m_children.size(); ++i)
+	{
+		if (m_children.at(i)) { m_children.at(i)->m_position = i; }
+	}
+}
+
+void SchemaItem::deleteChildren()
+{
+	QVector<SchemaItem *>::const_iterator i;
+	for (i = m_children.constBegin(); i != m_children.constEnd(); ++i) {
+		delete *i;
+	}
+	m_children.clear();
+	m_names.clear();
+	m_keys.clear();
+	m_shown.clear();
+	m_filtered = false;
+}
+
+
+SchemaModel::SchemaModel(QObject * parent)
+	: QAbstractItemModel(parent)
+{
+	m_root = new SchemaItem(this, 0, 0, QString(), QString());
+}
+
+SchemaModel::~SchemaModel()
+{
+	delete m_root;
+}
+
+QModelIndex SchemaModel::index(int row, int column,
+							   const QModelIndex & parent) const
+{
+	SchemaItem * p = parent.isValid() ? item(parent) : m_root;
+	if ((column != 0) || (row < 0) || (row >= p->childCount()))
+	{
+		return QModelIndex();
+	}
+	return createIndex(row, 0, p->child(row));
+}
+
+QModelIndex SchemaModel::parent(const QModelIndex & index) const
+{
+	SchemaItem * i = item(index);
+	return i ? indexOf(i->m_parent) : QModelIndex();
+}
+
+int SchemaModel::rowCount(const QModelIndex & parent) const
+{
+	if (parent.column() > 0) { return 0; }
+	return (parent.isValid() ? item(parent) : m_root)->childCount();
+}
+
+int SchemaModel::columnCount(const QModelIndex & /*parent*/) const
+{
+	return 1;
+}
+
+bool SchemaModel::hasChildren(const QModelIndex & parent) const
+{
+	SchemaItem * p = parent.isValid() ? item(parent) : m_root;
+	// a table or view which hasn't been read yet can be expanded to read it
+	if (canFetchMore(parent)) { return true; }
+	return p->childCount() > 0;
+}
+
+QVariant SchemaModel::data(const QModelIndex & index, int role) const
+{
+	SchemaItem * i = item(index);
+	if (!i) { return QVariant(); }
+
+	switch (role)
+	{
+		case Qt::DisplayRole:
+			return i->m_text;
+		case Qt::ToolTipRole:
+			if (i->m_toolTip.isEmpty()) { return QVariant(); }
+			return i->m_toolTip;
+		case Qt::DecorationRole:
+			switch (i->m_type)
+			{
+				case TableTree::DatabaseItemType:
+					return Utils::getIcon("database.png");
+				case TableTree::TablesItemType:
+					return Utils::getIcon("table.png");
+				case TableTree::ViewsItemType:
+					return Utils::getIcon("view.png");
+				case TableTree::SystemItemType:
+					return Utils::getIcon("system.png");
+				case TableTree::ColumnItemType:
+					return Utils::getIcon("column.png");
+				case TableTree::IndexesItemType:
+				case TableTree::SysIndexesItemType:
+					return Utils::getIcon("index.png");
+				case TableTree::TriggersItemType:
+					return Utils::getIcon("trigger.png");
+				case TableTree::ColumnType:
+					if (i->m_key) { return Utils::getIcon("key.png"); }
+					break;
+			}
+			break;
+	}
+	return QVariant();
+}
+
+QVariant SchemaModel::headerData(int section, Qt::Orientation orientation,
+								 int role) const
+{
+	if (   (role == Qt::DisplayRole)
+		&& (orientation == Qt::Horizontal)
+		&& (section == 0))
+	{
+		return m_header;
+	}
+	return QVariant();
+}
+
+Qt::ItemFlags SchemaModel::flags(const QModelIndex & index) const
+{
+	if (!index.isValid()) { return Qt::NoItemFlags; }
+	// TableTree drags names itself
+	return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
+bool SchemaModel::canFetchMore(const QModelIndex & parent) const
+{
+	SchemaItem * p = item(parent);
+	return    p
+		   && (   (p->m_type == TableTree::TableType)
+			   || (p->m_type == TableTree::ViewType))
+		   && !p->m_filled;
+}
+
+void SchemaModel::fetchMore(const QModelIndex & parent)
+{
+	if (canFetchMore(parent)) { emit fetch(QPersistentModelIndex(parent)); }
+}
+
+SchemaItem * SchemaModel::item(const QModelIndex & index) const
+{
+	if (!index.isValid()) { return 0; }
+	return static_cast<SchemaItem *>(index.internalPointer());
+}
+
+QModelIndex SchemaModel::indexOf(SchemaItem * item) const
+{
+	if (!item || (item == m_root)) { return QModelIndex(); }
+	// the children of an item which is filtered out aren't shown either
+	for (SchemaItem * i = item; i != m_root; i = i->m_parent)
+	{
+		if (i->m_parent->rowOf(i->m_position) < 0) { return QModelIndex(); }
+	}
+	return createIndex(item->m_parent->rowOf(item->m_position), 0, item);
+}
+
+int SchemaModel::topLevelItemCount() const
+{
+	return m_root->childCount();
+}
+
+SchemaItem * SchemaModel::topLevelItem(int row)
+{
+	return m_root->child(row);
+}
+
+SchemaItem * SchemaModel::addDatabase(const QString & schema)
+{
+	int row = m_root->childCount();
+	SchemaItem * item = new SchemaItem(this, m_root,
+		TableTree::DatabaseItemType, schema, schema);
+	beginInsertRows(QModelIndex(), row, row);
+	m_root->insertAt(m_root->m_names.size(), schema, false, item, true);
+	endInsertRows();
+	return item;
+}
+
+SchemaItem * SchemaModel::appendChild(SchemaItem * parent, int type,
+									  const QString & text)
+{
+	SchemaItem * item =
+		new SchemaItem(this, parent, type, text, parent->m_schema);
+	bool signal = (parent == m_root) || indexOf(parent).isValid();
+	int row = parent->childCount();
+	if (signal) { beginInsertRows(indexOf(parent), row, row); }
+	parent->insertAt(parent->m_names.size(), text, false, item, true);
+	if (signal) { endInsertRows(); }
+	return item;
+}
+
+void SchemaModel::setChildren(SchemaItem * parent, int type,
+							  const QStringList & names,
+							  const QList<bool> & keys)
+{
+	clearChildren(parent);
+	parent->m_childType = type;
+	if (names.isEmpty()) { return; }
+	bool signal = indexOf(parent).isValid();
+	if (signal) { beginInsertRows(indexOf(parent), 0, names.size() - 1); }
+	parent->m_names = names;
+	if (keys.size() == names.size()) { parent->m_keys = keys; }
+	parent->m_children.fill(0, names.size());
+	if (signal) { endInsertRows(); }
+}
+
+void SchemaModel::clearChildren(SchemaItem * parent)
+{
+	int count = parent->childCount();
+	bool signal = (count > 0) && indexOf(parent).isValid();
+	if (signal) { beginRemoveRows(indexOf(parent), 0, count - 1); }
+	parent->deleteChildren();
+	if (signal) { endRemoveRows(); }
+}
+
+void SchemaModel::insertName(SchemaItem * parent, int position,
+							 const QString & name)
+{
+	// a filtered group shows it when it is filtered again
+	bool shown = !parent->m_filtered;
+	bool signal = shown && indexOf(parent).isValid();
+	int row = parent->rowsBefore(position);
+	if (signal) { beginInsertRows(indexOf(parent), row, row); }
+	parent->insertAt(position, name, false, 0, shown);
+	if (signal) { endInsertRows(); }
+}
+
+void SchemaModel::removeName(SchemaItem * parent, int position)
+{
+	int row = parent->rowOf(position);
+	bool signal = (row >= 0) && indexOf(parent).isValid();
+	if (signal) { beginRemoveRows(indexOf(parent), row, row); }
+	delete parent->takeAt(position);
+	if (signal) { endRemoveRows(); }
+}
+
+QStringList SchemaModel::names(SchemaItem * parent) const
+{
+	return parent->m_names;
+}
+
+int SchemaModel::findName(SchemaItem * parent, const QString & name) const
+{
+	// tables and views are in the catalogue's order
+	QStringList::const_iterator i = std::lower_bound(
+		parent->m_names.constBegin(), parent->m_names.constEnd(), name);
+	if ((i == parent->m_names.constEnd()) || (*i != name)) { return -1; }
+	return i - parent->m_names.constBegin();
+}
+
+SchemaItem * SchemaModel::childAt(SchemaItem * parent, int position)
+{
+	return parent->childAt(position);
+}
+
+SchemaItem * SchemaModel::madeChildAt(SchemaItem * parent, int position) const
+{
+	return parent->m_children.at(position);
+}
+
+void SchemaModel::removeItem(SchemaItem * item)
+{
+	SchemaItem * parent = item->m_parent;
+	int row = parent->rowOf(item->m_position);
+	bool signal =
+		(row >= 0) && ((parent == m_root) || indexOf(parent).isValid());
+	if (signal) { beginRemoveRows(indexOf(parent), row, row); }
+	parent->takeAt(item->m_position);
+	if (signal) { endRemoveRows(); }
+	delete item;
+}
+
+void SchemaModel::clear()
+{
+	beginResetModel();
+	m_root->deleteChildren();
+	endResetModel();
+}
+
+void SchemaModel::setText(SchemaItem * item, const QString & text)
+{
+	SchemaItem * parent = item->m_parent;
+	int from = item->m_position;
+	int row = parent->rowOf(from);
+	bool signal =
+		(row >= 0) && ((parent == m_root) || indexOf(parent).isValid());
+	// tables and views are kept in order for findName()
+	int to = from;
+	if (   (item->m_type == TableTree::TableType)
+		|| (item->m_type == TableTree::ViewType))
+	{
+		to = std::lower_bound(parent->m_names.constBegin(),
+							  parent->m_names.constEnd(), text)
+			 - parent->m_names.constBegin();
+	}
+	if ((to == from) || (to == from + 1))
+	{
+		item->m_text = text;
+		parent->m_names[from] = text;
+		if (signal)
+		{
+			QModelIndex index(indexOf(item));
+			emit dataChanged(index, index);
+		}
+		return;
+	}
+
+	int destination = parent->rowsBefore(to);
+	bool moved =    signal
+				 && (destination != row) && (destination != row + 1)
+				 && beginMoveRows(indexOf(parent), row, row,
+								  indexOf(parent), destination);
+	parent->takeAt(from);
+	item->m_text = text;
+	parent->insertAt((to > from) ? to - 1 : to, text, item->m_key, item,
+					 row >= 0);
+	if (moved) { endMoveRows(); }
+	else if (signal)
+	{
+		QModelIndex index(indexOf(item));
+		emit dataChanged(index, index);
+	}
+}
+
+void SchemaModel::setFilled(SchemaItem * item, bool filled)
+{
+	item->m_filled = filled;
+}
+
+void SchemaModel::filter(SchemaItem * parent, const QSet<QString> * matched)
+{
+	QVector<int> shown;
+	if (matched)
+	{
+		for (int i = 0; i < parent->m_names.size(); ++i)
+		{
+			if (matched->contains(parent->m_names.at(i))) { shown.append(i); }
+		}
+		if (parent->m_filtered && (shown == parent->m_shown)) { return; }
+	}
+	else if (!parent->m_filtered) { return; }
+
+	if (!indexOf(parent).isValid())
+	{
+		parent->m_filtered = matched != 0;
+		parent->m_shown = shown;
+		return;
+	}
+
+	/* The rows move rather than being removed and inserted again, so the
+	 * view keeps the current item and which tables are expanded. */
+	emit layoutAboutToBeChanged();
+	QModelIndexList before(persistentIndexList());
+	QList<SchemaItem *> items;
+	QModelIndexList::const_iterator i;
+	for (i = before.constBegin(); i != before.constEnd(); ++i) {
+		items.append(item(*i));
+	}
+	parent->m_filtered = matched != 0;
+	parent->m_shown = shown;
+	QModelIndexList after;
+	QList<SchemaItem *>::const_iterator j;
+	for (j = items.constBegin(); j != items.constEnd(); ++j) {
+		after.append(indexOf(*j));
+	}
+	changePersistentIndexList(before, after);
+	emit layoutChanged();
+}
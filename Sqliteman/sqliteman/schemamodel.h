@@ -0,0 +1,178 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef SCHEMAMODEL_H
+#define SCHEMAMODEL_H
+
+#include <QtCore/QAbstractItemModel>
+#include <QtCore/QSet>
+#include <QtCore/QStringList>
+#include <QtCore/QVector>
+
+class SchemaModel;
+
+/*! \brief One item of the schema browser.
+It answers the same questions as the QTreeWidgetItem it replaces: its type,
+its name or label as text(0) and its schema as text(1), its parent and its
+children. A list of names (tables, views, columns...) is kept as just the
+names, and the item for one of them is only made when something asks for
+it, usually the view painting that row. Items stay until they are removed
+from the model, so pointers to them can be kept meanwhile.
+*/
+class SchemaItem
+{
+	public:
+		//! \brief The first type, like QTreeWidgetItem::UserType
+		static const int UserType = 1000;
+
+		int type() const { return m_type; }
+		//! \brief The name or label for column 0, the schema for column 1
+		QString text(int column) const;
+		/*! \brief Rename the item, keeping tables and views in order.
+		Only column 0 can be set. */
+		void setText(int column, const QString & text);
+		QString toolTip() const { return m_toolTip; }
+		void setToolTip(const QString & text) { m_toolTip = text; }
+		//! \brief For a column, whether it is part of the primary key
+		bool isKey() const { return m_key; }
+
+		SchemaItem * parent() const;
+		//! \brief How many children are shown: some may be filtered out
+		int childCount() const;
+		//! \brief The child shown at \a row, made if it hasn't been yet
+		SchemaItem * child(int row);
+
+	private:
+		friend class SchemaModel;
+
+		SchemaItem(SchemaModel * model, SchemaItem * parent, int type,
+				   const QString & text, const QString & schema);
+		~SchemaItem();
+
+		//! \brief The child at \a position of m_names, made if need be
+		SchemaItem * childAt(int position);
+		//! \brief The row \a position is shown at, or -1 if filtered out
+		int rowOf(int position) const;
+		int positionOf(int row) const { return m_filtered ? m_shown.at(row) : row; }
+		//! \brief How many children before \a position are shown
+		int rowsBefore(int position) const;
+		void insertAt(int position, const QString & name, bool key,
+					  SchemaItem * item, bool shown);
+		SchemaItem * takeAt(int position);
+		void renumber(int from);
+		void deleteChildren();
+
+		SchemaModel * m_model;
+		SchemaItem * m_parent;
+		int m_type;
+		QString m_text;
+		QString m_schema;
+		QString m_toolTip;
+		bool m_key;
+		//! \brief For a table or view, whether its children have been read
+		bool m_filled;
+		//! \brief Where this is in its parent's m_names
+		int m_position;
+
+		//! \brief The type of the children made from m_names
+		int m_childType;
+		//! \brief The text of every child, shown or not
+		QStringList m_names;
+		QList<bool> m_keys;
+		//! \brief The child for each of m_names, or 0 if not made yet
+		QVector<SchemaItem *> m_children;
+		//! \brief If m_filtered, which positions are shown, in order
+		bool m_filtered;
+		QVector<int> m_shown;
+};
+
+
+/*! \brief The items of the schema browser, as a tree model for TableTree.
+Each group item (Tables, Views, Columns...) holds the sorted names of its
+children, and rows are only turned into SchemaItems when the view asks for
+their index. With uniform row heights and no hidden rows, QTreeView only
+asks for the rows it paints, so a schema of many thousands of tables costs
+a list of names rather than an item each. Filtering therefore doesn't hide
+rows but changes which names a group shows.
+A table's columns, indexes and triggers, and a view's triggers, are read
+when the view first expands it: until then it says it can fetch more, and
+fetchMore() asks TableTree to read them with fetch().
+*/
+class SchemaModel : public QAbstractItemModel
+{
+	Q_OBJECT
+
+	public:
+		SchemaModel(QObject * parent = 0);
+		~SchemaModel();
+
+		QModelIndex index(int row, int column,
+						  const QModelIndex & parent = QModelIndex()) const;
+		QModelIndex parent(const QModelIndex & index) const;
+		int rowCount(const QModelIndex & parent = QModelIndex()) const;
+		int columnCount(const QModelIndex & parent = QModelIndex()) const;
+		bool hasChildren(const QModelIndex & parent = QModelIndex()) const;
+		QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const;
+		QVariant headerData(int section, Qt::Orientation orientation,
+							int role = Qt::DisplayRole) const;
+		Qt::ItemFlags flags(const QModelIndex & index) const;
+		bool canFetchMore(const QModelIndex & parent) const;
+		void fetchMore(const QModelIndex & parent);
+
+		void setHeader(const QString & text) { m_header = text; }
+
+		//! \brief The item of \a index, or 0 for the root
+		SchemaItem * item(const QModelIndex & index) const;
+		//! \brief The index of \a item, invalid if it isn't shown
+		QModelIndex indexOf(SchemaItem * item) const;
+		int topLevelItemCount() const;
+		SchemaItem * topLevelItem(int row);
+
+		//! \brief Add an item for \a schema at the end of the top level
+		SchemaItem * addDatabase(const QString & schema);
+		//! \brief Add a child of a type of its own, such as a group
+		SchemaItem * appendChild(SchemaItem * parent, int type,
+								 const QString & text);
+		/*! \brief Replace the children of \a parent by items for \a names.
+		\param keys for columns, which are part of the primary key */
+		void setChildren(SchemaItem * parent, int type,
+						 const QStringList & names,
+						 const QList<bool> & keys = QList<bool>());
+		//! \brief Remove all the children of \a parent
+		void clearChildren(SchemaItem * parent);
+		//! \brief Insert \a name before the name at \a position
+		void insertName(SchemaItem * parent, int position, const QString & name);
+		void removeName(SchemaItem * parent, int position);
+		//! \brief The names of all the children of \a parent, shown or not
+		QStringList names(SchemaItem * parent) const;
+		//! \brief The position of \a name among sorted names, or -1
+		int findName(SchemaItem * parent, const QString & name) const;
+		//! \brief The child for \a position among them
+		SchemaItem * childAt(SchemaItem * parent, int position);
+		//! \brief The same if it has been made, otherwise 0
+		SchemaItem * madeChildAt(SchemaItem * parent, int position) const;
+		//! \brief Remove \a item and its children, and delete them
+		void removeItem(SchemaItem * item);
+		void clear();
+
+		void setText(SchemaItem * item, const QString & text);
+		void setFilled(SchemaItem * item, bool filled);
+		bool isFilled(SchemaItem * item) const { return item->m_filled; }
+		/*! \brief Only show the children of \a parent in \a matched,
+		or all of them if it is 0. */
+		void filter(SchemaItem * parent, const QSet<QString> * matched);
+
+	signals:
+		//! \brief The view wants the contents of the table or view \a index
+		void fetch(const QPersistentModelIndex & index);
+
+	private:
+		SchemaItem * m_root;
+		QString m_header;
+};
+
+#endif
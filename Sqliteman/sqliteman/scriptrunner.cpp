@@ -0,0 +1,391 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <ctype.h>
+#include <string.h>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+
+#include "catalogue.h"
+#include "database.h"
+#include "scriptrunner.h"
+
+// Virtual machine instructions between checks for cancelling
+#define SCRIPT_PROGRESS_OPS 10000
+// Statements from a file in each transaction
+#define SCRIPT_BATCH 10000
+// How much of a failed statement is shown
+#define SCRIPT_FAILED_SQL 1000
+
+ScriptRunner::ScriptRunner(const QByteArray & script, int start,
+						   bool transaction, QObject * parent)
+	: QThread(parent),
+	  m_script(script),
+	  m_start(start),
+	  m_size(script.size()),
+	  m_transaction(transaction),
+	  m_begin(0),
+	  m_first(0),
+	  m_offset(0),
+	  m_committed(0),
+	  m_statements(0),
+	  m_failures(0),
+	  m_changed(0),
+	  m_cancelled(0),
+	  m_waiting(false),
+	  m_ignore(false),
+	  m_failureStart(0),
+	  m_failureEnd(0)
+{
+	m_db = Database::sqlite3handle();
+}
+
+ScriptRunner::ScriptRunner(const QString & fileName, qint64 start,
+						   QObject * parent)
+	: QThread(parent),
+	  m_fileName(fileName),
+	  m_start(start),
+	  m_size(QFile(fileName).size()),
+	  m_transaction(false),
+	  m_begin(0),
+	  m_first(start),
+	  m_offset(start),
+	  m_committed(start),
+	  m_statements(0),
+	  m_failures(0),
+	  m_changed(0),
+	  m_cancelled(0),
+	  m_waiting(false),
+	  m_ignore(false),
+	  m_failureStart(0),
+	  m_failureEnd(0)
+{
+	m_db = Database::sqlite3handle();
+}
+
+ScriptRunner::~ScriptRunner()
+{
+	cancel();
+	wait();
+}
+
+QString ScriptRunner::lastQuery() const
+{
+	QMutexLocker locker(&m_mutex);
+	return m_lastQuery;
+}
+
+bool ScriptRunner::failed(QString & message, QString & sql,
+						  qint64 & start, qint64 & end) const
+{
+	QMutexLocker locker(&m_mutex);
+	if (!m_waiting) { return false; }
+	message = m_failure;
+	sql = m_failureSql;
+	start = m_failureStart;
+	end = m_failureEnd;
+	return true;
+}
+
+void ScriptRunner::resume(bool ignore)
+{
+	QMutexLocker locker(&m_mutex);
+	m_ignore = ignore;
+	m_waiting = false;
+	m_answered.wakeAll();
+}
+
+void ScriptRunner::cancel()
+{
+	m_cancelled.storeRelease(1);
+	QMutexLocker locker(&m_mutex);
+	m_waiting = false;
+	m_answered.wakeAll();
+}
+
+int ScriptRunner::progressHandler(void * cancelled)
+{
+	return ((const QAtomicInt *)cancelled)->loadAcquire();
+}
+
+const char * ScriptRunner::statementEnd(const char * p, const char * end)
+{
+	const char * semicolon = p;
+	while (true)
+	{
+		semicolon = (const char *)memchr(semicolon, ';', end - semicolon);
+		if (!semicolon) { return end; }
+		++semicolon;
+		// sqlite3_complete() wants it terminated
+		QByteArray sql(p, semicolon - p);
+		if (sqlite3_complete(sql.constData())) { return semicolon; }
+	}
+}
+
+QByteArray ScriptRunner::firstWord(const char * p, const char * end)
+{
+	while (p < end)
+	{
+		if (isspace((unsigned char)*p))
+		{
+			++p;
+		}
+		else if ((end - p >= 2) && (p[0] == '-') && (p[1] == '-'))
+		{
+			p = (const char *)memchr(p, '\n', end - p);
+			if (!p) { return QByteArray(); }
+		}
+		else if ((end - p >= 2) && (p[0] == '/') && (p[1] == '*'))
+		{
+			for (p += 3; p < end; ++p)
+			{
+				if ((*p == '/') && (p[-1] == '*')) { break; }
+			}
+			if (p < end) { ++p; }
+		}
+		else { break; }
+	}
+	const char * word = p;
+	while ((p < end) && isalpha((unsigned char)*p)) { ++p; }
+	return QByteArray(word, p - word).toUpper();
+}
+
+bool ScriptRunner::outsideBatch(const char * p, const char * end)
+{
+	static const char * const words[] = {
+		"ATTACH", "BEGIN", "COMMIT", "DETACH", "END", "PRAGMA", "RELEASE",
+		"ROLLBACK", "SAVEPOINT", "VACUUM", 0 };
+	QByteArray first(firstWord(p, end));
+	for (int i = 0; words[i]; ++i)
+	{
+		if (first == words[i]) { return true; }
+	}
+	return false;
+}
+
+bool ScriptRunner::exec(const char * sql)
+{
+	if (sqlite3_exec(m_db, sql, 0, 0, 0) == SQLITE_OK) { return true; }
+	m_error = QString("%1 %2").arg(sql)
+			  .arg(QString::fromUtf8(sqlite3_errmsg(m_db)));
+	return false;
+}
+
+bool ScriptRunner::waitForUser(const char * from, const char * to)
+{
+	if (m_cancelled.loadAcquire()) { return false; }
+	m_failures.fetchAndAddRelease(1);
+	// leave out the white space before the statement
+	while ((from < to) && isspace((unsigned char)*from)) { ++from; }
+	QMutexLocker locker(&m_mutex);
+	m_failure = QString::fromUtf8(sqlite3_errmsg(m_db));
+	m_failureSql = QString::fromUtf8(from, qMin(int(to - from),
+												SCRIPT_FAILED_SQL));
+	m_failureStart = from - m_begin;
+	m_failureEnd = to - m_begin;
+	m_waiting = true;
+	while (m_waiting) { m_answered.wait(&m_mutex); }
+	return m_ignore && !m_cancelled.loadAcquire();
+}
+
+bool ScriptRunner::runStatement(const char * p, const char * end,
+								const char *& tail)
+{
+	sqlite3_stmt * stmt = 0;
+	int rc;
+	if (m_fileName.isNull())
+	{
+		// m_script is terminated: given a length, sqlite would copy all
+		// the rest of the script to prepare each statement
+		QElapsedTimer timer;
+		timer.start();
+		rc = sqlite3_prepare_v3(m_db, p, -1, 0, &stmt, &tail);
+		if (stmt) { m_profiler.prepared(timer.nsecsElapsed()); }
+		if (rc != SQLITE_OK) { tail = statementEnd(p, end); }
+	}
+	else
+	{
+		// a mapped file isn't, and end is the end of the statement
+		QByteArray sql(p, end - p);
+		rc = sqlite3_prepare_v3(m_db, sql.constData(), -1, 0, &stmt, 0);
+		tail = end;
+	}
+	if (rc != SQLITE_OK) { return waitForUser(p, tail); }
+	if (!stmt) { return true; } // white space or comments
+
+	qint64 count = 0;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) { ++count; }
+	bool rows = sqlite3_column_count(stmt) > 0;
+	m_profiler.finished(rows ? count : sqlite3_changes(m_db));
+	bool readOnly = sqlite3_stmt_readonly(stmt);
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE) { return waitForUser(p, tail); }
+
+	m_statements.fetchAndAddRelease(1);
+	if (!readOnly) { m_changed.storeRelease(1); }
+	else if (!rows && (firstWord(p, tail) == "ROLLBACK"))
+	{
+		// it may have undone changes to the schema
+		Catalogue::rolledBack();
+		m_changed.storeRelease(1);
+	}
+	else if (rows)
+	{
+		QMutexLocker locker(&m_mutex);
+		m_lastQuery = QString::fromUtf8(p, tail - p).trimmed();
+	}
+	return true;
+}
+
+bool ScriptRunner::runStatements(const char * p, const char * end)
+{
+	bool file = !m_fileName.isNull();
+	bool batch = false; // in one of our transactions
+	int batched = 0;
+	bool ok = true;
+	while ((p < end) && ok && !m_cancelled.loadAcquire())
+	{
+		const char * tail = p;
+		if (!file)
+		{
+			ok = runStatement(p, end, tail);
+		}
+		else
+		{
+			const char * next = statementEnd(p, end);
+			bool outside = outsideBatch(p, next);
+			if (batch && (outside || (batched >= SCRIPT_BATCH)))
+			{
+				batch = false;
+				ok = exec("COMMIT;");
+				if (ok) { m_committed.storeRelease(p - m_begin); }
+			}
+			if (ok && !outside && !batch && sqlite3_get_autocommit(m_db))
+			{
+				ok = batch = exec("BEGIN;");
+				batched = 0;
+			}
+			if (ok)
+			{
+				ok = runStatement(p, next, tail);
+				++batched;
+			}
+			if (batch && sqlite3_get_autocommit(m_db))
+			{
+				// some errors roll back the whole transaction
+				batch = false;
+				ok = false;
+				m_error = tr("The transaction was rolled back");
+			}
+		}
+		p = tail;
+		m_offset.storeRelease(p - m_begin);
+		if (ok && !batch && sqlite3_get_autocommit(m_db))
+		{
+			m_committed.storeRelease(p - m_begin);
+		}
+	}
+	if (m_cancelled.loadAcquire()) { ok = false; }
+	if (batch)
+	{
+		if (ok && exec("COMMIT;"))
+		{
+			m_committed.storeRelease(p - m_begin);
+		}
+		else
+		{
+			sqlite3_exec(m_db, "ROLLBACK;", 0, 0, 0);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+void ScriptRunner::run()
+{
+	m_error = QString();
+	if (!m_db)
+	{
+		m_error = tr("No database is open");
+		return;
+	}
+
+	QFile file(m_fileName);
+	const char * p;
+	const char * end;
+	if (m_fileName.isNull())
+	{
+		m_begin = m_script.constData();
+		end = m_begin + m_script.size();
+		const char * cursor = m_begin + qBound(qint64(0), m_start, m_size);
+		// skip the statements before the cursor without preparing them,
+		// since they may refer to things which they would have created
+		p = m_begin;
+		while (p < cursor)
+		{
+			const char * next = statementEnd(p, end);
+			if (next >= cursor) { break; }
+			p = next;
+		}
+	}
+	else
+	{
+		if (!file.open(QIODevice::ReadOnly))
+		{
+			m_error = file.errorString();
+			return;
+		}
+		m_size = file.size();
+		if (m_size > 0)
+		{
+			m_begin = (const char *)file.map(0, m_size);
+			if (!m_begin)
+			{
+				m_error = file.errorString();
+				return;
+			}
+		}
+		end = m_begin + m_size;
+		p = m_begin + qBound(qint64(0), m_start, m_size);
+	}
+	m_first.storeRelease(p - m_begin);
+	m_offset.storeRelease(p - m_begin);
+	m_committed.storeRelease(p - m_begin);
+
+	bool autocommit = sqlite3_get_autocommit(m_db);
+	bool savepoint = m_transaction && autocommit;
+	if (savepoint && !exec("SAVEPOINT RUN_SCRIPT;")) { return; }
+	sqlite3_progress_handler(m_db, SCRIPT_PROGRESS_OPS, progressHandler,
+							 (void *)&m_cancelled);
+	if (m_fileName.isNull()) { m_profiler.start(m_db); }
+	bool ok = runStatements(p, end);
+	m_profiler.stop();
+	sqlite3_progress_handler(m_db, 0, 0, 0);
+
+	// the script may have ended the transaction itself
+	if (savepoint && !sqlite3_get_autocommit(m_db))
+	{
+		// RELEASE fails if a deferred foreign key is still violated
+		ok = ok && exec("RELEASE RUN_SCRIPT;");
+		if (!ok)
+		{
+			sqlite3_exec(m_db, "ROLLBACK TO RUN_SCRIPT;", 0, 0, 0);
+			Catalogue::rolledBack();
+			sqlite3_exec(m_db, "RELEASE RUN_SCRIPT;", 0, 0, 0);
+		}
+	}
+	// don't leave a transaction begun by a file open, since it will be
+	// resumed from before it
+	if (!ok && !m_fileName.isNull() && autocommit
+		&& !sqlite3_get_autocommit(m_db))
+	{
+		sqlite3_exec(m_db, "ROLLBACK;", 0, 0, 0);
+	}
+	if (m_cancelled.loadAcquire()) { m_error = tr("Cancelled"); }
+	else if (!ok && m_error.isNull()) { m_error = tr("Script abandoned"); }
+}
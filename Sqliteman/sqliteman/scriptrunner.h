@@ -0,0 +1,146 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef SCRIPTRUNNER_H
+#define SCRIPTRUNNER_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
+
+#include "queryprofiler.h"
+#include "sqlite3.h"
+
+/*! \brief Runs SQL scripts on a worker thread.
+A script is either the SQL editor's text, for "Run as Script", or a file,
+for "Execute SQL File", which is memory mapped rather than read, so that
+it can be bigger than anything the editor could hold.
+The editor's text is taken as UTF-8 so that offsets in it are the editor's
+positions. Its statements are found and prepared by sqlite3_prepare_v3(),
+which says where the next one starts, and stepped to the end. Optionally
+the whole script is run in one savepoint, which is rolled back if the
+script is abandoned, and each statement is profiled.
+A file is split into statements by sqlite3_complete(), and they are run in
+transactions of up to SCRIPT_BATCH statements unless the file has its own.
+committed() says where to resume a file which wasn't finished.
+When a statement fails, the runner waits until the GUI has asked the user
+and called resume(). The runner uses the GUI's connection while the GUI
+waits, as DumpRestore does.
+*/
+class ScriptRunner : public QThread
+{
+	Q_OBJECT
+
+	public:
+		/*! \brief Get ready to run \a script
+		\param start offset in \a script of the cursor: statements ending
+		before it are skipped
+		\param transaction run the script in one savepoint */
+		ScriptRunner(const QByteArray & script, int start, bool transaction,
+					 QObject * parent = 0);
+		/*! \brief Get ready to run the file \a fileName
+		\param start where to start, which must be between statements */
+		ScriptRunner(const QString & fileName, qint64 start,
+					 QObject * parent = 0);
+		~ScriptRunner();
+
+		//! \brief Where the first statement to be run starts
+		qint64 firstOffset() const { return m_first.loadAcquire(); }
+		//! \brief Where the last statement run or skipped ends
+		qint64 offset() const { return m_offset.loadAcquire(); }
+		//! \brief Everything before this has been committed
+		qint64 committed() const { return m_committed.loadAcquire(); }
+		qint64 size() const { return m_size; }
+		int statements() const { return m_statements.loadAcquire(); }
+		int failures() const { return m_failures.loadAcquire(); }
+
+		/*! \brief Some statement may have changed the data or the schema:
+		not every statement was read-only */
+		bool changed() const { return m_changed.loadAcquire() != 0; }
+		/*! \brief The last read-only statement which returned rows,
+		for the GUI to show */
+		QString lastQuery() const;
+
+		/*! \brief True while the runner is waiting for resume().
+		The failed statement \a sql is at [\a start, \a end) of the
+		script. */
+		bool failed(QString & message, QString & sql,
+					qint64 & start, qint64 & end) const;
+
+		//! \brief Null if the script ran to the end, otherwise why it didn't
+		QString errorString() const { return m_error; }
+		bool wasCancelled() const { return m_cancelled.loadAcquire() != 0; }
+		/*! \brief What each statement of the editor's text cost, once the
+		runner has finished */
+		const QueryProfiler & profiler() const { return m_profiler; }
+
+		/*! \brief Where the statement starting at \a p ends, according to
+		sqlite3_complete() */
+		static const char * statementEnd(const char * p, const char * end);
+
+	public slots:
+		//! \brief Go on after a failure, or give up if \a ignore is false
+		void resume(bool ignore);
+		//! \brief Stop as soon as possible, and roll back if in one savepoint
+		void cancel();
+
+	protected:
+		void run();
+
+	private:
+		/*! \brief The first word of the statement at [\a p, \a end) in
+		upper case, after any white space and comments */
+		static QByteArray firstWord(const char * p, const char * end);
+		/*! \brief True if the statement at [\a p, \a end) can't be run in
+		one of our transactions, because it is about transactions itself or
+		sqlite won't run it in one */
+		static bool outsideBatch(const char * p, const char * end);
+		//! \brief Run the statements from \a p to \a end
+		bool runStatements(const char * p, const char * end);
+		/*! \brief Prepare the statement at \a p and step it to the end
+		\param tail set to where the next statement starts */
+		bool runStatement(const char * p, const char * end,
+						  const char *& tail);
+		bool exec(const char * sql);
+		//! \brief Wait for resume(), false to give up
+		bool waitForUser(const char * from, const char * to);
+		//! \brief Progress handler which interrupts a cancelled statement
+		static int progressHandler(void * cancelled);
+
+		QByteArray m_script;
+		QString m_fileName;
+		qint64 m_start;
+		qint64 m_size;
+		bool m_transaction;
+		sqlite3 * m_db;
+		const char * m_begin;
+
+		QAtomicInteger<qint64> m_first;
+		QAtomicInteger<qint64> m_offset;
+		QAtomicInteger<qint64> m_committed;
+		QAtomicInt m_statements;
+		QAtomicInt m_failures;
+		QAtomicInt m_changed;
+		QAtomicInt m_cancelled;
+		QString m_error;
+		QueryProfiler m_profiler;
+
+		mutable QMutex m_mutex;
+		QWaitCondition m_answered;
+		// the rest are guarded by m_mutex
+		QString m_lastQuery;
+		bool m_waiting;
+		bool m_ignore;
+		QString m_failure;
+		QString m_failureSql;
+		qint64 m_failureStart;
+		qint64 m_failureEnd;
+};
+
+#endif
@@ -16,13 +16,19 @@ for which a new license (GPL+exception) is in place.
 #include <QSqlError>
 #include <QShortcut>
 #include <QtCore/QDateTime>
+#include <QtCore/QElapsedTimer>
 
 #include <qscilexer.h>
 
+#include "catalogue.h"
 #include "createviewdialog.h"
 #include "database.h"
+#include "explainanalyzedialog.h"
+#include "indexadvisordialog.h"
 #include "preferences.h"
 #include "queryeditordialog.h"
+#include "querylint.h"
+#include "scriptrunner.h"
 #include "sqleditor.h"
 #include "sqlkeywords.h"
 #include "sqlmodels.h"
@@ -73,7 +79,11 @@ SqlEditor::SqlEditor(LiteManWindow * parent)
 	ui.actionRun_SQL->setIcon(Utils::getIcon("runsql.png"));
 	ui.actionRun_Explain->setIcon(Utils::getIcon("explain.png"));
 	ui.actionRun_ExplainQueryPlan->setIcon(Utils::getIcon("queryplan.png"));
+	ui.actionRun_ExplainAnalyze->setIcon(Utils::getIcon("queryplan.png"));
+	ui.actionIndex_Advisor->setIcon(Utils::getIcon("index.png"));
 	ui.actionRun_as_Script->setIcon(Utils::getIcon("runscript.png"));
+	ui.actionScript_Transaction->setIcon(
+		Utils::getIcon("database_commit.png"));
 	ui.action_Open->setIcon(Utils::getIcon("document-open.png"));
 	ui.action_Save->setIcon(Utils::getIcon("document-save.png"));
 	ui.action_New->setIcon(Utils::getIcon("document-new.png"));
@@ -86,10 +96,14 @@ SqlEditor::SqlEditor(LiteManWindow * parent)
 
     Preferences * prefs = Preferences::instance();
     restoreState(prefs->sqleditorState());
+    ui.actionScript_Transaction->setChecked(prefs->scriptTransaction());
 
     connect(ui.actionShow_History, SIGNAL(triggered()),
             this, SLOT(actionShow_History_triggered()));
     actionShow_History_triggered();
+    connect(ui.actionShow_Profile, SIGNAL(triggered()),
+            this, SLOT(actionShow_Profile_triggered()));
+    actionShow_Profile_triggered();
 
 	connect(ui.actionRun_SQL, SIGNAL(triggered()),
 			this, SLOT(actionRun_SQL_triggered()));
@@ -98,6 +112,10 @@ SqlEditor::SqlEditor(LiteManWindow * parent)
             this, SLOT(actionRun_SQL_triggered()));
 	connect(ui.actionRun_ExplainQueryPlan, SIGNAL(triggered()),
 			this, SLOT(actionRun_ExplainQueryPlan_triggered()));
+	connect(ui.actionRun_ExplainAnalyze, SIGNAL(triggered()),
+			this, SLOT(actionRun_ExplainAnalyze_triggered()));
+	connect(ui.actionIndex_Advisor, SIGNAL(triggered()),
+			this, SLOT(actionIndex_Advisor_triggered()));
 	connect(ui.actionRun_Explain, SIGNAL(triggered()),
 			this, SLOT(actionRun_Explain_triggered()));
 	connect(ui.actionRun_as_Script, SIGNAL(triggered()),
@@ -119,6 +137,9 @@ SqlEditor::SqlEditor(LiteManWindow * parent)
 	connect(parent, SIGNAL(prefsChanged()),
 			ui.sqlTextEdit, SLOT(prefsChanged()));
 
+	m_lint = new QueryLint(ui.sqlTextEdit, this);
+	connect(parent, SIGNAL(prefsChanged()), m_lint, SLOT(prefsChanged()));
+
 	// search
 	connect(ui.actionSearch, SIGNAL(triggered()),
             this, SLOT(actionSearch_triggered()));
@@ -137,6 +158,7 @@ SqlEditor::~SqlEditor()
 {
     Preferences * prefs = Preferences::instance();
     prefs->setsqleditorState(saveState());
+    prefs->setscriptTransaction(ui.actionScript_Transaction->isChecked());
 }
 
 void SqlEditor::setStatusMessage(const QString & message)
@@ -146,6 +168,11 @@ void SqlEditor::setStatusMessage(const QString & message)
 	ui.statusBar->showMessage(message);
 }
 
+void SqlEditor::closeReaders()
+{
+	m_lint->closeReader();
+}
+
 QString SqlEditor::query(bool creatingView)
 {
 	toSQLParse::editorTokenizer tokens(ui.sqlTextEdit);
@@ -264,12 +291,35 @@ void SqlEditor::actionRun_SQL_triggered()
         return;
 	} else {
         setStatusMessage();
-        QTime time;
+        QueryProfiler profiler;
+        profiler.start(Database::sqlite3handle());
+        // Qt prepares it where it can't be timed
+        profiler.prepare(sql);
+        QElapsedTimer time;
         time.start();
         SqlQueryModel * model = new SqlQueryModel(creator);
         model->setQuery(sql, QSqlDatabase::database(SESSION_NAME));
-        setStatusMessage(
-            tr("Duration: %1 seconds").arg(time.elapsed() / 1000.0));
+        if (Utils::rollsBack(sql)) { Catalogue::rolledBack(); }
+        qint64 elapsed = time.nsecsElapsed();
+        profiler.finished(model->columnCount() > 0
+                          ? model->rowCount()
+                          : model->query().numRowsAffected());
+        profiler.stop();
+        if (profiler.profiles().isEmpty())
+        {
+            setStatusMessage(
+                tr("Duration: %1 seconds").arg(elapsed / 1e9));
+        }
+        else
+        {
+            // the rest is Qt reading the rows into the model
+            setStatusMessage(
+                tr("Duration: %1 seconds, sqlite %2 ms")
+                .arg(elapsed / 1e9)
+                .arg(QueryProfiler::formatTime(
+                    profiler.profiles().last().run)));
+            appendProfile(profiler);
+        }
         if(model->lastError().isValid()) {
             QString s1(model->lastError().driverText());
             QString s2(model->lastError().databaseText());
@@ -319,102 +369,176 @@ void SqlEditor::actionRun_ExplainQueryPlan_triggered()
     }
 }
 
+void SqlEditor::actionRun_ExplainAnalyze_triggered()
+{
+	QString sql(query(false));
+	if (sql.isNull() || sql.trimmed().isEmpty())
+	{
+		QMessageBox::warning(this, tr("No SQL statement"), tr("You are trying to run an empty SQL query. Hint: select your query in the editor"));
+		return;
+	}
+	if ((!creator) || !(creator->checkForPending())) { return; }
+	setStatusMessage();
+
+	ExplainAnalyze analyze(sql);
+	QProgressDialog progress(tr("Running the statement"), tr("Cancel"),
+							 0, 0, this);
+	connect(&progress, SIGNAL(canceled()), &analyze, SLOT(cancel()));
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(1000);
+	analyze.start();
+	while (!analyze.wait(100)) { qApp->processEvents(); }
+	progress.reset();
+
+	appendHistory(sql);
+	if (!analyze.errorString().isNull())
+	{
+		creator->setStatusText(
+			tr("Query Error: <span style=\" color:#ff0000;\">")
+			+ analyze.errorString()
+			+ "<br/></span>"
+			+ tr("using sql statement:")
+			+ "<br/><tt>"
+			+ sql);
+		return;
+	}
+	ExplainAnalyzeDialog dia(analyze, this);
+	dia.exec();
+}
+
+void SqlEditor::actionIndex_Advisor_triggered()
+{
+	if (!creator) { return; }
+	QStringList history;
+	for (int i = 0; i < ui.historyTreeWidget->topLevelItemCount(); ++i)
+	{
+		history.append(ui.historyTreeWidget->topLevelItem(i)->text(0));
+	}
+	IndexAdvisorDialog dia(ui.sqlTextEdit->text(), history, creator);
+	dia.exec();
+}
+
+void SqlEditor::selectScript(int from, int to)
+{
+	int fromLine, fromIndex, toLine, toIndex;
+	ui.sqlTextEdit->lineIndexFromPosition(from, &fromLine, &fromIndex);
+	ui.sqlTextEdit->lineIndexFromPosition(to, &toLine, &toIndex);
+	ui.sqlTextEdit->setSelection(fromLine, fromIndex, toLine, toIndex);
+}
+
 void SqlEditor::actionRun_as_Script_triggered()
 {
 	if ((!creator) || !(creator->checkForPending())) { return; }
-	SqlQueryModel * model = 0;
-	bool callDetaches = false;
-	bool rebuildTree = false;
-	bool updateTable = false;
-	m_scriptCancelled = false;
-	toSQLParse::editorTokenizer tokens(ui.sqlTextEdit);
 	int cpos, cline;
 	ui.sqlTextEdit->getCursorPosition(&cline, &cpos);
-	QString sql;
-	int line;
-	int pos;
-	QProgressDialog * dialog = 0;
-	QSqlQuery query(QSqlDatabase::database(SESSION_NAME));
+	// The runner works on a copy, so the editor is left alone until the
+	// script has finished or a statement fails. In UTF-8, offsets in the
+	// copy are the editor's positions.
+	QByteArray script(ui.sqlTextEdit->text().toUtf8());
+	int start = ui.sqlTextEdit->positionFromLineIndex(cline, cpos);
+	QStringList databases(Database::getDatabases().keys());
+	ScriptRunner runner(script, start, ui.actionScript_Transaction->isChecked());
+
+	QProgressDialog progress(tr("Executing all statements"), tr("Cancel"),
+							 0, 1000, this);
+	connect(&progress, SIGNAL(canceled()), &runner, SLOT(cancel()));
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(1000);
+	emit sqlScriptStart();
+	emit showSqlScriptResult("-- " + tr("Script started"));
+	QElapsedTimer time;
+	time.start();
+	runner.start();
 	bool isError = false;
-	do
+	while (!runner.wait(100))
 	{
-		line = tokens.line();
-		pos = tokens.offset();
+		QString message, sql;
+		qint64 from, to;
+		if (runner.failed(message, sql, from, to))
+		{
+			selectScript(int(from), int(to));
+			int line, index;
+			ui.sqlTextEdit->lineIndexFromPosition(int(from), &line, &index);
+			emit showSqlScriptResult(sql);
+			emit showSqlScriptResult("-- " + tr("Error: %1.").arg(message));
+			int com = QMessageBox::question(this, tr("Run as Script"),
+					tr("This script contains the following error:\n")
+					+ message
+					+ tr("\nAt line: %1").arg(line + 1),
+					QMessageBox::Ignore, QMessageBox::Abort);
+			isError = (com == QMessageBox::Abort);
+			runner.resume(!isError);
+		}
+		int done = runner.offset() - runner.firstOffset();
+		int size = runner.size() - runner.firstOffset();
+		progress.setLabelText(
+			tr("Executing all statements\n%1 statements, %2 of %3 KB")
+			.arg(runner.statements()).arg(done / 1024).arg(size / 1024));
+		if (size > 0) { progress.setValue(qint64(done) * 1000 / size); }
 		qApp->processEvents();
-		if (m_scriptCancelled)
-			break;
-		toSQLParse::parseStatement(tokens);
-        if (   tokens.line() < cline
-            || (tokens.line() == cline && tokens.offset() < cpos))
-        { continue; }
-        sql = prepareExec(tokens, line, pos);
-        if (sql.trimmed().isEmpty()) { continue; }
-        if (dialog == 0) {
-            dialog = new QProgressDialog(tr("Executing all statements"),
-                         tr("Cancel"), 0, ui.sqlTextEdit->lines(), this);
-            dialog->setValue(line);
-            connect(dialog, SIGNAL(canceled()), this, SLOT(scriptCancelled()));
-            emit sqlScriptStart();
-            emit showSqlScriptResult("-- " + tr("Script started"));
-        }
-        emit showSqlScriptResult(sql);
-        SqlQueryModel * mdl = new SqlQueryModel(creator);
-        mdl->setQuery(sql, QSqlDatabase::database(SESSION_NAME));
-        appendHistory(sql);
-        if (mdl->lastError().isValid())
-        {
-            QString s1(mdl->lastError().driverText());
-            QString s2(mdl->lastError().databaseText());
-            if (s1.size() > 0) {
-                if (s2.size() > 0) {
-                    s1.append(" ").append(s2);
-                }
-            } else { s1 = s2; }
-            emit showSqlScriptResult(
-                "-- " + tr("Error: %1.").arg(mdl->lastError().text()));
-            int com = QMessageBox::question(this, tr("Run as Script"),
-                    tr("This script contains the following error:\n")
-                    + s1
-                    + tr("\nAt line: %1").arg(line),
-                    QMessageBox::Ignore, QMessageBox::Abort);
-            if (com == QMessageBox::Abort)
-            {
-                scriptCancelled();
-                isError = true;
-                break;
-            }
-        }
-        else
-        {
-            if (Utils::detaches(sql)) { callDetaches = true; }
-            if (Utils::updateObjectTree(sql)) { rebuildTree = true; }
-            if (Utils::updateTables(sql)) { updateTable = true; }
-            emit showSqlScriptResult("-- " + tr("No error"));
-            if (mdl->rowCount() > 0) {
-                model = mdl;
-            } else {
-                delete mdl;
-            }
-        }
-        emit showSqlScriptResult("--");
-	} while (tokens.line() < ui.sqlTextEdit->lines());
-	ui.sqlTextEdit->setSelection(cline, cpos, tokens.line(), tokens.offset());
-    if (dialog == 0) {
-        QMessageBox::warning(this, tr("No SQL statement"),
-            tr("There are no SQL statments to execute after the cursor"));
-    } else {
-        delete dialog;
-        if (!isError)
-            emit showSqlScriptResult("-- " + tr("Script finished"));
-		if (callDetaches) { creator->detaches(); }
-        if (rebuildTree) { emit buildTree(); }
-        if (updateTable) { emit refreshTable(); }
-        if (model)
-        {
-            creator->setTableModel(model);
-        }
-        creator->buildPragmasTree();
-    }
+	}
+	progress.reset();
+
+	if ((runner.statements() == 0) && (runner.failures() == 0))
+	{
+		emit showSqlScriptResult("--");
+		QMessageBox::warning(this, tr("No SQL statement"),
+			tr("There are no SQL statments to execute after the cursor"));
+		return;
+	}
+	if (!isError)
+	{
+		selectScript(int(runner.firstOffset()), int(runner.offset()));
+	}
+	if (runner.wasCancelled())
+	{
+		emit showSqlScriptResult("-- " + tr("Script was cancelled by user"));
+	}
+	else if (!isError && !runner.errorString().isNull())
+	{
+		emit showSqlScriptResult(
+			"-- " + tr("Error: %1.").arg(runner.errorString()));
+	}
+	else if (!isError)
+	{
+		emit showSqlScriptResult("-- " + tr("Script finished"));
+	}
+	emit showSqlScriptResult(
+		"-- " + tr("%1 statements, %2 errors, %3 seconds")
+		.arg(runner.statements()).arg(runner.failures())
+		.arg(time.elapsed() / 1000.0));
+	appendProfile(runner.profiler(),
+				  tr("Script: %1 statements").arg(runner.statements()));
+
+	if (runner.changed())
+	{
+		if (Database::getDatabases().keys() != databases)
+		{
+			creator->detaches();
+		}
+		emit buildTree();
+		emit refreshTable();
+	}
+	QString sql(runner.lastQuery());
+	if (!sql.isEmpty())
+	{
+		// The runner only counted its rows, so it is read-only and can be
+		// run again to show them, but say so: they are what it returns
+		// now, not what the script saw.
+		emit showSqlScriptResult("-- "
+			+ tr("Running the last query again to show its rows"));
+		SqlQueryModel * model = new SqlQueryModel(creator);
+		model->setQuery(sql, QSqlDatabase::database(SESSION_NAME));
+		appendHistory(sql);
+		if (model->rowCount() > 0) {
+			creator->setTableModel(model);
+			creator->setStatusText(
+				tr("The script's last query, run again after the script"
+				   " to show its rows:")
+				+ "<br/><tt>" + sql);
+		} else { delete model; }
+	}
+	creator->buildPragmasTree();
 }
 
 void SqlEditor::actionCreateView_triggered()
@@ -519,6 +643,84 @@ void SqlEditor::appendHistory(const QString & sql)
         delete ui.historyTreeWidget->takeTopLevelItem(0);
 }
 
+void SqlEditor::appendProfile(const QueryProfiler & profiler,
+							  const QString & title)
+{
+	const QList<StatementProfile> & profiles = profiler.profiles();
+	if (profiles.isEmpty()) { return; }
+	QTreeWidget * tree = ui.profileTreeWidget;
+	QTreeWidgetItem * top = new QTreeWidgetItem();
+	// totals for a script, each statement under them
+	StatementProfile total = profiles.first();
+	if (!title.isNull())
+	{
+		total.sql = title;
+		total.start = total.prepare = total.run = total.rows = 0;
+		total.vmSteps = total.fullScanSteps = total.sorts = 0;
+		total.autoIndexes = 0;
+		total.cacheHits = total.cacheMisses = total.cacheWrites = 0;
+		for (int i = 0; i < profiles.count(); ++i)
+		{
+			const StatementProfile & p = profiles.at(i);
+			total.prepare += qMax(p.prepare, qint64(0));
+			total.run += p.run;
+			total.rows += qMax(p.rows, qint64(0));
+			total.vmSteps += p.vmSteps;
+			total.fullScanSteps += p.fullScanSteps;
+			total.sorts += p.sorts;
+			total.autoIndexes += p.autoIndexes;
+			total.cacheHits += p.cacheHits;
+			total.cacheMisses += p.cacheMisses;
+			total.cacheWrites += p.cacheWrites;
+		}
+	}
+	QList<StatementProfile> items;
+	items.append(total);
+	if (!title.isNull()) { items += profiles; }
+	for (int i = 0; i < items.count(); ++i)
+	{
+		const StatementProfile & p = items.at(i);
+		QTreeWidgetItem * item = (i == 0) ? top : new QTreeWidgetItem(top);
+		item->setText(0, p.sql.simplified());
+		item->setToolTip(0, p.sql);
+		if (i > 0) { item->setText(1, QueryProfiler::formatTime(p.start)); }
+		item->setText(2, QueryProfiler::formatTime(p.prepare));
+		item->setText(3, QueryProfiler::formatTime(p.run));
+		if (p.rows >= 0) { item->setText(4, QString::number(p.rows)); }
+		item->setText(5, QString::number(p.vmSteps));
+		item->setText(6, QString::number(p.fullScanSteps));
+		item->setText(7, QString::number(p.sorts));
+		item->setText(8, QString::number(p.autoIndexes));
+		item->setText(9, QString::number(p.cacheHits));
+		item->setText(10, QString::number(p.cacheMisses));
+		item->setText(11, QString::number(p.cacheWrites));
+		for (int c = 1; c < tree->columnCount(); ++c)
+		{
+			item->setTextAlignment(c, Qt::AlignRight);
+		}
+	}
+	if (profiler.dropped() > 0)
+	{
+		new QTreeWidgetItem(top, QStringList(
+			tr("%1 more statements were not kept")
+			.arg(profiler.dropped())));
+	}
+	tree->addTopLevelItem(top);
+	tree->scrollToItem(top);
+	if (tree->topLevelItemCount() > 30)
+		delete tree->takeTopLevelItem(0);
+}
+
+void SqlEditor::actionShow_Profile_triggered()
+{
+	emit showSqlScriptResult("");
+	ui.profileTreeWidget->setVisible(ui.actionShow_Profile->isChecked());
+	ui.actionShow_Profile->setToolTip(
+		ui.profileTreeWidget->isVisible()
+			? tr("Hide what each statement run cost (Ctrl+Shift+P)")
+			: tr("Show what each statement run cost (Ctrl+Shift+P)"));
+}
+
 void SqlEditor::actionShow_History_triggered()
 {
 	emit showSqlScriptResult("");
@@ -718,12 +920,6 @@ void SqlEditor::setFileWatcher(const QString & newFileName)
 	m_fileWatcher->addPath(newFileName);
 }
 
-void SqlEditor::scriptCancelled()
-{
-	emit showSqlScriptResult("-- " + tr("Script was cancelled by user"));
-	m_scriptCancelled = true;
-}
-
 void SqlEditor::updateVisibility()
 {
     creator->actToggleSqlEditorToolBar->setChecked(ui.toolBar->isVisible());
@@ -12,12 +12,14 @@ for which a new license (GPL+exception) is in place.
 #include <QtCore/QFileSystemWatcher>
 
 #include "litemanwindow.h"
+#include "queryprofiler.h"
 #include "ui_sqleditor.h"
 #include "sqlparser/tosqlparse.h"
 
 class QTextDocument;
 class QLabel;
 class QProgressDialog;
+class QueryLint;
 
 
 /*!
@@ -41,6 +43,10 @@ class SqlEditor : public QMainWindow
 
 		void setStatusMessage(const QString & message = 0);
 
+		/*! \brief Close the connection the query plans are checked on.
+		See TableTree::closeReaders(). */
+		void closeReaders();
+
    	signals:
 		//! \brief It's emitted when the script is started
 		void sqlScriptStart();
@@ -59,6 +65,7 @@ class SqlEditor : public QMainWindow
 
 		QString m_fileName;
 		QFileSystemWatcher * m_fileWatcher;
+		QueryLint * m_lint;
 
 		QLabel * changedLabel;
 		QLabel * cursorLabel;
@@ -67,7 +74,6 @@ class SqlEditor : public QMainWindow
 
 		//! \brief True when user cancel file opening
 		bool canceled;
-		bool m_scriptCancelled;
 		//! \brief Handle long files (prevent app "freezing")
 		QProgressDialog * progress;
 		/*! \brief A helper method for progress.
@@ -77,6 +83,10 @@ class SqlEditor : public QMainWindow
 
 
         void appendHistory(const QString & sql);
+		/*! \brief Add what \a profiler found to the profile panel
+		\param title for a script, otherwise its only statement is used */
+		void appendProfile(const QueryProfiler & profiler,
+						   const QString & title = QString());
 
 		bool changedConfirm();
 		void saveFile();
@@ -88,6 +98,8 @@ class SqlEditor : public QMainWindow
 		QString query(bool creatingView);
 		//! \brief From TOra
 		QString prepareExec(toSQLParse::tokenizer &tokens, int line, int pos);
+		//! \brief Select from \a from to \a to, as UTF-8 offsets
+		void selectScript(int from, int to);
 
 		void find(QString ttf, bool forward/*, bool backward*/);
 
@@ -102,6 +114,8 @@ class SqlEditor : public QMainWindow
 		void actionRun_SQL_triggered();
 		void actionRun_Explain_triggered();
 		void actionRun_ExplainQueryPlan_triggered();
+		void actionRun_ExplainAnalyze_triggered();
+		void actionIndex_Advisor_triggered();
 		void action_Open_triggered();
 		void action_Save_triggered();
 		void action_New_triggered();
@@ -117,10 +131,9 @@ class SqlEditor : public QMainWindow
 		void findNext();
 
         void actionShow_History_triggered();
+		void actionShow_Profile_triggered();
 		//! \brief Watch file for changes from external apps
 		void externalFileChange(const QString & path);
-		//
-		void scriptCancelled();
     public slots:
 		void actionRun_as_Script_triggered();
         void updateVisibility();
@@ -25,7 +25,10 @@ for which a new license (GPL+exception) is in place.
 SqlEditorWidget::SqlEditorWidget(QWidget * parent)
 	: QsciScintilla(parent),
       m_searchText(""),
-      m_searchIndicator(9) // see QsciScintilla docs
+      m_searchIndicator(9), // see QsciScintilla docs
+      m_lintIndicator(10),
+      m_lintStyle(-1, "lint", QColor(128, 64, 0), QColor(255, 240, 210),
+                  QFont())
 {
 	QsciLexerSQL * lexer = new QsciLexerSQL(this);
 	m_prefs = Preferences::instance();
@@ -73,6 +76,13 @@ SqlEditorWidget::SqlEditorWidget(QWidget * parent)
     SendScintilla(QsciScintilla::SCI_INDICSETUNDER, m_searchIndicator, 1);
     // end of search all occurrences
 
+    // query plan warnings: a squiggle under the text, a mark in the
+    // symbol margin and the warnings in a box under the line
+    SendScintilla(QsciScintilla::SCI_INDICSETSTYLE, m_lintIndicator, QsciScintilla::INDIC_SQUIGGLE);
+    SendScintilla(QsciScintilla::SCI_INDICSETFORE, m_lintIndicator, QColor(230, 120, 0));
+    m_lintMarker = markerDefine(QsciScintilla::Circle);
+    setAnnotationDisplay(QsciScintilla::AnnotationBoxed);
+
 	connect(this, SIGNAL(linesChanged()),
 			this, SLOT(linesChanged()));
 #if 0
@@ -130,6 +140,26 @@ void SqlEditorWidget::highlightAllOccurrences(const QString & s,
     }
 }
 
+void SqlEditorWidget::clearLint()
+{
+    SendScintilla(QsciScintilla::SCI_SETINDICATORCURRENT, m_lintIndicator);
+    SendScintilla(QsciScintilla::SCI_INDICATORCLEARRANGE, 0, length());
+    markerDeleteAll(m_lintMarker);
+    clearAnnotations();
+}
+
+void SqlEditorWidget::markLint(int start, int length)
+{
+    SendScintilla(QsciScintilla::SCI_SETINDICATORCURRENT, m_lintIndicator);
+    SendScintilla(QsciScintilla::SCI_INDICATORFILLRANGE, start, length);
+}
+
+void SqlEditorWidget::annotateLint(int line, const QString & text)
+{
+    markerAdd(line, m_lintMarker);
+    annotate(line, text, m_lintStyle);
+}
+
 void SqlEditorWidget::keyPressEvent(QKeyEvent * e)
 {
 	// handle editor shortcuts with TAB
@@ -215,4 +245,7 @@ void SqlEditorWidget::prefsChanged()
 
 	setMarkerBackgroundColor(m_prefs->activeHighlighting() ?
 								m_prefs->activeHighlightColor() : paper());
+	// that set every marker's
+	setMarkerBackgroundColor(QColor(230, 120, 0), m_lintMarker);
+	m_lintStyle.setFont(m_prefs->sqlFont());
 }
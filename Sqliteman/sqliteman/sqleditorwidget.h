@@ -8,6 +8,7 @@ for which a new license (GPL+exception) is in place.
 #define SQLEDITORWIDGET_H
 
 #include <qsciscintilla.h>
+#include <qscistyle.h>
 
 class Preferences;
 
@@ -31,6 +32,13 @@ class SqlEditorWidget : public QsciScintilla/*QTextEdit*/
                                       bool caseSensitive,
                                       bool wholeWords);
 
+        //! \brief Remove everything QueryLint has shown.
+        void clearLint();
+        //! \brief Underline \a length bytes from \a start as slow.
+        void markLint(int start, int length);
+        //! \brief Show \a text under \a line, with a mark in the margin.
+        void annotateLint(int line, const QString & text);
+
 	public slots:
 		//! \brief Apply new preferences for editor.
 		void prefsChanged();
@@ -42,6 +50,10 @@ class SqlEditorWidget : public QsciScintilla/*QTextEdit*/
         QString m_searchText;
         //! Highligh all occurrences of m_searchText QScintilla indicator
         int m_searchIndicator;
+        //! QueryLint's QScintilla indicator, marker and annotation style
+        int m_lintIndicator;
+        int m_lintMarker;
+        QsciStyle m_lintStyle;
 
 		void keyPressEvent(QKeyEvent * e);
 
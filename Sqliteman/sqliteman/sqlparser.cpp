@@ -32,67 +32,107 @@ namespace { // local to this file (and therefore static)
     QStringList afterNOTs({"BETWEEN", "GLOB", "IN", "LIKE",
                            "MATCH", "REGEXP"});
     // used to save creating one whenever needed
-    Token nullToken = {"", tokenNone};
+    Token nullToken = {"", 0, 0, tokenNone};
     // used to save creating one whenever needed
     Expression nullExpression = {"", exprNull, NULL, nullToken, NULL, ""};
     // Last token used as argument for tosString(),
     // used to insert spaces when needed to separate tokens.
     Token m_lastToString;
+
+    // Whether s is the keyword k in any case, without making a QString of s
+    bool is(const QStringRef & s, const char * k)
+    {
+        return s.compare(QLatin1String(k), Qt::CaseInsensitive) == 0;
+    }
+}
+
+bool Token::is(const char * keyword) const
+{
+	return ref().compare(QLatin1String(keyword), Qt::CaseInsensitive) == 0;
+}
+
+bool Token::isIn(const QStringList & keywords) const
+{
+	QStringRef s(ref());
+	QStringList::const_iterator i;
+	for (i = keywords.constBegin(); i != keywords.constEnd(); ++i)
+	{
+		if (s.compare(*i, Qt::CaseInsensitive) == 0) { return true; }
+	}
+	return false;
+}
+
+void Token::setName(const QString & name)
+{
+	source = name;
+	start = 0;
+	length = name.length();
 }
 
 SqlParser::SqlParser() {
     m_fields = QList<FieldInfo>();
     m_columns = QList<Expression *>();
     m_whereClause = NULL;
+    m_blockUsed = 0;
     m_tokens = QList<Token>();
     m_lastToString = nullToken;
 }
 
 // state machine tokeniser
-QList<Token> SqlParser::tokenise(QString input)
+// This walks along the input by position rather than removing each character
+// as it is read, which made tokenising a long schema quadratic. A token
+// doesn't copy its name out of the input but keeps where it starts and how
+// long it is, so the only string made here is for a quoted name with a
+// doubled quote in it.
+QList<Token> SqlParser::tokenise(const QString & input)
 {
 	static const QString hexDigit("0123456789ABCDEFabcdef");
 	QList<Token> result = QList<Token>();
-	while (!input.isEmpty())
+	const int n = input.size();
+	int pos = 0;
+	while (pos < n)
 	{
 		Token t;
+		t.source = input; // shares the input's characters
+		t.start = 0;
+		t.length = 0;
 		t.type = tokenNone;
 		int state = 0; // nothing
+		int start = pos; // where the token starts
+		bool doubled = false; // quoted token contains a doubled quote
 		while (1)
 		{
-			QChar c = input.isEmpty() ? 0 : input.at(0);
+			bool atEnd = (pos >= n);
+			QChar c = atEnd ? QChar(0) : input.at(pos);
 			switch (state)
 			{
 				case 0: // nothing
-					if (c.isSpace()) {
-						input.remove(0, 1);
+					start = pos;
+					if (atEnd) {
+						break;
+					} else if (c.isSpace()) {
+						++pos;
 						continue; // ignore it
 					} else if (c == '0') {
-                        t.type = tokenNumeric;
+						t.type = tokenNumeric;
 						state = 1; // had initial 0
 					} else if (c.isDigit()) {
-                        t.type = tokenNumeric;
+						t.type = tokenNumeric;
 						state = 3; // in number, no . or E yet
 					} else if (c == '.') {
-                        t.type = tokenNumeric;
+						t.type = tokenNumeric;
 						state = 2; // had initial .
 					} else if (c.toUpper() == 'X') {
 						state = 8; // blob literal or identifier
 					} else if (c.isLetter() || (c == '_')) {
-                        t.type = tokenIdentifier;
+						t.type = tokenIdentifier;
 						state = 10; // identifier
 					} else if (c == '"') {
-						t.name = QString(""); // empty, not null
-                        t.type = tokenQuotedIdentifier;
+						t.type = tokenQuotedIdentifier;
 						state = 11; // "quoted identifier"
-						input.remove(0, 1);
-						continue;
 					} else if (c == '\'') {
-						t.name = QString(""); // empty, not null
-                        t.type = tokenStringLiteral;
+						t.type = tokenStringLiteral;
 						state = 13; // 'string literal'
-						input.remove(0, 1);
-						continue;
 					} else if (c == '|') {
 						state = 15; // check for ||
 					} else if (c == '<') {
@@ -104,83 +144,49 @@ QList<Token> SqlParser::tokenise(QString input)
 					} else if (c == '!') {
 						state = 19; // check for !=
 					} else if (c == '[') {
-						t.name = QString(""); // empty, not null
-                        t.type = tokenSquareIdentifier;
+						t.type = tokenSquareIdentifier;
 						state = 20; // [quoted identifier]
-						input.remove(0, 1);
-						continue;
 					} else if (c == '`') {
-						t.name = QString(""); // empty, not null
-                        t.type = tokenBackQuotedIdentifier;
+						t.type = tokenBackQuotedIdentifier;
 						state = 21; // `quoted identifier`
-						input.remove(0, 1);
-						continue;
-					} else if (c == 0) {
-                        break;
 					} else {
 						// single character token
-                        if (c == '/') {
-                            input.remove(0, 1);
-                            if (!input.isEmpty()) {
-                                if (input.at(0) == '*') {
-                                    // /* comment, skip until */
-                                    bool star = false;
-                                    while (!input.isEmpty())
-                                    {
-                                        c = input.at(0);
-                                        input.remove(0, 1);
-                                        if (star) {
-                                            if (c == '/') { break ; }
-                                            star = false;
-                                        } else {
-                                        }
-                                        star = (c == '*');
-                                    }
-                                    continue;
-                                }
-                            }
-                            t.type = tokenOperator;
-                            t.name = "/";
-                            break;
-                        } else if (   (c == '*')
-                                   || (c == '%')
-                                   || (c == '&'))
+						++pos;
+						if (c == '/') {
+							if ((pos < n) && (input.at(pos) == '*')) {
+								// /* comment, skip until */
+								int end = input.indexOf("*/", pos);
+								pos = (end < 0) ? n : end + 2;
+								continue;
+							}
+							t.type = tokenOperator;
+						} else if (   (c == '*')
+								   || (c == '%')
+								   || (c == '&'))
 						{ t.type = tokenOperator; }
 						else if (c == '~')
 						{ t.type = tokenPrefix; }
 						else if (c == '(')
 						{ t.type = tokenOpen; }
-                        else if (c == ',')
+						else if (c == ',')
 						{ t.type = tokenComma; }
-                        else if (c == ')')
+						else if (c == ')')
 						{ t.type = tokenClose; }
 						else if (c == '+')
 						{ t.type = tokenPlusMinus; }
 						else if (c == '-') {
-                            input.remove(0, 1);
-                            if (!input.isEmpty()) {
-                                if (input.at(0) == '-') {
-                                    // -- comment, skip until end of line
-                                    while (!input.isEmpty())
-                                    {
-                                        c = input.at(0);
-                                        input.remove(0, 1);
-                                        if (c == '\n') { break ; }
-                                    }
-                                    continue;
-                                }
-                            }
-                            t.type = tokenPlusMinus;
-                            t.name = "-";
-                            break;
-                        }
+							if ((pos < n) && (input.at(pos) == '-')) {
+								// -- comment, skip until end of line
+								int end = input.indexOf('\n', pos + 1);
+								pos = (end < 0) ? n : end + 1;
+								continue;
+							}
+							t.type = tokenPlusMinus;
+						}
 						else { t.type = tokenInvalid; }
-						t.name.append(c);
-						input.remove(0, 1);
 						break;
 					}
-					t.name.append(c);
-					input.remove(0, 1);
+					++pos;
 					continue;
 				case 1: // had initial 0
 					if (c.isDigit()) {
@@ -194,8 +200,7 @@ QList<Token> SqlParser::tokenise(QString input)
 					} else { // token is just 0
 						break;
 					}
-					t.name.append(c);
-					input.remove(0, 1);
+					++pos;
 					continue;
 				case 2: // had initial .
 					if (c.isDigit()) {
@@ -204,8 +209,7 @@ QList<Token> SqlParser::tokenise(QString input)
 						t.type = tokenInvalid;
 						break;
 					}
-					t.name.append(c);
-					input.remove(0, 1);
+					++pos;
 					continue;
 				case 3: // in number, no . or E yet
 					if (c == '.') {
@@ -215,45 +219,39 @@ QList<Token> SqlParser::tokenise(QString input)
 					} else if (!c.isDigit()) {
 						break; // end of number
 					}
-					t.name.append(c);
-					input.remove(0, 1);
+					++pos;
 					continue;
 				case 4: // in number, had .
 					if (c.toUpper() == 'E') {
 						state = 5; // in number, just had E
-                    } else if (c == '.' ) {
+					} else if (c == '.' ) {
 						t.type = tokenInvalid;
 					} else if (!c.isDigit()) {
-                        break; // end of number
+						break; // end of number
 					}
-					t.name.append(c);
-					input.remove(0, 1);
+					++pos;
 					continue;
 				case 5: // in number, just had E
 					if (c.isDigit() || (c == '-') || (c == '+')) {
 						state = 6; // in number after E
-						t.name.append(c);
-						input.remove(0, 1);
+						++pos;
 						continue;
 					}
 					t.type = tokenInvalid;
 					break; // invalid, end number
 				case 6: // in number after E
 					if (c.isDigit()) {
-						t.name.append(c);
-						input.remove(0, 1);
+						++pos;
 						continue;
 					} else if ((c == '.') || (c.toLower() == 'e')) {
-                        t.type = tokenInvalid;
-						t.name.append(c);
-						input.remove(0, 1);
+						t.type = tokenInvalid;
+						++pos;
 						continue;
-                    }
+					}
 					break; // end number
 				case 7: // in hex literal
-					if (hexDigit.contains(c)) {
-						t.name.append(c);
-						input.remove(0, 1);
+					if (!atEnd && hexDigit.contains(c)) {
+						++pos;
 						continue;
 					}
 					break; // end (hex) number
@@ -270,148 +268,120 @@ QList<Token> SqlParser::tokenise(QString input)
 						t.type = tokenIdentifier;
 						break;
 					}
-					t.name.append(c);
-					input.remove(0, 1);
+					++pos;
 					continue;
 				case 9: // blob literal
-					if (c == '\'') {
-						t.name.append(c);
-						input.remove(0, 1);
+					if (atEnd) {
+						t.type = tokenInvalid;
+						break; // unterminated
+					} else if (c == '\'') {
+						++pos;
 						break; // end of blob literal
 					} else if (!hexDigit.contains(c)) {
-                        // invalid character in blob literal
+						// invalid character in blob literal
 						t.type = tokenInvalid;
-                        if (c == 0) { break; } // unterminated
 					}
-                    t.name.append(c);
-                    input.remove(0, 1);
-                    continue;
+					++pos;
+					continue;
 				case 10: // identifier
 					if (c.isLetterOrNumber() || (c == '_') || (c == '$')) {
-						t.name.append(c);
-						input.remove(0, 1);
+						++pos;
 						continue;
 					}
 					// end of identifier
-                    if (operators.contains(t.name, Qt::CaseInsensitive))
-                    { t.type = tokenOperatorA; }
-                    else if (posts.contains(t.name, Qt::CaseInsensitive))
-                    { t.type = tokenPostfixA; }
-                    else if (prefixes.contains(t.name, Qt::CaseInsensitive))
-                    { t.type = tokenPrefixA; }
-                    else if (t.name.compare("NOT", Qt::CaseInsensitive) == 0)
-                    { t.type = tokenNOT; }
-                    break;
-                case 11: // "quoted identifier"
-					if (c == '"') {
-						state = 12; // look for doubled "
-                    } else if (c == 0) {
-						t.type = tokenInvalid;
-                        break; // unterminated "quoted identifier"
-					} else { t.name.append(c); }
-					input.remove(0, 1);
-					continue;
-				case 12: // look for doubled "
-					if (c == '"') {
-						state = 11; // still in "quoted identifier"
-						t.name.append(c);
-						input.remove(0, 1);
-						continue;
-                    }
-					break; // end of quoted identifier
+					t.start = start;
+					t.length = pos - start;
+					if (t.isIn(operators)) { t.type = tokenOperatorA; }
+					else if (t.isIn(posts)) { t.type = tokenPostfixA; }
+					else if (t.isIn(prefixes)) { t.type = tokenPrefixA; }
+					else if (t.is("NOT"))
+					{ t.type = tokenNOT; }
+					break;
+				case 11: // "quoted identifier"
 				case 13: // 'string literal'
-					if (c == '\'')
-					{
-						state = 14; // look for doubled '
-					} else if (c == 0) {
+				case 21: // `quoted identifier`
+					if (atEnd) {
 						t.type = tokenInvalid;
-                        break; // unterminated 'string literal'
-                    } else {
-						t.name.append(c);
+						break; // unterminated
+					} else if (c == input.at(start)) {
+						state += 1; // look for doubled quote
 					}
-					input.remove(0, 1);
+					++pos;
 					continue;
+				case 12: // look for doubled "
 				case 14: // look for doubled '
-					if (c == '\'') {
-						state = 13; // string literal
-						t.name.append(c);
-						input.remove(0, 1);
+				case 22: // look for doubled `
+					if (c == input.at(start)) {
+						state -= 1; // still quoted
+						doubled = true;
+						++pos;
 						continue;
 					}
-					break; // end of string literal
+					break; // end of quoted token
 				case 15: // check for ||
-					if (c == '|') {
-						t.name.append(c);
-						input.remove(0, 1);
-					}
+					if (c == '|') { ++pos; }
 					t.type = tokenOperator;
 					break;
 				case 16: // check for << <> <=
 					if ((c == '<') || (c == '>') || (c == '='))
-					{
-						t.name.append(c);
-						input.remove(0, 1);
-					}
+					{ ++pos; }
 					t.type = tokenOperator;
 					break;
 				case 17: // check for >> >=
 					if ((c == '>') || (c == '='))
-					{
-						t.name.append(c);
-						input.remove(0, 1);
-					}
+					{ ++pos; }
 					t.type = tokenOperator;
 					break;
 				case 18: // check for ==
-					if (c == '=')
-					{
-						t.name.append(c);
-						input.remove(0, 1);
-					}
+					if (c == '=') { ++pos; }
 					t.type = tokenOperator;
 					break;
 				case 19: // had !, check for !=
 					if (c == '=') { t.type = tokenOperator; }
 					else { t.type = tokenInvalid; }
-                    t.name.append(c);
-                    input.remove(0, 1);
+					if (!atEnd) { ++pos; }
 					break;
 				case 20: // [quoted identifier]
-					if (c == ']') {
-						input.remove(0, 1);
-						break;
-					} else if (c == 0) {
-                        t.type = tokenInvalid;
-                        break; // unterminated [quoted identifier]
-                    }
-					t.name.append(c);
-					input.remove(0, 1);
-					continue;
-				case 21: // `quoted identifier`
-					if (c == '`') {
-						state = 22; // look for doubled `
-					} else if (c == 0) {
-                        t.type = tokenInvalid;
-                        break; // unterminated `quoted identifier`
-                    } else { t.name.append(c); }
-					input.remove(0, 1);
-					continue;
-				case 22:
-					if (c == '`') {
-						state = 21; // `quoted identifier`
-						t.name.append(c);
-						input.remove(0, 1);
-						continue;
+					if (atEnd) {
+						t.type = tokenInvalid;
+						break; // unterminated [quoted identifier]
 					}
-                    break;
+					++pos;
+					if (c == ']') { break; }
+					continue;
 			}
 			// if we didn't continue, we're at the end of the token
 			break;
 		}
-		if (t.type != tokenNone) {
-            result.append(t);
-            state = 0;
-        }
+		if (t.type == tokenNone) { continue; }
+		switch (state)
+		{
+			case 10: // name already taken to classify it
+				break;
+			case 20:
+				t.start = start + 1;
+				t.length = pos - start - ((t.type == tokenInvalid) ? 1 : 2);
+				break;
+			case 11: // unterminated, no closing quote
+			case 13:
+			case 21:
+			case 12: // between the quotes
+			case 14:
+			case 22:
+				t.start = start + 1;
+				t.length = pos - start - ((state % 2) ? 1 : 2);
+				if (doubled) // only now does the token need a name of its own
+				{
+					QString quote(input.at(start));
+					t.setName(t.name().replace(quote + quote, quote));
+				}
+				break;
+			default:
+				t.start = start;
+				t.length = pos - start;
+				break;
+		}
+		result.append(t);
 	}
 	return result;
 }
@@ -430,27 +400,27 @@ QString SqlParser::tos(const Token t)
 	{
 		case tokenQuotedIdentifier:
             if (m_lastToString.type == tokenQuotedIdentifier)
-            { result = " " + Utils::q(t.name); }
-            else { result = Utils::q(t.name); }
+            { result = " " + Utils::q(t.name()); }
+            else { result = Utils::q(t.name()); }
             break;
 		case tokenSquareIdentifier:
-			result = "[" + t.name + "]"; break;
+			result = "[" + t.name() + "]"; break;
 		case tokenBackQuotedIdentifier:
             if (m_lastToString.type == tokenBackQuotedIdentifier)
-            { result = " " + Utils::q(t.name, "`"); }
-            else { result = Utils::q(t.name, "`"); }
+            { result = " " + Utils::q(t.name(), "`"); }
+            else { result = Utils::q(t.name(), "`"); }
             break;
 		case tokenStringLiteral:
             if (   (m_lastToString.type == tokenStringLiteral)
                 || (m_lastToString.type == tokenBlobLiteral))
-            { result = " " + Utils::q(t.name, "'"); }
-            else { result = Utils::q(t.name, "'"); }
+            { result = " " + Utils::q(t.name(), "'"); }
+            else { result = Utils::q(t.name(), "'"); }
             break;
 		case tokenBlobLiteral:
             if (   (m_lastToString.type == tokenStringLiteral)
                 || (m_lastToString.type == tokenBlobLiteral))
-            { result = " " + t.name; }
-            else { result = t.name; }
+            { result = " " + t.name(); }
+            else { result = t.name(); }
             break;
 		case tokenIdentifier:
 		case tokenNumeric:
@@ -464,21 +434,21 @@ QString SqlParser::tos(const Token t)
                 || (m_lastToString.type == tokenPostfixA)
                 || (m_lastToString.type == tokenPrefixA)
                 || (m_lastToString.type == tokenNOT))
-            { result = " " + t.name; }
-            else { result = t.name; }
+            { result = " " + t.name(); }
+            else { result = t.name(); }
             break;
 		case tokenOpen:
 		case tokenComma:
 		case tokenClose:
-            result = t.name; break;
+            result = t.name(); break;
 		case tokenOperator:
 		case tokenPrefix:
 		case tokenPlusMinus:
             if (   (m_lastToString.type == tokenOperator)
                 || (m_lastToString.type == tokenPrefix)
                 || (m_lastToString.type == tokenPlusMinus))
-            { result = " " + t.name; }
-            else { result = t.name; }
+            { result = " " + t.name(); }
+            else { result = t.name(); }
             break;
 		default:
 			result = "";
@@ -487,25 +457,16 @@ QString SqlParser::tos(const Token t)
     return result;
 }
 
-void SqlParser::destroyExpression(Expression * e)
+// Expressions are only freed when the parser is, so they are taken from
+// blocks rather than allocated one at a time.
+Expression * SqlParser::newExpression()
 {
-	if (e == NULL) { return; }
-    switch (e->type) {
-        case exprNull: // empty argument list
-            return; // static, don't try to free it
-		case exprToken: // a single operand
-			break;
-		case exprOpX: // unary-prefix-operator expression
-            destroyExpression(e->right); break;
-		case exprXOpX: // expression binary-operator expression
-            destroyExpression(e->left); destroyExpression(e->right); break;
-		case exprXOp: // expression unary-postfix-operator
-		case exprExpr: // ( expression )
-			destroyExpression(e->left); break;
-		case exprCall: // fname (expression)
-            destroyExpression(e->right); break;
+	if (m_blocks.isEmpty() || (m_blockUsed == ExpressionBlock))
+	{
+		m_blocks.append(new Expression[ExpressionBlock]());
+		m_blockUsed = 0;
 	}
-    delete e;
+	return m_blocks.last() + m_blockUsed++;
 }
 
 // Parse expression from m_tokens with initial stats "state"
@@ -536,8 +497,7 @@ Expression * SqlParser::internalParser(
                     } else { return NULL; } // unmatched '('
                 } else if (   (level == 0)
                            && (m_tokens.at(0).type == tokenIdentifier)
-                           && ends.contains(
-                                m_tokens.at(0).name, Qt::CaseInsensitive))
+                           && m_tokens.at(0).isIn(ends))
                 { // empty expression is valid at level 0
                     return &nullExpression;
                 } else {
@@ -551,41 +511,38 @@ Expression * SqlParser::internalParser(
                     } else { return NULL; } // "()" expression or unmatched ')'
                 } else if (level == 1) { // in function call
                     if (   (t.type == tokenIdentifier)
-                        && (t.name.compare(
-                            "DISTINCT", Qt::CaseInsensitive) == 0))
+                        && (t.is("DISTINCT")))
                     {
                         // DISTINCT is a keyword here
                         // Treat it as a prefix operator
                         // but don't allow DISTINCT DISTINCT
-                        Expression * expr = new Expression;
+                        Expression * expr = newExpression();
                         expr->type = exprOpX;
+                        expr->terminal = t;
                         expr->terminal.type = tokenPrefixA;
-                        expr->terminal.name = t.name;
                         expr->right = internalParser(0, 1, QStringList());
                         if (   (expr->right == NULL)
                             || (   (expr->right->type == exprOpX)
                                 && (expr->right->terminal.type
                                         == tokenPrefixA)
-                                && (expr->right->terminal.name.compare(
-                                    "DISTINCT", Qt::CaseInsensitive) == 0)))
+                                && (expr->right->terminal.is("DISTINCT"))))
                         {
-                            destroyExpression(expr);
                             return NULL;
                         } else { return expr; }
                     } else if (   (t.type == tokenOperator)
-                               && (t.name == "*")
+                               && t.is("*")
                                && (m_tokens.size() > 0)
                                && (m_tokens.at(0).type == tokenClose))
                     { // (*) is a valid function argument list
                         m_tokens.removeFirst();
-                        Expression * expr = new Expression;
+                        Expression * expr = newExpression();
                         expr->type = exprToken;
+                        expr->terminal = t;
                         expr->terminal.type = tokenIdentifier;
-                        expr->terminal.name = t.name;
                         return expr;
                     }
                 } else if (level == 2) { // in bracketed expression
-                    if (t.name.compare("SELECT", Qt::CaseInsensitive) == 0){
+                    if (t.is("SELECT")){
                         // For the time being we don't handle a subquery
                         // because it is not allowed in a DEFAULT expression
                         // even if it returns a constant result.
@@ -600,8 +557,7 @@ Expression * SqlParser::internalParser(
                 if (m_tokens.isEmpty()) { // premature end of expression
                     return NULL;
                 } else if (   (m_tokens.at(0).type == tokenIdentifier)
-                           && ends.contains(
-                               m_tokens.at(0).name, Qt::CaseInsensitive))
+                           && m_tokens.at(0).isIn(ends))
                 {
                     if ((level == 0) || (level == 3)) {
                         return NULL; // premature end of expression
@@ -625,12 +581,11 @@ Expression * SqlParser::internalParser(
                           // must be a valid unquoted identifier, although the
                           // sqlite documentation doesn't explicitly say this.
                             m_tokens.removeFirst();
-                            expr = new Expression();
+                            expr = newExpression();
                             expr->type = exprCall; // function call
                             expr->terminal = t; // function name
                             expr->right = internalParser(0, 1, QStringList());
                             if (expr->right == NULL) { // invalid expression
-                                destroyExpression(expr);
                                 return NULL;
                             } else { // recursive call found (arglist)
                                 break; // got operand, fall into state 3
@@ -643,37 +598,34 @@ Expression * SqlParser::internalParser(
                     case tokenStringLiteral:
                     case tokenBlobLiteral:
                     case tokenNumeric:
-                        expr = new Expression();
+                        expr = newExpression();
                         expr->type = exprToken;
                         expr->terminal = t;
                         break; // got operand, fall into state 3
                     case tokenPrefix:
                     case tokenPrefixA:
                     case tokenPlusMinus: // prefixes
-                        if (t.name.compare(
-                            "CASE", Qt::CaseInsensitive) == 0)
+                        if (t.is("CASE"))
                         {
                             QString sp;
                             if (m_tokens.isEmpty()) { return NULL; }
                             else if (m_tokens.at(0).type == tokenWhitespace) {
-                                sp = m_tokens.takeFirst().name;
+                                sp = m_tokens.takeFirst().name();
                                 if (m_tokens.isEmpty()) { return NULL; }
-                            } else if (m_tokens.at(0).name.compare(
-                                     "WHEN", Qt::CaseInsensitive) == 0)
+                            } else if (m_tokens.at(0).is("WHEN"))
                             {
                                 m_tokens.removeFirst();
-                                t.name = "CASE WHEN"; // treat as single prefix
+                                t.setName("CASE WHEN"); // treat as single prefix
                             }
                             // fall though into normal prefix handling
-                        } else if (t.name.compare(
-                                   "CAST", Qt::CaseInsensitive) == 0)
+                        } else if (t.is("CAST"))
                         {
                             if (   m_tokens.isEmpty()
                                 || (m_tokens.at(0).type != tokenOpen))
                             {
                                 return NULL; // CAST not followed by '('
                             } // otherise fall into standard prefix code
-                            expr = new Expression(); // CAST expression
+                            expr = newExpression(); // CAST expression
                             expr->type = exprCall; // looks like a call
                             expr->terminal = t;
                             m_tokens.removeFirst(); // absorb '('
@@ -682,44 +634,40 @@ Expression * SqlParser::internalParser(
                             continue;
                         }
                         // recurse to check for multiple prefixes
-                        expr = new Expression();
+                        expr = newExpression();
                         expr->type = exprOpX;
                         expr->terminal = t;
                         expr->right = internalParser(1, level, ends);
                         if (expr->right == NULL) { // invalid expression
-                            destroyExpression(expr);
                             return NULL;
                         } else { // recursive call found rest of expression
                             return expr; // done at this recursion depth
                         }
                     case tokenOpen: // operand is (expression)
-                        expr = new Expression();
+                        expr = newExpression();
                         expr->type = exprExpr;
                         expr->left = internalParser(0, 2, QStringList());
                         if (expr->left == NULL) { // invalid expression
-                            destroyExpression(expr);
                             return 0;
                         } else { // recursive call found (expression)
                             state = 3; // got operand, look for operator or end
                             continue;
                         }
                     case tokenNOT: // NOT and NOT EXISTS are prefixes
-                        expr = new Expression();
+                        expr = newExpression();
                         expr->type = exprOpX;
                         expr->terminal.type = tokenPrefixA;
                         if (   (m_tokens.size() > 0)
-                            && (m_tokens.at(0).name.compare(
-                                    "EXISTS", Qt::CaseInsensitive) == 0))
+                            && (m_tokens.at(0).is("EXISTS")))
                         { // valid prefix
                             m_tokens.removeFirst();
-                            expr->terminal.name = "NOT EXISTS";
+                            expr->terminal.setName("NOT EXISTS");
                         } else { // valid prefix
-                            expr->terminal.name = "NOT";
+                            expr->terminal.setName("NOT");
                         } // NOT at end of expression isn't valid
                         // but we'll catch that when we look for the next token
                         expr->right = internalParser(1, level, ends);
                         if (expr->right == NULL) { // invalid expression
-                            destroyExpression(expr);
                             return NULL;
                         } else { // recursive call found rest of expression
                             return expr; // done at this level
@@ -737,7 +685,6 @@ Expression * SqlParser::internalParser(
                     if (level == 0) { // end after operand is valid at level 0
                         return expr;
                     } else { // unmatched '('
-                        destroyExpression(expr);
                         return NULL;
                     }
                 } else if (   ((level == 0) || (level == 3))
@@ -746,14 +693,13 @@ Expression * SqlParser::internalParser(
                            && (m_tokens.at(0).type !=
                                                 tokenBackQuotedIdentifier)
                            && (m_tokens.at(0).type != tokenStringLiteral)
-                           && ends.contains(
-                                m_tokens.at(0).name, Qt::CaseInsensitive))
+                           && m_tokens.at(0).isIn(ends))
                 { return expr; } // end after operand is valid at level 0
                 t = m_tokens.takeFirst(); // m_tokens isn't empty now
                 switch (t.type) {
                     case tokenPostfixA:
                     {
-                        Expression * e = new Expression();
+                        Expression * e = newExpression();
                         e->type = exprXOp;
                         e->left = expr;
                         e->terminal = t;
@@ -762,70 +708,65 @@ Expression * SqlParser::internalParser(
                     }
                     case tokenComma:
                         if (level == 1) { // ',' valid in arglist
-                            Expression * e = new Expression;
+                            Expression * e = newExpression();
                             e->type = exprXOpX;
                             e->left = expr;
                             e->terminal = t;
                             e->right = internalParser(1, 1, ends);
                             if (e->right == NULL) { // invalid expression
-                                destroyExpression(expr);
                                 return NULL;
                             } else { return e; } // done at this level
                         } else { // ',' not valid elsewhere
-                            destroyExpression(expr);
                             return NULL;
                         }
                     case tokenClose:
                         if (level == 0) { // unmatched ')'
-                            destroyExpression(expr);
                             return NULL;
                         } else { return expr; } // ')' OK in levels 1 and 2
                     case tokenOperatorA:
-                        if (   (t.name.compare("IS") == 0)
+                        if (   (t.ref().compare(QLatin1String("IS")) == 0)
                             && (m_tokens.size() > 0)
                             && (m_tokens.at(0).type == tokenNOT)) {
                             // treat IS NOT as a single operator
                             m_tokens.removeFirst();
-                            t.name = "IS NOT";
+                            t.setName("IS NOT");
                         }
                         /*FALLTHRU*/
                     case tokenOperator:
                     case tokenPlusMinus:
                     {
-                        Expression * e = new Expression();
+                        Expression * e = newExpression();
                         e->left = expr;
                         e->type = exprXOpX;
                         e->terminal = t;
                         e->right = internalParser(1, level, ends);
                         if (e->right == 0) { // invalid expression
-                            destroyExpression(e);
                             return 0;
                         } else { return e; } // done at this level
                     }
                     case tokenNOT:
                         if (m_tokens.size() > 0) {
-                            QString n(m_tokens.at(0).name);
+                            QString n(m_tokens.at(0).name());
                             if (n.compare( "BETWEEN", Qt::CaseInsensitive)
                                 == 0)
                             {
                                 m_tokens.removeFirst();
-                                Expression * e = new Expression();
+                                Expression * e = newExpression();
                                 e->left = expr;
                                 e->type = exprXOpX;
-                                e->terminal.name = "NOT BETWEEN";
+                                e->terminal.setName("NOT BETWEEN");
                                 e->terminal.type = tokenOperatorA;
                                 e->right = internalParser(1, level, ends);
                                 if (e->right == 0) { // invalid expression
-                                    destroyExpression(e);
                                     return 0;
                                 } else { return e; } // done at this level
                             }
                             if (n.compare( "NULL", Qt::CaseInsensitive) == 0) {
                                 // NOT NULL is a postfix operator
                                 m_tokens.removeFirst();
-                                Expression * e = new Expression();
+                                Expression * e = newExpression();
                                 e->type = exprXOp;
-                                e->terminal.name = "NOT NULL";
+                                e->terminal.setName("NOT NULL");
                                 e->terminal.type = tokenPostfixA;
                                 e->left = expr;
                                 expr = e;
@@ -834,55 +775,48 @@ Expression * SqlParser::internalParser(
                                 n, Qt::CaseInsensitive))
                             {
                                 m_tokens.removeFirst();
-                                Expression * e = new Expression();
+                                Expression * e = newExpression();
                                 e->left = expr;
                                 e->type = exprXOpX;
-                                e->terminal.name = n.prepend("NOT ");
+                                e->terminal.setName(n.prepend("NOT "));
                                 e->terminal.type = tokenPostfixA;
                                 e->right = internalParser(1, level, ends);
                                 if (e->right == 0) { // invalid expression
-                                    destroyExpression(e);
                                     return 0;
                                 } else { return e; } // done at this level
                             }
                             // NOT by itself isn't a valid binary operator
                         }
                         // NOT by itself isn't valid at end of expression
-                        destroyExpression(expr);
                         return 0;
                     default: // invalid expression, probably missing operator
-                        destroyExpression(expr);
                         return 0;
                 }
             case 4: // CAST expression, had '(', look for expression
-                expr = new Expression;
+                expr = newExpression();
                 expr->type = exprXOpX;
                 expr->left = internalParser(1, 3, QStringList({"AS"}));
-                if ((expr == NULL) || m_tokens.isEmpty()) {
-                    expr->right = NULL;
-                    destroyExpression(expr);
+                if ((expr->left == NULL) || m_tokens.isEmpty()) {
                     return NULL;
                 }
                 m_tokens.removeFirst(); // remove the AS
                 expr->terminal.type = tokenOperatorA;
-                expr->terminal.name = "AS";
+                expr->terminal.setName("AS");
                 expr->right = internalParser(5, 3, QStringList());
                 if (expr->right == NULL) {
-                    destroyExpression(expr);
                     return NULL;
                 } else { return expr; }
             case 5: // CAST expression, had AS, looking for type-name
-                expr = new Expression;
+                expr = newExpression();
                 expr->type = exprToken;
                 expr->terminal.type = tokenIdentifier;
-                expr->terminal.name = "";
+                expr->terminal.setName("");
                 while (1) { // accumulate parts of type name
                     if (m_tokens.isEmpty()) {
-                        destroyExpression(expr);
                         return NULL;
                     }
                     t = m_tokens.takeFirst();
-                    if (!expr->terminal.name.isEmpty()) { // seen >=1 name
+                    if (!expr->terminal.name().isEmpty()) { // seen >=1 name
                         if (t.type == tokenClose) { return expr; }
                         else if (t.type == tokenOpen) { break; }
                     }
@@ -892,13 +826,13 @@ Expression * SqlParser::internalParser(
                         && (t.type != tokenStringLiteral)
                         && (t.type != tokenIdentifier))
                     {
-                        destroyExpression(expr);
                         return NULL;
                     }
-                    if (expr->terminal.name.isEmpty()) {
-                        expr->terminal.name = t.name;
+                    if (expr->terminal.name().isEmpty()) {
+                        expr->terminal.setName(t.name());
                     } else {
-                        expr->terminal.name.append(" ").append(t.name);
+                        expr->terminal.setName(
+                            expr->terminal.name() + " " + t.name());
                     }
                 }
                 expr->type = exprCall; // seen '(' after type name
@@ -906,30 +840,26 @@ Expression * SqlParser::internalParser(
                 // but we still have to parse them.
                 expr->right = internalParser(6, 3, QStringList());
                 if (expr->right == NULL) {
-                    destroyExpression(expr);
                     return NULL; // bad or unterminated field width
                 }
                 t = m_tokens.takeFirst();
                 if (t.type == tokenComma) {
-                    Expression * e = new Expression;
+                    Expression * e = newExpression();
                     e->type = exprXOpX;
                     e->left = expr->right;
                     e->terminal = t;
                     expr->right = e;
                     e->right = internalParser(6, 3, QStringList());
                     if (e->right == NULL) {
-                        destroyExpression(expr);
                         return NULL; // bad or unterminated field width
                     }
                     t = m_tokens.takeFirst();
                 }
                 if ((t.type != tokenClose) || m_tokens.isEmpty()) {
-                    destroyExpression(expr);
                     return NULL; // field width not terminated by ')'
                 }
                 t = m_tokens.takeFirst(); // CAST not terminated by ')'
                 if (t.type != tokenClose) {
-                    destroyExpression(expr);
                     return NULL; // CAST expression not terminated by ')'
                 }
                 return expr; // done at this recursion depth
@@ -938,22 +868,21 @@ Expression * SqlParser::internalParser(
                 t = m_tokens.takeFirst();
                 if (t.type == tokenPlusMinus) { // optional sign
                     if (m_tokens.isEmpty()) { return NULL; }
-                    expr = new Expression;
+                    expr = newExpression();
                     expr->type = exprOpX;
                     expr->terminal = t;
                     t = m_tokens.takeFirst();
                     if ((t.type != tokenNumeric) || m_tokens.isEmpty()) {
-                        delete expr; // bad token or no more
                         return NULL;
                     }
-                    expr->right = new Expression;
+                    expr->right = newExpression();
                     expr->right->type = exprToken;
                     expr->right->terminal = t;
                     return expr;
                 } else if ((t.type != tokenNumeric) || m_tokens.isEmpty()) {
                     return NULL;
                 }
-                expr = new Expression;
+                expr = newExpression();
                 expr->type = exprToken;
                 expr->terminal = t;
                 return expr; // done at this recursion level
@@ -1040,6 +969,7 @@ SqlParser::SqlParser(QString input)
 	m_isUnique = false;
 	m_hasRowid = true;
 	m_whereClause = NULL;
+	m_blockUsed = 0;
 	m_tokens = tokenise(input);
 	m_depth = 0;
 	enum sqlParserState state = expectCREATE; // nothing
@@ -1048,26 +978,26 @@ SqlParser::SqlParser(QString input)
 	while (!m_tokens.isEmpty())
 	{
         Token t = m_tokens.at(0);
-		QString s;
+		QStringRef s; // the name if it is an identifier, otherwise empty
         if (t.type == tokenWhitespace) { continue; }
-        else if (t.type == tokenIdentifier) { s = t.name; } else { s = ""; }
+        else if (t.type == tokenIdentifier) { s = t.ref(); }
 		switch (state)
 		{
 			case expectCREATE: // we only parse CREATE statements so far
-				if (s.compare("CREATE", Qt::CaseInsensitive) == 0) {
+				if (is(s, "CREATE")) {
 					state = expectCreated; // seen CREATE
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case expectCreated: // seen CREATE
 				// TEMP[ORARY] doesn't get copied to schema
-                if (s.compare("TABLE", Qt::CaseInsensitive) == 0) {
+                if (is(s, "TABLE")) {
                     state = TexpectTableName; // CREATE TABLE
                     m_type = createTable;
-                } else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+                } else if (is(s, "UNIQUE")) {
                     m_isUnique = true;
                     state = IexpectINDEX; // CREATE UNIQUE
-                } else if (s.compare("INDEX", Qt::CaseInsensitive) == 0) {
+                } else if (is(s, "INDEX")) {
                     state = IexpectIndexName; // CREATE INDEX
                 } else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1081,7 +1011,7 @@ SqlParser::SqlParser(QString input)
 					|| (t.type == tokenBackQuotedIdentifier)
 					|| (t.type == tokenStringLiteral))
 				{
-					m_tableName = t.name;
+					m_tableName = t.name();
 					state = TexpectColumnList; // had table name
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1099,23 +1029,23 @@ SqlParser::SqlParser(QString input)
 					|| (t.type == tokenBackQuotedIdentifier)
 					|| (t.type == tokenStringLiteral))
 				{
-					f.name = t.name;
+					f.name = t.name();
 					state = TexpectColumnType; // look for type
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
             // after ',', expect column name or table constraint
 			case TexpectColOrTC:
-				if (s.compare("CONSTRAINT", Qt::CaseInsensitive) == 0) {
+				if (is(s, "CONSTRAINT")) {
 					state = TCexpectName; // look for table constraint name
-				} else if (s.compare("PRIMARY", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "PRIMARY")) {
 					state = TCexpectPKEY; // look for KEY
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = TCexpectUOpen; // look for columns and conflict clause
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = TCexpectCheckOpen; // look for bracketed expression
-				} else if (s.compare("FOREIGN", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "FOREIGN")) {
 					state = TCexpectFKEY; // look for KEY
 				} else if (   (t.type == tokenIdentifier)
                            || (t.type == tokenQuotedIdentifier)
@@ -1123,7 +1053,7 @@ SqlParser::SqlParser(QString input)
                            || (t.type == tokenBackQuotedIdentifier)
                            || (t.type == tokenStringLiteral))
 				{
-					f.name = t.name;
+					f.name = t.name();
 					state = TexpectColumnType;
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1139,22 +1069,22 @@ SqlParser::SqlParser(QString input)
 					m_fields.append(f);
 					clearField(f);
 					state = TexpectWITHOUT; // check for WITHOUT ROWID or rubbish at end
-				} else if (s.compare("CONSTRAINT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CONSTRAINT")) {
 					state = CCexpectName; // look for column constraint name
-				} else if (s.compare("PRIMARY", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "PRIMARY")) {
 					state = CCexpectKEY; // look for KEY
 				} else if (t.type == tokenNOT) {
 					state = CCexpectNULL; // look for NULL
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = CCexpectConflict; // look for conflict clause or next
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = CCexpectOpenExprClose; // look for bracketed expression
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectDefault; // look for default value
-				} else if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "COLLATE")) {
 					state = CCexpectCollateName; // look for collation name
-				} else if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REFERENCES")) {
 					state = CCexpectREFTable; // look for (foreign) table name
 				} else if (   (t.type == tokenIdentifier)
 						   || (t.type == tokenQuotedIdentifier)
@@ -1162,7 +1092,7 @@ SqlParser::SqlParser(QString input)
 						   || (t.type == tokenBackQuotedIdentifier)
 						   || (t.type == tokenStringLiteral))
 				{ // look for more type name or column constraint or , or ) 
-                    f.type = t.name;
+                    f.type = t.name();
                     state = TexpectTypeQualifier;
                 } else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1180,79 +1110,79 @@ SqlParser::SqlParser(QString input)
 					m_fields.append(f);
 					clearField(f);
 					state = TexpectWITHOUT; // check for WITHOUT ROWID or rubbish at end
-				} else if (s.compare("CONSTRAINT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CONSTRAINT")) {
 					state = CCexpectName; // look for column constraint name
-				} else if (s.compare("PRIMARY", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "PRIMARY")) {
 					state = CCexpectKEY; // look for KEY
 				} else if (t.type == tokenNOT) {
 					state = CCexpectNULL; // look for NULL
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = CCexpectConflict; // look for conflict clause or next
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = CCexpectOpenExprClose; // look for bracketed expression
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectDefault; // look for default value
-				} else if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "COLLATE")) {
 					state = CCexpectCollateName; // look for collation name
-				} else if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REFERENCES")) {
 					state = CCexpectREFTable; // look for (foreign) table name
 				} else if (   (t.type == tokenIdentifier)
 						   || (t.type == tokenQuotedIdentifier)
 						   || (t.type == tokenSquareIdentifier)
 						   || (t.type == tokenBackQuotedIdentifier)
 						   || (t.type == tokenStringLiteral))
-				{ f.type.append(" ").append(t.name); }
+				{ f.type.append(" ").append(t.ref()); }
                 else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
             case TexpectFieldWidth1: // look for field width(s)
                 if (t.type == tokenPlusMinus) {
-                    f.type.append(t.name);
+                    f.type.append(t.ref());
                     state = TexpectFieldWidth1N; // only one sign allowed before number
                 } else if (t.type == tokenNumeric) { // real IS allowed
-                    f.type.append(t.name);
+                    f.type.append(t.ref());
                     state = TexpectFieldWidthSep; // look for , or )
                 } else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
             case TexpectFieldWidth1N: // look for first field width after sign
                 if (t.type == tokenNumeric) { // real IS allowed
-                    f.type.append(t.name);
+                    f.type.append(t.ref());
                     state = TexpectFieldWidthSep; // look for , or )
                 } else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
             case TexpectFieldWidthSep: // look for second field width or )
                 if (t.type == tokenComma) {
-                    f.type.append(t.name);
+                    f.type.append(t.ref());
                     state = TexpectFieldWidth2; // look for second field width
                 } else if (t.type == tokenClose) {
-                    f.type.append(t.name);
+                    f.type.append(t.ref());
                     state = TexpectColConstraint;
                 } else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
             case TexpectFieldWidth2: // look for second field width
                 if (t.type == tokenPlusMinus) {
-                    f.type.append(t.name);
+                    f.type.append(t.ref());
                     state = TexpectFieldWidth2N; // only one sign allowed before number
                 } else if (t.type == tokenNumeric) { // real IS allowed
-                    f.type.append(t.name);
+                    f.type.append(t.ref());
                     state = TexpectFieldWidthClose; // look for )
                 } else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
             case TexpectFieldWidth2N: // look for second field width after sign
                 if (t.type == tokenNumeric) { // real IS allowed
-                    f.type.append(t.name);
+                    f.type.append(t.ref());
                     state = TexpectFieldWidthClose; // look for )
                 } else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
             case TexpectFieldWidthClose: // look for ) after second field width
                 if (t.type == tokenClose) {
-                    f.type.append(t.name);
+                    f.type.append(t.ref());
                     state = TexpectColConstraint; // look for column constraint or , or )
                 } else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1267,22 +1197,22 @@ SqlParser::SqlParser(QString input)
 					m_fields.append(f);
 					clearField(f);
 					state = TexpectWITHOUT; // expect WITHOUT ROWID or end
-				} else if (s.compare("CONSTRAINT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CONSTRAINT")) {
 					state = CCexpectName; // look for column constraint name
-				} else if (s.compare("PRIMARY", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "PRIMARY")) {
 					state = CCexpectKEY; // look for KEY
 				} else if (t.type == tokenNOT) {
 					state = CCexpectNULL; // look for NULL
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = CCexpectConflict; // look for conflict clause or next
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = CCexpectOpenExprClose; // look for bracketed expression
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectDefault; // look for default value
-				} else if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "COLLATE")) {
 					state = CCexpectCollateName; // look for collation name
-				} else if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REFERENCES")) {
 					state = CCexpectREFTable; // look for (foreign) table name
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1299,56 +1229,55 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectType: // look for constraint
-				if (s.compare("PRIMARY", Qt::CaseInsensitive) == 0) {
+				if (is(s, "PRIMARY")) {
 					state = CCexpectKEY; // look for KEY
 				} else if (t.type == tokenNOT) {
 					state = CCexpectNULL; // look for NULL
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = CCexpectConflict; // look for conflict clause or next
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = CCexpectOpenExprClose; // look for bracketed expression
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectDefault; // look for default value
-				} else if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "COLLATE")) {
 					state = CCexpectCollateName; // look for collation name
-				} else if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REFERENCES")) {
 					state = CCexpectREFTable; // look for (foreign) table name
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectKEY: // look for KEY
-				if (s.compare("KEY", Qt::CaseInsensitive) == 0) {
+				if (is(s, "KEY")) {
 					addToPrimaryKey(f);
 					state = CCexpectPKqualifier; // look for ASC or DESC or conflict clause
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectPKqualifier: // look for ASC or DESC or conflict clause
-				if (t.name.compare("ASC", Qt::CaseInsensitive) == 0) {
+				if (t.is("ASC")) {
 					state = CCexpectPKConflict; // look for conflict clause
-				} else if (t.name.compare("DESC", Qt::CaseInsensitive) == 0) {
+				} else if (t.is("DESC")) {
 					f.isColumnPkDesc = true;
 					state = CCexpectPKConflict; // look for conflict clause
-				} else if (s.compare("ON", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "ON")) {
 					state = CCexpectPKCONFLICT; // look for CONFLICT
-				} else if (s.compare(
-                    "AUTOINCREMENT", Qt::CaseInsensitive) == 0)
+				} else if (is(s, "AUTOINCREMENT"))
 				{
 					f.isAutoIncrement = true;
 					state = TexpectColConstraint; // look for column constraint or , or )
 				} else if (t.type == tokenNOT) {
 					state = CCexpectNULL; // look for NULL
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = CCexpectConflict; // look for conflict clause or next
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = CCexpectOpenExprClose; // look for bracketed expression
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectDefault; // look for default value
-				} else if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "COLLATE")) {
 					state = CCexpectCollateName; // look for collation name
-				} else if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REFERENCES")) {
 					state = CCexpectREFTable; // look for (foreign) table name
 				} else if (t.type == tokenComma) {
 					m_fields.append(f);
@@ -1362,26 +1291,25 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectPKConflict: // look for conflict clause
-				if (s.compare("ON", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ON")) {
 					state = CCexpectPKCONFLICT; // look for CONFLICT
-				} else if (s.compare(
-                    "AUTOINCREMENT", Qt::CaseInsensitive) == 0)
+				} else if (is(s, "AUTOINCREMENT"))
 				{
                     if (f.isColumnPkDesc) { break; } // not after DESC
 					f.isAutoIncrement = true;
 					state = TexpectColConstraint; // look for column constraint or , or )
 				} else if (t.type == tokenNOT) {
 					state = CCexpectNULL; // look for NULL
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = CCexpectConflict; // look for conflict clause or next
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = CCexpectOpenExprClose; // look for bracketed expression
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectDefault; // look for default value
-				} else if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "COLLATE")) {
 					state = CCexpectCollateName; // look for collation name
-				} else if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REFERENCES")) {
 					state = CCexpectREFTable; // look for (foreign) table name
 				} else if (t.type == tokenComma) {
 					m_fields.append(f);
@@ -1395,41 +1323,41 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectPKCONFLICT: // look for CONFLICT
-				if (s.compare("CONFLICT", Qt::CaseInsensitive) == 0) {
+				if (is(s, "CONFLICT")) {
 					state = CCexpectPKConflictAction; // look for conflict action
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectPKConflictAction: // look for conflict action
-				if (s.compare("ROLLBACK", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ROLLBACK")) {
 					state = CCexpectAUTO; // look for AUTOINCREMENT or next
-				} else if (s.compare("ABORT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "ABORT")) {
 					state = CCexpectAUTO; // look for AUTOINCREMENT or next
-				} else if (s.compare("FAIL", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "FAIL")) {
 					state = CCexpectAUTO; // look for AUTOINCREMENT or next
-				} else if (s.compare("IGNORE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "IGNORE")) {
 					state = CCexpectAUTO; // look for AUTOINCREMENT or next
-				} else if (s.compare("REPLACE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REPLACE")) {
 					state = CCexpectAUTO; // look for AUTOINCREMENT or next
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectAUTO: // look for AUTOINCREMENT or next
-				if (s.compare("AUTOINCREMENT", Qt::CaseInsensitive) == 0) {
+				if (is(s, "AUTOINCREMENT")) {
 					f.isAutoIncrement = true;
 					state = TexpectColConstraint; // look for column constraint or , or )
 				} else if (t.type == tokenNOT) {
 					state = CCexpectNULL; // look for NULL
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = CCexpectConflict; // look for conflict clause or next
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = CCexpectOpenExprClose; // look for bracketed expression
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectDefault; // look for default value
-				} else if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "COLLATE")) {
 					state = CCexpectCollateName; // look for collation name
-				} else if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REFERENCES")) {
 					state = CCexpectREFTable; // look for (foreign) table name
 				} else if (t.type == tokenComma) {
 					m_fields.append(f);
@@ -1443,27 +1371,27 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectNULL: // look for NULL
-				if (s.compare("NULL", Qt::CaseInsensitive) == 0) {
+				if (is(s, "NULL")) {
 					f.isNotNull = true;
 					state = CCexpectConflict; // look for conflict clause or next
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectConflict: // look for conflict clause or next
-				if (s.compare("ON", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ON")) {
 					state = CCexpectCONFLICT; // look for CONFLICT
 				} else if (t.type == tokenNOT) {
 					state = CCexpectNULL; // look for NULL
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = CCexpectConflict; // look for conflict clause or next
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = CCexpectOpenExprClose; // look for bracketed expression
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectDefault; // look for default value
-				} else if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "COLLATE")) {
 					state = CCexpectCollateName; // look for collation name
-				} else if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REFERENCES")) {
 					state = CCexpectREFTable; // look for (foreign) table name
 				} else if (t.type == tokenComma) {
 					m_fields.append(f);
@@ -1477,21 +1405,21 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectCONFLICT: // look for CONFLICT
-				if (s.compare("CONFLICT", Qt::CaseInsensitive) == 0) {
+				if (is(s, "CONFLICT")) {
 					state = CCexpectConflictAction; // look for conflict action
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectConflictAction: // look for conflict action
-				if (s.compare("ROLLBACK", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ROLLBACK")) {
 					state = TexpectColConstraint; // look for constraint or , or )
-				} else if (s.compare("ABORT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "ABORT")) {
 					state = TexpectColConstraint; // look for constraint or , or )
-				} else if (s.compare("FAIL", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "FAIL")) {
 					state = TexpectColConstraint; // look for constraint or , or )
-				} else if (s.compare("IGNORE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "IGNORE")) {
 					state = TexpectColConstraint; // look for constraint or , or )
-				} else if (s.compare("REPLACE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REPLACE")) {
 					state = TexpectColConstraint; // look for constraint or , or )
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1518,7 +1446,7 @@ SqlParser::SqlParser(QString input)
 					state = CCexpectDefaultExprClose; // scan for end of default value expression
 					++m_depth;
 				} else if (t.type == tokenPlusMinus) {
-					f.defaultValue = t.name;
+					f.defaultValue = t.name();
 					state = CCexpectDefaultLiteral; // look for (signed) number
 				} else {
 					if (   (t.type == tokenStringLiteral)
@@ -1526,7 +1454,7 @@ SqlParser::SqlParser(QString input)
 						|| (t.type == tokenSquareIdentifier)
 						|| (t.type == tokenBackQuotedIdentifier))
 					{ f.defaultisQuoted = true; }
-					f.defaultValue = s;
+					f.defaultValue = s.toString();
 					state = TexpectColConstraint; // look for column constraint or , or )
 				}
 				m_tokens.removeFirst();
@@ -1550,7 +1478,7 @@ SqlParser::SqlParser(QString input)
 				if (   (t.type == tokenNumeric)
                     || (t.type == tokenStringLiteral))
 				{
-					f.defaultValue.append(t.name);
+					f.defaultValue.append(t.ref());
 					state = TexpectColConstraint; // look for column constraint or , or )
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1562,7 +1490,7 @@ SqlParser::SqlParser(QString input)
 					|| (t.type == tokenBackQuotedIdentifier)
 					|| (t.type == tokenStringLiteral))
 				{
-                    f.collator = t.name;
+                    f.collator = t.name();
 					state = TexpectColConstraint; // look for constraint or , or )
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1574,7 +1502,7 @@ SqlParser::SqlParser(QString input)
 					|| (t.type == tokenBackQuotedIdentifier)
 					|| (t.type == tokenStringLiteral))
 				{
-                    f.referencedTable = t.name;
+                    f.referencedTable = t.name();
 					state = CCexpectREFOpen; // look for clause or next
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1583,28 +1511,28 @@ SqlParser::SqlParser(QString input)
 			case CCexpectREFOpen:
 				if (t.type == tokenOpen) {
 					state = CCexpectREFColumn; // look for column list
-				} else if (s.compare("ON", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "ON")) {
 					state = CCexpectFKDeleteUpdate; // look for DELETE or UPDATE
-				} else if (s.compare("MATCH", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "MATCH")) {
 					state = CCexpectFKMatchType; // look for SIMPLE or PARTIAL or FULL
 				} else if (t.type == tokenNOT) {
 					state = CCexpectFKDEFERRABLE; // look for DEFERRABLE or NULL
-				} else if (s.compare("DEFERRABLE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFERRABLE")) {
 					state = CCexpectFKINITIALLY; // look for INITIALLY or next
-				} else if (s.compare("CONSTRAINT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CONSTRAINT")) {
 					state = CCexpectName; // look for column constraint name
-				} else if (s.compare("PRIMARY", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "PRIMARY")) {
 					state = CCexpectKEY; // look for KEY
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = CCexpectConflict; // look for conflict clause or next
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = CCexpectOpenExprClose; // look for bracketed expression
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectDefault; // look for default value
-				} else if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "COLLATE")) {
 					state = CCexpectCollateName; // look for collation name
-				} else if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REFERENCES")) {
 					state = CCexpectREFTable; // look for (foreign) table name
 				} else if (t.type == tokenComma) {
 					m_fields.append(f);
@@ -1625,7 +1553,7 @@ SqlParser::SqlParser(QString input)
 					|| (t.type == tokenBackQuotedIdentifier)
 					|| (t.type == tokenStringLiteral))
 				{
-                    f.referencedKeys.append(t.name);
+                    f.referencedKeys.append(t.name());
 					state = CCexpectREFClose; // look for next column name or )
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1637,28 +1565,28 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectFKType: // look for rest of foreign key clause
-				if (s.compare("ON", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ON")) {
 					state = CCexpectFKDeleteUpdate; // look for DELETE or UPDATE
-				} else if (s.compare("MATCH", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "MATCH")) {
 					state = CCexpectFKMatchType; // look for SIMPLE or PARTIAL or FULL
 				} else if (t.type == tokenNOT) {
 					state = CCexpectFKDEFERRABLE; // look for DEFERRABLE or NULL
-				} else if (s.compare("DEFERRABLE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFERRABLE")) {
 					state = CCexpectFKINITIALLY; // look for INITIALLY
-				} else if (s.compare("CONSTRAINT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CONSTRAINT")) {
 					state = CCexpectName; // look for column constraint name
-				} else if (s.compare("PRIMARY", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "PRIMARY")) {
 					state = CCexpectKEY; // look for KEY
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = CCexpectConflict; // look for conflict clause or next
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = CCexpectOpenExprClose; // look for bracketed expression
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectDefault; // look for default value
-				} else if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "COLLATE")) {
 					state = CCexpectCollateName; // look for collation name
-				} else if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REFERENCES")) {
 					state = CCexpectREFTable; // look for (foreign) table name
 				} else if (t.type == tokenComma) {
 					m_fields.append(f);
@@ -1672,77 +1600,77 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectFKDeleteUpdate: // look for DELETE or UPDATE
-				if (s.compare("DELETE", Qt::CaseInsensitive) == 0) {
+				if (is(s, "DELETE")) {
 					state = CCexpectFKDUAction; // look for foreign key action
-				} else if (s.compare("UPDATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UPDATE")) {
 					state = CCexpectFKDUAction; // look for foreign key action
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectFKDUAction: // look for foreign key DELETE / UPDATE action
-				if (s.compare("SET", Qt::CaseInsensitive) == 0) {
+				if (is(s, "SET")) {
 					state = CCexpectFKSetAction; // look for NULL or DEFAULT
-				} else if (s.compare("CASCADE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CASCADE")) {
 					state = CCexpectFKType; // look for rest of foreign key clause
-				} else if (s.compare("RESTRICT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "RESTRICT")) {
 					state = CCexpectFKType; // look for rest of foreign key clause
-				} else if (s.compare("NO", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "NO")) {
 					state = CCexpectFKACTION; // look for ACTION
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectFKSetAction: // look for NULL or DEFAULT
-				if (s.compare("NULL", Qt::CaseInsensitive) == 0) {
+				if (is(s, "NULL")) {
 					state = CCexpectFKType; // look for rest of foreign key clause
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectFKType; // look for rest of foreign key clause
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectFKACTION: // look for ACTION
-				if (s.compare("ACTION", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ACTION")) {
 					state = CCexpectFKType; // look for rest of foreign key clause
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectFKMatchType: // look for SIMPLE or PARTIAL or FULL
-				if (s.compare("SIMPLE", Qt::CaseInsensitive) == 0) {
+				if (is(s, "SIMPLE")) {
 					state = CCexpectFKType; // look for rest of foreign key clause
-				} else if (s.compare("PARTIAL", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "PARTIAL")) {
 					state = CCexpectFKType; // look for rest of foreign key clause
-				} else if (s.compare("FULL", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "FULL")) {
 					state = CCexpectFKType; // look for rest of foreign key clause
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectFKDEFERRABLE: // look for DEFERRABLE or NULL
-				if (s.compare("DEFERRABLE", Qt::CaseInsensitive) == 0) {
+				if (is(s, "DEFERRABLE")) {
 					state = CCexpectFKINITIALLY; // look for INITIALLY etc
-				} else if (s.compare("NULL", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "NULL")) {
 					f.isNotNull = true;
 					state = CCexpectAUTO; // look for conflict clause or next
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case CCexpectFKINITIALLY: // look for INITIALLY or next
-				if (s.compare("INITIALLY", Qt::CaseInsensitive) == 0) {
+				if (is(s, "INITIALLY")) {
 					state = CCexpectFKDeferType; // look for DEFERRED or IMMEDIATE
-				} else if (s.compare("CONSTRAINT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CONSTRAINT")) {
 					state = CCexpectName; // look for column constraint name
-				} else if (s.compare("PRIMARY", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "PRIMARY")) {
 					state = CCexpectKEY; // look for KEY
 				} else if (t.type == tokenNOT) {
 					state = CCexpectNULL; // look for NULL
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = CCexpectConflict; // look for conflict clause or next
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = CCexpectOpenExprClose; // look for bracketed expression
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = CCexpectDefault; // look for default value
-				} else if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "COLLATE")) {
 					state = CCexpectCollateName; // look for collation name
-				} else if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REFERENCES")) {
 					state = CCexpectREFTable; // look for (foreign) table name
 				} else if (t.type == tokenComma) {
 					m_fields.append(f);
@@ -1756,9 +1684,9 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case 45: // look for DEFERRED or IMMEDIATE
-				if (s.compare("DEFERRED", Qt::CaseInsensitive) == 0) {
+				if (is(s, "DEFERRED")) {
 					state = TexpectColConstraint; // look for column constraint or , or )
-				} else if (s.compare("IMMEDIATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "IMMEDIATE")) {
 					state = TexpectColConstraint; // look for column constraint or , or )
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1776,20 +1704,20 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectType: // look for rest of table constraint
-				if (s.compare("PRIMARY", Qt::CaseInsensitive) == 0) {
+				if (is(s, "PRIMARY")) {
 					state = TCexpectPKEY; // look for KEY
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = TCexpectUOpen; // look for columns and conflict clause
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = TCexpectCheckOpen; // look for bracketed expression
-				} else if (s.compare("FOREIGN", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "FOREIGN")) {
 					state = TCexpectFKEY; // look for KEY
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectPKEY: // look for KEY
-				if (s.compare("KEY", Qt::CaseInsensitive) == 0) {
+				if (is(s, "KEY")) {
 					state = TCexpectPKOpen; // look for columns and conflict clause
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1807,17 +1735,17 @@ SqlParser::SqlParser(QString input)
 					|| (t.type == tokenBackQuotedIdentifier)
 					|| (t.type == tokenStringLiteral))
 				{
-					addToPrimaryKey(s);
+					addToPrimaryKey(s.toString());
 					state = TCexpectPKQualifier; // look for COLLATE or ASC/DESC or next
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectPKQualifier: // look for COLLATE or ASC/DESC or next
-				if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				if (is(s, "COLLATE")) {
 					state = TCexpectPKCollateName; // look for collation name
-				} else if (t.name.compare("ASC", Qt::CaseInsensitive) == 0) {
+				} else if (t.is("ASC")) {
 					state = TCexpectPKNext; // look for , or )
-				} else if (t.name.compare("DESC", Qt::CaseInsensitive) == 0) {
+				} else if (t.is("DESC")) {
 					f.isTablePkDesc = true;
 					state = TCexpectPKNext; // look for , or )
 				} else if (t.type == tokenComma) {
@@ -1839,9 +1767,9 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectPKAscDesc: // look for ASC/DESC or next
-				if (t.name.compare("ASC", Qt::CaseInsensitive) == 0) {
+				if (t.is("ASC")) {
 					state = TCexpectPKNext; // look for , or )
-				} else if (t.name.compare("DESC", Qt::CaseInsensitive) == 0) {
+				} else if (t.is("DESC")) {
 					state = TCexpectPKNext; // look for , or )
 				} else if (t.type == tokenComma) {
 					state = TCexpectPKColumn; // look for next column in list
@@ -1877,11 +1805,11 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectUQualifier: // look for COLLATE or ASC/DESC or next
-				if (s.compare("COLLATE", Qt::CaseInsensitive) == 0) {
+				if (is(s, "COLLATE")) {
 					state = TCexpectUCollateName; // look for collation name
-				} else if (t.name.compare("ASC", Qt::CaseInsensitive) == 0) {
+				} else if (t.is("ASC")) {
 					state = TCexpectUNext; // look for , or )
-				} else if (t.name.compare("DESC", Qt::CaseInsensitive) == 0) {
+				} else if (t.is("DESC")) {
 					state = TCexpectUNext; // look for , or )
 				} else if (t.type == tokenComma) {
 					state = TCexpectUColumn; // look for next column in list
@@ -1902,9 +1830,9 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectUAscDesc: // look for ASC/DESC or next
-				if (t.name.compare("ASC", Qt::CaseInsensitive) == 0) {
+				if (t.is("ASC")) {
 					state = TCexpectUNext; // look for , or )
-				} else if (t.name.compare("DESC", Qt::CaseInsensitive) == 0) {
+				} else if (t.is("DESC")) {
 					state = TCexpectUNext; // look for , or )
 				} else if (t.type == tokenComma) {
 					state = TCexpectUColumn; // look for next column in list
@@ -1922,7 +1850,7 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectONorNext: // look for conflict clause or next
-				if (s.compare("ON", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ON")) {
 					state = TCexpectCONFLICT; // look for CONFLICT
 				} else if (t.type == tokenComma) {
 					state = TexpectTableConstraint; // look for next table constraint
@@ -1932,21 +1860,21 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectCONFLICT: // look for CONFLICT
-				if (s.compare("CONFLICT", Qt::CaseInsensitive) == 0) {
+				if (is(s, "CONFLICT")) {
 					state = TCexpectConflictAction; // look for conflict action
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectConflictAction: // look for conflict action
-				if (s.compare("ROLLBACK", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ROLLBACK")) {
 					state = TCexpectAnotherOrEnd; // look for next table constraint or end
-				} else if (s.compare("ABORT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "ABORT")) {
 					state = TCexpectAnotherOrEnd; // look for next table constraint or end
-				} else if (s.compare("FAIL", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "FAIL")) {
 					state = TCexpectAnotherOrEnd; // look for next table constraint or end
-				} else if (s.compare("IGNORE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "IGNORE")) {
 					state = TCexpectAnotherOrEnd; // look for next table constraint or end
-				} else if (s.compare("REPLACE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "REPLACE")) {
 					state = TCexpectAnotherOrEnd; // look for next table constraint or end
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1967,7 +1895,7 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectFKEY: // look for KEY
-				if (s.compare("KEY", Qt::CaseInsensitive) == 0) {
+				if (is(s, "KEY")) {
 					state = TCexpectFKOpen; // look for column list
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -1989,15 +1917,15 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectFKClose: // look for , or )
-				if (s.compare(",") == tokenComma) {
+				if (s.compare(QLatin1String(",")) == tokenComma) {
 					state = TCexpectFKColumn; // look for next column in list
-				} else if (s.compare(")") == tokenClose) {
+				} else if (s.compare(QLatin1String(")")) == tokenClose) {
 					state = TCexpectREFERENCES; // look for foreign key clause
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectREFERENCES: // look for foreign key clause
-				if (s.compare("REFERENCES", Qt::CaseInsensitive) == 0) {
+				if (is(s, "REFERENCES")) {
 					state = TCexpectREFTable; // look for table name
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -2016,13 +1944,13 @@ SqlParser::SqlParser(QString input)
 			case TCexpectREFOpen: // look for column list or rest of clause
 				if (t.type == tokenOpen) {
 					state = TCexpectREFColumn; // look for next column in list
-				} else if (s.compare("ON", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "ON")) {
 					state = CCexpectFKDeleteUpdate; // look for DELETE or UPDATE
-				} else if (s.compare("MATCH", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "MATCH")) {
 					state = TCexpectFKMatchType; // look for SIMPLE or PARTIAL or FULL
 				} else if (t.type == tokenNOT) {
 					state = TCexpectFKDEFERRABLE; // look for DEFERRABLE
-				} else if (s.compare("DEFERRABLE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFERRABLE")) {
 					state = TCexpectFKINITIALLY; // look for INITIALLY
 				} else if (t.type == tokenComma) {
 					state = TexpectTableConstraint; // look for next table constraint
@@ -2051,13 +1979,13 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectFKType: // look for rest of foreign key clause
-				if (s.compare("ON", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ON")) {
 					state = TCexpectFKDeleteUpdate; // look for DELETE or UPDATE
-				} else if (s.compare("MATCH", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "MATCH")) {
 					state = TCexpectFKMatchType; // look for SIMPLE or PARTIAL or FULL
 				} else if (t.type == tokenNOT) {
 					state = TCexpectFKDEFERRABLE; // look for DEFERRABLE
-				} else if (s.compare("DEFERRABLE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFERRABLE")) {
 					state = TCexpectFKINITIALLY; // look for INITIALLY
 				} else if (t.type == tokenComma) {
 					state = TexpectTableConstraint; // look for next table constraint
@@ -2067,57 +1995,57 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectFKDeleteUpdate: // look for DELETE or UPDATE
-				if (s.compare("DELETE", Qt::CaseInsensitive) == 0) {
+				if (is(s, "DELETE")) {
 					state = TCexpectFKDUAction; // look for foreign key action
-				} else if (s.compare("UPDATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UPDATE")) {
 					state = TCexpectFKDUAction; // look for foreign key action
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectFKDUAction: // look for foreign key action
-				if (s.compare("SET", Qt::CaseInsensitive) == 0) {
+				if (is(s, "SET")) {
 					state = TCexpectFKSetAction; // look for NULL or DEFAULT
-				} else if (s.compare("CASCADE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CASCADE")) {
 					state = TCexpectFKType; // look for rest of foreign key clause
-				} else if (s.compare("RESTRICT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "RESTRICT")) {
 					state = TCexpectFKType; // look for rest of foreign key clause
-				} else if (s.compare("NO", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "NO")) {
 					state = TCexpectACTION; // look for ACTION
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectFKSetAction: // look for NULL or DEFAULT
-				if (s.compare("NULL", Qt::CaseInsensitive) == 0) {
+				if (is(s, "NULL")) {
 					state = TCexpectFKType; // look for rest of foreign key clause
-				} else if (s.compare("DEFAULT", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "DEFAULT")) {
 					state = TCexpectFKType; // look for rest of foreign key clause
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectACTION: // look for ACTION
-				if (s.compare("ACTION", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ACTION")) {
 					state = TCexpectFKType; // look for rest of foreign key clause
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectFKMatchType: // look for SIMPLE or PARTIAL or FULL
-				if (s.compare("SIMPLE", Qt::CaseInsensitive) == 0) {
+				if (is(s, "SIMPLE")) {
 					state = TCexpectFKType; // look for rest of foreign key clause
-				} else if (s.compare("PARTIAL", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "PARTIAL")) {
 					state = TCexpectFKType; // look for rest of foreign key clause
-				} else if (s.compare("FULL", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "FULL")) {
 					state = TCexpectFKType; // look for rest of foreign key clause
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectFKDEFERRABLE: // look for DEFERRABLE
-				if (s.compare("DEFERRABLE", Qt::CaseInsensitive) == 0) {
+				if (is(s, "DEFERRABLE")) {
 					state = TCexpectFKINITIALLY; // look for INITIALLY etc
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectFKINITIALLY: // look for INITIALLY or next
-				if (s.compare("INITIALLY", Qt::CaseInsensitive) == 0) {
+				if (is(s, "INITIALLY")) {
 					state = TCexpectFKDeferType; // look for DEFERRED or IMMEDIATE
 				} else if (t.type == tokenComma) {
 					state = TexpectTableConstraint; // look for next table constraint
@@ -2127,9 +2055,9 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TCexpectFKDeferType: // look for DEFERRED or IMMEDIATE
-				if (s.compare("DEFERRED", Qt::CaseInsensitive) == 0) {
+				if (is(s, "DEFERRED")) {
 					state = TCexpectAnotherOrEnd; // look for next table constraint or end
-				} else if (s.compare("IMMEDIATE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "IMMEDIATE")) {
 					state = TCexpectAnotherOrEnd; // look for next table constraint or end
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -2143,35 +2071,35 @@ SqlParser::SqlParser(QString input)
 				m_tokens.removeFirst();
 				continue;
 			case TexpectTableConstraint: // look for next table constraint
-				if (s.compare("CONSTRAINT", Qt::CaseInsensitive) == 0) {
+				if (is(s, "CONSTRAINT")) {
 					state = TCexpectName; // look for table constraint name
-				} else if (s.compare("PRIMARY", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "PRIMARY")) {
 					state = TCexpectPKEY; // look for KEY
-				} else if (s.compare("UNIQUE", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "UNIQUE")) {
                     f.isUnique = true;
 					state = TCexpectUOpen; // look for columns and conflict clause
-				} else if (s.compare("CHECK", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "CHECK")) {
 					state = TCexpectCheckOpen; // look for bracketed expression
-				} else if (s.compare("FOREIGN", Qt::CaseInsensitive) == 0) {
+				} else if (is(s, "FOREIGN")) {
 					state = TCexpectFKEY; // look for KEY
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TexpectWITHOUT: // check for WITHOUT ROWID or rubbish at end
-				if (s.compare("WITHOUT", Qt::CaseInsensitive) == 0) {
+				if (is(s, "WITHOUT")) {
 					state = TexpectROWID; // seen WITHOUT
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case TexpectROWID: // seen WITHOUT
-				if (s.compare("ROWID", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ROWID")) {
 					state = expectStatementEnd; // seen ROWID
 					m_hasRowid = false;
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case IexpectINDEX: // CREATE UNIQUE
-				if (s.compare("INDEX", Qt::CaseInsensitive) == 0) {
+				if (is(s, "INDEX")) {
 					state = IexpectIndexName; // CREATE UNIQUE INDEX
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -2186,13 +2114,13 @@ SqlParser::SqlParser(QString input)
 					|| (t.type == tokenBackQuotedIdentifier)
 					|| (t.type == tokenStringLiteral))
 				{
-					m_indexName = s;
+					m_indexName = s.toString();
 					state = IexpectON; // had index name
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
 				continue;
 			case IexpectON: // look for ON
-				if (s.compare("ON", Qt::CaseInsensitive) == 0) {
+				if (is(s, "ON")) {
 					state = IexpectTableName; // look for table name
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -2204,7 +2132,7 @@ SqlParser::SqlParser(QString input)
 					|| (t.type == tokenBackQuotedIdentifier)
 					|| (t.type == tokenStringLiteral))
 				{
-					m_tableName = s;
+					m_tableName = s.toString();
 					state = IexpectColumnList; // look for indexed column list
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -2232,7 +2160,7 @@ SqlParser::SqlParser(QString input)
 				continue;
 			}
 			case IexpectWHERE: // look for end or WHERE clause
-				if (s.compare("WHERE", Qt::CaseInsensitive) == 0) {
+				if (is(s, "WHERE")) {
 					state = IexpectWhereExpression; // look for expression
 				} else { break; } // not a valid create statement
 				m_tokens.removeFirst();
@@ -2253,11 +2181,11 @@ SqlParser::SqlParser(QString input)
 
 SqlParser::~SqlParser()
 {
-	while (!m_columns.isEmpty())
+	QList<Expression *>::const_iterator i;
+	for (i = m_blocks.constBegin(); i != m_blocks.constEnd(); ++i)
 	{
-		destroyExpression(m_columns.takeFirst());
+		delete [] *i;
 	}
-	destroyExpression(m_whereClause);
 }
 
 QString SqlParser::defaultToken(FieldInfo &f)
@@ -2277,8 +2205,8 @@ QString SqlParser::toString(Token t) {
 }
 
 QString SqlParser::brackets(Expression * expr) {
-    static const Token open = {"(", tokenOpen};
-    static const Token close = {")", tokenClose};
+    static const Token open = {"(", 0, 1, tokenOpen};
+    static const Token close = {")", 0, 1, tokenClose};
     return tos(open) + tos(expr) + tos(close);
 }
 
@@ -2443,12 +2371,12 @@ QString SqlParser::toString()
 
 bool SqlParser::replaceToken(QMap<QString,QString> map, Expression * expr)
 {
-	QString s(expr->terminal.name);
+	QString s(expr->terminal.name());
 	if (map.contains(s))
 	{
 		QString t(map.value(s));
 		if (t.isNull()) { return false; } // column removed
-		expr->terminal.name = t;
+		expr->terminal.setName(t);
 		expr->terminal.type = tokenQuotedIdentifier;
 	}
 	return true;
@@ -2519,8 +2447,7 @@ bool SqlParser::replace(QMap<QString,QString> map,
 				switch (expr->terminal.type)
 				{
 					case tokenIdentifier:
-						if (expr->terminal.name.compare(
-							"NULL", Qt::CaseInsensitive) == 0)
+						if (expr->terminal.is("NULL"))
 							{ return true; }
 						else {return replaceToken(map, expr); }
 					case tokenStringLiteral:
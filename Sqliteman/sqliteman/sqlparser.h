@@ -172,9 +172,21 @@ enum itemType {
 	createIndex
 };
 
+// A token's name is length characters of source from start. The tokeniser
+// shares the whole input as source, so a token costs no string of its own
+// until its name is changed.
 typedef struct Token {
-	QString name;
+	QString source;
+	int start;
+	int length;
 	enum tokenType type;
+	//! \brief The name in place in source, valid while the token is
+	QStringRef ref() const { return QStringRef(&source, start, length); }
+	QString name() const { return source.mid(start, length); }
+	//! \brief Whether the name is \a keyword, ignoring case
+	bool is(const char * keyword) const;
+	bool isIn(const QStringList & keywords) const;
+	void setName(const QString & name);
 } Token;
 
 typedef struct Expression {
@@ -221,8 +233,12 @@ class SqlParser
 		int m_depth;
         enum itemType m_type;
         QList<Token> m_tokens;
-		static QList<Token> tokenise(QString input);
-		void destroyExpression(Expression * e);
+		static QList<Token> tokenise(const QString & input);
+		//! \brief Expression nodes, all deleted by ~SqlParser()
+		QList<Expression *> m_blocks;
+		int m_blockUsed; //!< in the last of m_blocks
+		static const int ExpressionBlock = 64;
+		Expression * newExpression();
         Expression * internalParser(int state, int level, QStringList ends);
         Expression * parseExpression(QString input);
         void clearField(FieldInfo &f);
@@ -0,0 +1,127 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+
+A benchmark for SqlParser, only built with -DWANT_BENCHMARKS=1 and not
+installed. It parses a generated CREATE TABLE and CREATE INDEX far wider than
+a real schema and prints how long each parse took and how many allocations
+it made, so a change to the tokeniser or the parser can be compared before
+and after. The index's columns and WHERE clause go through the expression
+parser, which the table's CHECKs and defaults don't.
+
+Usage: sqlparserbench [columns [rounds]]
+*/
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QStringList>
+#include <QtCore/QTextStream>
+
+#include <cstdlib>
+#include <new>
+
+#include "sqlparser.h"
+
+// Every operator new in the program is counted. QString and the arrays of
+// QList use malloc directly and aren't, so this is mostly nodes: Expressions,
+// and the entries of a QList of anything bigger than a pointer.
+static long allocations = 0;
+
+void * operator new(std::size_t size)
+{
+	++allocations;
+	void * p = std::malloc(size ? size : 1);
+	if (p == 0) { throw std::bad_alloc(); }
+	return p;
+}
+
+void operator delete(void * p) noexcept
+{
+	std::free(p);
+}
+
+// A table of columns columns, each with quoted names, a type with field
+// widths, a default and a CHECK, so that every kind of token is seen.
+static QString createTable(int columns)
+{
+	QStringList defs;
+	for (int i = 0; i < columns; ++i)
+	{
+		defs.append(QString("\"col %1\" NUMERIC(10,2) NOT NULL DEFAULT %1"
+							" CHECK (\"col %1\" >= 0 AND \"col %1\" < 'x''%1')")
+					.arg(i));
+	}
+	return QString("CREATE TABLE \"wide\" (%1, PRIMARY KEY (\"col 0\"))")
+		.arg(defs.join(", "));
+}
+
+// An index on the same table whose columns are calls with a sort order and
+// whose WHERE clause is a long chain of comparisons.
+static QString createIndex(int columns)
+{
+	QStringList cols;
+	QStringList terms;
+	for (int i = 0; i < columns; ++i)
+	{
+		cols.append(QString("abs(\"col %1\") DESC").arg(i));
+		terms.append(QString("\"col %1\" >= %1").arg(i));
+	}
+	return QString("CREATE INDEX \"wide_idx\" ON \"wide\" (%1) WHERE %2")
+		.arg(cols.join(", "), terms.join(" AND "));
+}
+
+// How many columns the parser found: fields for a table, or indexed columns
+static int parse(const QString & sql, bool index)
+{
+	SqlParser parser(sql);
+	return index ? parser.m_columns.count() : parser.m_fields.count();
+}
+
+static bool bench(QTextStream & out, const QString & what,
+				  const QString & sql, bool index, int columns, int rounds)
+{
+	int parsed = 0;
+	long before = allocations;
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < rounds; ++i)
+	{
+		parsed = parse(sql, index);
+	}
+	qint64 elapsed = timer.elapsed();
+	long made = (allocations - before) / rounds;
+
+	out << QString("%1, %2 columns, %3 characters:"
+				   " %4 ms and %5 allocations a parse\n")
+			.arg(what).arg(columns).arg(sql.length())
+			.arg(double(elapsed) / rounds, 0, 'f', 2).arg(made);
+	if (parsed != columns)
+	{
+		out << QString("only %1 of %2 columns were parsed\n")
+				.arg(parsed).arg(columns);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char ** argv)
+{
+	QCoreApplication app(argc, argv);
+	QStringList args(app.arguments());
+	int columns = (args.count() > 1) ? args.at(1).toInt() : 2000;
+	int rounds = (args.count() > 2) ? args.at(2).toInt() : 20;
+	QTextStream out(stdout);
+	if ((columns <= 0) || (rounds <= 0))
+	{
+		out << "usage: sqlparserbench [columns [rounds]]\n";
+		return 2;
+	}
+
+	bool ok = bench(out, "CREATE TABLE", createTable(columns), false,
+					columns, rounds);
+	ok &= bench(out, "CREATE INDEX", createIndex(columns), true,
+				columns, rounds);
+	return ok ? 0 : 1;
+}
@@ -14,8 +14,8 @@ for which a new license (GPL+exception) is in place.
 #include <QSqlError>
 #include <QTableWidget>
 #include <QtCore/QTimer>
-#include <QTreeWidgetItem>
 
+#include "catalogue.h"
 #include "litemanwindow.h"
 #include "mylineedit.h"
 #include "preferences.h"
@@ -180,7 +180,7 @@ QString TableEditorDialog::schema()
 	return ui.databaseCombo->currentText();
 }
 
-void TableEditorDialog::setItem(QTreeWidgetItem * item, bool makeView)
+void TableEditorDialog::setItem(SchemaItem * item, bool makeView)
 {
 	ui.databaseCombo->addItems(m_creator->visibleDatabases());
     m_noTemp = (ui.databaseCombo->findText("temp", Qt::MatchFixedString) < 0);
@@ -443,25 +443,12 @@ bool TableEditorDialog::checkOk()
         if (   m_originalName.isNull()
             || (m_originalName.compare(fullname, Qt::CaseInsensitive) != 0))
         { // creating table or view with new name
-            QString sql = "SELECT type FROM " + databaseName + "."
-                        + "sqlite_master WHERE "
-                        + "(type IS 'table' OR type is 'view' OR type is 'index')"
-                        + " AND lower(name) IS lower("
-                        + Utils::q(newName, "'") + ");";
-            QSqlQuery query(sql, QSqlDatabase::database(SESSION_NAME));
-            if (query.lastError().isValid())
+            // new name is already a table or view or index
+            CatalogueRef catalogue = Catalogue::snapshot(m_databaseName);
+            if (catalogue && catalogue->names.contains(newName.toLower()))
             {
-                QString errtext = tr("Cannot read schema for ")
-                                + ui.databaseCombo->currentText()
-                                + ":<br/><span style=\" color:#ff0000;\">"
-                                + query.lastError().text()
-                                + "<br/></span>" + tr("using sql statement:")
-                                + "<br/><code>" + sql;
-                resultAppend(errtext);
-            } else if (query.first()) {
-                ok = false; // new name is already a table or view or index
+                ok = false;
             }
-            query.clear();
         }
     }
 	return ok;
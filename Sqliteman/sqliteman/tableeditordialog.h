@@ -26,7 +26,7 @@ modified instead.
 \author Petr Vanek <petr@scribus.info>
 \author Igor Khanin
 */
-class QTreeWidgetItem;
+class SchemaItem;
 
 class TableEditorDialog : public DialogCommon // public QDialog
 {
@@ -61,7 +61,7 @@ protected:
     QWidget * m_oldWidget; // the widget from which we got the SQL
     bool m_noTemp; // temp database does not exist yet
 
-    void setItem(QTreeWidgetItem * item, bool makeView);
+    void setItem(SchemaItem * item, bool makeView);
     QString createdName();
     bool checkOk();
     virtual bool checkColumn(
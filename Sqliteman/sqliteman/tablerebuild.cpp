@@ -0,0 +1,200 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include "tablerebuild.h"
+
+// Rows copied by one INSERT ... SELECT
+#define REBUILD_CHUNK_ROWS 20000
+// Virtual machine instructions between checks for cancel()
+#define REBUILD_PROGRESS_OPS 10000
+
+TableRebuild::TableRebuild(sqlite3 * db, QObject * parent)
+	: QThread(parent),
+	  m_db(db),
+	  m_copyWeight(0),
+	  m_total(0),
+	  m_step(-1),
+	  m_cancelled(0),
+	  m_done(0),
+	  m_rows(0)
+{
+}
+
+void TableRebuild::setCopy(const QString & insert, const QString & select,
+						   const QString & source, const QString & rowid,
+						   qint64 weight)
+{
+	m_insert = insert;
+	m_select = select;
+	m_source = source;
+	m_rowid = rowid;
+	m_total += weight - m_copyWeight;
+	m_copyWeight = weight;
+}
+
+void TableRebuild::addStep(const QString & sql, const QString & label,
+						   const QString & message, qint64 weight, bool fatal)
+{
+	Step step;
+	step.sql = sql;
+	step.label = label;
+	step.message = message;
+	step.weight = weight;
+	step.fatal = fatal;
+	m_steps.append(step);
+	m_total += weight;
+}
+
+QString TableRebuild::stepText() const
+{
+	int i = m_step.loadAcquire();
+	return (i < 0) ? QString() : m_steps.at(i).label;
+}
+
+void TableRebuild::cancel()
+{
+	m_cancelled.storeRelease(1);
+}
+
+int TableRebuild::progressHandler(void * rebuild)
+{
+	return ((TableRebuild *)rebuild)->m_cancelled.loadAcquire();
+}
+
+bool TableRebuild::sqliteError(const QString & context)
+{
+	if (!wasCancelled())
+	{
+		m_error = QString("%1: %2").arg(context)
+				  .arg(QString::fromUtf8(sqlite3_errmsg(m_db)));
+	}
+	return false;
+}
+
+bool TableRebuild::exec(const QString & sql)
+{
+	return sqlite3_exec(m_db, sql.toUtf8().constData(), 0, 0, 0)
+		   == SQLITE_OK;
+}
+
+void TableRebuild::run()
+{
+	sqlite3_progress_handler(m_db, REBUILD_PROGRESS_OPS,
+							 progressHandler, this);
+	bool ok = m_insert.isEmpty() || copy();
+	qint64 done = m_copyWeight;
+	m_done.storeRelease(done);
+	for (int i = 0; ok && (i < m_steps.count()); ++i)
+	{
+		m_step.storeRelease(i);
+		const Step & step = m_steps.at(i);
+		if (!exec(step.sql))
+		{
+			if (wasCancelled() || step.fatal)
+			{
+				ok = sqliteError(step.message);
+			}
+			else
+			{
+				m_warnings.append(QString("%1: %2").arg(step.message)
+					.arg(QString::fromUtf8(sqlite3_errmsg(m_db))));
+			}
+		}
+		done += step.weight;
+		m_done.storeRelease(done);
+	}
+	sqlite3_progress_handler(m_db, 0, 0, 0);
+	if (wasCancelled()) { m_error = QString(); }
+}
+
+bool TableRebuild::copy()
+{
+	if (!m_rowid.isNull()) { return copyByRowid(); }
+	QString sql = m_insert + " " + m_select + " FROM " + m_source + ";";
+	if (!exec(sql)) { return sqliteError(sql); }
+	m_rows.storeRelease(sqlite3_changes(m_db));
+	return true;
+}
+
+bool TableRebuild::copyByRowid()
+{
+	// the range for the progress, from the ends of the table's b-tree
+	qint64 first = 0;
+	qint64 last = -1;
+	sqlite3_stmt * stmt = 0;
+	// a column may hide rowid itself, so it's m_rowid
+	QByteArray sql = QString("SELECT min(%1), max(%1) FROM %2;")
+					 .arg(m_rowid, m_source).toUtf8();
+	if (sqlite3_prepare_v2(m_db, sql.constData(), -1, &stmt, 0) != SQLITE_OK)
+	{
+		return sqliteError(sql);
+	}
+	if (   (sqlite3_step(stmt) == SQLITE_ROW)
+		&& (sqlite3_column_type(stmt, 0) != SQLITE_NULL))
+	{
+		first = sqlite3_column_int64(stmt, 0);
+		last = sqlite3_column_int64(stmt, 1);
+	}
+	sqlite3_finalize(stmt);
+	if (last < first) { return true; } // empty
+
+	// where each chunk ends, and the chunk itself
+	sqlite3_stmt * bound = 0;
+	sqlite3_stmt * chunk = 0;
+	QByteArray boundSql = QString("SELECT %1 FROM %2 WHERE %1 >= ?1 "
+								  "ORDER BY %1 LIMIT 1 OFFSET %3;")
+						  .arg(m_rowid, m_source)
+						  .arg(REBUILD_CHUNK_ROWS).toUtf8();
+	QByteArray chunkSql = QString("%1 %2 FROM %3 WHERE %4 >= ?1 "
+								  "AND %4 <= ?2;")
+						  .arg(m_insert, m_select, m_source, m_rowid).toUtf8();
+	if (sqlite3_prepare_v2(m_db, boundSql.constData(), -1, &bound, 0)
+		!= SQLITE_OK)
+	{
+		return sqliteError(boundSql);
+	}
+	if (sqlite3_prepare_v2(m_db, chunkSql.constData(), -1, &chunk, 0)
+		!= SQLITE_OK)
+	{
+		sqlite3_finalize(bound);
+		return sqliteError(chunkSql);
+	}
+
+	bool ok = true;
+	qint64 from = first;
+	bool more = true;
+	while (more)
+	{
+		// the chunk ends before the rowid REBUILD_CHUNK_ROWS rows on
+		qint64 next = 0;
+		sqlite3_bind_int64(bound, 1, from);
+		int rc = sqlite3_step(bound);
+		if (rc == SQLITE_ROW) { next = sqlite3_column_int64(bound, 0); }
+		else if (rc == SQLITE_DONE) { more = false; }
+		else { ok = sqliteError(boundSql); break; }
+		sqlite3_reset(bound);
+
+		sqlite3_bind_int64(chunk, 1, from);
+		sqlite3_bind_int64(chunk, 2, more ? next - 1 : last);
+		if (sqlite3_step(chunk) != SQLITE_DONE)
+		{
+			ok = sqliteError(chunkSql);
+			break;
+		}
+		sqlite3_reset(chunk);
+		m_rows.fetchAndAddRelease(sqlite3_changes(m_db));
+		// how far through the rowids we are
+		double fraction = more ? (double)(next - first)
+								 / ((double)(last - first) + 1.0)
+							   : 1.0;
+		m_done.storeRelease((qint64)(m_copyWeight * fraction));
+		from = next;
+	}
+	sqlite3_finalize(bound);
+	sqlite3_finalize(chunk);
+	return ok;
+}
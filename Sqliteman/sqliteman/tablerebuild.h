@@ -0,0 +1,109 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef TABLEREBUILD_H
+#define TABLEREBUILD_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+
+#include "sqlite3.h"
+
+/*! \brief The slow part of rebuilding a table for AlterTableDialog, on a
+worker thread: copying the rows into the new table and then running the
+statements which follow, such as dropping the old table and recreating
+its indexes.
+The rows are copied in chunks of rowid ranges, so that progress is known,
+unless the table has no rowid or columns hide all of its names,
+and a progress handler lets cancel() interrupt any statement. The work is
+done on the GUI's connection inside its savepoint while the GUI waits, so
+the caller rolls back if it fails or is cancelled.
+The GUI polls done() against total(), which are in units of pages.
+*/
+class TableRebuild : public QThread
+{
+	Q_OBJECT
+
+	public:
+		TableRebuild(sqlite3 * db, QObject * parent = 0);
+
+		/*! \brief Copy the rows first.
+		\param insert "INSERT INTO new (columns)"
+		\param select "SELECT columns"
+		\param source the old table, schema qualified and quoted
+		\param rowid the name of the source's rowid, from
+		Utils::rowidAlias(), to copy in rowid ranges, or a null string
+		to copy in one statement
+		\param weight how much of the work it is, e.g. the table's pages
+		*/
+		void setCopy(const QString & insert, const QString & select,
+					 const QString & source, const QString & rowid,
+					 qint64 weight);
+		/*! \brief Run \a sql after the copy, in the order they are added.
+		\param label what it does, for the progress dialog
+		\param message prefix for the error if it fails
+		\param fatal if false, a failure is only reported as a warning
+		and the rebuild goes on */
+		void addStep(const QString & sql, const QString & label,
+					 const QString & message, qint64 weight, bool fatal);
+
+		qint64 total() const { return m_total; }
+		qint64 done() const { return m_done.loadAcquire(); }
+		qint64 rowsCopied() const { return m_rows.loadAcquire(); }
+		//! \brief The label of the step being run, null while copying
+		QString stepText() const;
+
+		//! \brief Null if it completed, otherwise why it didn't
+		QString errorString() const { return m_error; }
+		//! \brief Failures of the steps which weren't fatal
+		QStringList warnings() const { return m_warnings; }
+		bool wasCancelled() const { return m_cancelled.loadAcquire() != 0; }
+
+	public slots:
+		//! \brief Interrupt the current statement and stop.
+		void cancel();
+
+	protected:
+		void run();
+
+	private:
+		typedef struct
+		{
+			QString sql;
+			QString label;
+			QString message;
+			qint64 weight;
+			bool fatal;
+		}
+		Step;
+
+		bool copy();
+		bool copyByRowid();
+		bool exec(const QString & sql);
+		bool sqliteError(const QString & context);
+		static int progressHandler(void * rebuild);
+
+		sqlite3 * m_db;
+		QString m_insert;
+		QString m_select;
+		QString m_source;
+		QString m_rowid;
+		qint64 m_copyWeight;
+		QList<Step> m_steps;
+		qint64 m_total;
+
+		QString m_error;
+		QStringList m_warnings;
+		QAtomicInt m_step; // -1 while copying
+		QAtomicInt m_cancelled;
+		QAtomicInteger<qint64> m_done;
+		QAtomicInteger<qint64> m_rows;
+};
+
+#endif
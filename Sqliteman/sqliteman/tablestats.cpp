@@ -0,0 +1,152 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#include <QSqlQuery>
+#include <QtCore/QStringList>
+#include <QtCore/QVariant>
+
+#include "catalogue.h"
+#include "tablestats.h"
+#include "utils.h"
+
+// Virtual machine instructions between checks for cancelling
+#define STATS_PROGRESS_OPS 10000
+
+void TableStats::init(ObjectStats & stats, const QString & schema,
+					  const QString & name, bool isIndex)
+{
+	stats.schema = schema;
+	stats.name = name;
+	stats.isIndex = isIndex;
+	stats.estimate = -1;
+	stats.rows = -1;
+	stats.pages = -1;
+	stats.bytes = -1;
+	stats.unused = -1;
+	stats.generation = 0;
+	stats.done = false;
+}
+
+qint64 TableStats::estimate(const QString & table, const QString & schema)
+{
+	// don't complain about a database which has never been analyzed
+	CatalogueRef catalogue = Catalogue::snapshot(schema);
+	if (!catalogue || !catalogue->system.contains("sqlite_stat1"))
+	{
+		return -1;
+	}
+	QSqlQuery query(QSqlDatabase::database(SESSION_NAME));
+	query.prepare(QString("SELECT stat FROM %1.sqlite_stat1 "
+						  "WHERE tbl = ? LIMIT 1;").arg(Utils::q(schema)));
+	query.addBindValue(table);
+	if (!query.exec() || !query.next()) { return -1; }
+	// the first number is the rows in the table, whichever index it's for
+	bool ok;
+	qint64 rows = query.value(0).toString().section(' ', 0, 0).toLongLong(&ok);
+	return ok ? rows : -1;
+}
+
+QString TableStats::stamp(const QString & schema)
+{
+	QSqlQuery query(QString("PRAGMA %1.data_version;").arg(Utils::q(schema)),
+					QSqlDatabase::database(SESSION_NAME));
+	QString version(query.next() ? query.value(0).toString() : QString());
+	sqlite3 * db = Database::sqlite3handle();
+	return QString("%1:%2").arg(version)
+		   .arg(db ? sqlite3_total_changes(db) : 0);
+}
+
+int TableStats::progressHandler(void * cancel)
+{
+	return ((const QAtomicInt *)cancel)->loadAcquire();
+}
+
+void TableStats::read(sqlite3 * db, const QString & dbSchema,
+					  ObjectStats & stats, const QAtomicInt * cancel)
+{
+	sqlite3_progress_handler(db, STATS_PROGRESS_OPS, progressHandler,
+							 (void *)cancel);
+	QByteArray name(stats.name.toUtf8());
+	QByteArray schema(dbSchema.toUtf8());
+	sqlite3_stmt * stmt = 0;
+	bool ok = true;
+	if (!stats.isIndex)
+	{
+		QByteArray sql = QString("SELECT count(*) FROM %1.%2;")
+						 .arg(Utils::q(dbSchema), Utils::q(stats.name))
+						 .toUtf8();
+		ok =    (sqlite3_prepare_v2(db, sql.constData(), -1, &stmt, 0)
+				 == SQLITE_OK)
+			 && (sqlite3_step(stmt) == SQLITE_ROW);
+		if (ok) { stats.rows = sqlite3_column_int64(stmt, 0); }
+		sqlite3_finalize(stmt);
+		stmt = 0;
+	}
+
+	// the second argument makes dbstat add up the pages of each b-tree
+	const char * sql = "SELECT pageno, pgsize, unused FROM dbstat(?2, 1) "
+					   "WHERE name = ?1;";
+	if (   ok
+		&& (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) == SQLITE_OK))
+	{
+		sqlite3_bind_text(stmt, 1, name.constData(), name.size(),
+						  SQLITE_STATIC);
+		sqlite3_bind_text(stmt, 2, schema.constData(), schema.size(),
+						  SQLITE_STATIC);
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			stats.pages = sqlite3_column_int64(stmt, 0);
+			stats.bytes = sqlite3_column_int64(stmt, 1);
+			stats.unused = sqlite3_column_int64(stmt, 2);
+		}
+	}
+	sqlite3_finalize(stmt);
+	sqlite3_progress_handler(db, 0, 0, 0);
+	stats.done = true;
+}
+
+QString TableStats::formatSize(qint64 size)
+{
+	if (size < 1024)
+		return tr("%L1 B").arg(size);
+	else if (size < 1024 * 1024)
+		return tr("%L1 KB").arg(size / 1024);
+	else if (size < 1024 * 1024 * 1024)
+		return tr("%L1 MB").arg(double(size) / 1024.0 / 1024.0, 0, 'f', 1);
+	else
+		return tr("%L1 GB").arg(double(size) / 1024.0 / 1024.0 / 1024.0,
+								0, 'f', 1);
+}
+
+QString TableStats::describe(const ObjectStats & stats)
+{
+	QStringList lines;
+	if (stats.rows >= 0)
+	{
+		lines.append(tr("%L1 rows").arg(stats.rows));
+	}
+	else if (stats.estimate >= 0)
+	{
+		lines.append(tr("About %L1 rows, when last analyzed")
+					 .arg(stats.estimate));
+	}
+	if (stats.pages >= 0)
+	{
+		lines.append(tr("%1 in %L2 pages").arg(formatSize(stats.bytes))
+					 .arg(stats.pages));
+		if (stats.bytes > 0)
+		{
+			lines.append(tr("%1% of it unused")
+						 .arg(100.0 * stats.unused / stats.bytes, 0, 'f', 1));
+		}
+	}
+	if (!stats.done)
+	{
+		lines.append(tr("Counting..."));
+	}
+	return lines.join("\n");
+}
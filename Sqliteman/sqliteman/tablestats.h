@@ -0,0 +1,75 @@
+/*
+For general Sqliteman copyright and licensing information please refer
+to the COPYING file provided with the program. Following this notice may exist
+a copyright and/or license notice that predates the release of Sqliteman
+for which a new license (GPL+exception) is in place.
+*/
+
+#ifndef TABLESTATS_H
+#define TABLESTATS_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QString>
+
+#include "sqlite3.h"
+
+/*! \brief How big one table or index is.
+Each number is -1 until it is known. */
+typedef struct
+{
+	QString schema;
+	QString name;
+	bool isIndex;
+	qint64 estimate; //!< rows, from sqlite_stat1
+	qint64 rows; //!< exact, tables only
+	qint64 pages;
+	qint64 bytes; //!< of the pages
+	qint64 unused; //!< bytes in the pages which hold nothing
+	QString stamp; //!< see TableStats::stamp()
+	int generation; //!< see TableTree
+	bool done; //!< nothing more is coming
+}
+ObjectStats;
+
+/*! \brief Statistics for the schema browser's tooltips.
+The estimated row count from sqlite_stat1 is cheap, so it is read on the
+GUI's connection at once. The exact row count and the space used, from
+count(*) and the dbstat virtual table, have to read the whole b-tree, so
+TableTree gets them on a worker thread with read().
+*/
+class TableStats
+{
+		Q_DECLARE_TR_FUNCTIONS(TableStats)
+
+	public:
+		//! \brief Set up \a stats for \a name in \a schema, nothing known
+		static void init(ObjectStats & stats, const QString & schema,
+						 const QString & name, bool isIndex);
+
+		/*! \brief What ANALYZE found, on the GUI's connection.
+		\retval qint64 the number of rows, or -1 if it wasn't analyzed */
+		static qint64 estimate(const QString & table, const QString & schema);
+
+		/*! \brief Something which changes whenever the data in \a schema
+		may have: PRAGMA data_version, which changes when another connection
+		commits, and the changes made by the GUI's connection. */
+		static QString stamp(const QString & schema);
+
+		/*! \brief Count the rows and measure the b-tree, on \a db.
+		\param dbSchema the name of stats.schema on \a db
+		\param cancel stop as soon as it isn't 0
+		dbstat may not have been compiled in, and then only the rows are
+		counted. */
+		static void read(sqlite3 * db, const QString & dbSchema,
+						 ObjectStats & stats, const QAtomicInt * cancel);
+
+		//! \brief Describe \a stats for a tooltip
+		static QString describe(const ObjectStats & stats);
+
+	private:
+		static QString formatSize(qint64 size);
+		static int progressHandler(void * cancel);
+};
+
+#endif
@@ -5,16 +5,100 @@ a copyright and/or license notice that predates the release of Sqliteman
 for which a new license (GPL+exception) is in place.
 */
 #include <QApplication>
+#include <QCursor>
 #include <QDrag>
+#include <QHelpEvent>
 #include <QMimeData>
 #include <QMouseEvent>
+#include <QToolTip>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QSet>
 
 #include "database.h"
 #include "tabletree.h"
 #include "utils.h"
 
+// How long a reader waits for a lock held by the GUI's connection
+#define READER_BUSY_TIMEOUT 2000
 
-TableTree::TableTree(QWidget * parent) : QTreeWidget(parent)
+namespace {
+	/*! \brief The read only connection to \a file in \a readers,
+	which is opened the first time. Only use it on the readers' thread.
+	\retval sqlite3* 0 if it can't be opened */
+	sqlite3 * reader(QMap<QString, sqlite3 *> * readers, const QString & file)
+	{
+		sqlite3 * db = readers->value(file);
+		if (!db)
+		{
+			if (sqlite3_open_v2(file.toUtf8().constData(), &db,
+								SQLITE_OPEN_READONLY, 0) != SQLITE_OK)
+			{
+				sqlite3_close(db);
+				return 0;
+			}
+			sqlite3_busy_timeout(db, READER_BUSY_TIMEOUT);
+			readers->insert(file, db);
+		}
+		return db;
+	}
+
+	//! \brief Reads a table's contents on TableTree's worker thread
+	class LoadTable
+	{
+		public:
+			typedef TableContents result_type;
+
+			LoadTable(QMap<QString, sqlite3 *> * readers,
+					  const QString & file, const TableContents & contents)
+				: m_readers(readers), m_file(file), m_contents(contents) {}
+
+			TableContents operator()()
+			{
+				TableContents contents(m_contents);
+				sqlite3 * db = reader(m_readers, m_file);
+				if (db) { TableTree::readTable(db, "main", contents); }
+				return contents;
+			}
+
+		private:
+			QMap<QString, sqlite3 *> * m_readers;
+			QString m_file;
+			TableContents m_contents;
+	};
+
+	//! \brief Counts a table or index on TableTree's statistics thread
+	class LoadStats
+	{
+		public:
+			typedef ObjectStats result_type;
+
+			LoadStats(QMap<QString, sqlite3 *> * readers, const QString & file,
+					  const ObjectStats & stats, const QAtomicInt * cancel)
+				: m_readers(readers), m_file(file), m_stats(stats),
+				  m_cancel(cancel) {}
+
+			ObjectStats operator()()
+			{
+				ObjectStats stats(m_stats);
+				sqlite3 * db = reader(m_readers, m_file);
+				if (db) { TableStats::read(db, "main", stats, m_cancel); }
+				stats.done = true;
+				return stats;
+			}
+
+		private:
+			QMap<QString, sqlite3 *> * m_readers;
+			QString m_file;
+			ObjectStats m_stats;
+			const QAtomicInt * m_cancel;
+	};
+}
+
+
+
+
+TableTree::TableTree(QWidget * parent) : QTreeView(parent)
 {
 	trDatabase = tr("Database");
 	trTables = tr("Tables");
@@ -24,105 +108,533 @@ TableTree::TableTree(QWidget * parent) : QTreeWidget(parent)
 	trTriggers = tr("Triggers");
 	trSys = tr("System Catalogue");
 	trCols = tr("Columns");
-	
-	setColumnCount(2);
-	setHeaderLabels(QStringList() << trDatabase << "schema");
-	hideColumn(1);
-	
+
+	m_model = new SchemaModel(this);
+	m_model->setHeader(trDatabase);
+	setModel(m_model);
+
 	setContextMenuPolicy(Qt::CustomContextMenu);
 	setDragDropMode(QAbstractItemView::DragOnly);
 	setDragEnabled(true);
 	setDropIndicatorShown(true);
 	setAcceptDrops(false);
+	/* Every row is an icon and a name, so there's no need to measure them,
+	 * and then the view only asks the model for the rows it shows. */
+	setUniformRowHeights(true);
     m_pressed = false;
+
+	m_loader.setMaxThreadCount(1);
+	m_statsLoader.setMaxThreadCount(1);
+	m_generation = 0;
+	// the view asks for more while laying itself out, so read it afterwards
+	connect(m_model, SIGNAL(fetch(const QPersistentModelIndex &)),
+			this, SLOT(loadExpanded(const QPersistentModelIndex &)),
+			Qt::QueuedConnection);
+	connect(this, SIGNAL(activated(const QModelIndex &)),
+			this, SLOT(indexActivated(const QModelIndex &)));
+	connect(selectionModel(),
+			SIGNAL(selectionChanged(const QItemSelection &,
+									const QItemSelection &)),
+			this, SIGNAL(itemSelectionChanged()));
+
+	m_refreshTimer.setSingleShot(true);
+	m_refreshTimer.setInterval(0);
+	connect(&m_refreshTimer, SIGNAL(timeout()), this, SLOT(buildTree()));
+}
+
+TableTree::~TableTree()
+{
+	closeReaders();
+}
+
+void TableTree::closeReaders()
+{
+	// results still to come are from before, so they'll be ignored
+	++m_generation;
+	m_cancelStats.storeRelease(1);
+	m_loader.waitForDone();
+	m_statsLoader.waitForDone();
+	m_cancelStats.storeRelease(0);
+	QMap<QString, sqlite3 *>::const_iterator i;
+	for (i = m_readers.constBegin(); i != m_readers.constEnd(); ++i)
+	{
+		sqlite3_close(i.value());
+	}
+	m_readers.clear();
+	for (i = m_statsReaders.constBegin(); i != m_statsReaders.constEnd(); ++i)
+	{
+		sqlite3_close(i.value());
+	}
+	m_statsReaders.clear();
+	m_stats.clear();
+	m_loading.clear();
+}
+
+int TableTree::topLevelItemCount() const
+{
+	return m_model->topLevelItemCount();
+}
+
+SchemaItem * TableTree::topLevelItem(int row) const
+{
+	return m_model->topLevelItem(row);
+}
+
+SchemaItem * TableTree::currentItem() const
+{
+	return m_model->item(currentIndex());
+}
+
+void TableTree::setCurrentItem(SchemaItem * item)
+{
+	setCurrentIndex(m_model->indexOf(item));
+}
+
+QList<SchemaItem *> TableTree::selectedItems() const
+{
+	QList<SchemaItem *> result;
+	QModelIndexList indexes(selectionModel()->selectedIndexes());
+	QModelIndexList::const_iterator i;
+	for (i = indexes.constBegin(); i != indexes.constEnd(); ++i) {
+		result.append(m_model->item(*i));
+	}
+	return result;
+}
+
+SchemaItem * TableTree::itemAt(const QPoint & pos) const
+{
+	return m_model->item(indexAt(pos));
+}
+
+bool TableTree::isItemExpanded(SchemaItem * item) const
+{
+	return isExpanded(m_model->indexOf(item));
+}
+
+void TableTree::setItemExpanded(SchemaItem * item, bool expanded)
+{
+	QModelIndex index(m_model->indexOf(item));
+	if (index.isValid()) { setExpanded(index, expanded); }
+}
+
+void TableTree::removeItem(SchemaItem * item)
+{
+	if (item->type() == DatabaseItemType) { m_shown.remove(item->text(1)); }
+	m_model->removeItem(item);
+}
+
+void TableTree::clear()
+{
+	m_model->clear();
+	m_shown.clear();
+}
+
+void TableTree::indexActivated(const QModelIndex & index)
+{
+	SchemaItem * item = m_model->item(index);
+	if (item) { emit itemActivated(item, index.column()); }
+}
+
+void TableTree::refresh()
+{
+	m_refreshTimer.start();
 }
 
 void TableTree::buildTree()
 {
+	m_refreshTimer.stop();
 	QStringList databases(Database::getDatabases().keys());
-	clear();
+	for (int i = topLevelItemCount() - 1; i >= 0; --i)
+	{
+		SchemaItem * dbItem = topLevelItem(i);
+		if (!databases.contains(dbItem->text(1)))
+		{
+			// detached
+			removeItem(dbItem);
+		}
+	}
     QStringList::const_iterator i;
     for (i = databases.constBegin(); i != databases.constEnd(); ++i) {
-		buildDatabase(*i);
+		SchemaItem * dbItem = findDatabase(*i);
+		if (!dbItem) { buildDatabase(*i); }
+		else { updateDatabase(dbItem, *i); }
 	}
-	setSelection(QRect(0, 0, 0, 0), QItemSelectionModel::Clear);
 }
 
-void TableTree::buildDatabase(QTreeWidgetItem * dbItem, const QString & schema)
+void TableTree::buildDatabase(SchemaItem * dbItem, const QString & schema)
 {
-	deleteChildren(dbItem);
+	removeItem(dbItem);
 	buildDatabase(schema);
 }
 
 void TableTree::buildDatabase(const QString & schema)
 {
-	QTreeWidgetItem * dbItem = new QTreeWidgetItem(this, DatabaseItemType);
-	dbItem->setIcon(0, Utils::getIcon("database.png"));
-	dbItem->setText(0, schema);
-	dbItem->setText(1, schema);
-
-	lastTablesItem = new QTreeWidgetItem(dbItem, TablesItemType);
-	lastTablesItem->setIcon(0, Utils::getIcon("table.png"));
+	SchemaItem * dbItem = m_model->addDatabase(schema);
+	lastTablesItem = m_model->appendChild(dbItem, TablesItemType, QString());
+	lastViewsItem = m_model->appendChild(dbItem, ViewsItemType, QString());
+	SchemaItem * systemItem =
+		m_model->appendChild(dbItem, SystemItemType, QString());
 
-	lastViewsItem = new QTreeWidgetItem(dbItem, ViewsItemType);
-	lastViewsItem->setIcon(0, Utils::getIcon("view.png"));
+	// everything at this level from one read of sqlite_master
+	CatalogueRef catalogue = Catalogue::snapshot(schema);
+	CatalogueSnapshot none;
+	const CatalogueSnapshot & c = catalogue ? *catalogue : none;
+	m_shown.insert(schema, catalogue);
 
-	QTreeWidgetItem * systemItem = new QTreeWidgetItem(dbItem, SystemItemType);
-	systemItem->setIcon(0, Utils::getIcon("system.png"));
+	fillTables(lastTablesItem, c.objectsOf("table").keys());
+	fillViews(lastViewsItem, c.objectsOf("view").keys());
+	fillCatalogue(systemItem, c.system.keys());
 
-	buildTables(lastTablesItem, schema, false);
-	buildViews(lastViewsItem, schema);
-	buildCatalogue(systemItem, schema);
+	setItemExpanded(dbItem, true);
+}
 
-	dbItem->setExpanded(true);
+SchemaItem * TableTree::findDatabase(const QString & schema)
+{
+	for (int i = 0; i < topLevelItemCount(); ++i)
+	{
+		if (topLevelItem(i)->text(1) == schema) { return topLevelItem(i); }
+	}
+	return 0;
 }
 
-void TableTree::buildTableItem(QTreeWidgetItem * tableItem, bool rebuild)
+void TableTree::buildTableItem(SchemaItem * tableItem, bool rebuild)
 {
-	if (rebuild) { deleteChildren(tableItem); }
+	if (!rebuild && m_model->isFilled(tableItem)) { return; }
+	if (tableItem->type() == ViewType)
+	{
+		fillViewItem(tableItem);
+		return;
+	}
 
-	QString schema = tableItem->text(1);
-	QString table = tableItem->text(0);
+	TableContents contents;
+	contents.schema = tableItem->text(1);
+	contents.table = tableItem->text(0);
+	contents.generation = m_generation;
+	sqlite3 * db = Database::sqlite3handle();
+	if (db) { readTable(db, contents.schema, contents); }
+	else { contents.ok = false; }
+	if (contents.ok)
+	{
+		fillTableItem(tableItem, contents);
+		return;
+	}
+
+	// the table valued pragmas need sqlite 3.16, so the old way
+	m_model->clearChildren(tableItem);
+	m_model->setFilled(tableItem, true);
+	QString schema = contents.schema;
+	QString table = contents.table;
 	// columns
-	QTreeWidgetItem *columnsItem = new QTreeWidgetItem(tableItem, ColumnItemType);
+	SchemaItem *columnsItem =
+		m_model->appendChild(tableItem, ColumnItemType, QString());
 	buildColumns(columnsItem, schema, table);
 	// indexes
-	QTreeWidgetItem *indexesItem = new QTreeWidgetItem(tableItem, IndexesItemType);
+	SchemaItem *indexesItem =
+		m_model->appendChild(tableItem, IndexesItemType, QString());
 	buildIndexes(indexesItem, schema, table);
 	// system indexes (unique)
-	QTreeWidgetItem *sysIndexesItem = new QTreeWidgetItem(tableItem, SysIndexesItemType);
+	SchemaItem *sysIndexesItem =
+		m_model->appendChild(tableItem, SysIndexesItemType, QString());
 	buildSysIndexes(sysIndexesItem, schema, table);
 	// triggers
-	QTreeWidgetItem *triggersItem = new QTreeWidgetItem(tableItem, TriggersItemType);
+	SchemaItem *triggersItem =
+		m_model->appendChild(tableItem, TriggersItemType, QString());
 	buildTriggers(triggersItem, schema, table);
 }
 
-void TableTree::buildTables(QTreeWidgetItem * tablesItem,
+void TableTree::readTable(sqlite3 * db, const QString & dbSchema,
+						  TableContents & contents)
+{
+	contents.ok = false;
+	contents.columns.clear();
+	contents.keys.clear();
+	contents.indexes.clear();
+	contents.sysIndexes.clear();
+	contents.triggers.clear();
+
+	// indexes with origin 'c' are the ones in sqlite_master
+	QByteArray sql = QString(
+		"SELECT 0, cid, name, pk FROM pragma_table_info(?1, ?2) "
+		"UNION ALL "
+		"SELECT 1, 0, name, origin = 'c' FROM pragma_index_list(?1, ?2) "
+		"UNION ALL "
+		"SELECT 2, 0, name, 0 FROM %1.sqlite_master "
+		"WHERE type = 'trigger' AND tbl_name = ?1 "
+		"ORDER BY 1, 2, 3;").arg(Utils::q(dbSchema)).toUtf8();
+	sqlite3_stmt * stmt = 0;
+	if (sqlite3_prepare_v2(db, sql.constData(), -1, &stmt, 0) != SQLITE_OK)
+	{
+		sqlite3_finalize(stmt);
+		return;
+	}
+	QByteArray table(contents.table.toUtf8());
+	QByteArray schema(dbSchema.toUtf8());
+	sqlite3_bind_text(stmt, 1, table.constData(), table.size(), SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, schema.constData(), schema.size(), SQLITE_STATIC);
+	int rc;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+	{
+		QString name(QString::fromUtf8(
+			(const char *)sqlite3_column_text(stmt, 2)));
+		bool flag = sqlite3_column_int(stmt, 3) != 0;
+		switch (sqlite3_column_int(stmt, 0))
+		{
+			case 0:
+				contents.columns.append(name);
+				contents.keys.append(flag);
+				break;
+			case 1:
+				if (flag) { contents.indexes.append(name); }
+				else { contents.sysIndexes.append(name); }
+				break;
+			default:
+				contents.triggers.append(name);
+				break;
+		}
+	}
+	sqlite3_finalize(stmt);
+	contents.ok = (rc == SQLITE_DONE);
+}
+
+void TableTree::fillTableItem(SchemaItem * tableItem,
+							  const TableContents & contents)
+{
+	m_model->clearChildren(tableItem);
+	m_model->setFilled(tableItem, true);
+
+	SchemaItem *columnsItem = m_model->appendChild(tableItem, ColumnItemType,
+		trLabel(trCols).arg(contents.columns.size()));
+	m_model->setChildren(columnsItem, ColumnType,
+						 contents.columns, contents.keys);
+
+	SchemaItem *indexesItem = m_model->appendChild(tableItem, IndexesItemType,
+		trLabel(trIndexes).arg(contents.indexes.size()));
+	m_model->setChildren(indexesItem, IndexType, contents.indexes);
+
+	SchemaItem *sysIndexesItem =
+		m_model->appendChild(tableItem, SysIndexesItemType,
+			trLabel(trSysIndexes).arg(contents.sysIndexes.size()));
+	m_model->setChildren(sysIndexesItem, SysIndexType, contents.sysIndexes);
+
+	SchemaItem *triggersItem =
+		m_model->appendChild(tableItem, TriggersItemType, QString());
+	fillTriggers(triggersItem, contents.triggers);
+}
+
+void TableTree::fillViewItem(SchemaItem * viewItem)
+{
+	CatalogueRef catalogue = Catalogue::snapshot(viewItem->text(1));
+	QStringList triggers;
+	if (catalogue)
+	{
+		triggers = catalogue->objectsOf("trigger").values(viewItem->text(0));
+	}
+	m_model->clearChildren(viewItem);
+	m_model->setFilled(viewItem, true);
+	SchemaItem *triggersItem =
+		m_model->appendChild(viewItem, TriggersItemType, QString());
+	fillTriggers(triggersItem, triggers);
+}
+
+void TableTree::loadExpanded(const QPersistentModelIndex & index)
+{
+	SchemaItem * item = m_model->item(index);
+	if (item) { loadItem(item); }
+}
+
+void TableTree::loadItem(SchemaItem * item)
+{
+	if (m_model->isFilled(item)) { return; }
+	if (item->type() == ViewType)
+	{
+		// its triggers are in the catalogue already
+		fillViewItem(item);
+		return;
+	}
+	if (item->type() != TableType) { return; }
+
+	TableContents contents;
+	contents.schema = item->text(1);
+	contents.table = item->text(0);
+	contents.generation = m_generation;
+	contents.ok = false;
+	QString file(readerFile(contents.schema));
+	if (file.isEmpty())
+	{
+		buildTableItem(item, false);
+		return;
+	}
+	// the view may ask again before the worker has answered
+	QString key(statsKey(contents.schema, contents.table));
+	if (m_loading.contains(key)) { return; }
+	m_loading.insert(key);
+	QFutureWatcher<TableContents> * watcher =
+		new QFutureWatcher<TableContents>(this);
+	connect(watcher, SIGNAL(finished()), this, SLOT(tableLoaded()));
+	watcher->setFuture(QtConcurrent::run(&m_loader,
+		LoadTable(&m_readers, file, contents)));
+}
+
+void TableTree::tableLoaded()
+{
+	QFutureWatcher<TableContents> * watcher =
+		static_cast<QFutureWatcher<TableContents> *>(sender());
+	TableContents contents = watcher->result();
+	watcher->deleteLater();
+	m_loading.remove(statsKey(contents.schema, contents.table));
+
+	// the tree may have been rebuilt meanwhile, so find the item again
+	SchemaItem * item = findTable(contents.schema, contents.table);
+	if (!item || m_model->isFilled(item)) { return; }
+	if (contents.generation != m_generation)
+	{
+		// read from a database which has since been closed
+		if (isItemExpanded(item)) { loadItem(item); }
+		return;
+	}
+	if (contents.ok) { fillTableItem(item, contents); }
+	else { buildTableItem(item, false); }
+}
+
+QString TableTree::readerFile(const QString & schema)
+{
+	/* The workers' connections only see what has been committed, and
+	 * temporary and in-memory databases are private to the GUI's one. */
+	if (   Database::isAutoCommit()
+		&& schema.compare("temp", Qt::CaseInsensitive))
+	{
+		return Database::getDatabases().value(schema);
+	}
+	return QString();
+}
+
+QString TableTree::statsKey(const QString & schema, const QString & name)
+{
+	return schema.toLower() + "\n" + name.toLower();
+}
+
+bool TableTree::viewportEvent(QEvent * event)
+{
+	if (event->type() == QEvent::ToolTip)
+	{
+		SchemaItem * item = itemAt(static_cast<QHelpEvent *>(event)->pos());
+		if (   item
+			&& (   (item->type() == TableType)
+				|| (item->type() == IndexType)
+				|| (item->type() == SysIndexType)))
+		{
+			updateStats(item);
+		}
+	}
+	return QTreeView::viewportEvent(event);
+}
+
+void TableTree::updateStats(SchemaItem * item)
+{
+	QString schema(item->text(1));
+	QString name(item->text(0));
+	QString key(statsKey(schema, name));
+	QString stamp(TableStats::stamp(schema));
+	QHash<QString, ObjectStats>::const_iterator i = m_stats.constFind(key);
+	if ((i != m_stats.constEnd()) && (i.value().stamp == stamp))
+	{
+		// known, or still being counted
+		item->setToolTip(TableStats::describe(i.value()));
+		return;
+	}
+
+	ObjectStats stats;
+	TableStats::init(stats, schema, name, item->type() != TableType);
+	stats.stamp = stamp;
+	stats.generation = m_generation;
+	if (!stats.isIndex) { stats.estimate = TableStats::estimate(name, schema); }
+	QString file(readerFile(schema));
+	if (file.isEmpty())
+	{
+		// counting on the GUI's connection could take far too long
+		stats.done = true;
+		item->setToolTip(TableStats::describe(stats));
+		return;
+	}
+	m_stats.insert(key, stats);
+	item->setToolTip(TableStats::describe(stats));
+
+	QFutureWatcher<ObjectStats> * watcher =
+		new QFutureWatcher<ObjectStats>(this);
+	connect(watcher, SIGNAL(finished()), this, SLOT(statsLoaded()));
+	watcher->setFuture(QtConcurrent::run(&m_statsLoader,
+		LoadStats(&m_statsReaders, file, stats, &m_cancelStats)));
+}
+
+void TableTree::statsLoaded()
+{
+	QFutureWatcher<ObjectStats> * watcher =
+		static_cast<QFutureWatcher<ObjectStats> *>(sender());
+	ObjectStats stats = watcher->result();
+	watcher->deleteLater();
+	QString key(statsKey(stats.schema, stats.name));
+	if (stats.generation != m_generation)
+	{
+		// from a database which has since been closed
+		return;
+	}
+	m_stats.insert(key, stats);
+
+	// update the tooltip if it's showing
+	SchemaItem * item = itemAt(viewport()->mapFromGlobal(QCursor::pos()));
+	if (   item
+		&& (statsKey(item->text(1), item->text(0)) == key)
+		&& (   (item->type() == TableType)
+			|| (item->type() == IndexType)
+			|| (item->type() == SysIndexType)))
+	{
+		QString text(TableStats::describe(stats));
+		item->setToolTip(text);
+		if (QToolTip::isVisible())
+		{
+			QToolTip::showText(QCursor::pos(), text, viewport());
+		}
+	}
+}
+
+SchemaItem * TableTree::findTable(const QString & schema,
+								  const QString & table)
+{
+	SchemaItem * dbItem = findDatabase(schema);
+	if (!dbItem) { return 0; }
+	for (int i = 0; i < dbItem->childCount(); ++i)
+	{
+		SchemaItem * tablesItem = dbItem->child(i);
+		if (tablesItem->type() != TablesItemType) { continue; }
+		// it may be filtered out, but it's still there
+		int position = m_model->findName(tablesItem, table);
+		if (position >= 0) { return m_model->childAt(tablesItem, position); }
+	}
+	return 0;
+}
+
+void TableTree::buildTables(SchemaItem * tablesItem,
                             const QString & schema, bool expand)
 {
-    deleteChildren(tablesItem);
+    fillTables(tablesItem, Database::getObjects("table", schema).keys());
+    if (expand) { setItemExpanded(tablesItem, true); }
+}
 
-    QStringList tables = Database::getObjects("table", schema).keys();
+void TableTree::fillTables(SchemaItem * tablesItem, const QStringList & tables)
+{
     tablesItem->setText(0, trLabel(trTables).arg(tables.size()));
-    tablesItem->setText(1, schema);
-    QStringList::const_iterator i;
-    for (i = tables.constBegin(); i != tables.constEnd(); ++i) {
-        QTreeWidgetItem * tableItem =
-            new QTreeWidgetItem(tablesItem, TableType);
-        tableItem->setText(0, *i);
-        tableItem->setText(1, schema);
-        buildTableItem(tableItem, false);
-    }
-    if (expand) { tablesItem->setExpanded(true); }
+    // the items for the tables are made as they are shown
+    m_model->setChildren(tablesItem, TableType, tables);
+    filterGroup(tablesItem);
 }
 
-void TableTree::buildIndexes(QTreeWidgetItem *indexesItem, const QString & schema, const QString & table)
+void TableTree::buildIndexes(SchemaItem *indexesItem, const QString & schema, const QString & table)
 {
 	if (indexesItem->type() == TableTree::TableType)
 	{
 		for (int i = 0; i < indexesItem->childCount(); ++i)
 		{
-			QTreeWidgetItem * item = indexesItem->child(i);
+			SchemaItem * item = indexesItem->child(i);
 			if (item->type() == TableTree::IndexesItemType)
 			{
 				indexesItem = item;
@@ -131,119 +643,325 @@ void TableTree::buildIndexes(QTreeWidgetItem *indexesItem, const QString & schem
 		}
 	}
 	if (indexesItem->type() != TableTree::IndexesItemType) { return; }
-	deleteChildren(indexesItem);
 	QStringList values = Database::getObjects("index", schema).values(table);
 	indexesItem->setText(0, trLabel(trIndexes).arg(values.size()));
-	indexesItem->setIcon(0, Utils::getIcon("index.png"));
-	indexesItem->setText(1, schema);
-	for (int i = 0; i < values.size(); ++i)
-	{
-		QTreeWidgetItem *indexItem = new QTreeWidgetItem(indexesItem, IndexType);
-		indexItem->setText(0, values.at(i));
-		indexItem->setText(1, schema);
-	}
+	m_model->setChildren(indexesItem, IndexType, values);
 }
 
-void TableTree::buildColumns(QTreeWidgetItem * columnsItem, const QString & schema, const QString & table)
+void TableTree::buildColumns(SchemaItem * columnsItem, const QString & schema, const QString & table)
 {
-	deleteChildren(columnsItem);
 	QList<FieldInfo> values = Database::tableFields(table, schema);
-	columnsItem->setText(0, trLabel(trCols).arg(values.size()));
-	columnsItem->setIcon(0, Utils::getIcon("column.png"));
-// 	columnsItem->setText(1, schema);
+	QStringList columns;
+	QList<bool> keys;
 	for (int i = 0; i < values.size(); ++i)
 	{
-		QTreeWidgetItem *columnItem = new QTreeWidgetItem(columnsItem, ColumnType);
-		columnItem->setText(0, values.at(i).name);
-		if (values.at(i).isPartOfPrimaryKey)
-			columnItem->setIcon(0, Utils::getIcon("key.png"));
-// 		indexItem->setText(1, schema);
+		columns.append(values.at(i).name);
+		keys.append(values.at(i).isPartOfPrimaryKey);
 	}
+	columnsItem->setText(0, trLabel(trCols).arg(values.size()));
+	m_model->setChildren(columnsItem, ColumnType, columns, keys);
 }
 
-void TableTree::buildSysIndexes(QTreeWidgetItem *indexesItem, const QString & schema, const QString & table)
+void TableTree::buildSysIndexes(SchemaItem *indexesItem, const QString & schema, const QString & table)
 {
-	deleteChildren(indexesItem);
 	QStringList sysIx = Database::getSysIndexes(table, schema);
 	indexesItem->setText(0, trLabel(trSysIndexes).arg(sysIx.size()));
-	indexesItem->setIcon(0, Utils::getIcon("index.png"));
-	indexesItem->setText(1, schema);
-	for (int i = 0; i < sysIx.size(); ++i)
-	{
-		QTreeWidgetItem *indexItem = new QTreeWidgetItem(indexesItem, SysIndexType);
-		indexItem->setText(0, sysIx.at(i));
-		indexItem->setText(1, schema);
-	}
+	m_model->setChildren(indexesItem, SysIndexType, sysIx);
 }
 
-void TableTree::buildTriggers(QTreeWidgetItem *triggersItem, const QString & schema, const QString & table)
+void TableTree::buildTriggers(SchemaItem *triggersItem, const QString & schema, const QString & table)
+{
+	fillTriggers(triggersItem,
+				 Database::getObjects("trigger", schema).values(table));
+}
+
+void TableTree::fillTriggers(SchemaItem * triggersItem,
+							 const QStringList & values)
 {
-	deleteChildren(triggersItem);
-	QStringList values = Database::getObjects("trigger", schema).values(table);
 	triggersItem->setText(0, trLabel(trTriggers).arg(values.size()));
-	triggersItem->setIcon(0, Utils::getIcon("trigger.png"));
-	triggersItem->setText(1, schema);
-	for (int i = 0; i < values.size(); ++i)
-	{
-		QTreeWidgetItem *triggerItem = new QTreeWidgetItem(triggersItem, TriggerType);
-		triggerItem->setText(0, values.at(i));
-		triggerItem->setText(1, schema);
-	}
+	m_model->setChildren(triggersItem, TriggerType, values);
 }
 
-void TableTree::buildViews(QTreeWidgetItem * viewsItem, const QString & schema)
+void TableTree::buildViews(SchemaItem * viewsItem, const QString & schema)
 {
-	deleteChildren(viewsItem);
+	fillViews(viewsItem, Database::getObjects("view", schema).keys());
+}
 
+void TableTree::fillViews(SchemaItem * viewsItem, const QStringList & views)
+{
 	// Build views tree
-	QStringList views = Database::getObjects("view", schema).keys();
 	viewsItem->setText(0, trLabel(trViews).arg(views.size()));
-	viewsItem->setText(1, schema);
-    QStringList::const_iterator i;
-    for (i = views.constBegin(); i != views.constEnd(); ++i) {
-		QTreeWidgetItem * viewItem = new QTreeWidgetItem(viewsItem, ViewType);
-		viewItem->setText(0, *i);
-		viewItem->setText(1, schema);
-		QTreeWidgetItem *triggersItem =
-            new QTreeWidgetItem(viewItem, TriggersItemType);
-		buildTriggers(triggersItem, schema, *i);
+	// each view's triggers are read when it is first expanded
+	m_model->setChildren(viewsItem, ViewType, views);
+	filterGroup(viewsItem);
+}
+
+QString TableTree::signature(const CatalogueSnapshot & catalogue,
+							 const QString & name)
+{
+	QStringList parts;
+	QStringList indexes(catalogue.objectsOf("index").values(name));
+	QStringList triggers(catalogue.objectsOf("trigger").values(name));
+	QStringList::const_iterator i;
+	for (i = indexes.constBegin(); i != indexes.constEnd(); ++i) {
+		parts.append(*i + "\n" + catalogue.sql.value(i->toLower()));
+	}
+	for (i = triggers.constBegin(); i != triggers.constEnd(); ++i) {
+		parts.append(*i + "\n" + catalogue.triggerSql.value(i->toLower()));
 	}
+	parts.sort();
+	parts.prepend(catalogue.sql.value(name.toLower()));
+	return parts.join("\n");
 }
 
-void TableTree::buildCatalogue(QTreeWidgetItem * systemItem, const QString & schema)
+void TableTree::updateDatabase(SchemaItem * dbItem, const QString & schema)
 {
-	deleteChildren(systemItem);
+	CatalogueRef before = m_shown.value(schema);
+	CatalogueRef now = Catalogue::snapshot(schema);
+	// the catalogue hands out the same snapshot until the schema changes
+	if (!now || (now == before)) { return; }
+	m_shown.insert(schema, now);
 
-	QStringList values = Database::getSysObjects(schema).keys();
-	systemItem->setText(0, trLabel(trSys).arg(values.size()));
-	systemItem->setText(1, schema);
-    QStringList::const_iterator i;
-    for (i = values.constBegin(); i != values.constEnd(); ++i) {
-		QTreeWidgetItem * sysItem = new QTreeWidgetItem(systemItem, SystemType);
-		sysItem->setText(0, *i);
-		sysItem->setText(1, schema);
+	for (int i = 0; i < dbItem->childCount(); ++i)
+	{
+		SchemaItem * item = dbItem->child(i);
+		switch (item->type())
+		{
+			case TablesItemType:
+				updateTables(item, before, now);
+				break;
+			case ViewsItemType:
+				updateViews(item, before, now);
+				break;
+			case SystemItemType:
+				if (!before || (before->system != now->system))
+				{
+					fillCatalogue(item, now->system.keys());
+				}
+				break;
+		}
 	}
 }
 
+/* The names under tablesItem and viewsItem are in the same order as the
+ * catalogue's keys, so the new list can be merged into them. Names are
+ * compared with the tree as it is, rather than with the old snapshot,
+ * because other things may have rebuilt parts of it since. Only the
+ * items which have been made can have been read, so only those are
+ * looked at.
+ */
+void TableTree::updateTables(SchemaItem * tablesItem,
+							 const CatalogueRef & before,
+							 const CatalogueRef & now)
+{
+	QStringList tables(now->objectsOf("table").keys());
+	QStringList shown(m_model->names(tablesItem));
+	int position = 0;
+	int j = 0;
+	int k = 0;
+	while ((k < shown.size()) || (j < tables.size()))
+	{
+		if (   (k < shown.size())
+			&& ((j >= tables.size()) || (shown.at(k) < tables.at(j))))
+		{
+			// dropped
+			m_model->removeName(tablesItem, position);
+			++k;
+		}
+		else if ((k >= shown.size()) || (tables.at(j) < shown.at(k)))
+		{
+			// created
+			m_model->insertName(tablesItem, position++, tables.at(j++));
+		}
+		else
+		{
+			// still there, but the columns, indexes or triggers may differ
+			SchemaItem * item = m_model->madeChildAt(tablesItem, position);
+			if (   item
+				&& m_model->isFilled(item)
+				&& (   !before
+					|| (signature(*before, item->text(0))
+						!= signature(*now, item->text(0)))))
+			{
+				reloadTableItem(item);
+			}
+			++position;
+			++j;
+			++k;
+		}
+	}
+	tablesItem->setText(0, trLabel(trTables).arg(tables.size()));
+	filterGroup(tablesItem);
+}
+
+void TableTree::updateViews(SchemaItem * viewsItem,
+							const CatalogueRef & before,
+							const CatalogueRef & now)
+{
+	QStringList views(now->objectsOf("view").keys());
+	DbObjects triggers(now->objectsOf("trigger"));
+	QStringList shown(m_model->names(viewsItem));
+	int position = 0;
+	int j = 0;
+	int k = 0;
+	while ((k < shown.size()) || (j < views.size()))
+	{
+		if (   (k < shown.size())
+			&& ((j >= views.size()) || (shown.at(k) < views.at(j))))
+		{
+			m_model->removeName(viewsItem, position);
+			++k;
+		}
+		else if ((k >= shown.size()) || (views.at(j) < shown.at(k)))
+		{
+			m_model->insertName(viewsItem, position++, views.at(j++));
+		}
+		else
+		{
+			SchemaItem * item = m_model->madeChildAt(viewsItem, position);
+			if (   item
+				&& m_model->isFilled(item)
+				&& (   !before
+					|| (signature(*before, item->text(0))
+						!= signature(*now, item->text(0)))))
+			{
+				fillTriggers(item->child(0), triggers.values(item->text(0)));
+			}
+			++position;
+			++j;
+			++k;
+		}
+	}
+	viewsItem->setText(0, trLabel(trViews).arg(views.size()));
+	filterGroup(viewsItem);
+}
+
+void TableTree::setFilter(const QString & text)
+{
+	m_filter = text.trimmed();
+	setUpdatesEnabled(false);
+	for (int i = 0; i < topLevelItemCount(); ++i)
+	{
+		SchemaItem * dbItem = topLevelItem(i);
+		for (int j = 0; j < dbItem->childCount(); ++j)
+		{
+			filterGroup(dbItem->child(j));
+		}
+	}
+	setUpdatesEnabled(true);
+}
+
+void TableTree::filterGroup(SchemaItem * group)
+{
+	bool tables = group->type() == TablesItemType;
+	if (!tables && (group->type() != ViewsItemType)) { return; }
+	if (m_filter.isEmpty())
+	{
+		m_model->filter(group, 0);
+		return;
+	}
+
+	// the indexes are only made again when the schema has changed
+	QString schema(group->text(1));
+	CatalogueRef catalogue = Catalogue::snapshot(schema);
+	if (!catalogue) { return; }
+	Names & names = m_names[schema];
+	if (names.catalogue != catalogue)
+	{
+		names.catalogue = catalogue;
+		names.tables = NameIndex(catalogue->objectsOf("table").keys());
+		names.views = NameIndex(catalogue->objectsOf("view").keys());
+	}
+	QStringList found((tables ? names.tables : names.views).match(m_filter));
+	QSet<QString> matched;
+	matched.reserve(found.size());
+	QStringList::const_iterator i;
+	for (i = found.constBegin(); i != found.constEnd(); ++i) {
+		matched.insert(*i);
+	}
+	// the rows left out are taken out of the model rather than hidden
+	m_model->filter(group, &matched);
+	if (!matched.isEmpty()) { setItemExpanded(group, true); }
+}
 
-void TableTree::deleteChildren(QTreeWidgetItem * item)
+void TableTree::reloadTableItem(SchemaItem * tableItem)
 {
-	QList<QTreeWidgetItem *> items = item->takeChildren();
-    QList<QTreeWidgetItem *>::const_iterator i;
-    for (i = items.constBegin(); i != items.constEnd(); ++i) {
-        // *i is a const pointer, but not a pointer to const
-		delete *i;
+	// keep the Columns, Indexes etc. which were open open
+	QList<int> expanded;
+	for (int i = 0; i < tableItem->childCount(); ++i)
+	{
+		if (isItemExpanded(tableItem->child(i)))
+		{
+			expanded.append(tableItem->child(i)->type());
+		}
 	}
+	buildTableItem(tableItem, true);
+	for (int i = 0; i < tableItem->childCount(); ++i)
+	{
+		if (expanded.contains(tableItem->child(i)->type()))
+		{
+			setItemExpanded(tableItem->child(i), true);
+		}
+	}
+}
+
+void TableTree::buildCatalogue(SchemaItem * systemItem, const QString & schema)
+{
+	fillCatalogue(systemItem, Database::getSysObjects(schema).keys());
+}
+
+void TableTree::fillCatalogue(SchemaItem * systemItem,
+							  const QStringList & values)
+{
+	systemItem->setText(0, trLabel(trSys).arg(values.size()));
+	m_model->setChildren(systemItem, SystemType, values);
 }
 
+
 QString TableTree::trLabel(const QString & trStr)
 {
 	return trStr + " (%1)";
 }
 
-QList<QTreeWidgetItem*> TableTree::searchMask(const QString & trStr)
+void TableTree::findLabels(SchemaItem * item, const QString & label,
+						   QList<SchemaItem*> & result)
 {
-	return findItems(trStr + " (", Qt::MatchStartsWith | Qt::MatchRecursive, 0);
+	// the items which haven't been made yet are only names, not groups
+	QStringList names(m_model->names(item));
+	for (int i = 0; i < names.size(); ++i)
+	{
+		SchemaItem * child = m_model->madeChildAt(item, i);
+		if (!child) { continue; }
+		if (child->text(0).startsWith(label)) { result.append(child); }
+		findLabels(child, label, result);
+	}
+}
+
+QList<SchemaItem*> TableTree::searchMask(const QString & trStr)
+{
+	QString label(trStr + " (");
+	QList<SchemaItem*> result;
+	if (   (trStr != trTables) && (trStr != trViews) && (trStr != trSys))
+	{
+		for (int i = 0; i < topLevelItemCount(); ++i)
+		{
+			findLabels(topLevelItem(i), label, result);
+		}
+		return result;
+	}
+	// these are always just under the databases, so don't look any deeper
+	for (int i = 0; i < topLevelItemCount(); ++i)
+	{
+		SchemaItem * dbItem = topLevelItem(i);
+		for (int j = 0; j < dbItem->childCount(); ++j)
+		{
+			if (dbItem->child(j)->text(0).startsWith(label))
+			{
+				result.append(dbItem->child(j));
+			}
+		}
+	}
+	return result;
 }
 
 void TableTree::buildViewTree(QString schema, QString name)
@@ -252,24 +970,22 @@ void TableTree::buildViewTree(QString schema, QString name)
         /* Handle the special case where we created a temp view
          * and the temp database was not previously shown. */
         QStringList databases(Database::getDatabases().keys());
-        QList<QTreeWidgetItem *> schemas =
-            findItems("temp", Qt::MatchFixedString);
         if (   databases.contains("temp", Qt::CaseInsensitive)
-            && schemas.isEmpty())
+            && !findDatabase("temp"))
         {
             buildDatabase("temp");
-            lastViewsItem->setExpanded(true);
+            setItemExpanded(lastViewsItem, true);
             return;
         }
     }
-    QList<QTreeWidgetItem*> l = searchMask(trViews);
-    QList<QTreeWidgetItem*>::const_iterator i;
+    QList<SchemaItem*> l = searchMask(trViews);
+    QList<SchemaItem*>::const_iterator i;
     for (i = l.constBegin(); i != l.constEnd(); ++i) {
-        QTreeWidgetItem* item = *i;
+        SchemaItem* item = *i;
 		if (item->text(1) == schema && item->type() == ViewsItemType)
         {
 			buildViews(item, schema);
-            item->setExpanded(true);
+            setItemExpanded(item, true);
             break;
         }
 	}
@@ -281,23 +997,21 @@ void TableTree::buildTableTree(QString schema)
         /* Handle the special case where we created a temp table
          * and the temp database was not previously shown. */
         QStringList databases(Database::getDatabases().keys());
-        QList<QTreeWidgetItem *> schemas =
-            findItems("temp", Qt::MatchFixedString);
         if (   databases.contains("temp", Qt::CaseInsensitive)
-            && schemas.isEmpty())
+            && !findDatabase("temp"))
         {
             buildDatabase("temp");
-            lastTablesItem->setExpanded(true);
+            setItemExpanded(lastTablesItem, true);
             return;
         }
     }
-    QList<QTreeWidgetItem*> l = searchMask(trTables);
-    QList<QTreeWidgetItem*>::const_iterator i;
+    QList<SchemaItem*> l = searchMask(trTables);
+    QList<SchemaItem*>::const_iterator i;
     for (i = l.constBegin(); i != l.constEnd(); ++i) {
-        QTreeWidgetItem* item = *i;
+        SchemaItem* item = *i;
 		if (item->text(1) == schema && item->type() == TablesItemType) {
 			buildTables(item, schema, true);
-            item->setExpanded(true);
+            setItemExpanded(item, true);
             break;
         }
 	}
@@ -309,7 +1023,7 @@ void TableTree::mousePressEvent(QMouseEvent *event)
 		m_dragStartPosition = event->pos();
         m_pressed = true;
     }
-	QTreeWidget::mousePressEvent(event);
+	QTreeView::mousePressEvent(event);
 }
 
 // If we drag an item from the schema browser,
@@ -343,7 +1057,7 @@ void TableTree::mouseMoveEvent(QMouseEvent *event)
         }
     }
 #endif
-	QTreeWidget::mouseMoveEvent(event);
+	QTreeView::mouseMoveEvent(event);
 }
 
 void TableTree::mouseReleaseEvent(QMouseEvent *event)
@@ -365,5 +1079,5 @@ void TableTree::mouseReleaseEvent(QMouseEvent *event)
             }
         }
     }
-	QTreeWidget::mouseReleaseEvent(event);
+	QTreeView::mouseReleaseEvent(event);
 }
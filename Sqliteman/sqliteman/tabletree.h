@@ -8,47 +8,85 @@ for which a new license (GPL+exception) is in place.
 #ifndef TABLETREE_H
 #define TABLETREE_H
 
-#include <QTreeWidget>
+#include <QtCore/QMap>
+#include <QtCore/QThreadPool>
+#include <QtCore/QTimer>
+#include <QTreeView>
+
+#include "catalogue.h"
+#include "nameindex.h"
+#include "schemamodel.h"
+#include "tablestats.h"
+
+/*! \brief What is shown under a table item, read in one query. */
+typedef struct
+{
+	QString schema;
+	QString table;
+	QStringList columns;
+	QList<bool> keys; //!< for each column, is it part of the primary key
+	QStringList indexes;
+	QStringList sysIndexes;
+	QStringList triggers;
+	int generation; //!< which buildTree() it was asked for
+	bool ok;
+}
+TableContents;
 
 
 /*! \brief Schema browser.
-A tree structure containing sorted database objects.
+A tree structure containing sorted database objects, shown from a
+SchemaModel which only makes an item for a name when it is shown.
+Each schema is listed from one query of its sqlite_master. The columns,
+indexes and triggers of a table are only read when its item is first
+expanded, on a read only connection of its own on a worker thread when
+the GUI's connection has nothing uncommitted which it wouldn't see.
+buildTree() doesn't start again from nothing: it compares each schema's
+catalogue snapshot with the one it last showed, and only adds, removes
+or reloads the items which have changed, so expanded items stay so.
+setFilter() leaves out the tables and views whose names don't match,
+looking them up in a NameIndex of each schema's names.
+The tooltips of tables and indexes give their sizes: see TableStats.
+These are counted on another worker thread with connections of its own,
+and kept until the data may have changed.
 \author Petr Vanek <petr@scribus.info>
 */
-class TableTree : public QTreeWidget
+class TableTree : public QTreeView
 {
 		Q_OBJECT
 	public:
-		static const int TablesItemType = QTreeWidgetItem::UserType;
-		static const int ViewsItemType = QTreeWidgetItem::UserType + 1;
-		static const int TableType = QTreeWidgetItem::UserType + 2;
-		static const int ViewType = QTreeWidgetItem::UserType + 3;
-		static const int IndexesItemType = QTreeWidgetItem::UserType + 4;
-		static const int IndexType = QTreeWidgetItem::UserType + 5;
-		static const int TriggersItemType = QTreeWidgetItem::UserType + 6;
-		static const int TriggerType = QTreeWidgetItem::UserType + 7;
-		static const int SystemItemType = QTreeWidgetItem::UserType + 8;
-		static const int SystemType = QTreeWidgetItem::UserType + 9;
-		static const int DatabaseItemType = QTreeWidgetItem::UserType + 10;
-		static const int SysIndexesItemType = QTreeWidgetItem::UserType + 11;
-		static const int SysIndexType = QTreeWidgetItem::UserType + 12;
-		static const int ColumnType = QTreeWidgetItem::UserType + 13;
-		static const int ColumnItemType = QTreeWidgetItem::UserType + 14;
+		static const int TablesItemType = SchemaItem::UserType;
+		static const int ViewsItemType = SchemaItem::UserType + 1;
+		static const int TableType = SchemaItem::UserType + 2;
+		static const int ViewType = SchemaItem::UserType + 3;
+		static const int IndexesItemType = SchemaItem::UserType + 4;
+		static const int IndexType = SchemaItem::UserType + 5;
+		static const int TriggersItemType = SchemaItem::UserType + 6;
+		static const int TriggerType = SchemaItem::UserType + 7;
+		static const int SystemItemType = SchemaItem::UserType + 8;
+		static const int SystemType = SchemaItem::UserType + 9;
+		static const int DatabaseItemType = SchemaItem::UserType + 10;
+		static const int SysIndexesItemType = SchemaItem::UserType + 11;
+		static const int SysIndexType = SchemaItem::UserType + 12;
+		static const int ColumnType = SchemaItem::UserType + 13;
+		static const int ColumnItemType = SchemaItem::UserType + 14;
 
 		TableTree(QWidget * parent = 0);
-		~TableTree(){};
+		~TableTree();
 
-		void buildDatabase(QTreeWidgetItem * dbItem, const QString & schema);
+		void buildDatabase(SchemaItem * dbItem, const QString & schema);
 		void buildDatabase(const QString & schema);
-		void buildTableItem(QTreeWidgetItem * tableItem, bool rebuild);
-		void buildTables(QTreeWidgetItem * tablesItem,
+		/*! \brief Fill \a tableItem, or a view item, now if it hasn't been yet.
+		\param rebuild fill it again even if it has */
+		void buildTableItem(SchemaItem * tableItem, bool rebuild);
+		void buildTables(SchemaItem * tablesItem,
                          const QString & schema, bool expand);
-		void buildIndexes(QTreeWidgetItem *indexesItem, const QString & schema, const QString & table);
-		void buildColumns(QTreeWidgetItem * columnsItem, const QString & schema, const QString & table);
-		void buildSysIndexes(QTreeWidgetItem *indexesItem, const QString & schema, const QString & table);
-		void buildTriggers(QTreeWidgetItem *triggersItem, const QString & schema, const QString & table);
-		void buildViews(QTreeWidgetItem * viewsItem, const QString & schema);
-		void buildCatalogue(QTreeWidgetItem * systemItem, const QString & schema);
+		void buildIndexes(SchemaItem *indexesItem, const QString & schema, const QString & table);
+		void buildColumns(SchemaItem * columnsItem, const QString & schema, const QString & table);
+		void buildSysIndexes(SchemaItem *indexesItem, const QString & schema, const QString & table);
+		void buildTriggers(SchemaItem *triggersItem, const QString & schema, const QString & table);
+		void buildViews(SchemaItem * viewsItem, const QString & schema);
+		void buildCatalogue(SchemaItem * systemItem, const QString & schema);
 		QString trDatabase;
 		QString trTables;
 		QString trIndexes;
@@ -58,16 +96,123 @@ class TableTree : public QTreeWidget
 		QString trSys;
 		QString trCols;
 
-		QList<QTreeWidgetItem*> searchMask(const QString & trStr);
+		QList<SchemaItem*> searchMask(const QString & trStr);
+		//! \brief The item of \a table in \a schema, or 0
+		SchemaItem * findTable(const QString & schema, const QString & table);
+
+		int topLevelItemCount() const;
+		SchemaItem * topLevelItem(int row) const;
+		SchemaItem * currentItem() const;
+		void setCurrentItem(SchemaItem * item);
+		QList<SchemaItem *> selectedItems() const;
+		SchemaItem * itemAt(const QPoint & pos) const;
+		bool isItemExpanded(SchemaItem * item) const;
+		void setItemExpanded(SchemaItem * item, bool expanded);
+		//! \brief Remove \a item and its children, and delete them
+		void removeItem(SchemaItem * item);
+		void clear();
+
+		/*! \brief Close the worker's connections.
+		Call it before closing the database, so that they don't keep the
+		file open. */
+		void closeReaders();
+
+		/*! \brief Read the contents of a table item into \a contents.
+		\param db the connection to use
+		\param dbSchema the name of contents.schema on \a db */
+		static void readTable(sqlite3 * db, const QString & dbSchema,
+							  TableContents & contents);
         
+	signals:
+		//! \brief Like QTreeWidget::itemActivated()
+		void itemActivated(SchemaItem * item, int column);
+		void itemSelectionChanged();
+
 	public slots:
+		//! \brief Bring the whole tree up to date now.
 		void buildTree();
+		/*! \brief Bring the whole tree up to date when control returns to
+		the event loop, once however many times it is called before then. */
+		void refresh();
+		//! \brief Only show the tables and views whose names match \a text.
+		void setFilter(const QString & text);
 		void buildViewTree(QString schema, QString name);
 		void buildTableTree(QString schema);
 
+	private slots:
+		void loadExpanded(const QPersistentModelIndex & index);
+		void tableLoaded();
+		void indexActivated(const QModelIndex & index);
+		void statsLoaded();
+
+	protected:
+		bool viewportEvent(QEvent * event);
+
 	private:
-		void deleteChildren(QTreeWidgetItem * item);
 		QString trLabel(const QString & trStr);
+		SchemaItem * findDatabase(const QString & schema);
+		//! \brief Add the items under \a item whose text starts with \a label
+		void findLabels(SchemaItem * item, const QString & label,
+						QList<SchemaItem*> & result);
+		void fillTables(SchemaItem * tablesItem, const QStringList & tables);
+		void fillViews(SchemaItem * viewsItem, const QStringList & views);
+		void fillTriggers(SchemaItem * triggersItem, const QStringList & values);
+		void updateDatabase(SchemaItem * dbItem, const QString & schema);
+		void updateTables(SchemaItem * tablesItem,
+						  const CatalogueRef & before,
+						  const CatalogueRef & now);
+		void updateViews(SchemaItem * viewsItem,
+						 const CatalogueRef & before,
+						 const CatalogueRef & now);
+		void reloadTableItem(SchemaItem * tableItem);
+		//! \brief Apply the filter to the tables or views under \a group
+		void filterGroup(SchemaItem * group);
+		/*! \brief What the children of the item for \a name depend on:
+		its own CREATE statement and those of its indexes and triggers */
+		static QString signature(const CatalogueSnapshot & catalogue,
+								 const QString & name);
+		void fillCatalogue(SchemaItem * systemItem, const QStringList & values);
+		void fillTableItem(SchemaItem * tableItem,
+						   const TableContents & contents);
+		//! \brief Give a view item its Triggers, from the catalogue
+		void fillViewItem(SchemaItem * viewItem);
+		//! \brief Fill a table or view item which has been expanded
+		void loadItem(SchemaItem * item);
+		/*! \brief The file a worker can read \a schema from, or null if
+		it must be read on the GUI's connection */
+		QString readerFile(const QString & schema);
+		//! \brief Give \a item the statistics known, and ask for more
+		void updateStats(SchemaItem * item);
+		static QString statsKey(const QString & schema, const QString & name);
+
+		SchemaModel * m_model;
+		//! \brief The tables being read, by statsKey()
+		QSet<QString> m_loading;
+
+		//! \brief One thread, so the readers are used one at a time
+		QThreadPool m_loader;
+		//! \brief Read only connections by file name, used by m_loader
+		QMap<QString, sqlite3 *> m_readers;
+		int m_generation;
+		//! \brief Another thread and connections for counting rows
+		QThreadPool m_statsLoader;
+		QMap<QString, sqlite3 *> m_statsReaders;
+		QAtomicInt m_cancelStats;
+		//! \brief by statsKey()
+		QHash<QString, ObjectStats> m_stats;
+		//! \brief What each schema's items were last built from
+		QMap<QString, CatalogueRef> m_shown;
+		QTimer m_refreshTimer;
+
+		typedef struct
+		{
+			CatalogueRef catalogue; //!< what the indexes were made from
+			NameIndex tables;
+			NameIndex views;
+		}
+		Names;
+		QString m_filter;
+		QMap<QString, Names> m_names; //!< by schema
 
 		QPoint m_dragStartPosition;
         bool m_pressed;
@@ -77,8 +222,8 @@ class TableTree : public QTreeWidget
         void mouseReleaseEvent(QMouseEvent *event);
 
         // these are only valid immediately after a call to buildDatabase()
-        QTreeWidgetItem * lastTablesItem;
-        QTreeWidgetItem * lastViewsItem;
+        SchemaItem * lastTablesItem;
+        SchemaItem * lastViewsItem;
 };
 
 #endif
@@ -45,6 +45,13 @@ bool Utils::detaches(const QString & sql)
 		    || tmp.contains("EXEC")); // crude, but will work for now
 }
 
+bool Utils::rollsBack(const QString & sql)
+{
+	if (sql.isNull())
+		return false;
+	return sql.trimmed().startsWith("ROLLBACK", Qt::CaseInsensitive);
+}
+
 bool Utils::updateObjectTree(const QString & sql)
 {
 	if (sql.isNull())
@@ -55,6 +62,7 @@ bool Utils::updateObjectTree(const QString & sql)
 			|| tmp.startsWith("CREATE")
 			|| tmp.startsWith("DETACH")
 			|| tmp.startsWith("DROP")
+			|| tmp.startsWith("ROLLBACK")
 		    || tmp.contains("EXEC")); // crude, but will work for now
 }
 
@@ -107,6 +115,17 @@ QString Utils::unQuote(QString s)
 }
 #endif
 
+QString Utils::rowidAlias(const QStringList & columns)
+{
+	QStringList lower;
+	foreach (QString c, columns) { lower.append(c.toLower()); }
+	foreach (QString alias, QStringList() << "rowid" << "_rowid_" << "oid")
+	{
+		if (!lower.contains(alias)) { return alias; }
+	}
+	return QString();
+}
+
 QString Utils::like(QString s)
 {
 	return "'%"
@@ -55,6 +55,9 @@ namespace Utils {
     //! \brief Check if sql statement could detach a database
     bool detaches(const QString & sql);
 
+    //! \brief Check if sql statement is a ROLLBACK, of a savepoint or not
+    bool rollsBack(const QString & sql);
+
     //! \brief Check if the object tree should be refilled depending on sql statement
     bool updateObjectTree(const QString & sql);
 
@@ -77,6 +80,10 @@ namespace Utils {
     QString like(QString s);
     QString startswith(QString s);
 
+    /*! \brief A name for the rowid of a table with \a columns which isn't
+    hidden by one of them, or a null string if they all are */
+    QString rowidAlias(const QStringList & columns);
+
     void setColumnWidths(QTableView * tv);
 }
 #endif